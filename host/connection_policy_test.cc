@@ -0,0 +1,242 @@
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+//
+// 接続パラメータの段階の移行 (ホスト環境)
+// BleConnectionPolicy単体の判定と、GattStandIn・仮想時間のesp_timerで
+// BleClockServiceを動かした場合の変更要求の時刻を確認する
+// 接続・Read毎に BULK → INTERACTIVE (2s後) → IDLE (30s後) の順で要求され、
+// 複数の接続でも各接続の移行時刻に要求されなければ終了コード1
+//
+//   cmake -S host -B build_host && cmake --build build_host
+//   ./build_host/connection_policy_test [-v]
+
+// Include ----------------------
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "ble_connection_policy.h"
+#include "ble_device.h"
+#include "ble_services.h"
+#include "gatt_stand_in.h"
+
+using namespace HareTortoiseClockSystem;
+
+namespace {
+
+/// 接続時のパラメータ (gatt_stand_in.cc と同じ)
+constexpr uint16_t CONNECT_INTERVAL = 24;
+constexpr uint16_t CONNECT_LATENCY = 0;
+constexpr uint16_t CONNECT_TIMEOUT = 400;
+
+/// 仮想時間の刻み(us)
+constexpr int64_t STEP_US = 10000;
+constexpr int64_t INTERACTIVE_AFTER_US =
+    BleConnectionPolicy::INTERACTIVE_AFTER_US;
+constexpr int64_t IDLE_AFTER_US = BleConnectionPolicy::IDLE_AFTER_US;
+
+/// 2台目の接続・1台目のReadの時刻(us)
+constexpr int64_t SECOND_CONNECT_US = 10 * 1000 * 1000;
+constexpr int64_t FIRST_READ_US = 45 * 1000 * 1000;
+/// 模擬する時間(us)
+constexpr int64_t SIMULATED_US = FIRST_READ_US + IDLE_AFTER_US + 5 * 1000 * 1000;
+
+constexpr uint16_t FIRST_CONN_ID = 0;
+constexpr uint16_t SECOND_CONN_ID = 1;
+
+/// 変更要求 (期待値・記録)
+struct Request {
+  int64_t time_us;
+  uint16_t conn_id;
+  BleConnectionPolicy::Phase phase;
+};
+
+bool Check(const bool condition, const char *const name) {
+  std::printf("%-36s %s\n", name, condition ? "ok" : "NG");
+  return condition;
+}
+
+/// 要求された接続パラメータの段階
+BleConnectionPolicy::Phase ToPhase(const esp_ble_conn_update_params_t &params) {
+  for (const BleConnectionPolicy::Phase phase :
+       {BleConnectionPolicy::PHASE_BULK, BleConnectionPolicy::PHASE_INTERACTIVE,
+        BleConnectionPolicy::PHASE_IDLE}) {
+    const BleConnectionParams &expected = BleConnectionPolicy::GetParams(phase);
+    if (params.min_int == expected.min_interval &&
+        params.max_int == expected.max_interval &&
+        params.latency == expected.latency &&
+        params.timeout == expected.timeout) {
+      return phase;
+    }
+  }
+  return BleConnectionPolicy::PHASE_NONE;
+}
+
+/// BleConnectionPolicy単体
+bool CheckPolicy() {
+  bool is_ok = true;
+  BleConnectionPolicy policy;
+  BleConnectionParams request = {};
+  const int64_t start_us = 1000;
+  policy.Reset(start_us, CONNECT_INTERVAL, CONNECT_LATENCY, CONNECT_TIMEOUT);
+
+  // 接続直後はBULK 結果の通知までは次の要求を行わない
+  is_ok &= Check(policy.Poll(start_us, &request) &&
+                     request.max_interval ==
+                         BleConnectionPolicy::GetParams(
+                             BleConnectionPolicy::PHASE_BULK)
+                             .max_interval &&
+                     !policy.Poll(start_us + IDLE_AFTER_US, &request),
+                 "bulk on connect, one request pending");
+  policy.OnUpdated(true, request.max_interval, request.latency,
+                   request.timeout);
+  is_ok &= Check(policy.GetStats().phase == BleConnectionPolicy::PHASE_BULK &&
+                     policy.GetNextCheckDelayUs(start_us) ==
+                         INTERACTIVE_AFTER_US,
+                 "bulk applied, next check at 2s");
+
+  // 2s後にINTERACTIVE
+  is_ok &= Check(!policy.Poll(start_us + INTERACTIVE_AFTER_US - 1, &request) &&
+                     policy.Poll(start_us + INTERACTIVE_AFTER_US, &request) &&
+                     request.max_interval ==
+                         BleConnectionPolicy::GetParams(
+                             BleConnectionPolicy::PHASE_INTERACTIVE)
+                             .max_interval,
+                 "interactive at 2s");
+  policy.OnUpdated(true, request.max_interval, request.latency,
+                   request.timeout);
+  is_ok &= Check(policy.GetNextCheckDelayUs(start_us + INTERACTIVE_AFTER_US) ==
+                     IDLE_AFTER_US - INTERACTIVE_AFTER_US,
+                 "next check at 30s");
+
+  // 拒否された段階は再要求しない
+  is_ok &= Check(policy.Poll(start_us + IDLE_AFTER_US, &request) &&
+                     request.latency ==
+                         BleConnectionPolicy::GetParams(
+                             BleConnectionPolicy::PHASE_IDLE)
+                             .latency,
+                 "idle at 30s");
+  const BleConnectionPolicy::Stats before = policy.GetStats();
+  policy.OnUpdated(false, before.interval, before.latency, before.timeout);
+  is_ok &= Check(!policy.Poll(start_us + IDLE_AFTER_US * 2, &request) &&
+                     policy.GetStats().phase ==
+                         BleConnectionPolicy::PHASE_INTERACTIVE &&
+                     policy.GetStats().reject_count == 1 &&
+                     policy.GetNextCheckDelayUs(start_us + IDLE_AFTER_US) < 0,
+                 "rejected idle not requested again");
+
+  // 操作でBULKへ戻る
+  const int64_t activity_us = start_us + IDLE_AFTER_US * 2;
+  policy.OnActivity(activity_us);
+  is_ok &= Check(policy.Poll(activity_us, &request) &&
+                     request.max_interval ==
+                         BleConnectionPolicy::GetParams(
+                             BleConnectionPolicy::PHASE_BULK)
+                             .max_interval &&
+                     policy.GetNextCheckDelayUs(activity_us) ==
+                         INTERACTIVE_AFTER_US,
+                 "activity returns to bulk");
+  return is_ok;
+}
+
+/// GattStandIn経由のBleClockService (接続毎の移行時刻)
+bool CheckService(const bool is_verbose) {
+  BleServiceInterfaceSharedPtr service =
+      std::make_shared<BleClockService>(0, CLOCK_SERVICE_UUID.ToEspBtUuid());
+  service->AddCharacteristic(std::make_shared<BleStatusCharacteristic>(
+      STATUS_CHARACTERISTIC_UUID.ToEspBtUuid(), ESP_GATT_CHAR_PROP_BIT_READ));
+
+  GattStandIn *const stand_in = GattStandIn::GetInstance();
+  BleDevice *const ble_device = BleDevice::GetInstance();
+  ble_device->Initialize();
+  ble_device->AddService(service);
+  ble_device->StartAdvertising();
+  stand_in->Pump();
+  const uint16_t status_handle =
+      stand_in->FindValueHandle(STATUS_CHARACTERISTIC_UUID.ToEspBtUuid());
+  if (status_handle == 0) {
+    return Check(false, "attribute table registered");
+  }
+
+  const int64_t start_us = esp_timer_get_time();
+  const std::vector<Request> expected = {
+      {0, FIRST_CONN_ID, BleConnectionPolicy::PHASE_BULK},
+      {INTERACTIVE_AFTER_US, FIRST_CONN_ID,
+       BleConnectionPolicy::PHASE_INTERACTIVE},
+      {SECOND_CONNECT_US, SECOND_CONN_ID, BleConnectionPolicy::PHASE_BULK},
+      // 1台目のIDLEへのタイマーより早い
+      {SECOND_CONNECT_US + INTERACTIVE_AFTER_US, SECOND_CONN_ID,
+       BleConnectionPolicy::PHASE_INTERACTIVE},
+      {IDLE_AFTER_US, FIRST_CONN_ID, BleConnectionPolicy::PHASE_IDLE},
+      {SECOND_CONNECT_US + IDLE_AFTER_US, SECOND_CONN_ID,
+       BleConnectionPolicy::PHASE_IDLE},
+      {FIRST_READ_US, FIRST_CONN_ID, BleConnectionPolicy::PHASE_BULK},
+      {FIRST_READ_US + INTERACTIVE_AFTER_US, FIRST_CONN_ID,
+       BleConnectionPolicy::PHASE_INTERACTIVE},
+      {FIRST_READ_US + IDLE_AFTER_US, FIRST_CONN_ID,
+       BleConnectionPolicy::PHASE_IDLE},
+  };
+  std::vector<Request> requests;
+  requests.reserve(expected.size() * 2);
+  bool is_ok = true;
+  uint32_t last_count = stand_in->GetCounters().conn_params_requests;
+
+  stand_in->Connect(FIRST_CONN_ID);
+  for (int64_t elapsed_us = 0; elapsed_us <= SIMULATED_US;
+       elapsed_us += STEP_US) {
+    if (elapsed_us == SECOND_CONNECT_US) {
+      stand_in->Connect(SECOND_CONN_ID);
+    }
+    if (elapsed_us == FIRST_READ_US) {
+      is_ok &= stand_in->Read(FIRST_CONN_ID, status_handle) == ESP_GATT_OK;
+    }
+    stand_in->Pump();
+    // 1刻みに1要求まで (同じ刻みの要求は取りこぼすため失敗とする)
+    const uint32_t count = stand_in->GetCounters().conn_params_requests;
+    if (count != last_count) {
+      const GattStandIn::ConnParamsRequest &last =
+          stand_in->GetLastConnParamsRequest();
+      requests.push_back(
+          {last.time_us - start_us, last.conn_id, ToPhase(last.params)});
+      is_ok &= count == last_count + 1;
+      last_count = count;
+    }
+    HostTimer::Advance(STEP_US);
+  }
+
+  is_ok &= requests.size() == expected.size();
+  for (size_t i = 0; i < std::max(requests.size(), expected.size()); ++i) {
+    const bool has_request = i < requests.size();
+    const bool has_expected = i < expected.size();
+    const bool is_match =
+        has_request && has_expected &&
+        requests[i].conn_id == expected[i].conn_id &&
+        requests[i].phase == expected[i].phase &&
+        requests[i].time_us == expected[i].time_us;
+    is_ok &= is_match;
+    if (is_verbose || !is_match) {
+      const Request &request = has_request ? requests[i] : expected[i];
+      std::printf("  %8.2fs conn_id:%u %-11s (expected %.2fs) %s\n",
+                  has_request ? request.time_us / 1e6 : -1.0, request.conn_id,
+                  BleConnectionPolicy::GetPhaseName(request.phase),
+                  has_expected ? expected[i].time_us / 1e6 : -1.0,
+                  is_match ? "" : "<");
+    }
+  }
+  return Check(is_ok, "service requests at each phase change");
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const bool is_verbose = 1 < argc && std::strcmp(argv[1], "-v") == 0;
+  esp_log_level_set("*", is_verbose ? ESP_LOG_INFO : ESP_LOG_WARN);
+  bool is_ok = CheckPolicy();
+  is_ok = CheckService(is_verbose) && is_ok;
+  return is_ok ? 0 : 1;
+}
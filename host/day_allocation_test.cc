@@ -0,0 +1,189 @@
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+//
+// 1日分の運転でのヒープ確保回数 (ホスト環境)
+// operator new・malloc/calloc/reallocをHeapAuditの確保フックへ接続し、時刻設定後の定常状態
+// (毎分の移動・毎時の戻り・12時間毎の原点復帰) を早送りで1日分実行する
+// 時計管理・モーター制御タスクで確保が発生した場合・時間内に1日分進まない場合・
+// 記録した針位置と模擬の位置が異なる場合は終了コード1
+//
+//   cmake -S host -B build_host && cmake --build build_host
+//   ./build_host/day_allocation_test [-v]
+
+// Include ----------------------
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <new>
+
+#include "clock_management_task.h"
+#include "gpio_control.h"
+#include "hand_mechanism.h"
+#include "hare_tortoise_clock_interface.h"
+#include "heap_audit.h"
+#include "host_clock.h"
+#include "util.h"
+
+using namespace HareTortoiseClockSystem;
+
+/// ESP-IDFのheap hookと同じ関数へ通知 (heap_audit.cc)
+extern "C" void esp_heap_trace_alloc_hook(void *ptr, size_t size,
+                                          uint32_t caps);
+
+/// mallocの系統はリンカの--wrapで置き換える (CMakeLists.txt)
+/// このテストとmain/ のコードからの呼び出しが対象 (libc・libstdc++の内部は対象外)
+extern "C" {
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(const size_t size) {
+  void *const ptr = __real_malloc(size);
+  if (ptr) {
+    esp_heap_trace_alloc_hook(ptr, size, 0);
+  }
+  return ptr;
+}
+
+void *__wrap_calloc(const size_t count, const size_t size) {
+  void *const ptr = __real_calloc(count, size);
+  if (ptr) {
+    esp_heap_trace_alloc_hook(ptr, count * size, 0);
+  }
+  return ptr;
+}
+
+void *__wrap_realloc(void *const ptr, const size_t size) {
+  void *const new_ptr = __real_realloc(ptr, size);
+  if (new_ptr) {
+    esp_heap_trace_alloc_hook(new_ptr, size, 0);
+  }
+  return new_ptr;
+}
+}
+
+/// operator newは置き換えたmallocを経由して通知する
+void *operator new(const std::size_t size) {
+  void *const ptr = __wrap_malloc(size == 0 ? 1 : size);
+  if (!ptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void *operator new[](const std::size_t size) { return operator new(size); }
+
+void operator delete(void *const ptr) noexcept { std::free(ptr); }
+
+void operator delete[](void *const ptr) noexcept { std::free(ptr); }
+
+void operator delete(void *const ptr, std::size_t) noexcept { std::free(ptr); }
+
+void operator delete[](void *const ptr, std::size_t) noexcept {
+  std::free(ptr);
+}
+
+namespace {
+
+/// 設定する時刻 (2024/01/01 12:05:00 JST)
+constexpr std::time_t SET_UNIX_TIME = 1704078300;
+/// 早送りする時間 (1日)
+constexpr std::time_t SIMULATED_SECONDS = 24 * 60 * 60;
+/// 1日の分針の移動回数の下限 (毎時の戻りを含めると更に多い)
+constexpr uint32_t MIN_MINUTE_MOVES = 24 * 60;
+
+/// 待機上限 (実時間)
+constexpr auto SETUP_TIMEOUT = std::chrono::seconds(30);
+constexpr auto DAY_TIMEOUT = std::chrono::seconds(120);
+
+/// 表示中の時刻が現在時刻と一致し、針が停止しているか
+bool IsShowingNow(HandMechanism &mechanism, const ClockState &state) {
+  const std::tm now = Util::GetLocalTime();
+  return state.status == ClockManagementTask::STATUS_ENABLE &&
+         state.hour == now.tm_hour % 12 && state.minute == now.tm_min &&
+         mechanism.IsSettled(state);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const bool is_verbose = 1 < argc && std::strcmp(argv[1], "-v") == 0;
+  esp_log_level_set("*", is_verbose ? ESP_LOG_INFO : ESP_LOG_WARN);
+
+  HandMechanism mechanism;
+  mechanism.Attach(false);
+
+  Util::InitTimeZone();
+  GPIO::InitGpioIsrService();
+  std::shared_ptr<ClockManagementTask> task =
+      std::make_shared<ClockManagementTask>(HareTortoiseClockInterfaceWeakPtr());
+
+  // 原点復帰・時刻設定 (確保回数は参考値 定常状態の対象外)
+  task->Start();
+  bool is_ok = WaitUntil(SETUP_TIMEOUT, [&] {
+    const ClockState state = task->GetClockState();
+    return state.status == ClockManagementTask::STATUS_SETTING_WAIT &&
+           mechanism.IsSettled(state);
+  });
+  if (is_ok) {
+    task->SetUnixTime(SET_UNIX_TIME);
+    is_ok = WaitUntil(SETUP_TIMEOUT, [&] {
+      return IsShowingNow(mechanism, task->GetClockState());
+    });
+  }
+  const uint32_t setup_allocations = HeapAudit::GetAllocationCount();
+  std::printf("setup          %s allocations:%" PRIu32 "\n",
+              is_ok ? "ok" : "NG", setup_allocations);
+
+  // 1日分の早送り
+  if (is_ok) {
+    portENTER_CRITICAL(&mechanism.mux);
+    mechanism.hour.ResetTotal();
+    mechanism.minute.ResetTotal();
+    portEXIT_CRITICAL(&mechanism.mux);
+
+    const auto start = std::chrono::steady_clock::now();
+    HostClock::SetFastForward(true);
+    is_ok = WaitUntil(DAY_TIMEOUT, [] {
+      return SET_UNIX_TIME + SIMULATED_SECONDS <= Util::GetEpoch();
+    });
+    HostClock::SetFastForward(false);
+    // 早送りの終了時に移動中であれば実時間で完了を待つ
+    is_ok = is_ok && WaitUntil(SETUP_TIMEOUT, [&] {
+              return IsShowingNow(mechanism, task->GetClockState());
+            });
+    const auto end = std::chrono::steady_clock::now();
+
+    const uint32_t day_allocations =
+        HeapAudit::GetAllocationCount() - setup_allocations;
+    const uint32_t minute_moves = mechanism.GetMinuteMoves();
+    is_ok = is_ok && MIN_MINUTE_MOVES <= minute_moves && day_allocations == 0;
+    std::printf("simulated day  %s %.1fs minute moves:%" PRIu32
+                " allocations:%" PRIu32 " last size:%" PRIu32 "\n",
+                is_ok ? "ok" : "NG",
+                std::chrono::duration<double>(end - start).count(),
+                minute_moves, day_allocations,
+                HeapAudit::GetLastAllocationSize());
+  }
+
+  const ClockState state = task->GetClockState();
+  portENTER_CRITICAL(&mechanism.mux);
+  std::printf("status:%u time:%02u:%02u position hour:%" PRId32 "/%" PRId32
+              " minute:%" PRId32 "/%" PRId32 " (recorded/mechanism)\n",
+              state.status, state.hour, state.minute, state.hour_pos,
+              mechanism.hour.GetPosition(), state.minute_pos,
+              mechanism.minute.GetPosition());
+  portEXIT_CRITICAL(&mechanism.mux);
+
+  task->Stop();
+  task.reset();
+  mechanism.Detach();
+  return is_ok ? 0 : 1;
+}
@@ -0,0 +1,100 @@
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// ESP-IDF (ログ・システム・クリティカルセクション・CRC) のホスト環境用代替
+// タイマーの代替はesp_timer_stand_in.cc (BLE経路) とhal/linux (針の制御)
+// Bluedroidの代替はgatt_stand_in.cc
+
+// Include ----------------------
+#include <esp_err.h>
+#include <esp_log.h>
+#include <esp_rom_crc.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+#include <mutex>
+
+namespace {
+
+std::atomic<esp_log_level_t> log_level{ESP_LOG_INFO};
+/// 割り込み禁止の代替 (タスク・割り込みの代替で共有)
+std::recursive_mutex critical_mutex;
+
+}  // namespace
+
+void HostEnterCritical() { critical_mutex.lock(); }
+
+void HostExitCritical() { critical_mutex.unlock(); }
+
+const char *esp_err_to_name(esp_err_t code) {
+  switch (code) {
+    case ESP_OK:
+      return "ESP_OK";
+    case ESP_FAIL:
+      return "ESP_FAIL";
+    case ESP_ERR_NO_MEM:
+      return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:
+      return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:
+      return "ESP_ERR_INVALID_STATE";
+    default:
+      return "UNKNOWN ERROR";
+  }
+}
+
+void esp_log_level_set(const char *tag, esp_log_level_t level) {
+  log_level = level;
+}
+
+esp_log_level_t esp_log_level_get(const char *tag) { return log_level; }
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format,
+                   ...) {
+  constexpr char LEVEL_CHARS[] = "NEWIDV";
+  // 複数スレッドからの出力が行の途中で混ざらないように
+  flockfile(stderr);
+  std::fprintf(stderr, "%c (%lld) %s: ", LEVEL_CHARS[level],
+               static_cast<long long>(esp_timer_get_time() / 1000), tag);
+  va_list args;
+  va_start(args, format);
+  std::vfprintf(stderr, format, args);
+  va_end(args);
+  std::fputc('\n', stderr);
+  funlockfile(stderr);
+}
+
+void esp_log_buffer_hex(const char *tag, const void *buffer,
+                        uint16_t buff_len) {
+  if (log_level < ESP_LOG_INFO) {
+    return;
+  }
+  const uint8_t *const bytes = static_cast<const uint8_t *>(buffer);
+  flockfile(stderr);
+  std::fprintf(stderr, "I (%lld) %s:",
+               static_cast<long long>(esp_timer_get_time() / 1000), tag);
+  for (uint16_t i = 0; i < buff_len; ++i) {
+    std::fprintf(stderr, " %02x", bytes[i]);
+  }
+  std::fputc('\n', stderr);
+  funlockfile(stderr);
+}
+
+void esp_restart() { ESP_LOGW("esp_stand_in", "esp_restart (ignored)"); }
+
+esp_reset_reason_t esp_reset_reason() { return ESP_RST_POWERON; }
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len) {
+  crc = ~crc;
+  for (uint32_t i = 0; i < len; ++i) {
+    crc ^= buf[i];
+    for (int bit = 0; bit < 8; ++bit) {
+      crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+    }
+  }
+  return ~crc;
+}
@@ -0,0 +1,98 @@
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// ESP-IDF esp_timer のホスト環境用代替 (仮想時間 BLE経路の検証用)
+
+// Include ----------------------
+#include <esp_timer.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "util.h"
+
+/// ESP-IDFのタイマー (仮想時間)
+struct esp_timer {
+  esp_timer_create_args_t args;
+  bool is_active;
+  int64_t deadline_us;
+};
+
+namespace {
+
+/// 仮想時間の開始時刻 (2024/01/01 00:00:00 UTC)
+constexpr int64_t EPOCH_BASE_US = 1704067200LL * 1000000;
+
+int64_t now_us = 0;
+std::vector<std::unique_ptr<esp_timer>> timers;
+
+}  // namespace
+
+int64_t esp_timer_get_time() { return now_us; }
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args,
+                           esp_timer_handle_t *out_handle) {
+  timers.push_back(std::make_unique<esp_timer>(esp_timer{*create_args, false, 0}));
+  *out_handle = timers.back().get();
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+  if (timer->is_active) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  timer->is_active = true;
+  timer->deadline_us = now_us + static_cast<int64_t>(timeout_us);
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+  if (!timer->is_active) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  timer->is_active = false;
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+  timers.erase(std::remove_if(timers.begin(), timers.end(),
+                              [timer](const std::unique_ptr<esp_timer> &t) {
+                                return t.get() == timer;
+                              }),
+               timers.end());
+  return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer) { return timer->is_active; }
+
+namespace HostTimer {
+
+void Advance(const int64_t elapsed_us) {
+  const int64_t target_us = now_us + elapsed_us;
+  while (true) {
+    // 期限の早い順に1つずつ実行する (コールバック内で再開される場合がある)
+    esp_timer *next = nullptr;
+    for (const std::unique_ptr<esp_timer> &timer : timers) {
+      if (timer->is_active && timer->deadline_us <= target_us &&
+          (next == nullptr || timer->deadline_us < next->deadline_us)) {
+        next = timer.get();
+      }
+    }
+    if (next == nullptr) {
+      break;
+    }
+    now_us = std::max(now_us, next->deadline_us);
+    next->is_active = false;
+    next->args.callback(next->args.arg);
+  }
+  now_us = target_us;
+}
+
+}  // namespace HostTimer
+
+namespace HareTortoiseClockSystem::Util {
+
+int64_t GetEpochMicroseconds() { return EPOCH_BASE_US + esp_timer_get_time(); }
+
+}  // namespace HareTortoiseClockSystem::Util
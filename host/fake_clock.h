@@ -0,0 +1,48 @@
+#ifndef FAKE_CLOCK_H_
+#define FAKE_CLOCK_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include <cstdint>
+#include <ctime>
+
+#include "hare_tortoise_clock_interface.h"
+
+namespace HareTortoiseClockSystem {
+
+/// BLE経路の検証用の時計の代わり (呼び出しを記録し、固定の状態を返す)
+class FakeClock final : public HareTortoiseClockInterface {
+ public:
+  /// 応答を返す時刻
+  static constexpr std::time_t UNIX_TIME = 1704067200;
+
+  void SetUnixTime(const std::time_t epoc) override {
+    last_set_time = epoc;
+    ++set_time_count;
+  }
+  void AdjustTime(const int64_t offset_us) override {}
+  void EmergencyStop() override {}
+  void Restart() override {}
+  std::time_t GetUnixTime() const override { return UNIX_TIME; }
+  void AdoptTime(const int64_t offset_us, const uint8_t hops,
+                 const uint16_t uncertainty_ms) override {}
+  TimeSyncState GetTimeSyncState() const override {
+    return TimeSyncState{true, 0, 5, 0, 0};
+  }
+  ClockState GetClockState() const override {
+    return ClockState{4, 10, 8, 0, 0, 1200, 3400};
+  }
+  bool RunChoreography(const Choreography &choreography) override {
+    ++choreography_count;
+    return true;
+  }
+
+  std::time_t last_set_time = 0;
+  uint32_t set_time_count = 0;
+  uint32_t choreography_count = 0;
+};
+
+}  // namespace HareTortoiseClockSystem
+
+#endif  // FAKE_CLOCK_H_
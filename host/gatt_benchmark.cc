@@ -0,0 +1,273 @@
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+//
+// BLE経路の1要求あたりの処理時間とヒープ確保回数 (ホスト環境)
+// GattStandInでセントラルの操作 (登録・接続・MTU交換・購読・Read/Write) を
+// 再現し、BleDevice → BleClockService → Characteristic の処理を計測する
+// 応答・通知の内容も確認し、不一致があれば終了コード1
+//
+//   cmake -S host -B build_host && cmake --build build_host
+//   ./build_host/gatt_benchmark [繰り返し回数] [-v]
+
+// Include ----------------------
+#include <esp_log.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include "ble_device.h"
+#include "ble_services.h"
+#include "command_protocol.h"
+#include "fake_clock.h"
+#include "gatt_stand_in.h"
+
+using namespace HareTortoiseClockSystem;
+
+// ヒープ確保の計数 ----------------------
+namespace {
+std::atomic<uint64_t> allocation_count{0};
+}  // namespace
+
+void *operator new(size_t size) {
+  ++allocation_count;
+  if (void *const p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  std::abort();
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+void operator delete[](void *p, size_t) noexcept { std::free(p); }
+
+namespace {
+
+/// 接続するセントラル
+constexpr uint16_t CONN_ID = 0;
+/// スマートフォンで一般的なMTU
+constexpr uint16_t CENTRAL_MTU = 247;
+/// 応答を返す時刻
+constexpr std::time_t CLOCK_UNIX_TIME = FakeClock::UNIX_TIME;
+
+/// 1種類の要求の計測結果
+struct Result {
+  const char *name;
+  double mean_ns;
+  double p50_ns;
+  double p99_ns;
+  double max_ns;
+  double allocations;
+  uint32_t failures;
+};
+
+/// 要求を繰り返し、処理時間 (応答・遅延イベントの処理まで) を計測する
+/// checkは要求毎の確認 (falseで失敗として数える)
+template <typename REQUEST, typename CHECK>
+Result Measure(const char *const name, const uint32_t count,
+               std::vector<double> *const samples, REQUEST request,
+               CHECK check) {
+  GattStandIn *const stand_in = GattStandIn::GetInstance();
+  samples->clear();
+  uint32_t failures = 0;
+  const uint64_t allocation_begin = allocation_count;
+  for (uint32_t i = 0; i < count; ++i) {
+    const auto begin = std::chrono::steady_clock::now();
+    const esp_gatt_status_t status = request(i);
+    stand_in->Pump();
+    const auto end = std::chrono::steady_clock::now();
+    samples->push_back(
+        std::chrono::duration<double, std::nano>(end - begin).count());
+    if (status != ESP_GATT_OK || !check(i)) {
+      ++failures;
+    }
+  }
+  const uint64_t allocations = allocation_count - allocation_begin;
+
+  std::sort(samples->begin(), samples->end());
+  double total = 0;
+  for (const double sample : *samples) {
+    total += sample;
+  }
+  const size_t size = samples->size();
+  return Result{name,
+                total / size,
+                (*samples)[size / 2],
+                (*samples)[std::min(size - 1, size * 99 / 100)],
+                samples->back(),
+                static_cast<double>(allocations) / count,
+                failures};
+}
+
+void Print(const Result &result) {
+  std::printf("%-24s %9.1f %9.1f %9.1f %10.1f %8.2f %s\n", result.name,
+              result.mean_ns, result.p50_ns, result.p99_ns, result.max_ns,
+              result.allocations, result.failures == 0 ? "ok" : "NG");
+  if (result.failures != 0) {
+    std::printf("  %" PRIu32 " request(s) failed\n", result.failures);
+  }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  uint32_t count = 100000;
+  bool is_verbose = false;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "-v") == 0) {
+      is_verbose = true;
+    } else {
+      count = static_cast<uint32_t>(std::strtoul(argv[i], nullptr, 10));
+    }
+  }
+  count = std::max<uint32_t>(count, 1);
+  // 計測中はログの書式化を行わない (実機の出力時間は含まない)
+  esp_log_level_set("*", is_verbose ? ESP_LOG_INFO : ESP_LOG_WARN);
+
+  // hare_tortoise_clock.cc の CreateBLEService と同じ構成
+  std::shared_ptr<FakeClock> clock = std::make_shared<FakeClock>();
+  HareTortoiseClockInterfaceSharedPtr clock_interface = clock;
+  BleServiceInterfaceSharedPtr ble_clock_service =
+      std::make_shared<BleClockService>(0, CLOCK_SERVICE_UUID.ToEspBtUuid());
+  ble_clock_service->AddCharacteristic(std::make_shared<BleTimeCharacteristic>(
+      TIME_CHARACTERISTIC_UUID.ToEspBtUuid(),
+      ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_WRITE,
+      clock_interface));
+  ble_clock_service->AddCharacteristic(
+      std::make_shared<BleTimeSyncCharacteristic>(
+          TIME_SYNC_CHARACTERISTIC_UUID.ToEspBtUuid(),
+          ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_WRITE,
+          clock_interface));
+  ble_clock_service->AddCharacteristic(
+      std::make_shared<BleCommandCharacteristic>(
+          COMMAND_CHARACTERISTIC_UUID.ToEspBtUuid(),
+          ESP_GATT_CHAR_PROP_BIT_WRITE | ESP_GATT_CHAR_PROP_BIT_WRITE_NR |
+              ESP_GATT_CHAR_PROP_BIT_NOTIFY,
+          clock_interface));
+  ble_clock_service->AddCharacteristic(
+      std::make_shared<BleStatusCharacteristic>(
+          STATUS_CHARACTERISTIC_UUID.ToEspBtUuid(),
+          ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_NOTIFY));
+
+  // 登録 (REG → CREAT_ATTR_TAB → START)
+  GattStandIn *const stand_in = GattStandIn::GetInstance();
+  BleDevice *const ble_device = BleDevice::GetInstance();
+  ble_device->Initialize();
+  ble_device->AddService(ble_clock_service);
+  ble_device->StartAdvertising();
+  stand_in->Pump();
+
+  const uint16_t time_handle =
+      stand_in->FindValueHandle(TIME_CHARACTERISTIC_UUID.ToEspBtUuid());
+  const uint16_t command_handle =
+      stand_in->FindValueHandle(COMMAND_CHARACTERISTIC_UUID.ToEspBtUuid());
+  if (time_handle == 0 || command_handle == 0) {
+    std::printf("attribute table not registered\n");
+    return 1;
+  }
+
+  // 接続 → MTU交換 → 通知の購読
+  stand_in->Connect(CONN_ID);
+  stand_in->ExchangeMtu(CONN_ID, CENTRAL_MTU);
+  stand_in->Subscribe(CONN_ID, command_handle, 0x0001);
+  stand_in->Pump();
+  if (ble_device->GetConnectionCount() != 1) {
+    std::printf("connection not established\n");
+    return 1;
+  }
+
+  std::vector<double> samples;
+  samples.reserve(count);
+  std::printf("%" PRIu32 " requests each (MTU %d)\n", count, CENTRAL_MTU);
+  std::printf("%-24s %9s %9s %9s %10s %8s\n", "request", "mean(ns)", "p50",
+              "p99", "max", "alloc");
+
+  bool is_ok = true;
+  const auto run = [&is_ok](const Result &result) {
+    Print(result);
+    is_ok = is_ok && result.failures == 0;
+  };
+
+  // 時刻 Read [Unix時間(秒) uint64] ビッグエンディアン
+  run(Measure(
+      "time read", count, &samples,
+      [&](uint32_t) { return stand_in->Read(CONN_ID, time_handle); },
+      [&](uint32_t) {
+        const GattStandIn::Response &rsp = stand_in->GetLastResponse();
+        return rsp.length == sizeof(uint64_t) &&
+               LoadBigEndian<uint64_t>(rsp.value.data()) ==
+                   static_cast<uint64_t>(CLOCK_UNIX_TIME);
+      }));
+
+  // 時刻 Write
+  std::array<uint8_t, sizeof(uint64_t)> time_value = {};
+  run(Measure(
+      "time write", count, &samples,
+      [&](const uint32_t i) {
+        StoreBigEndian(static_cast<uint64_t>(CLOCK_UNIX_TIME + i),
+                       time_value.data());
+        return stand_in->Write(CONN_ID, time_handle, time_value);
+      },
+      [&](const uint32_t i) {
+        return clock->last_set_time ==
+               static_cast<std::time_t>(CLOCK_UNIX_TIME + i);
+      }));
+
+  // 一括コマンド (時刻・状態の問い合わせ) → Notifyで応答
+  std::array<uint8_t, 7> query_frame = {
+      CommandProtocol::VERSION, 0,   0, CommandProtocol::TYPE_QUERY_TIME,
+      0, CommandProtocol::TYPE_QUERY_STATE, 0};
+  run(Measure(
+      "command query", count, &samples,
+      [&](const uint32_t i) {
+        query_frame[2] = static_cast<uint8_t>(i);
+        return stand_in->Write(CONN_ID, command_handle, query_frame);
+      },
+      [&](const uint32_t i) {
+        const GattStandIn::Indication &ind = stand_in->GetLastIndication();
+        return ind.handle == command_handle &&
+               CommandProtocol::HEADER_LENGTH < ind.length &&
+               ind.value[2] == static_cast<uint8_t>(i) &&
+               ind.value[CommandProtocol::HEADER_LENGTH] ==
+                   CommandProtocol::TYPE_QUERY_TIME;
+      }));
+
+  // 一括コマンド (針移動の振り付け 応答なし) Write Without Response
+  const std::array<uint8_t, 21> move_frame = {
+      CommandProtocol::VERSION, CommandProtocol::FLAG_NO_REPLY, 0,
+      CommandProtocol::TYPE_SET_SPEED, 4, 0x01, 0xF4, 0x01, 0xF4,
+      CommandProtocol::TYPE_MOVE_HAND, 3, CommandProtocol::HAND_HOUR, 0x01,
+      0xF4,
+      CommandProtocol::TYPE_WAIT, 2, 0x00, 0x64,
+      CommandProtocol::TYPE_RUN_CHOREOGRAPHY, 1, 1};
+  const uint32_t indication_count = stand_in->GetCounters().indications;
+  run(Measure(
+      "command choreography", count, &samples,
+      [&](uint32_t) {
+        return stand_in->Write(CONN_ID, command_handle, move_frame, false);
+      },
+      [&](const uint32_t i) {
+        return clock->choreography_count == i + 1 &&
+               stand_in->GetCounters().indications == indication_count;
+      }));
+
+  stand_in->Disconnect(CONN_ID);
+  stand_in->Pump();
+  const GattStandIn::Counters &counters = stand_in->GetCounters();
+  std::printf("responses:%" PRIu32 " notifications:%" PRIu32
+              " conn params requests:%" PRIu32 " advertising starts:%" PRIu32
+              "\n",
+              counters.responses, counters.indications,
+              counters.conn_params_requests, counters.advertising_starts);
+  return is_ok ? 0 : 1;
+}
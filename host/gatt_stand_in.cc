@@ -0,0 +1,513 @@
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include "gatt_stand_in.h"
+
+#include <esp_bt.h>
+#include <esp_bt_main.h>
+#include <esp_gatt_common_api.h>
+#include <esp_timer.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace HareTortoiseClockSystem {
+
+/// Bluedroidと同じく最初のアプリのgatts_ifは3から
+constexpr esp_gatt_if_t FIRST_GATTS_IF = 3;
+/// 属性テーブルの先頭ハンドル (GAP・GATTのServiceの後)
+constexpr uint16_t FIRST_HANDLE = 40;
+/// 接続時のパラメータ (30ms, Latency 0, 4s)
+constexpr uint16_t CONNECT_INTERVAL = 24;
+constexpr uint16_t CONNECT_LATENCY = 0;
+constexpr uint16_t CONNECT_TIMEOUT = 400;
+/// 切断理由 (Remote User Terminated Connection)
+constexpr int DISCONNECT_REASON = 0x13;
+/// コントローラの送信バッファ数の既定値
+constexpr uint16_t DEFAULT_SENDABLE_PACKETS = 10;
+
+GattStandIn *GattStandIn::GetInstance() {
+  static GattStandIn instance;
+  return &instance;
+}
+
+GattStandIn::GattStandIn()
+    : gatts_callback_(nullptr),
+      gap_callback_(nullptr),
+      next_gatts_if_(FIRST_GATTS_IF),
+      gatts_if_(ESP_GATT_IF_NONE),
+      next_handle_(FIRST_HANDLE),
+      next_trans_id_(1),
+      sendable_packets_(DEFAULT_SENDABLE_PACKETS),
+      attributes_(),
+      handles_(),
+      receive_buffer_(),
+      pending_events_(),
+      pending_head_(0),
+      pending_count_(0),
+      last_response_(),
+      last_indication_(),
+      last_conn_params_request_(),
+      counters_() {}
+
+void GattStandIn::Pump() {
+  // イベントの処理中に追加されたイベントも続けて処理する
+  while (0 < pending_count_) {
+    PendingEvent &event = pending_events_[pending_head_];
+    pending_head_ = (pending_head_ + 1) % MAX_PENDING_EVENTS;
+    --pending_count_;
+    if (event.is_gap) {
+      if (gap_callback_) {
+        gap_callback_(event.gap_event, &event.gap_param);
+      }
+    } else if (gatts_callback_) {
+      gatts_callback_(event.gatts_event, event.gatts_if, &event.gatts_param);
+    }
+  }
+  HostTimer::Advance(0);
+}
+
+void GattStandIn::Connect(const uint16_t conn_id) {
+  esp_ble_gatts_cb_param_t param = {};
+  param.connect.conn_id = conn_id;
+  MakeAddress(conn_id, param.connect.remote_bda);
+  param.connect.conn_params = {CONNECT_INTERVAL, CONNECT_LATENCY,
+                               CONNECT_TIMEOUT};
+  DispatchGatts(ESP_GATTS_CONNECT_EVT, &param);
+}
+
+void GattStandIn::Disconnect(const uint16_t conn_id) {
+  esp_ble_gatts_cb_param_t param = {};
+  param.disconnect.conn_id = conn_id;
+  MakeAddress(conn_id, param.disconnect.remote_bda);
+  param.disconnect.reason = DISCONNECT_REASON;
+  DispatchGatts(ESP_GATTS_DISCONNECT_EVT, &param);
+}
+
+void GattStandIn::ExchangeMtu(const uint16_t conn_id, const uint16_t mtu) {
+  esp_ble_gatts_cb_param_t param = {};
+  param.mtu.conn_id = conn_id;
+  // ローカルMTU(esp_ble_gatt_set_local_mtu)との小さい方
+  param.mtu.mtu = std::min<uint16_t>(mtu, ESP_GATT_MAX_MTU_SIZE);
+  DispatchGatts(ESP_GATTS_MTU_EVT, &param);
+}
+
+void GattStandIn::SetCongested(const uint16_t conn_id,
+                               const bool is_congested) {
+  esp_ble_gatts_cb_param_t param = {};
+  param.congest.conn_id = conn_id;
+  param.congest.congested = is_congested;
+  DispatchGatts(ESP_GATTS_CONGEST_EVT, &param);
+}
+
+esp_gatt_status_t GattStandIn::Read(const uint16_t conn_id,
+                                    const uint16_t handle,
+                                    const uint16_t offset) {
+  const uint32_t response_count = counters_.responses;
+  esp_ble_gatts_cb_param_t param = {};
+  param.read.conn_id = conn_id;
+  param.read.trans_id = next_trans_id_++;
+  MakeAddress(conn_id, param.read.bda);
+  param.read.handle = handle;
+  param.read.offset = offset;
+  param.read.is_long = offset != 0;
+  param.read.need_rsp = true;
+  DispatchGatts(ESP_GATTS_READ_EVT, &param);
+  // 応答しない場合、実機ではセントラルがATTタイムアウトになる
+  if (counters_.responses == response_count) {
+    return ESP_GATT_ERROR;
+  }
+  return last_response_.status;
+}
+
+esp_gatt_status_t GattStandIn::Write(const uint16_t conn_id,
+                                     const uint16_t handle, ConstByteSpan data,
+                                     const bool need_rsp) {
+  if (receive_buffer_.size() < data.size()) {
+    return ESP_GATT_INVALID_ATTR_LEN;
+  }
+  const uint32_t response_count = counters_.responses;
+  std::copy(data.begin(), data.end(), receive_buffer_.begin());
+  esp_ble_gatts_cb_param_t param = {};
+  param.write.conn_id = conn_id;
+  param.write.trans_id = next_trans_id_++;
+  MakeAddress(conn_id, param.write.bda);
+  param.write.handle = handle;
+  param.write.offset = 0;
+  param.write.need_rsp = need_rsp;
+  param.write.is_prep = false;
+  param.write.len = static_cast<uint16_t>(data.size());
+  param.write.value = receive_buffer_.data();
+  DispatchGatts(ESP_GATTS_WRITE_EVT, &param);
+  if (!need_rsp) {
+    return ESP_GATT_OK;
+  }
+  if (counters_.responses == response_count) {
+    return ESP_GATT_ERROR;
+  }
+  return last_response_.status;
+}
+
+esp_gatt_status_t GattStandIn::PrepareWrite(const uint16_t conn_id,
+                                            const uint16_t handle,
+                                            const uint16_t offset,
+                                            ConstByteSpan data) {
+  if (receive_buffer_.size() < data.size()) {
+    return ESP_GATT_INVALID_ATTR_LEN;
+  }
+  const uint32_t response_count = counters_.responses;
+  std::copy(data.begin(), data.end(), receive_buffer_.begin());
+  esp_ble_gatts_cb_param_t param = {};
+  param.write.conn_id = conn_id;
+  param.write.trans_id = next_trans_id_++;
+  MakeAddress(conn_id, param.write.bda);
+  param.write.handle = handle;
+  param.write.offset = offset;
+  param.write.need_rsp = true;
+  param.write.is_prep = true;
+  param.write.len = static_cast<uint16_t>(data.size());
+  param.write.value = receive_buffer_.data();
+  DispatchGatts(ESP_GATTS_WRITE_EVT, &param);
+  if (counters_.responses == response_count) {
+    return ESP_GATT_ERROR;
+  }
+  return last_response_.status;
+}
+
+esp_gatt_status_t GattStandIn::ExecuteWrite(const uint16_t conn_id,
+                                            const bool is_exec) {
+  const uint32_t response_count = counters_.responses;
+  esp_ble_gatts_cb_param_t param = {};
+  param.exec_write.conn_id = conn_id;
+  param.exec_write.trans_id = next_trans_id_++;
+  MakeAddress(conn_id, param.exec_write.bda);
+  param.exec_write.exec_write_flag =
+      is_exec ? ESP_GATT_PREP_WRITE_EXEC : ESP_GATT_PREP_WRITE_CANCEL;
+  DispatchGatts(ESP_GATTS_EXEC_WRITE_EVT, &param);
+  if (counters_.responses == response_count) {
+    return ESP_GATT_ERROR;
+  }
+  return last_response_.status;
+}
+
+esp_gatt_status_t GattStandIn::Subscribe(const uint16_t conn_id,
+                                         const uint16_t value_handle,
+                                         const uint16_t cccd_value) {
+  const uint16_t cccd_handle = FindCccdHandle(value_handle);
+  if (cccd_handle == 0) {
+    return ESP_GATT_INVALID_HANDLE;
+  }
+  // CCCD [値(uint16_t)] リトルエンディアン
+  const std::array<uint8_t, sizeof(uint16_t)> value = {
+      static_cast<uint8_t>(cccd_value),
+      static_cast<uint8_t>(cccd_value >> 8)};
+  return Write(conn_id, cccd_handle, value);
+}
+
+uint16_t GattStandIn::FindValueHandle(const esp_bt_uuid_t &uuid) const {
+  for (const Attribute &attribute : attributes_) {
+    if (attribute.uuid.len == uuid.len &&
+        std::memcmp(&attribute.uuid.uuid, &uuid.uuid, uuid.len) == 0) {
+      return attribute.handle;
+    }
+  }
+  return 0;
+}
+
+uint16_t GattStandIn::FindCccdHandle(const uint16_t value_handle) const {
+  for (size_t i = 0; i + 1 < attributes_.size(); ++i) {
+    if (attributes_[i].handle != value_handle) {
+      continue;
+    }
+    const Attribute &next = attributes_[i + 1];
+    if (next.uuid.len == ESP_UUID_LEN_16 &&
+        next.uuid.uuid.uuid16 == ESP_GATT_UUID_CHAR_CLIENT_CONFIG) {
+      return next.handle;
+    }
+    return 0;
+  }
+  return 0;
+}
+
+esp_err_t GattStandIn::RegisterGattsCallback(esp_gatts_cb_t callback) {
+  gatts_callback_ = callback;
+  return ESP_OK;
+}
+
+esp_err_t GattStandIn::RegisterGapCallback(esp_gap_ble_cb_t callback) {
+  gap_callback_ = callback;
+  return ESP_OK;
+}
+
+esp_err_t GattStandIn::AppRegister(const uint16_t app_id) {
+  PendingEvent event = {};
+  event.gatts_event = ESP_GATTS_REG_EVT;
+  event.gatts_if = next_gatts_if_++;
+  event.gatts_param.reg.status = ESP_GATT_OK;
+  event.gatts_param.reg.app_id = app_id;
+  gatts_if_ = event.gatts_if;
+  Post(event);
+  return ESP_OK;
+}
+
+esp_err_t GattStandIn::CreateAttributeTable(const esp_gatts_attr_db_t *const db,
+                                            const esp_gatt_if_t gatts_if,
+                                            const uint16_t count) {
+  // ハンドルは連番で割り当てる (Bluedroidと同じ)
+  handles_.resize(count);
+  for (uint16_t i = 0; i < count; ++i) {
+    const esp_attr_desc_t &desc = db[i].att_desc;
+    Attribute attribute = {};
+    attribute.handle = next_handle_++;
+    attribute.uuid.len = desc.uuid_length;
+    std::memcpy(&attribute.uuid.uuid, desc.uuid_p,
+                std::min<size_t>(desc.uuid_length, ESP_UUID_LEN_128));
+    attributes_.push_back(attribute);
+    handles_[i] = attribute.handle;
+  }
+
+  PendingEvent event = {};
+  event.gatts_event = ESP_GATTS_CREAT_ATTR_TAB_EVT;
+  event.gatts_if = gatts_if;
+  event.gatts_param.add_attr_tab.status = ESP_GATT_OK;
+  event.gatts_param.add_attr_tab.num_handle = count;
+  event.gatts_param.add_attr_tab.handles = handles_.data();
+  Post(event);
+  return ESP_OK;
+}
+
+esp_err_t GattStandIn::StartService(const uint16_t service_handle) {
+  PendingEvent event = {};
+  event.gatts_event = ESP_GATTS_START_EVT;
+  event.gatts_if = gatts_if_;
+  event.gatts_param.start.status = ESP_GATT_OK;
+  event.gatts_param.start.service_handle = service_handle;
+  Post(event);
+  return ESP_OK;
+}
+
+esp_err_t GattStandIn::SendResponse(const uint16_t conn_id,
+                                    const uint32_t trans_id,
+                                    const esp_gatt_status_t status,
+                                    const esp_gatt_rsp_t *const rsp) {
+  ++counters_.responses;
+  last_response_.conn_id = conn_id;
+  last_response_.trans_id = trans_id;
+  last_response_.status = status;
+  last_response_.handle = rsp ? rsp->attr_value.handle : 0;
+  last_response_.length = rsp ? rsp->attr_value.len : 0;
+  if (rsp) {
+    std::copy_n(rsp->attr_value.value,
+                std::min<size_t>(rsp->attr_value.len, MAX_VALUE_LENGTH),
+                last_response_.value.begin());
+  }
+  return ESP_OK;
+}
+
+esp_err_t GattStandIn::SendIndicate(const uint16_t conn_id,
+                                    const uint16_t handle, ConstByteSpan value,
+                                    const bool need_confirm) {
+  if (MAX_VALUE_LENGTH < value.size()) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  ++counters_.indications;
+  last_indication_.conn_id = conn_id;
+  last_indication_.handle = handle;
+  last_indication_.need_confirm = need_confirm;
+  last_indication_.length = static_cast<uint16_t>(value.size());
+  std::copy(value.begin(), value.end(), last_indication_.value.begin());
+
+  // 送信完了 (Indicationは確認応答) でCONF_EVTが届く
+  PendingEvent event = {};
+  event.gatts_event = ESP_GATTS_CONF_EVT;
+  event.gatts_if = gatts_if_;
+  event.gatts_param.conf.status = ESP_GATT_OK;
+  event.gatts_param.conf.conn_id = conn_id;
+  event.gatts_param.conf.handle = handle;
+  Post(event);
+  return ESP_OK;
+}
+
+esp_err_t GattStandIn::PostGapComplete(const esp_gap_ble_cb_event_t event) {
+  if (event == ESP_GAP_BLE_ADV_START_COMPLETE_EVT) {
+    ++counters_.advertising_starts;
+  }
+  PendingEvent pending = {};
+  pending.is_gap = true;
+  pending.gap_event = event;
+  // 完了通知のstatusは共通の位置にある
+  pending.gap_param.adv_start_cmpl.status = ESP_BT_STATUS_SUCCESS;
+  Post(pending);
+  return ESP_OK;
+}
+
+esp_err_t GattStandIn::UpdateConnParams(
+    const esp_ble_conn_update_params_t &params) {
+  ++counters_.conn_params_requests;
+  // アドレスの末尾はconn_id
+  last_conn_params_request_.conn_id = params.bda[ESP_BD_ADDR_LEN - 1];
+  last_conn_params_request_.time_us = esp_timer_get_time();
+  last_conn_params_request_.params = params;
+  // セントラルは要求の最大間隔を採用する
+  PendingEvent event = {};
+  event.is_gap = true;
+  event.gap_event = ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT;
+  event.gap_param.update_conn_params.status = ESP_BT_STATUS_SUCCESS;
+  std::memcpy(event.gap_param.update_conn_params.bda, params.bda,
+              sizeof(esp_bd_addr_t));
+  event.gap_param.update_conn_params.min_int = params.min_int;
+  event.gap_param.update_conn_params.max_int = params.max_int;
+  event.gap_param.update_conn_params.conn_int = params.max_int;
+  event.gap_param.update_conn_params.latency = params.latency;
+  event.gap_param.update_conn_params.timeout = params.timeout;
+  Post(event);
+  return ESP_OK;
+}
+
+esp_err_t GattStandIn::DisconnectRequest(const esp_bd_addr_t address) {
+  ++counters_.disconnect_requests;
+  // アドレスの末尾はconn_id
+  PendingEvent event = {};
+  event.gatts_event = ESP_GATTS_DISCONNECT_EVT;
+  event.gatts_if = gatts_if_;
+  event.gatts_param.disconnect.conn_id = address[ESP_BD_ADDR_LEN - 1];
+  std::memcpy(event.gatts_param.disconnect.remote_bda, address,
+              sizeof(esp_bd_addr_t));
+  event.gatts_param.disconnect.reason = DISCONNECT_REASON;
+  Post(event);
+  return ESP_OK;
+}
+
+void GattStandIn::DispatchGatts(const esp_gatts_cb_event_t event,
+                                esp_ble_gatts_cb_param_t *const param) {
+  if (gatts_callback_) {
+    gatts_callback_(event, gatts_if_, param);
+  }
+}
+
+void GattStandIn::Post(const PendingEvent &event) {
+  if (MAX_PENDING_EVENTS <= pending_count_) {
+    // 実機ではBTCタスクのキューが溢れた状態 (呼び出し側の不具合)
+    std::abort();
+  }
+  pending_events_[(pending_head_ + pending_count_) % MAX_PENDING_EVENTS] =
+      event;
+  ++pending_count_;
+}
+
+void GattStandIn::MakeAddress(const uint16_t conn_id, esp_bd_addr_t address) {
+  const esp_bd_addr_t base = {0x24, 0x0a, 0xc4, 0x00, 0x00, 0x00};
+  std::memcpy(address, base, sizeof(esp_bd_addr_t));
+  address[ESP_BD_ADDR_LEN - 1] = static_cast<uint8_t>(conn_id);
+}
+
+}  // namespace HareTortoiseClockSystem
+
+// ESP-IDF API ----------------------
+using HareTortoiseClockSystem::ConstByteSpan;
+using HareTortoiseClockSystem::GattStandIn;
+
+esp_err_t esp_ble_gatts_register_callback(esp_gatts_cb_t callback) {
+  return GattStandIn::GetInstance()->RegisterGattsCallback(callback);
+}
+
+esp_err_t esp_ble_gatts_app_register(uint16_t app_id) {
+  return GattStandIn::GetInstance()->AppRegister(app_id);
+}
+
+esp_err_t esp_ble_gatts_create_attr_tab(const esp_gatts_attr_db_t *gatts_attr_db,
+                                        esp_gatt_if_t gatts_if,
+                                        uint16_t max_nb_attr,
+                                        uint8_t srvc_inst_id) {
+  return GattStandIn::GetInstance()->CreateAttributeTable(
+      gatts_attr_db, gatts_if, max_nb_attr);
+}
+
+esp_err_t esp_ble_gatts_start_service(uint16_t service_handle) {
+  return GattStandIn::GetInstance()->StartService(service_handle);
+}
+
+esp_err_t esp_ble_gatts_send_response(esp_gatt_if_t gatts_if, uint16_t conn_id,
+                                      uint32_t trans_id,
+                                      esp_gatt_status_t status,
+                                      esp_gatt_rsp_t *rsp) {
+  return GattStandIn::GetInstance()->SendResponse(conn_id, trans_id, status,
+                                                  rsp);
+}
+
+esp_err_t esp_ble_gatts_send_indicate(esp_gatt_if_t gatts_if, uint16_t conn_id,
+                                      uint16_t attr_handle, uint16_t value_len,
+                                      uint8_t *value, bool need_confirm) {
+  return GattStandIn::GetInstance()->SendIndicate(
+      conn_id, attr_handle, ConstByteSpan(value, value_len), need_confirm);
+}
+
+esp_err_t esp_ble_gatt_set_local_mtu(uint16_t mtu) { return ESP_OK; }
+
+esp_err_t esp_ble_gap_register_callback(esp_gap_ble_cb_t callback) {
+  return GattStandIn::GetInstance()->RegisterGapCallback(callback);
+}
+
+esp_err_t esp_ble_gap_set_device_name(const char *name) { return ESP_OK; }
+
+esp_err_t esp_ble_gap_config_adv_data(esp_ble_adv_data_t *adv_data) {
+  return GattStandIn::GetInstance()->PostGapComplete(
+      ESP_GAP_BLE_ADV_DATA_SET_COMPLETE_EVT);
+}
+
+esp_err_t esp_ble_gap_config_adv_data_raw(uint8_t *raw_data,
+                                          uint32_t raw_data_len) {
+  return GattStandIn::GetInstance()->PostGapComplete(
+      ESP_GAP_BLE_ADV_DATA_RAW_SET_COMPLETE_EVT);
+}
+
+esp_err_t esp_ble_gap_config_scan_rsp_data_raw(uint8_t *raw_data,
+                                               uint32_t raw_data_len) {
+  return GattStandIn::GetInstance()->PostGapComplete(
+      ESP_GAP_BLE_SCAN_RSP_DATA_RAW_SET_COMPLETE_EVT);
+}
+
+esp_err_t esp_ble_gap_start_advertising(esp_ble_adv_params_t *adv_params) {
+  return GattStandIn::GetInstance()->PostGapComplete(
+      ESP_GAP_BLE_ADV_START_COMPLETE_EVT);
+}
+
+esp_err_t esp_ble_gap_set_scan_params(esp_ble_scan_params_t *scan_params) {
+  // スキャンは再現しない
+  return ESP_FAIL;
+}
+
+esp_err_t esp_ble_gap_start_scanning(uint32_t duration) { return ESP_FAIL; }
+
+esp_err_t esp_ble_gap_update_conn_params(
+    esp_ble_conn_update_params_t *params) {
+  return GattStandIn::GetInstance()->UpdateConnParams(*params);
+}
+
+esp_err_t esp_ble_gap_set_pkt_data_len(esp_bd_addr_t remote_device,
+                                       uint16_t tx_data_length) {
+  return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_disconnect(esp_bd_addr_t remote_device) {
+  return GattStandIn::GetInstance()->DisconnectRequest(remote_device);
+}
+
+uint16_t esp_ble_get_cur_sendable_packets_num(uint16_t connid) {
+  return GattStandIn::GetInstance()->GetSendablePackets();
+}
+
+esp_err_t esp_bt_controller_mem_release(esp_bt_mode_t mode) { return ESP_OK; }
+
+esp_err_t esp_bt_controller_init(esp_bt_controller_config_t *cfg) {
+  return ESP_OK;
+}
+
+esp_err_t esp_bt_controller_enable(esp_bt_mode_t mode) { return ESP_OK; }
+
+esp_err_t esp_bluedroid_init_with_cfg(esp_bluedroid_config_t *cfg) {
+  return ESP_OK;
+}
+
+esp_err_t esp_bluedroid_enable() { return ESP_OK; }
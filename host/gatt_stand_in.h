@@ -0,0 +1,173 @@
+#ifndef GATT_STAND_IN_H_
+#define GATT_STAND_IN_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include <esp_gap_ble_api.h>
+#include <esp_gatts_api.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "byte_span.h"
+
+namespace HareTortoiseClockSystem {
+
+/// Bluedroid (GATTサーバー・GAP) のホスト環境用スタンドイン
+/// esp_ble_gatts_* / esp_ble_gap_* の呼び出しを受け、登録されたコールバックへ
+/// 実機と同じ順序でイベントを返す (BTCタスクの代わりに呼び出し元のスレッドで実行)
+/// セントラルの操作 (接続・MTU交換・Read・Write) を再現し、応答・通知を記録する
+/// 要求の処理中はヒープ確保を行わない (計測対象の確保回数に混ざらないように)
+class GattStandIn final {
+ public:
+  /// 記録する応答・通知の最大長
+  static constexpr size_t MAX_VALUE_LENGTH = ESP_GATT_MAX_ATTR_LEN;
+
+  /// Read・Writeへの応答
+  struct Response {
+    uint16_t conn_id;
+    uint32_t trans_id;
+    esp_gatt_status_t status;
+    uint16_t handle;
+    uint16_t length;
+    std::array<uint8_t, MAX_VALUE_LENGTH> value;
+  };
+
+  /// Notify・Indication
+  struct Indication {
+    uint16_t conn_id;
+    uint16_t handle;
+    bool need_confirm;
+    uint16_t length;
+    std::array<uint8_t, MAX_VALUE_LENGTH> value;
+  };
+
+  /// 接続パラメータの変更要求
+  struct ConnParamsRequest {
+    uint16_t conn_id;
+    /// 要求時の仮想時刻(us)
+    int64_t time_us;
+    esp_ble_conn_update_params_t params;
+  };
+
+  /// 呼び出し回数
+  struct Counters {
+    uint32_t responses;
+    uint32_t indications;
+    uint32_t conn_params_requests;
+    uint32_t advertising_starts;
+    uint32_t disconnect_requests;
+  };
+
+  static GattStandIn *GetInstance();
+
+  /// 遅延しているイベント (Indicationの確認応答・GAPの完了通知等) と
+  /// 期限に達したタイマーを実行する
+  void Pump();
+
+  /// セントラルの操作
+  /// アドレスはconn_idから生成する
+  void Connect(const uint16_t conn_id);
+  void Disconnect(const uint16_t conn_id);
+  void ExchangeMtu(const uint16_t conn_id, const uint16_t mtu);
+  void SetCongested(const uint16_t conn_id, const bool is_congested);
+  /// Read (応答はGetLastResponse)
+  esp_gatt_status_t Read(const uint16_t conn_id, const uint16_t handle,
+                         const uint16_t offset = 0);
+  /// Write (need_rsp=falseはWrite Without Response)
+  esp_gatt_status_t Write(const uint16_t conn_id, const uint16_t handle,
+                          ConstByteSpan data, const bool need_rsp = true);
+  /// Prepared Write (長い書き込み) の1区間とExecute Write
+  esp_gatt_status_t PrepareWrite(const uint16_t conn_id, const uint16_t handle,
+                                 const uint16_t offset, ConstByteSpan data);
+  esp_gatt_status_t ExecuteWrite(const uint16_t conn_id, const bool is_exec);
+  /// CCCDへの書き込み (bit0:Notify bit1:Indicate)
+  esp_gatt_status_t Subscribe(const uint16_t conn_id,
+                              const uint16_t value_handle,
+                              const uint16_t cccd_value);
+
+  /// 属性テーブルから値のハンドルを検索 (見つからない場合0)
+  uint16_t FindValueHandle(const esp_bt_uuid_t &uuid) const;
+  /// 値のハンドルに続くCCCDのハンドル (ない場合0)
+  uint16_t FindCccdHandle(const uint16_t value_handle) const;
+
+  const Response &GetLastResponse() const { return last_response_; }
+  const Indication &GetLastIndication() const { return last_indication_; }
+  const ConnParamsRequest &GetLastConnParamsRequest() const {
+    return last_conn_params_request_;
+  }
+  const Counters &GetCounters() const { return counters_; }
+  /// 送信可能なパケット数 (0で送信待ちを再現)
+  void SetSendablePackets(const uint16_t count) { sendable_packets_ = count; }
+
+  /// ESP-IDF APIの実装から呼び出し
+  esp_err_t RegisterGattsCallback(esp_gatts_cb_t callback);
+  esp_err_t RegisterGapCallback(esp_gap_ble_cb_t callback);
+  esp_err_t AppRegister(const uint16_t app_id);
+  esp_err_t CreateAttributeTable(const esp_gatts_attr_db_t *const db,
+                                 const esp_gatt_if_t gatts_if,
+                                 const uint16_t count);
+  esp_err_t StartService(const uint16_t service_handle);
+  esp_err_t SendResponse(const uint16_t conn_id, const uint32_t trans_id,
+                         const esp_gatt_status_t status,
+                         const esp_gatt_rsp_t *const rsp);
+  esp_err_t SendIndicate(const uint16_t conn_id, const uint16_t handle,
+                         ConstByteSpan value, const bool need_confirm);
+  esp_err_t PostGapComplete(const esp_gap_ble_cb_event_t event);
+  esp_err_t UpdateConnParams(const esp_ble_conn_update_params_t &params);
+  esp_err_t DisconnectRequest(const esp_bd_addr_t address);
+  uint16_t GetSendablePackets() const { return sendable_packets_; }
+
+ private:
+  /// 登録された属性
+  struct Attribute {
+    uint16_t handle;
+    esp_bt_uuid_t uuid;
+  };
+
+  /// BTCタスクで後から届くイベント
+  struct PendingEvent {
+    bool is_gap;
+    esp_gatts_cb_event_t gatts_event;
+    esp_gap_ble_cb_event_t gap_event;
+    esp_gatt_if_t gatts_if;
+    esp_ble_gatts_cb_param_t gatts_param;
+    esp_ble_gap_cb_param_t gap_param;
+  };
+  static constexpr size_t MAX_PENDING_EVENTS = 32;
+
+  GattStandIn();
+
+  void DispatchGatts(const esp_gatts_cb_event_t event,
+                     esp_ble_gatts_cb_param_t *const param);
+  void Post(const PendingEvent &event);
+  static void MakeAddress(const uint16_t conn_id, esp_bd_addr_t address);
+
+ private:
+  esp_gatts_cb_t gatts_callback_;
+  esp_gap_ble_cb_t gap_callback_;
+  esp_gatt_if_t next_gatts_if_;
+  esp_gatt_if_t gatts_if_;
+  uint16_t next_handle_;
+  uint32_t next_trans_id_;
+  uint16_t sendable_packets_;
+  std::vector<Attribute> attributes_;
+  /// CREAT_ATTR_TAB_EVTで渡すハンドル
+  std::vector<uint16_t> handles_;
+  /// 受信値 (スタックの受信バッファに相当 イベントの間のみ有効)
+  std::array<uint8_t, MAX_VALUE_LENGTH> receive_buffer_;
+  std::array<PendingEvent, MAX_PENDING_EVENTS> pending_events_;
+  size_t pending_head_;
+  size_t pending_count_;
+  Response last_response_;
+  Indication last_indication_;
+  ConnParamsRequest last_conn_params_request_;
+  Counters counters_;
+};
+
+}  // namespace HareTortoiseClockSystem
+
+#endif  // GATT_STAND_IN_H_
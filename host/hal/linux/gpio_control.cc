@@ -0,0 +1,159 @@
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include "gpio_control.h"
+
+#include <freertos/FreeRTOS.h>
+
+#include <atomic>
+
+namespace HareTortoiseClockSystem::GPIO {
+
+namespace {
+
+constexpr int32_t GPIO_PIN_COUNT = 64;
+
+/// ピンの状態 (割り込み禁止相当のロックで保護)
+struct Pin {
+  bool level;
+  bool is_output;
+  InputEdge edge;
+  void (*handler)(void*);
+  void* handler_arg;
+};
+
+Pin pins[GPIO_PIN_COUNT] = {};
+portMUX_TYPE pins_mux = portMUX_INITIALIZER_UNLOCKED;
+std::atomic<OutputObserver> output_observer{nullptr};
+std::atomic<void*> output_observer_arg{nullptr};
+
+bool IsValid(const gpio_num_t gpio_number) {
+  return 0 <= gpio_number && gpio_number < GPIO_PIN_COUNT;
+}
+
+/// ロック内で呼び出す
+void WriteLocked(const gpio_num_t gpio_number, const bool level) {
+  Pin& pin = pins[gpio_number];
+  if (!pin.is_output || pin.level == level) {
+    pin.level = level;
+    return;
+  }
+  pin.level = level;
+  const OutputObserver observer = output_observer.load();
+  if (observer) {
+    observer(output_observer_arg.load(), gpio_number, level);
+  }
+}
+
+}  // namespace
+
+void InitGpioIsrService() {}
+
+void Reset(const gpio_num_t gpio_number) {
+  if (!IsValid(gpio_number)) {
+    return;
+  }
+  portENTER_CRITICAL(&pins_mux);
+  pins[gpio_number] = Pin{};
+  portEXIT_CRITICAL(&pins_mux);
+}
+
+void InitOutput(const gpio_num_t gpio_number, const bool level) {
+  if (!IsValid(gpio_number)) {
+    return;
+  }
+  portENTER_CRITICAL(&pins_mux);
+  pins[gpio_number].is_output = true;
+  pins[gpio_number].level = !level;
+  WriteLocked(gpio_number, level);
+  portEXIT_CRITICAL(&pins_mux);
+}
+
+void InitInput(const gpio_num_t gpio_number, const InputEdge edge) {
+  if (!IsValid(gpio_number)) {
+    return;
+  }
+  // 入力レベルは模擬側が与えるため変更しない
+  portENTER_CRITICAL(&pins_mux);
+  pins[gpio_number].is_output = false;
+  pins[gpio_number].edge = edge;
+  portEXIT_CRITICAL(&pins_mux);
+}
+
+void AddIsrHandler(const gpio_num_t gpio_number, void (*handler)(void*),
+                   void* const arg) {
+  if (!IsValid(gpio_number)) {
+    return;
+  }
+  portENTER_CRITICAL(&pins_mux);
+  pins[gpio_number].handler = handler;
+  pins[gpio_number].handler_arg = arg;
+  portEXIT_CRITICAL(&pins_mux);
+}
+
+void RemoveIsrHandler(const gpio_num_t gpio_number) {
+  AddIsrHandler(gpio_number, nullptr, nullptr);
+}
+
+void SetLevel(const gpio_num_t gpio_number, const bool level) {
+  if (!IsValid(gpio_number)) {
+    return;
+  }
+  portENTER_CRITICAL(&pins_mux);
+  WriteLocked(gpio_number, level);
+  portEXIT_CRITICAL(&pins_mux);
+}
+
+bool GetLevel(const gpio_num_t gpio_number) {
+  if (!IsValid(gpio_number)) {
+    return false;
+  }
+  portENTER_CRITICAL(&pins_mux);
+  const bool level = pins[gpio_number].level;
+  portEXIT_CRITICAL(&pins_mux);
+  return level;
+}
+
+void SetOutputObserver(const OutputObserver observer, void* const arg) {
+  portENTER_CRITICAL(&pins_mux);
+  output_observer_arg = arg;
+  output_observer = observer;
+  portEXIT_CRITICAL(&pins_mux);
+}
+
+void SetInputLevel(const gpio_num_t gpio_number, const bool level) {
+  if (!IsValid(gpio_number)) {
+    return;
+  }
+  portENTER_CRITICAL(&pins_mux);
+  Pin& pin = pins[gpio_number];
+  const bool is_changed = pin.level != level;
+  pin.level = level;
+  if (is_changed && !pin.is_output && pin.handler &&
+      (pin.edge == INPUT_EDGE_ANY || !level)) {
+    pin.handler(pin.handler_arg);
+  }
+  portEXIT_CRITICAL(&pins_mux);
+}
+
+void WriteMask(const uint64_t mask, const bool level) {
+  portENTER_CRITICAL(&pins_mux);
+  for (int32_t i = 0; i < GPIO_PIN_COUNT; ++i) {
+    if (mask & (1ull << i)) {
+      WriteLocked(static_cast<gpio_num_t>(i), level);
+    }
+  }
+  portEXIT_CRITICAL(&pins_mux);
+}
+
+bool TestMask(const uint64_t mask) {
+  for (int32_t i = 0; i < GPIO_PIN_COUNT; ++i) {
+    if (mask & (1ull << i)) {
+      return GetLevel(static_cast<gpio_num_t>(i));
+    }
+  }
+  return false;
+}
+
+}  // namespace HareTortoiseClockSystem::GPIO
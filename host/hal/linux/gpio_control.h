@@ -0,0 +1,100 @@
+#ifndef GPIO_H_
+#define GPIO_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// GPIOのLinux実装 (ピンはメモリ上の模擬)
+// 出力は観測関数へ通知し、入力はSetInputLevelで外部から与える
+
+// Include ----------------------
+#include <esp_attr.h>
+#include <stdint.h>
+
+/// GPIO番号 (ESP-IDF driver/gpio.h 相当)
+enum gpio_num_t : int {
+  GPIO_NUM_NC = -1,
+};
+
+namespace HareTortoiseClockSystem::GPIO {
+
+/// 入力割り込みのエッジ
+enum InputEdge {
+  INPUT_EDGE_ANY = 0,
+  INPUT_EDGE_FALLING = 1,
+};
+
+/// 出力の観測関数 (ピン操作の呼び出し元スレッドで実行)
+using OutputObserver = void (*)(void* arg, const gpio_num_t gpio_number,
+                                const bool level);
+
+/// Init GPIO ISR Service
+void InitGpioIsrService();
+
+/// Reset GPIO 
+void Reset(const gpio_num_t gpio_number);
+
+/// Init GPIO (Output)
+void InitOutput(const gpio_num_t gpio_number, const bool level = false);
+
+/// Init GPIO (Input)
+void InitInput(const gpio_num_t gpio_number,
+               const InputEdge edge = INPUT_EDGE_ANY);
+
+/// Add GPIO ISR Handler
+void AddIsrHandler(const gpio_num_t gpio_number, void (*handler)(void*),
+                   void* const arg);
+
+/// Remove GPIO ISR Handler
+void RemoveIsrHandler(const gpio_num_t gpio_number);
+
+/// Set GPIO Level (Output)
+void SetLevel(const gpio_num_t gpio_number, const bool level);
+
+/// Gett GPIO Level (Input)
+bool GetLevel(const gpio_num_t gpio_number);
+
+/// 出力の観測関数の設定 (nullptrで解除)
+void SetOutputObserver(const OutputObserver observer, void* const arg);
+
+/// 入力レベルの設定 (エッジが一致すればISR Handlerを割り込み禁止相当で実行)
+void SetInputLevel(const gpio_num_t gpio_number, const bool level);
+
+/// 複数ピンの出力 (マスクのビット順に観測関数へ通知)
+void WriteMask(const uint64_t mask, const bool level);
+
+/// ピンの入力レベル
+bool TestMask(const uint64_t mask);
+
+/// GPIO Bit Mask (GPIO0-31:下位32bit GPIO32-39:上位32bit)
+constexpr uint64_t PinMask(const gpio_num_t gpio_number) {
+  return 1ull << gpio_number;
+}
+
+/// Set GPIO Bits (Output)
+template <uint64_t MASK>
+FORCE_INLINE_ATTR void SetBits() {
+  WriteMask(MASK, true);
+}
+
+/// Clear GPIO Bits (Output)
+template <uint64_t MASK>
+FORCE_INLINE_ATTR void ClearBits() {
+  WriteMask(MASK, false);
+}
+
+/// Write GPIO Bits (Output)
+template <uint64_t MASK>
+FORCE_INLINE_ATTR void WriteBits(const bool level) {
+  WriteMask(MASK, level);
+}
+
+/// Test GPIO Bit (Input)
+template <uint64_t MASK>
+FORCE_INLINE_ATTR bool TestBit() {
+  static_assert((MASK & (MASK - 1)) == 0, "single pin only");
+  return TestMask(MASK);
+}
+
+}  // namespace HareTortoiseClockSystem::GPIO
+
+#endif  // GPIO_H_
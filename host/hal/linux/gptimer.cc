@@ -0,0 +1,125 @@
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include "gptimer.h"
+
+#include <freertos/FreeRTOS.h>
+#include <time.h>
+
+#include "host_clock.h"
+
+namespace {
+
+constexpr int64_t NANOSECONDS_PER_SECOND = 1000000000;
+
+int64_t ToNanoseconds(const timespec &time) {
+  return static_cast<int64_t>(time.tv_sec) * NANOSECONDS_PER_SECOND +
+         time.tv_nsec;
+}
+
+timespec FromNanoseconds(const int64_t nanoseconds) {
+  timespec time;
+  time.tv_sec = nanoseconds / NANOSECONDS_PER_SECOND;
+  time.tv_nsec = nanoseconds % NANOSECONDS_PER_SECOND;
+  return time;
+}
+
+}  // namespace
+
+GPTimer::GPTimer()
+    : resolution_(1),
+      function_(nullptr),
+      user_data_(nullptr),
+      is_enabled_(false),
+      thread_(),
+      mutex_(),
+      condition_(),
+      is_running_(false),
+      generation_(0),
+      wait_count_(0),
+      is_quit_(false) {}
+
+void GPTimer::Create(const uint32_t resolution, gptimer_alarm_cb_t function,
+                     void *const user_data) {
+  if (thread_.joinable()) {
+    return;
+  }
+  resolution_ = resolution;
+  function_ = function;
+  user_data_ = user_data;
+  is_quit_ = false;
+  thread_ = std::thread(&GPTimer::Worker, this);
+}
+
+void GPTimer::Destroy() {
+  if (!thread_.joinable()) {
+    return;
+  }
+  Stop();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    is_quit_ = true;
+  }
+  condition_.notify_one();
+  thread_.join();
+  is_enabled_ = false;
+}
+
+void GPTimer::Start(const uint64_t wait_count) const {
+  if (!thread_.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    wait_count_ = wait_count;
+    ++generation_;
+    is_running_ = true;
+  }
+  condition_.notify_one();
+}
+
+void GPTimer::Worker() {
+  uint32_t started_generation = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      condition_.wait(lock, [&] {
+        return is_quit_ ||
+               (is_running_ && generation_ != started_generation);
+      });
+      if (is_quit_) {
+        return;
+      }
+      started_generation = generation_;
+    }
+
+    const int64_t period_ns = static_cast<int64_t>(wait_count_) *
+                              NANOSECONDS_PER_SECOND / resolution_;
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    const int64_t start_ns = ToNanoseconds(now);
+    uint64_t alarm_count = 0;
+    while (is_running_ && generation_ == started_generation) {
+      ++alarm_count;
+      // 早送り中は待たずに次のアラームを発生させる
+      // (停止されるまでアラームは続くため、時刻は進めない)
+      if (HareTortoiseClockSystem::HostClock::IsFastForward()) {
+        std::this_thread::yield();
+      } else {
+        const timespec deadline = FromNanoseconds(
+            start_ns + period_ns * static_cast<int64_t>(alarm_count));
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr);
+      }
+
+      // 割り込み禁止相当のロック内で実行 (停止後のアラームは発生させない)
+      HostEnterCritical();
+      if (is_running_ && generation_ == started_generation) {
+        const gptimer_alarm_event_data_t event_data = {
+            .count_value = wait_count_, .alarm_value = wait_count_};
+        function_(nullptr, &event_data, user_data_);
+      }
+      HostExitCritical();
+    }
+  }
+}
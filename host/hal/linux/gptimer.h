@@ -0,0 +1,61 @@
+#ifndef GPTIMER_H_
+#define GPTIMER_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// GPTimerのLinux実装 (std::thread と CLOCK_MONOTONIC の絶対時刻待ち)
+// アラームは開始時刻からの周期の整数倍で発生させ、待機の遅れを累積させない
+
+// Include ----------------------
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+typedef struct gptimer_t *gptimer_handle_t;
+
+/// アラームイベント (ESP-IDF driver/gptimer.h 相当)
+typedef struct {
+  uint64_t count_value;
+  uint64_t alarm_value;
+} gptimer_alarm_event_data_t;
+
+typedef bool (*gptimer_alarm_cb_t)(gptimer_handle_t timer,
+                                   const gptimer_alarm_event_data_t *edata,
+                                   void *user_ctx);
+
+class GPTimer {
+ public:
+  GPTimer();
+  ~GPTimer() { Destroy(); }
+
+  void Create(const uint32_t resolution, gptimer_alarm_cb_t function,
+              void *const user_data);
+  void Destroy();
+
+  void Enable() { is_enabled_ = true; }
+  void Disable() { is_enabled_ = false; }
+
+  void Start(const uint64_t wait_count) const;
+  /// 停止 (ISRからも呼び出し可)
+  void Stop() const { is_running_ = false; }
+
+ private:
+  void Worker();
+
+ private:
+  uint32_t resolution_;
+  gptimer_alarm_cb_t function_;
+  void *user_data_;
+  bool is_enabled_;
+  std::thread thread_;
+  mutable std::mutex mutex_;
+  mutable std::condition_variable condition_;
+  mutable std::atomic<bool> is_running_;
+  mutable std::atomic<uint32_t> generation_;
+  mutable std::atomic<uint64_t> wait_count_;
+  bool is_quit_;
+};
+
+#endif  // GPTIMER_H_
@@ -0,0 +1,25 @@
+#ifndef HOST_CLOCK_H_
+#define HOST_CLOCK_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// ホスト環境の時刻の早送り
+// 有効にするとSleepMillisecond・Task::WaitNotificationのタイムアウト・
+// GPTimerのアラーム周期を実時間で待たず、その分だけ時刻を進める
+// (1日分の運転などを短時間で検証するため hal/linuxのみ)
+
+// Include ----------------------
+#include <cstdint>
+
+namespace HareTortoiseClockSystem::HostClock {
+
+/// 早送りの有効/無効
+void SetFastForward(const bool is_enable);
+bool IsFastForward();
+
+/// esp_timer_get_time とエポック時刻を進める
+void Advance(const int64_t microseconds);
+
+}  // namespace HareTortoiseClockSystem::HostClock
+
+#endif  // HOST_CLOCK_H_
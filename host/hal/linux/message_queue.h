@@ -0,0 +1,164 @@
+#ifndef MESSAGE_QUEUE_H_
+#define MESSAGE_QUEUE_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// MessageQueueのLinux実装 (リングバッファ と std::condition_variable)
+// ISRの代替 (タイマー・GPIOのスレッド) からの送信も通常の送信と同じ
+
+// Include ----------------------
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+template <typename T>
+class MessageQueue {
+ public:
+  MessageQueue()
+      : buffer_(nullptr), capacity_(0), head_(0), count_(0), heap_buffer_() {}
+
+  virtual ~MessageQueue() { Destroy(); }
+
+  bool Create(const int32_t queueSize = 1) {
+    if (buffer_) {
+      return true;
+    }
+    heap_buffer_ = std::make_unique<T[]>(queueSize);
+    return Attach(heap_buffer_.get(), queueSize);
+  }
+
+  void Destroy() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffer_ = nullptr;
+    capacity_ = 0;
+    head_ = 0;
+    count_ = 0;
+    heap_buffer_.reset();
+  }
+
+  bool ReceiveWait(T *const receive_data, const int32_t max_wait_millisecond) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!buffer_) {
+      return false;
+    }
+    if (!not_empty_.wait_for(lock,
+                             std::chrono::milliseconds(max_wait_millisecond),
+                             [this] { return 0 < count_; })) {
+      return false;
+    }
+    PopLocked(receive_data);
+    return true;
+  }
+
+  bool ReceiveNonBlock(T *const receive_data) {
+    return ReceiveWait(receive_data, 0);
+  }
+
+  bool ReceiveBlock(T *const receive_data) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!buffer_) {
+      return false;
+    }
+    not_empty_.wait(lock, [this] { return 0 < count_; });
+    PopLocked(receive_data);
+    return true;
+  }
+
+  bool Send(const T &data) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!buffer_ || capacity_ <= count_) {
+        return false;
+      }
+      buffer_[(head_ + count_) % capacity_] = data;
+      ++count_;
+    }
+    not_empty_.notify_one();
+    return true;
+  }
+
+  /// 複数件送信 (キューが満杯になった時点で打ち切り)
+  /// @return 送信できた件数
+  size_t SendBatch(const T *const data, const size_t count) {
+    size_t sent = 0;
+    while (sent < count && Send(data[sent])) {
+      ++sent;
+    }
+    return sent;
+  }
+
+  /// 複数件受信 (1件目のみ待機し、以降はキューに残っている分を取り出す)
+  /// @return 受信できた件数
+  size_t ReceiveBatch(T *const receive_data, const size_t max_count,
+                      const int32_t max_wait_millisecond) {
+    if (max_count == 0 || !ReceiveWait(&receive_data[0], max_wait_millisecond)) {
+      return 0;
+    }
+    size_t received = 1;
+    while (received < max_count && ReceiveNonBlock(&receive_data[received])) {
+      ++received;
+    }
+    return received;
+  }
+
+  /// ISRから送信
+  /// @return 高優先度タスクが起床した場合true (Linuxでは常にfalse)
+  bool SendFromISR(const T &data) {
+    Send(data);
+    return false;
+  }
+
+  /// ISRから送信
+  void SendFromISRAndYield(const T &data) { Send(data); }
+
+ protected:
+  /// 確保済みの領域をキューとして利用
+  bool Attach(T *const buffer, const int32_t capacity) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffer_ = buffer;
+    capacity_ = capacity;
+    head_ = 0;
+    count_ = 0;
+    return buffer_ != nullptr;
+  }
+
+  bool IsCreated() const { return buffer_ != nullptr; }
+
+ private:
+  void PopLocked(T *const receive_data) {
+    *receive_data = buffer_[head_];
+    head_ = (head_ + 1) % capacity_;
+    --count_;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable not_empty_;
+  T *buffer_;
+  int32_t capacity_;
+  int32_t head_;
+  int32_t count_;
+  std::unique_ptr<T[]> heap_buffer_;
+};
+
+/// 静的領域を利用するMessageQueue (ヒープ確保なし)
+template <typename T, int32_t QUEUE_SIZE>
+class StaticMessageQueue final : public MessageQueue<T> {
+ public:
+  StaticMessageQueue() : MessageQueue<T>(), storage_() {}
+
+  bool Create() {
+    if (this->IsCreated()) {
+      return true;
+    }
+    return this->Attach(storage_, QUEUE_SIZE);
+  }
+
+ private:
+  T storage_[QUEUE_SIZE];
+};
+
+#endif  // MESSAGE_QUEUE_H_
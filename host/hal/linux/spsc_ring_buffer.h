@@ -0,0 +1,119 @@
+#ifndef SPSC_RING_BUFFER_H_
+#define SPSC_RING_BUFFER_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// SpscRingBufferのLinux実装 (リングバッファはFreeRTOS実装と同じ)
+// タスク通知の代わりに、受信側が待機中の場合のみstd::condition_variableで起床する
+
+// Include ----------------------
+#include <freertos/FreeRTOS.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+/// ISR(送信1箇所) -> タスク(受信1箇所) 向けロックフリーリングバッファ
+/// 送信側は受信側が待機中の場合のみロックを取る
+template <typename T, uint32_t CAPACITY>
+class SpscRingBuffer final {
+  static_assert((CAPACITY & (CAPACITY - 1)) == 0,
+                "CAPACITY must be a power of two");
+
+ public:
+  SpscRingBuffer()
+      : buffer_(),
+        head_(0),
+        tail_(0),
+        is_waiting_(false),
+        mutex_(),
+        not_empty_() {}
+
+  /// コピー禁止
+  SpscRingBuffer(const SpscRingBuffer &) = delete;
+  SpscRingBuffer &operator=(const SpscRingBuffer &) = delete;
+
+  /// 受信タスクを登録 (Linuxでは待機中の判定で起床するため不要)
+  void BindConsumer() {}
+
+  /// 全件破棄 (受信側から呼び出す)
+  void Clear() { tail_.store(head_.load(std::memory_order_acquire)); }
+
+  /// ISRから送信
+  /// @param high_task_awoken Linuxでは常にpdFALSE
+  bool PushFromISR(const T &data, BaseType_t *const high_task_awoken) {
+    const uint32_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) == CAPACITY) {
+      return false;
+    }
+    buffer_[head & (CAPACITY - 1)] = data;
+    // 受信側の待機開始と順序付けるため、送信と待機中の確認は逐次一貫
+    head_.store(head + 1);
+    if (is_waiting_.load()) {
+      // 受信側の判定から待機開始までの間に通知しないようロックを通す
+      { std::lock_guard<std::mutex> lock(mutex_); }
+      not_empty_.notify_one();
+    }
+    *high_task_awoken = pdFALSE;
+    return true;
+  }
+
+  /// ISRから送信
+  bool PushFromISRAndYield(const T &data) {
+    BaseType_t high_task_awoken = pdFALSE;
+    return PushFromISR(data, &high_task_awoken);
+  }
+
+  /// 受信 (ノンブロック)
+  bool Pop(T *const receive_data) {
+    const uint32_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    *receive_data = buffer_[tail & (CAPACITY - 1)];
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// 受信 (最大max_wait_millisecond待機)
+  bool PopWait(T *const receive_data, const int32_t max_wait_millisecond) {
+    if (Pop(receive_data)) {
+      return true;
+    }
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      is_waiting_.store(true);
+      // 空でなくなるまで待つ (待機開始までに送信された場合は待たない)
+      // 前回の待機の後に届いた通知で空のまま戻らないよう、通知ではなく残数で判定
+      not_empty_.wait_for(
+          lock, std::chrono::milliseconds(max_wait_millisecond), [this] {
+            return tail_.load(std::memory_order_relaxed) != head_.load();
+          });
+      is_waiting_.store(false);
+    }
+    return Pop(receive_data);
+  }
+
+  /// まとめて受信 (ノンブロック)
+  /// @return 受信できた件数
+  size_t PopBatch(T *const receive_data, const size_t max_count) {
+    size_t received = 0;
+    while (received < max_count && Pop(&receive_data[received])) {
+      ++received;
+    }
+    return received;
+  }
+
+ private:
+  T buffer_[CAPACITY];
+  std::atomic<uint32_t> head_;
+  std::atomic<uint32_t> tail_;
+  std::atomic<bool> is_waiting_;
+  std::mutex mutex_;
+  std::condition_variable not_empty_;
+};
+
+#endif  // SPSC_RING_BUFFER_H_
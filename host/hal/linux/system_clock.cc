@@ -0,0 +1,129 @@
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// 時刻・待機のLinux実装
+// 設定した時刻はプロセス内のオフセットとして保持する (システム時刻は変更しない)
+// 徐々の補正はESP-IDFのadjtimeと同じ速度 (経過時間の1/64) で適用する
+// 早送り中の待機は時刻を進めるのみ (host_clock.h)
+
+// Include ----------------------
+#include <esp_timer.h>
+#include <time.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+
+#include "host_clock.h"
+#include "util.h"
+
+namespace {
+
+/// adjtimeの補正速度 (経過時間 >> ADJTIME_CORRECTION_SHIFT)
+constexpr int32_t ADJTIME_CORRECTION_SHIFT = 6;
+
+std::mutex clock_mutex;
+/// システム時刻に加えるオフセット(us) と 未適用の補正量(us)
+int64_t epoch_offset_us = 0;
+int64_t outstanding_slew_us = 0;
+int64_t last_slew_update_us = 0;
+/// 早送りで進めた時間(us) (esp_timer_get_timeに加算)
+std::atomic<int64_t> advanced_us(0);
+std::atomic<bool> is_fast_forward(false);
+
+int64_t GetClockMicroseconds(const clockid_t clock_id) {
+  timespec now;
+  clock_gettime(clock_id, &now);
+  return static_cast<int64_t>(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
+
+/// 起動時のモノトニック時刻 (esp_timer_get_timeの起点)
+const int64_t boot_monotonic_us = GetClockMicroseconds(CLOCK_MONOTONIC);
+
+/// 経過時間に応じて補正を適用 (clock_mutex内で呼び出す)
+void ApplySlewLocked() {
+  const int64_t now_us = esp_timer_get_time();
+  const int64_t max_correction_us =
+      (now_us - last_slew_update_us) >> ADJTIME_CORRECTION_SHIFT;
+  last_slew_update_us = now_us;
+  if (std::llabs(outstanding_slew_us) <= max_correction_us) {
+    epoch_offset_us += outstanding_slew_us;
+    outstanding_slew_us = 0;
+  } else {
+    const int64_t correction_us =
+        0 < outstanding_slew_us ? max_correction_us : -max_correction_us;
+    epoch_offset_us += correction_us;
+    outstanding_slew_us -= correction_us;
+  }
+}
+
+}  // namespace
+
+int64_t esp_timer_get_time() {
+  return GetClockMicroseconds(CLOCK_MONOTONIC) - boot_monotonic_us +
+         advanced_us.load();
+}
+
+namespace HareTortoiseClockSystem {
+namespace HostClock {
+
+void SetFastForward(const bool is_enable) { is_fast_forward = is_enable; }
+
+bool IsFastForward() { return is_fast_forward.load(); }
+
+void Advance(const int64_t microseconds) {
+  // エポック時刻はesp_timerの経過と同じだけ進める (補正の進み方を変えない)
+  std::lock_guard<std::mutex> lock(clock_mutex);
+  advanced_us += microseconds;
+  epoch_offset_us += microseconds;
+}
+
+}  // namespace HostClock
+
+namespace Util {
+
+/// Sleep
+void SleepMillisecond(const uint32_t sleep_milliseconds) {
+  if (HostClock::IsFastForward()) {
+    HostClock::Advance(static_cast<int64_t>(sleep_milliseconds) * 1000);
+    std::this_thread::yield();
+    return;
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(sleep_milliseconds));
+}
+
+std::time_t GetEpoch() {
+  return static_cast<std::time_t>(GetEpochMicroseconds() / 1000000);
+}
+
+/// SetTime
+void SetSystemTime(const std::time_t set_epoch_time) {
+  std::lock_guard<std::mutex> lock(clock_mutex);
+  epoch_offset_us = static_cast<int64_t>(set_epoch_time) * 1000000 -
+                    GetClockMicroseconds(CLOCK_REALTIME);
+  outstanding_slew_us = 0;
+}
+
+int64_t GetEpochMicroseconds() {
+  std::lock_guard<std::mutex> lock(clock_mutex);
+  ApplySlewLocked();
+  return GetClockMicroseconds(CLOCK_REALTIME) + epoch_offset_us;
+}
+
+void StepSystemTime(const int64_t offset_microseconds) {
+  std::lock_guard<std::mutex> lock(clock_mutex);
+  ApplySlewLocked();
+  epoch_offset_us += offset_microseconds;
+}
+
+void SlewSystemTime(const int64_t offset_microseconds) {
+  // 補正中の残量に加算する (上書きすると前回の補正が失われる)
+  std::lock_guard<std::mutex> lock(clock_mutex);
+  ApplySlewLocked();
+  outstanding_slew_us += offset_microseconds;
+}
+
+}  // namespace Util
+}  // namespace HareTortoiseClockSystem
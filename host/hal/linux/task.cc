@@ -0,0 +1,143 @@
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include "task.h"
+
+#include <freertos/task.h>
+
+#include <esp_timer.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "host_clock.h"
+#include "logger.h"
+
+namespace HareTortoiseClockSystem {
+
+/// スタック使用量報告対象のタスク
+static Task* s_RegisteredTasks[Task::MAX_REGISTERED_TASKS] = {};
+static std::mutex s_RegisteredTasksMutex;
+
+/// 通知待ちで早送りの開始を確認する間隔(us)
+static constexpr int64_t FAST_FORWARD_POLL_US = 100000;
+
+Task::Task() = default;
+
+Task::Task(const std::string& taskName, const int32_t priority,
+           const int coreId)
+    : Task(taskName, priority, coreId, TASK_STAC_DEPTH, nullptr) {}
+
+Task::Task(const std::string& taskName, const int32_t priority,
+           const int coreId, const uint32_t stackDepth,
+           StackType_t* const stackBuffer)
+    : m_Status(TASK_STATUS_READY),
+      m_TaskName(taskName),
+      m_Priority(priority),
+      m_CoreId(coreId),
+      m_StackDepth(stackDepth),
+      m_Thread(),
+      m_NotifyMutex(),
+      m_NotifyCondition(),
+      m_NotifyCount(0) {}
+
+Task::~Task() { Stop(); }
+
+void Task::Start() {
+  if (m_Status != TASK_STATUS_READY) {
+    return;
+  }
+  m_Status = TASK_STATUS_RUN;
+  m_Thread = std::thread(&Task::Run, this);
+}
+
+void Task::Stop() {
+  TaskStatus expected = TASK_STATUS_RUN;
+  m_Status.compare_exchange_strong(expected, TASK_STATUS_END);
+  if (m_Thread.joinable() && m_Thread.get_id() != std::this_thread::get_id()) {
+    Notify();
+    m_Thread.join();
+  }
+}
+
+void Task::Run() {
+  Register(this);
+  Initialize();
+  while (m_Status == TASK_STATUS_RUN) {
+    Update();
+  }
+  Unregister(this);
+}
+
+void Task::LogStackHighWaterMarks() {
+  std::lock_guard<std::mutex> lock(s_RegisteredTasksMutex);
+  for (const Task* const task : s_RegisteredTasks) {
+    if (task) {
+      ESP_LOGI(TAG, "Task %s depth:%u", task->m_TaskName.c_str(),
+               task->m_StackDepth);
+    }
+  }
+}
+
+uint32_t Task::GetCurrentStackHighWaterMark() { return 0; }
+
+void Task::Notify() {
+  {
+    std::lock_guard<std::mutex> lock(m_NotifyMutex);
+    ++m_NotifyCount;
+  }
+  m_NotifyCondition.notify_one();
+}
+
+bool Task::WaitNotification(const uint32_t max_wait_millisecond) {
+  // 待機中に早送りが始まった場合も残りの時間を進めて終了するため、
+  // 実時間の待機は一定間隔で区切る
+  const int64_t deadline_us =
+      esp_timer_get_time() + static_cast<int64_t>(max_wait_millisecond) * 1000;
+  std::unique_lock<std::mutex> lock(m_NotifyMutex);
+  while (m_NotifyCount == 0) {
+    const int64_t remaining_us = deadline_us - esp_timer_get_time();
+    if (remaining_us <= 0) {
+      return false;
+    }
+    if (HostClock::IsFastForward()) {
+      // 早送り中は通知が無ければタイムアウトまで時刻を進める
+      lock.unlock();
+      HostClock::Advance(remaining_us);
+      return false;
+    }
+    m_NotifyCondition.wait_for(
+        lock, std::chrono::microseconds(
+                  std::min(remaining_us, FAST_FORWARD_POLL_US)));
+  }
+  m_NotifyCount = 0;
+  return true;
+}
+
+void Task::Register(Task* const task) {
+  std::lock_guard<std::mutex> lock(s_RegisteredTasksMutex);
+  for (Task*& slot : s_RegisteredTasks) {
+    if (!slot) {
+      slot = task;
+      break;
+    }
+  }
+}
+
+void Task::Unregister(Task* const task) {
+  std::lock_guard<std::mutex> lock(s_RegisteredTasksMutex);
+  for (Task*& slot : s_RegisteredTasks) {
+    if (slot == task) {
+      slot = nullptr;
+    }
+  }
+}
+
+}  // namespace HareTortoiseClockSystem
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+  // スレッド毎に異なるアドレスをハンドルとする
+  static thread_local char current_task;
+  return &current_task;
+}
@@ -0,0 +1,107 @@
+#ifndef TASK_H_
+#define TASK_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// TaskのLinux実装 (std::thread)
+// 優先度・コア・スタックの指定はFreeRTOS実装との互換のため保持のみ
+
+// Include ----------------------
+#include <freertos/FreeRTOS.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace HareTortoiseClockSystem {
+
+/// std::thread Wrap
+class Task {
+ public:
+  enum TaskStatus {
+    TASK_STATUS_READY,
+    TASK_STATUS_RUN,
+    TASK_STATUS_END,
+  };
+
+  static constexpr int32_t TASK_STAC_DEPTH = 8192;
+
+  /// スタック使用量を報告するタスクの最大数
+  static constexpr int32_t MAX_REGISTERED_TASKS = 8;
+
+  /// Task Priority
+  static constexpr int32_t PRIORITY_TOP = (configMAX_PRIORITIES) - 1;
+  static constexpr int32_t PRIORITY_LOW = 0;
+  static constexpr int32_t PRIORITY_NORMAL = PRIORITY_TOP - 4;
+  static constexpr int32_t PRIORITY_HIGH = PRIORITY_TOP - 3;
+
+ private:
+  Task();
+
+ public:
+  Task(const std::string& taskName, const int32_t priority, const int coreId);
+  Task(const std::string& taskName, const int32_t priority, const int coreId,
+       const uint32_t stackDepth, StackType_t* const stackBuffer = nullptr);
+  virtual ~Task();
+
+  /// Start Task
+  void Start();
+
+  /// Stop Task (自スレッド以外からの呼び出しは終了まで待機)
+  void Stop();
+
+  /// Initialize (Called when the Start function is executed.)
+  virtual void Initialize() {}
+
+  /// (override) sub class processing
+  virtual void Update() = 0;
+
+ public:
+  /// Task Running
+  void Run();
+
+  /// Log running tasks (Linuxではスタック使用量は取得しない)
+  static void LogStackHighWaterMarks();
+  /// Stack high water mark (Linuxでは常に0)
+  static uint32_t GetCurrentStackHighWaterMark();
+
+ protected:
+  /// 通知で起床 (他タスクから呼び出し 待機中でなければ次の待機を即時終了)
+  void Notify();
+  /// 通知を待機 (通知を受けた場合true)
+  bool WaitNotification(const uint32_t max_wait_millisecond);
+
+ private:
+  static void Register(Task* const task);
+  static void Unregister(Task* const task);
+
+ protected:
+  /// Task Status
+  std::atomic<TaskStatus> m_Status;
+
+  /// Task Name
+  std::string m_TaskName;
+
+  /// Task Priority
+  int32_t m_Priority;
+
+  /// Use Core Id
+  int32_t m_CoreId;
+
+  /// Stack Depth (byte)
+  uint32_t m_StackDepth;
+
+  /// Thread
+  std::thread m_Thread;
+
+  /// Notification
+  std::mutex m_NotifyMutex;
+  std::condition_variable m_NotifyCondition;
+  uint32_t m_NotifyCount;
+};
+
+}  // namespace HareTortoiseClockSystem
+
+#endif  // TASK_H_
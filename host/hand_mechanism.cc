@@ -0,0 +1,179 @@
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include "hand_mechanism.h"
+
+#include <time.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+
+namespace HareTortoiseClockSystem {
+
+namespace {
+
+/// 期待周期(平均)に対してこの割合を超えたステップ周期を遅れとして数える
+constexpr int64_t LATE_PERCENT = 150;
+
+int64_t MonotonicNs() {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+}  // namespace
+
+HandModel::HandModel(const char *const name, const gpio_num_t enable,
+                     const gpio_num_t step, const gpio_num_t dir,
+                     const gpio_num_t right_limit, const gpio_num_t left_limit,
+                     const int32_t position)
+    : name_(name),
+      enable_(enable),
+      step_(step),
+      dir_(dir),
+      right_limit_(right_limit),
+      left_limit_(left_limit),
+      is_enabled_(false),
+      is_dir_right_(false),
+      position_(position),
+      last_edge_ns_(0),
+      move_(EMPTY_STATS),
+      total_(EMPTY_STATS),
+      intervals_(),
+      is_verbose_(false) {
+  intervals_.reserve(static_cast<size_t>(RIGHT_STOP_STEPS));
+}
+
+bool HandModel::OnOutput(const gpio_num_t gpio_number, const bool level) {
+  if (gpio_number == enable_) {
+    const bool was_enabled = is_enabled_;
+    is_enabled_ = !level;  // LOWで有効
+    if (is_enabled_ && !was_enabled) {
+      move_ = EMPTY_STATS;
+      last_edge_ns_ = 0;
+    } else if (!is_enabled_ && was_enabled) {
+      FinishMove();
+    }
+  } else if (gpio_number == dir_) {
+    is_dir_right_ = level;
+  } else if (gpio_number == step_) {
+    OnStepEdge(level);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void HandModel::OnStepEdge(const bool level) {
+  // ステップ周期は立ち上がりの間隔 (ClearStepの立ち下がりを含めない)
+  if (!is_enabled_ || !level) {
+    return;
+  }
+  const int64_t now_ns = MonotonicNs();
+  if (last_edge_ns_ != 0) {
+    const int64_t interval = now_ns - last_edge_ns_;
+    move_.min_ns = std::min(move_.min_ns, interval);
+    move_.max_ns = std::max(move_.max_ns, interval);
+    move_.sum_ns += interval;
+    ++move_.intervals;
+    if (intervals_.size() < intervals_.capacity()) {
+      intervals_.push_back(interval);
+    }
+  }
+  last_edge_ns_ = now_ns;
+  ++move_.steps;
+  position_ += is_dir_right_ ? 1 : -1;
+  position_ = std::clamp(position_, LEFT_STOP_STEPS, RIGHT_STOP_STEPS);
+  UpdateLimits();
+}
+
+void HandModel::FinishMove() {
+  ++move_.moves;
+  if (0 < move_.intervals) {
+    // アラームは開始時刻からの周期の整数倍で発生するため、平均が期待周期
+    const int64_t late_ns = move_.sum_ns / move_.intervals * LATE_PERCENT / 100;
+    move_.late = static_cast<uint32_t>(
+        std::count_if(intervals_.begin(), intervals_.end(),
+                      [late_ns](const int64_t ns) { return late_ns < ns; }));
+  }
+  if (is_verbose_ && 0 < move_.steps) {
+    std::printf("  %-6s steps:%6" PRIu32 " period min:%7.1fus max:%7.1fus "
+                "late:%" PRIu32 " pos:%" PRId32 "\n",
+                name_, move_.steps, move_.min_ns / 1000.0,
+                move_.max_ns / 1000.0, move_.late, position_);
+  }
+  total_.moves += move_.moves;
+  total_.steps += move_.steps;
+  total_.intervals += move_.intervals;
+  total_.sum_ns += move_.sum_ns;
+  total_.late += move_.late;
+  if (0 < move_.intervals) {
+    total_.min_ns = std::min(total_.min_ns, move_.min_ns);
+    total_.max_ns = std::max(total_.max_ns, move_.max_ns);
+  }
+  intervals_.clear();
+}
+
+void HandModel::UpdateLimits() {
+  // リミットスイッチは押下でHIGH
+  GPIO::SetInputLevel(left_limit_, position_ <= LEFT_STOP_STEPS);
+  GPIO::SetInputLevel(right_limit_, RIGHT_STOP_STEPS <= position_);
+}
+
+HandMechanism::HandMechanism()
+    : hour("hour",
+           static_cast<gpio_num_t>(CONFIG_HOUR_HAND_ENABLE_OUTPUT_GPIO_NO),
+           static_cast<gpio_num_t>(CONFIG_HOUR_HAND_STEP_OUTPUT_GPIO_NO),
+           static_cast<gpio_num_t>(CONFIG_HOUR_HAND_DIR_OUTPUT_GPIO_NO),
+           static_cast<gpio_num_t>(CONFIG_HOUR_HAND_RIGHT_LIMIT_INPUT_GPIO_NO),
+           static_cast<gpio_num_t>(CONFIG_HOUR_HAND_LEFT_LIMIT_INPUT_GPIO_NO),
+           HOUR_START_STEPS),
+      minute(
+          "minute",
+          static_cast<gpio_num_t>(CONFIG_MINUTE_HAND_ENABLE_OUTPUT_GPIO_NO),
+          static_cast<gpio_num_t>(CONFIG_MINUTE_HAND_STEP_OUTPUT_GPIO_NO),
+          static_cast<gpio_num_t>(CONFIG_MINUTE_HAND_DIR_OUTPUT_GPIO_NO),
+          static_cast<gpio_num_t>(CONFIG_MINUTE_HAND_RIGHT_LIMIT_INPUT_GPIO_NO),
+          static_cast<gpio_num_t>(CONFIG_MINUTE_HAND_LEFT_LIMIT_INPUT_GPIO_NO),
+          MINUTE_START_STEPS),
+      mux(portMUX_INITIALIZER_UNLOCKED) {}
+
+void HandMechanism::Attach(const bool is_verbose) {
+  hour.SetVerbose(is_verbose);
+  minute.SetVerbose(is_verbose);
+  hour.Reset();
+  minute.Reset();
+  GPIO::SetOutputObserver(&HandMechanism::OnOutput, this);
+}
+
+void HandMechanism::Detach() { GPIO::SetOutputObserver(nullptr, nullptr); }
+
+bool HandMechanism::IsSettled(const ClockState &state) {
+  portENTER_CRITICAL(&mux);
+  const bool is_settled = !hour.IsEnabled() && !minute.IsEnabled() &&
+                          state.hour_pos == hour.GetPosition() &&
+                          state.minute_pos == minute.GetPosition();
+  portEXIT_CRITICAL(&mux);
+  return is_settled;
+}
+
+uint32_t HandMechanism::GetMinuteMoves() {
+  portENTER_CRITICAL(&mux);
+  const uint32_t moves = minute.GetTotal().moves;
+  portEXIT_CRITICAL(&mux);
+  return moves;
+}
+
+void HandMechanism::OnOutput(void *const arg, const gpio_num_t gpio_number,
+                             const bool level) {
+  HandMechanism *const self = static_cast<HandMechanism *>(arg);
+  portENTER_CRITICAL(&self->mux);
+  if (!self->hour.OnOutput(gpio_number, level)) {
+    self->minute.OnOutput(gpio_number, level);
+  }
+  portEXIT_CRITICAL(&self->mux);
+}
+
+}  // namespace HareTortoiseClockSystem
@@ -0,0 +1,123 @@
+#ifndef HAND_MECHANISM_H_
+#define HAND_MECHANISM_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include <freertos/FreeRTOS.h>
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "gpio_control.h"
+#include "hare_tortoise_clock_interface.h"
+#include "stepper_motor_util.h"
+
+namespace HareTortoiseClockSystem {
+
+/// 機構の可動範囲の端 (左リミットは0 右リミットは目盛の右端+25mm+余裕2mm)
+constexpr int32_t LEFT_STOP_STEPS = 0;
+constexpr int32_t RIGHT_STOP_STEPS =
+    StepperMotorUtil::ToSteps(Millimetres(662)).Count();
+/// 起動時の針位置 (原点復帰前)
+constexpr int32_t HOUR_START_STEPS =
+    StepperMotorUtil::ToSteps(Millimetres(40)).Count();
+constexpr int32_t MINUTE_START_STEPS =
+    StepperMotorUtil::ToSteps(Millimetres(25)).Count();
+
+/// ステップ周期の集計 (ns)
+struct EdgeStats {
+  uint32_t moves;
+  uint32_t steps;
+  uint32_t intervals;
+  int64_t min_ns;
+  int64_t max_ns;
+  int64_t sum_ns;
+  uint32_t late;
+};
+
+constexpr EdgeStats EMPTY_STATS = {0, 0, 0, INT64_MAX, 0, 0, 0};
+
+/// 1本の針の機構 (ENABLE LOW中のSTEP立ち上がりで1step DIR HIGHで右)
+/// 移動毎にステップ周期を集計し、期待周期(平均)の150%を超えた周期を遅れとして数える
+class HandModel {
+ public:
+  HandModel(const char *const name, const gpio_num_t enable,
+            const gpio_num_t step, const gpio_num_t dir,
+            const gpio_num_t right_limit, const gpio_num_t left_limit,
+            const int32_t position);
+
+  /// 入力の初期レベル (タスク開始前に呼び出す)
+  void Reset() { UpdateLimits(); }
+
+  /// GPIO出力の通知 (割り込み禁止相当のロック内)
+  bool OnOutput(const gpio_num_t gpio_number, const bool level);
+
+  int32_t GetPosition() const { return position_; }
+  bool IsEnabled() const { return is_enabled_; }
+  const EdgeStats &GetTotal() const { return total_; }
+  void ResetTotal() { total_ = EMPTY_STATS; }
+  void SetVerbose(const bool is_verbose) { is_verbose_ = is_verbose; }
+
+ private:
+  void OnStepEdge(const bool level);
+  void FinishMove();
+  void UpdateLimits();
+
+ private:
+  const char *const name_;
+  const gpio_num_t enable_;
+  const gpio_num_t step_;
+  const gpio_num_t dir_;
+  const gpio_num_t right_limit_;
+  const gpio_num_t left_limit_;
+  bool is_enabled_;
+  bool is_dir_right_;
+  int32_t position_;
+  int64_t last_edge_ns_;
+  EdgeStats move_;
+  EdgeStats total_;
+  /// 移動中のステップ周期 (ロック内で確保しないよう最大移動量分を予約)
+  std::vector<int64_t> intervals_;
+  bool is_verbose_;
+};
+
+/// 両方の針の模擬 (Kconfigのピン定義でGPIO出力を観測)
+/// ClockManagementTaskの開始前にAttach、終了後にDetachする
+struct HandMechanism {
+  HandMechanism();
+
+  void Attach(const bool is_verbose);
+  void Detach();
+
+  /// 停止中で、記録した針位置が模擬の位置と一致しているか
+  bool IsSettled(const ClockState &state);
+  uint32_t GetMinuteMoves();
+
+  static void OnOutput(void *const arg, const gpio_num_t gpio_number,
+                       const bool level);
+
+  HandModel hour;
+  HandModel minute;
+  portMUX_TYPE mux;
+};
+
+/// 条件を満たすまで実時間で待機 (時間内に満たさない場合false)
+template <typename CONDITION>
+bool WaitUntil(const std::chrono::steady_clock::duration timeout,
+               CONDITION condition) {
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+  while (!condition()) {
+    if (deadline < std::chrono::steady_clock::now()) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  return true;
+}
+
+}  // namespace HareTortoiseClockSystem
+
+#endif  // HAND_MECHANISM_H_
@@ -0,0 +1,14 @@
+#ifndef HOST_ESP_ATTR_H_
+#define HOST_ESP_ATTR_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+/// ESP-IDF esp_attr.h のホスト環境用代替 (配置指定は無視する)
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+#define FORCE_INLINE_ATTR static inline __attribute__((always_inline))
+
+#endif  // HOST_ESP_ATTR_H_
@@ -0,0 +1,24 @@
+#ifndef HOST_ESP_BT_H_
+#define HOST_ESP_BT_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+/// ESP-IDF esp_bt.h のホスト環境用代替 (コントローラは常に成功する)
+
+// Include ----------------------
+#include "esp_bt_defs.h"
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+typedef struct {
+  uint8_t mode;
+} esp_bt_controller_config_t;
+
+#define BT_CONTROLLER_INIT_CONFIG_DEFAULT() \
+  { ESP_BT_MODE_BLE }
+
+esp_err_t esp_bt_controller_mem_release(esp_bt_mode_t mode);
+esp_err_t esp_bt_controller_init(esp_bt_controller_config_t *cfg);
+esp_err_t esp_bt_controller_enable(esp_bt_mode_t mode);
+
+#endif  // HOST_ESP_BT_H_
@@ -0,0 +1,46 @@
+#ifndef HOST_ESP_BT_DEFS_H_
+#define HOST_ESP_BT_DEFS_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+/// ESP-IDF esp_bt_defs.h のホスト環境用代替 (利用している定義のみ)
+
+// Include ----------------------
+#include <cstdint>
+
+#include "esp_err.h"
+
+#define ESP_UUID_LEN_16 2
+#define ESP_UUID_LEN_32 4
+#define ESP_UUID_LEN_128 16
+
+typedef struct {
+  uint16_t len;
+  union {
+    uint16_t uuid16;
+    uint32_t uuid32;
+    uint8_t uuid128[ESP_UUID_LEN_128];
+  } uuid;
+} __attribute__((packed)) esp_bt_uuid_t;
+
+#define ESP_BD_ADDR_LEN 6
+typedef uint8_t esp_bd_addr_t[ESP_BD_ADDR_LEN];
+
+typedef enum {
+  ESP_BT_STATUS_SUCCESS = 0,
+  ESP_BT_STATUS_FAIL,
+} esp_bt_status_t;
+
+typedef enum {
+  BLE_ADDR_TYPE_PUBLIC = 0x00,
+  BLE_ADDR_TYPE_RANDOM = 0x01,
+} esp_ble_addr_type_t;
+
+typedef enum {
+  ESP_BT_MODE_IDLE = 0x00,
+  ESP_BT_MODE_BLE = 0x01,
+  ESP_BT_MODE_CLASSIC_BT = 0x02,
+  ESP_BT_MODE_BTDM = 0x03,
+} esp_bt_mode_t;
+
+#endif  // HOST_ESP_BT_DEFS_H_
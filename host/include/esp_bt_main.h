@@ -0,0 +1,21 @@
+#ifndef HOST_ESP_BT_MAIN_H_
+#define HOST_ESP_BT_MAIN_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+/// ESP-IDF esp_bt_main.h のホスト環境用代替
+
+// Include ----------------------
+#include "esp_err.h"
+
+typedef struct {
+  bool ssp_en;
+} esp_bluedroid_config_t;
+
+#define BT_BLUEDROID_INIT_CONFIG_DEFAULT() \
+  { true }
+
+esp_err_t esp_bluedroid_init_with_cfg(esp_bluedroid_config_t *cfg);
+esp_err_t esp_bluedroid_enable();
+
+#endif  // HOST_ESP_BT_MAIN_H_
@@ -0,0 +1,22 @@
+#ifndef HOST_ESP_CPU_H_
+#define HOST_ESP_CPU_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+/// ESP-IDF esp_cpu.h のホスト環境用代替
+/// サイクル数はモノトニック時刻(ns) (esp_rom_get_cpu_ticks_per_usは1000)
+
+// Include ----------------------
+#include <time.h>
+
+#include <cstdint>
+
+static inline uint32_t esp_cpu_get_cycle_count() {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<uint32_t>(static_cast<uint64_t>(now.tv_sec) *
+                                   1000000000ull +
+                               now.tv_nsec);
+}
+
+#endif  // HOST_ESP_CPU_H_
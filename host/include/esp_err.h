@@ -0,0 +1,28 @@
+#ifndef HOST_ESP_ERR_H_
+#define HOST_ESP_ERR_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+/// ESP-IDF esp_err.h のホスト環境用代替
+
+// Include ----------------------
+#include <cstdlib>
+
+typedef int esp_err_t;
+
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_NO_MEM 0x101
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_INVALID_STATE 0x103
+
+const char *esp_err_to_name(esp_err_t code);
+
+#define ESP_ERROR_CHECK(x)  \
+  do {                      \
+    if ((x) != ESP_OK) {    \
+      std::abort();         \
+    }                       \
+  } while (0)
+
+#endif  // HOST_ESP_ERR_H_
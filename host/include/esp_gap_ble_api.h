@@ -0,0 +1,149 @@
+#ifndef HOST_ESP_GAP_BLE_API_H_
+#define HOST_ESP_GAP_BLE_API_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+/// ESP-IDF esp_gap_ble_api.h のホスト環境用代替 (利用している定義のみ)
+/// 構造体のメンバの並びはESP-IDF v5.2と同じ (指示付き初期化子のため)
+
+// Include ----------------------
+#include "esp_bt_defs.h"
+
+#define ESP_BLE_ADV_FLAG_GEN_DISC (0x01 << 1)
+#define ESP_BLE_ADV_FLAG_BREDR_NOT_SPT (0x01 << 2)
+#define ESP_BLE_ADV_DATA_LEN_MAX 31
+
+typedef enum {
+  ESP_GAP_BLE_ADV_DATA_SET_COMPLETE_EVT = 0,
+  ESP_GAP_BLE_SCAN_RSP_DATA_SET_COMPLETE_EVT,
+  ESP_GAP_BLE_SCAN_PARAM_SET_COMPLETE_EVT,
+  ESP_GAP_BLE_SCAN_RESULT_EVT,
+  ESP_GAP_BLE_ADV_DATA_RAW_SET_COMPLETE_EVT,
+  ESP_GAP_BLE_SCAN_RSP_DATA_RAW_SET_COMPLETE_EVT,
+  ESP_GAP_BLE_ADV_START_COMPLETE_EVT,
+  ESP_GAP_BLE_SCAN_START_COMPLETE_EVT,
+  ESP_GAP_BLE_ADV_STOP_COMPLETE_EVT = 17,
+  ESP_GAP_BLE_SCAN_STOP_COMPLETE_EVT,
+  ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT = 20,
+} esp_gap_ble_cb_event_t;
+
+typedef enum {
+  ADV_TYPE_IND = 0x00,
+  ADV_TYPE_SCAN_IND = 0x02,
+  ADV_TYPE_NONCONN_IND = 0x03,
+} esp_ble_adv_type_t;
+
+typedef enum {
+  ADV_CHNL_ALL = 0x07,
+} esp_ble_adv_channel_t;
+
+typedef enum {
+  ADV_FILTER_ALLOW_SCAN_ANY_CON_ANY = 0x00,
+} esp_ble_adv_filter_t;
+
+typedef struct {
+  uint16_t adv_int_min;
+  uint16_t adv_int_max;
+  esp_ble_adv_type_t adv_type;
+  esp_ble_addr_type_t own_addr_type;
+  esp_bd_addr_t peer_addr;
+  esp_ble_addr_type_t peer_addr_type;
+  esp_ble_adv_channel_t channel_map;
+  esp_ble_adv_filter_t adv_filter_policy;
+} esp_ble_adv_params_t;
+
+typedef struct {
+  bool set_scan_rsp;
+  bool include_name;
+  bool include_txpower;
+  int min_interval;
+  int max_interval;
+  int appearance;
+  uint16_t manufacturer_len;
+  uint8_t *p_manufacturer_data;
+  uint16_t service_data_len;
+  uint8_t *p_service_data;
+  uint16_t service_uuid_len;
+  uint8_t *p_service_uuid;
+  uint8_t flag;
+} esp_ble_adv_data_t;
+
+typedef enum {
+  BLE_SCAN_TYPE_PASSIVE = 0x0,
+  BLE_SCAN_TYPE_ACTIVE = 0x1,
+} esp_ble_scan_type_t;
+
+typedef enum {
+  BLE_SCAN_FILTER_ALLOW_ALL = 0x0,
+} esp_ble_scan_filter_t;
+
+typedef enum {
+  BLE_SCAN_DUPLICATE_DISABLE = 0x0,
+  BLE_SCAN_DUPLICATE_ENABLE = 0x1,
+} esp_ble_scan_duplicate_t;
+
+typedef struct {
+  esp_ble_scan_type_t scan_type;
+  esp_ble_addr_type_t own_addr_type;
+  esp_ble_scan_filter_t scan_filter_policy;
+  uint16_t scan_interval;
+  uint16_t scan_window;
+  esp_ble_scan_duplicate_t scan_duplicate;
+} esp_ble_scan_params_t;
+
+typedef struct {
+  esp_bd_addr_t bda;
+  uint16_t min_int;
+  uint16_t max_int;
+  uint16_t latency;
+  uint16_t timeout;
+} esp_ble_conn_update_params_t;
+
+typedef enum {
+  ESP_GAP_SEARCH_INQ_RES_EVT = 0,
+  ESP_GAP_SEARCH_INQ_CMPL_EVT = 1,
+} esp_gap_search_evt_t;
+
+typedef union {
+  struct {
+    esp_bt_status_t status;
+  } adv_start_cmpl, adv_stop_cmpl, scan_param_cmpl, scan_start_cmpl;
+  struct {
+    esp_gap_search_evt_t search_evt;
+    esp_bd_addr_t bda;
+    int rssi;
+    uint8_t ble_adv[ESP_BLE_ADV_DATA_LEN_MAX * 2];
+    uint8_t adv_data_len;
+    uint8_t scan_rsp_len;
+  } scan_rst;
+  struct {
+    esp_bt_status_t status;
+    esp_bd_addr_t bda;
+    uint16_t min_int;
+    uint16_t max_int;
+    uint16_t latency;
+    uint16_t conn_int;
+    uint16_t timeout;
+  } update_conn_params;
+} esp_ble_gap_cb_param_t;
+
+typedef void (*esp_gap_ble_cb_t)(esp_gap_ble_cb_event_t event,
+                                 esp_ble_gap_cb_param_t *param);
+
+esp_err_t esp_ble_gap_register_callback(esp_gap_ble_cb_t callback);
+esp_err_t esp_ble_gap_set_device_name(const char *name);
+esp_err_t esp_ble_gap_config_adv_data(esp_ble_adv_data_t *adv_data);
+esp_err_t esp_ble_gap_config_adv_data_raw(uint8_t *raw_data,
+                                          uint32_t raw_data_len);
+esp_err_t esp_ble_gap_config_scan_rsp_data_raw(uint8_t *raw_data,
+                                               uint32_t raw_data_len);
+esp_err_t esp_ble_gap_start_advertising(esp_ble_adv_params_t *adv_params);
+esp_err_t esp_ble_gap_set_scan_params(esp_ble_scan_params_t *scan_params);
+esp_err_t esp_ble_gap_start_scanning(uint32_t duration);
+esp_err_t esp_ble_gap_update_conn_params(esp_ble_conn_update_params_t *params);
+esp_err_t esp_ble_gap_set_pkt_data_len(esp_bd_addr_t remote_device,
+                                       uint16_t tx_data_length);
+esp_err_t esp_ble_gap_disconnect(esp_bd_addr_t remote_device);
+uint16_t esp_ble_get_cur_sendable_packets_num(uint16_t connid);
+
+#endif  // HOST_ESP_GAP_BLE_API_H_
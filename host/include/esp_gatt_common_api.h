@@ -0,0 +1,13 @@
+#ifndef HOST_ESP_GATT_COMMON_API_H_
+#define HOST_ESP_GATT_COMMON_API_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+/// ESP-IDF esp_gatt_common_api.h のホスト環境用代替
+
+// Include ----------------------
+#include "esp_gatt_defs.h"
+
+esp_err_t esp_ble_gatt_set_local_mtu(uint16_t mtu);
+
+#endif  // HOST_ESP_GATT_COMMON_API_H_
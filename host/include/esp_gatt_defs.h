@@ -0,0 +1,81 @@
+#ifndef HOST_ESP_GATT_DEFS_H_
+#define HOST_ESP_GATT_DEFS_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+/// ESP-IDF esp_gatt_defs.h のホスト環境用代替 (利用している定義のみ)
+/// 構造体のメンバの並びはESP-IDF v5.2と同じ (指示付き初期化子のため)
+
+// Include ----------------------
+#include "esp_bt_defs.h"
+
+#define ESP_GATT_UUID_PRI_SERVICE 0x2800
+#define ESP_GATT_UUID_CHAR_DECLARE 0x2803
+#define ESP_GATT_UUID_CHAR_CLIENT_CONFIG 0x2902
+
+#define ESP_GATT_PERM_READ (1 << 0)
+#define ESP_GATT_PERM_WRITE (1 << 4)
+
+#define ESP_GATT_CHAR_PROP_BIT_BROADCAST (1 << 0)
+#define ESP_GATT_CHAR_PROP_BIT_READ (1 << 1)
+#define ESP_GATT_CHAR_PROP_BIT_WRITE_NR (1 << 2)
+#define ESP_GATT_CHAR_PROP_BIT_WRITE (1 << 3)
+#define ESP_GATT_CHAR_PROP_BIT_NOTIFY (1 << 4)
+#define ESP_GATT_CHAR_PROP_BIT_INDICATE (1 << 5)
+
+#define ESP_GATT_MAX_ATTR_LEN 512
+#define ESP_GATT_DEF_BLE_MTU_SIZE 23
+#define ESP_GATT_MAX_MTU_SIZE 517
+
+#define ESP_GATT_RSP_BY_APP 0
+#define ESP_GATT_AUTO_RSP 1
+
+#define ESP_GATT_IF_NONE 0xff
+
+typedef uint8_t esp_gatt_if_t;
+typedef uint8_t esp_gatt_char_prop_t;
+typedef uint16_t esp_gatt_perm_t;
+
+typedef enum {
+  ESP_GATT_OK = 0x0,
+  ESP_GATT_INVALID_HANDLE = 0x01,
+  ESP_GATT_READ_NOT_PERMIT = 0x02,
+  ESP_GATT_WRITE_NOT_PERMIT = 0x03,
+  ESP_GATT_INVALID_PDU = 0x04,
+  ESP_GATT_INVALID_OFFSET = 0x07,
+  ESP_GATT_INVALID_ATTR_LEN = 0x0d,
+  ESP_GATT_ERROR = 0x85,
+} esp_gatt_status_t;
+
+typedef struct {
+  uint8_t auto_rsp;
+} esp_attr_control_t;
+
+typedef struct {
+  uint16_t uuid_length;
+  uint8_t *uuid_p;
+  uint16_t perm;
+  uint16_t max_length;
+  uint16_t length;
+  uint8_t *value;
+} esp_attr_desc_t;
+
+typedef struct {
+  esp_attr_control_t attr_control;
+  esp_attr_desc_t att_desc;
+} esp_gatts_attr_db_t;
+
+typedef struct {
+  uint8_t value[ESP_GATT_MAX_ATTR_LEN];
+  uint16_t handle;
+  uint16_t offset;
+  uint16_t len;
+  uint8_t auth_req;
+} esp_gatt_value_t;
+
+typedef union {
+  esp_gatt_value_t attr_value;
+  uint16_t handle;
+} esp_gatt_rsp_t;
+
+#endif  // HOST_ESP_GATT_DEFS_H_
@@ -0,0 +1,125 @@
+#ifndef HOST_ESP_GATTS_API_H_
+#define HOST_ESP_GATTS_API_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+/// ESP-IDF esp_gatts_api.h のホスト環境用代替 (利用している定義のみ)
+/// 実装はGattStandIn (host/gatt_stand_in.cc)
+
+// Include ----------------------
+#include "esp_gatt_defs.h"
+
+#define ESP_GATT_PREP_WRITE_CANCEL 0x00
+#define ESP_GATT_PREP_WRITE_EXEC 0x01
+
+typedef enum {
+  ESP_GATTS_REG_EVT = 0,
+  ESP_GATTS_READ_EVT = 1,
+  ESP_GATTS_WRITE_EVT = 2,
+  ESP_GATTS_EXEC_WRITE_EVT = 3,
+  ESP_GATTS_MTU_EVT = 4,
+  ESP_GATTS_CONF_EVT = 5,
+  ESP_GATTS_START_EVT = 12,
+  ESP_GATTS_CONNECT_EVT = 14,
+  ESP_GATTS_DISCONNECT_EVT = 15,
+  ESP_GATTS_CONGEST_EVT = 20,
+  ESP_GATTS_RESPONSE_EVT = 21,
+  ESP_GATTS_CREAT_ATTR_TAB_EVT = 22,
+} esp_gatts_cb_event_t;
+
+typedef struct {
+  uint16_t interval;
+  uint16_t latency;
+  uint16_t timeout;
+} esp_gatt_conn_params_t;
+
+typedef union {
+  struct {
+    esp_gatt_status_t status;
+    uint16_t app_id;
+  } reg;
+  struct {
+    uint16_t conn_id;
+    uint32_t trans_id;
+    esp_bd_addr_t bda;
+    uint16_t handle;
+    uint16_t offset;
+    bool is_long;
+    bool need_rsp;
+  } read;
+  struct {
+    uint16_t conn_id;
+    uint32_t trans_id;
+    esp_bd_addr_t bda;
+    uint16_t handle;
+    uint16_t offset;
+    bool need_rsp;
+    bool is_prep;
+    uint16_t len;
+    uint8_t *value;
+  } write;
+  struct {
+    uint16_t conn_id;
+    uint32_t trans_id;
+    esp_bd_addr_t bda;
+    uint8_t exec_write_flag;
+  } exec_write;
+  struct {
+    uint16_t conn_id;
+    uint16_t mtu;
+  } mtu;
+  struct {
+    esp_gatt_status_t status;
+    uint16_t conn_id;
+    uint16_t handle;
+    uint16_t len;
+    uint8_t *value;
+  } conf;
+  struct {
+    esp_gatt_status_t status;
+    uint16_t service_handle;
+  } start;
+  struct {
+    uint16_t conn_id;
+    uint8_t link_role;
+    esp_bd_addr_t remote_bda;
+    esp_gatt_conn_params_t conn_params;
+  } connect;
+  struct {
+    uint16_t conn_id;
+    esp_bd_addr_t remote_bda;
+    int reason;
+  } disconnect;
+  struct {
+    uint16_t conn_id;
+    bool congested;
+  } congest;
+  struct {
+    esp_gatt_status_t status;
+    esp_bt_uuid_t svc_uuid;
+    uint8_t svc_inst_id;
+    uint16_t num_handle;
+    uint16_t *handles;
+  } add_attr_tab;
+} esp_ble_gatts_cb_param_t;
+
+typedef void (*esp_gatts_cb_t)(esp_gatts_cb_event_t event,
+                               esp_gatt_if_t gatts_if,
+                               esp_ble_gatts_cb_param_t *param);
+
+esp_err_t esp_ble_gatts_register_callback(esp_gatts_cb_t callback);
+esp_err_t esp_ble_gatts_app_register(uint16_t app_id);
+esp_err_t esp_ble_gatts_create_attr_tab(const esp_gatts_attr_db_t *gatts_attr_db,
+                                        esp_gatt_if_t gatts_if,
+                                        uint16_t max_nb_attr,
+                                        uint8_t srvc_inst_id);
+esp_err_t esp_ble_gatts_start_service(uint16_t service_handle);
+esp_err_t esp_ble_gatts_send_response(esp_gatt_if_t gatts_if, uint16_t conn_id,
+                                      uint32_t trans_id,
+                                      esp_gatt_status_t status,
+                                      esp_gatt_rsp_t *rsp);
+esp_err_t esp_ble_gatts_send_indicate(esp_gatt_if_t gatts_if, uint16_t conn_id,
+                                      uint16_t attr_handle, uint16_t value_len,
+                                      uint8_t *value, bool need_confirm);
+
+#endif  // HOST_ESP_GATTS_API_H_
@@ -0,0 +1,51 @@
+#ifndef HOST_ESP_LOG_H_
+#define HOST_ESP_LOG_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+/// ESP-IDF esp_log.h のホスト環境用代替 (標準エラー出力)
+/// 出力の可否は実行時のレベルで判定する (計測時は書式化も行わない)
+
+// Include ----------------------
+#include <cinttypes>
+#include <cstdint>
+
+#include "sdkconfig.h"
+
+typedef enum {
+  ESP_LOG_NONE,
+  ESP_LOG_ERROR,
+  ESP_LOG_WARN,
+  ESP_LOG_INFO,
+  ESP_LOG_DEBUG,
+  ESP_LOG_VERBOSE,
+} esp_log_level_t;
+
+#define LOG_LOCAL_LEVEL ESP_LOG_VERBOSE
+
+void esp_log_level_set(const char *tag, esp_log_level_t level);
+esp_log_level_t esp_log_level_get(const char *tag);
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format,
+                   ...) __attribute__((format(printf, 3, 4)));
+void esp_log_buffer_hex(const char *tag, const void *buffer,
+                        uint16_t buff_len);
+
+#define ESP_LOG_LEVEL_LOCAL(level, tag, format, ...)         \
+  do {                                                       \
+    if ((level) <= esp_log_level_get(tag)) {                 \
+      esp_log_write(level, tag, format, ##__VA_ARGS__);      \
+    }                                                        \
+  } while (0)
+
+#define ESP_LOGE(tag, format, ...) \
+  ESP_LOG_LEVEL_LOCAL(ESP_LOG_ERROR, tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) \
+  ESP_LOG_LEVEL_LOCAL(ESP_LOG_WARN, tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) \
+  ESP_LOG_LEVEL_LOCAL(ESP_LOG_INFO, tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) \
+  ESP_LOG_LEVEL_LOCAL(ESP_LOG_DEBUG, tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) \
+  ESP_LOG_LEVEL_LOCAL(ESP_LOG_VERBOSE, tag, format, ##__VA_ARGS__)
+
+#endif  // HOST_ESP_LOG_H_
@@ -0,0 +1,10 @@
+#ifndef HOST_ESP_PM_H_
+#define HOST_ESP_PM_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+/// ESP-IDF esp_pm.h のホスト環境用代替 (型のみ CONFIG_POWER_MANAGEMENTは無効)
+
+typedef struct esp_pm_lock *esp_pm_lock_handle_t;
+
+#endif  // HOST_ESP_PM_H_
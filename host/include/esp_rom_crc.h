@@ -0,0 +1,13 @@
+#ifndef HOST_ESP_ROM_CRC_H_
+#define HOST_ESP_ROM_CRC_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+/// ESP-IDF esp_rom_crc.h のホスト環境用代替 (CRC-32 IEEE 802.3)
+
+// Include ----------------------
+#include <cstdint>
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len);
+
+#endif  // HOST_ESP_ROM_CRC_H_
@@ -0,0 +1,14 @@
+#ifndef HOST_ESP_ROM_SYS_H_
+#define HOST_ESP_ROM_SYS_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+/// ESP-IDF esp_rom_sys.h のホスト環境用代替
+
+// Include ----------------------
+#include <cstdint>
+
+/// 1usあたりのサイクル数 (esp_cpu_get_cycle_countはns単位)
+static inline uint32_t esp_rom_get_cpu_ticks_per_us() { return 1000; }
+
+#endif  // HOST_ESP_ROM_SYS_H_
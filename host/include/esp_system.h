@@ -0,0 +1,31 @@
+#ifndef HOST_ESP_SYSTEM_H_
+#define HOST_ESP_SYSTEM_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+/// ESP-IDF esp_system.h のホスト環境用代替
+
+// Include ----------------------
+#include "esp_err.h"
+
+typedef enum {
+  ESP_RST_UNKNOWN,
+  ESP_RST_POWERON,
+  ESP_RST_EXT,
+  ESP_RST_SW,
+  ESP_RST_PANIC,
+  ESP_RST_INT_WDT,
+  ESP_RST_TASK_WDT,
+  ESP_RST_WDT,
+  ESP_RST_DEEPSLEEP,
+  ESP_RST_BROWNOUT,
+  ESP_RST_SDIO,
+} esp_reset_reason_t;
+
+/// 再起動 (ホスト環境では回数を記録して戻る)
+void esp_restart();
+
+/// 起動要因 (ホスト環境では常に電源投入)
+esp_reset_reason_t esp_reset_reason();
+
+#endif  // HOST_ESP_SYSTEM_H_
@@ -0,0 +1,47 @@
+#ifndef HOST_ESP_TIMER_H_
+#define HOST_ESP_TIMER_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+/// ESP-IDF esp_timer.h のホスト環境用代替
+/// BLE経路 (esp_timer_stand_in.cc): 時刻は仮想時間で、HostTimer::Advanceで
+/// 進めた時にタイマーを実行する (再現性のため実時間に依存しない)
+/// 針の制御 (hal/linux): esp_timer_get_timeのみ モノトニック時刻
+
+// Include ----------------------
+#include <cstdint>
+
+#include "esp_err.h"
+
+typedef struct esp_timer *esp_timer_handle_t;
+typedef void (*esp_timer_cb_t)(void *arg);
+
+typedef enum {
+  ESP_TIMER_TASK,
+  ESP_TIMER_ISR,
+} esp_timer_dispatch_t;
+
+typedef struct {
+  esp_timer_cb_t callback;
+  void *arg;
+  esp_timer_dispatch_t dispatch_method;
+  const char *name;
+  bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+int64_t esp_timer_get_time();
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args,
+                           esp_timer_handle_t *out_handle);
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us);
+esp_err_t esp_timer_stop(esp_timer_handle_t timer);
+esp_err_t esp_timer_delete(esp_timer_handle_t timer);
+bool esp_timer_is_active(esp_timer_handle_t timer);
+
+namespace HostTimer {
+
+/// 仮想時間を進め、期限に達したタイマーを実行する (0で期限到来済みのみ実行)
+void Advance(const int64_t elapsed_us);
+
+}  // namespace HostTimer
+
+#endif  // HOST_ESP_TIMER_H_
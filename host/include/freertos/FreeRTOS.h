@@ -0,0 +1,43 @@
+#ifndef HOST_FREERTOS_H_
+#define HOST_FREERTOS_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+/// FreeRTOS.h のホスト環境用代替
+/// クリティカルセクションは全体で1つの再帰ロックとし、hal/linuxのタイマー・
+/// GPIO割り込みの代替も同じロックの中で実行する (割り込み禁止による排他の再現)
+
+// Include ----------------------
+#include <cstddef>
+#include <cstdint>
+
+#include "esp_system.h"
+#include "sdkconfig.h"
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint8_t StackType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define PRO_CPU_NUM 0
+#define APP_CPU_NUM 1
+#define configMAX_PRIORITIES 25
+
+typedef struct {
+  uint32_t owner;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED \
+  { 0 }
+
+void HostEnterCritical();
+void HostExitCritical();
+
+#define portENTER_CRITICAL(mux) ((void)(mux), HostEnterCritical())
+#define portEXIT_CRITICAL(mux) ((void)(mux), HostExitCritical())
+#define portENTER_CRITICAL_ISR(mux) ((void)(mux), HostEnterCritical())
+#define portEXIT_CRITICAL_ISR(mux) ((void)(mux), HostExitCritical())
+
+#endif  // HOST_FREERTOS_H_
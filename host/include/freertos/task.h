@@ -0,0 +1,16 @@
+#ifndef HOST_FREERTOS_TASK_H_
+#define HOST_FREERTOS_TASK_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+/// FreeRTOS task.h のホスト環境用代替 (タスクはhal/linux/task.h)
+
+// Include ----------------------
+#include "freertos/FreeRTOS.h"
+
+typedef void *TaskHandle_t;
+
+/// 呼び出し元スレッドの識別子 (hal/linux/task.cc)
+TaskHandle_t xTaskGetCurrentTaskHandle();
+
+#endif  // HOST_FREERTOS_TASK_H_
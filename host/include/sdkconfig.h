@@ -0,0 +1,30 @@
+#ifndef HOST_SDKCONFIG_H_
+#define HOST_SDKCONFIG_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+/// ホスト環境用の設定値 (main/Kconfig.projbuildの既定値)
+/// ESP-IDFに依存する機能 (SNTP・ビーコン・テレメトリ・OTA・電源断検出・
+/// deep sleep・省電力制御) は無効
+#define CONFIG_BLE_MAX_CONNECTIONS 2
+#define CONFIG_STEPPER_MOTOR_STEP_DIVIDE 16
+#define CONFIG_LOCAL_TIME_ZONE "JST-9"
+
+#define CONFIG_MONITORING_OUTPUT_GPIO_NO 17
+#define CONFIG_HOUR_HAND_ENABLE_OUTPUT_GPIO_NO 25
+#define CONFIG_HOUR_HAND_STEP_OUTPUT_GPIO_NO 27
+#define CONFIG_HOUR_HAND_DIR_OUTPUT_GPIO_NO 26
+#define CONFIG_HOUR_HAND_RIGHT_LIMIT_INPUT_GPIO_NO 19
+#define CONFIG_HOUR_HAND_LEFT_LIMIT_INPUT_GPIO_NO 18
+#define CONFIG_MINUTE_HAND_ENABLE_OUTPUT_GPIO_NO 14
+#define CONFIG_MINUTE_HAND_STEP_OUTPUT_GPIO_NO 13
+#define CONFIG_MINUTE_HAND_DIR_OUTPUT_GPIO_NO 12
+#define CONFIG_MINUTE_HAND_RIGHT_LIMIT_INPUT_GPIO_NO 2
+#define CONFIG_MINUTE_HAND_LEFT_LIMIT_INPUT_GPIO_NO 15
+#define CONFIG_IS_STEPPER_MOTOR_ROTATE_RIGHT_IS_DIR_UP 1
+
+/// ヒープ確保の監査 (既定値はn) operator newを置き換えた
+/// day_allocation_testで確保回数を数える
+#define CONFIG_HEAP_ALLOCATION_AUDIT 1
+
+#endif  // HOST_SDKCONFIG_H_
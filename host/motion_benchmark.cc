@@ -0,0 +1,198 @@
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+//
+// 針の制御の所要時間とステップ周期の揺らぎ (ホスト環境)
+// HALのLinux実装 (hal/linux) でClockManagementTask・StepperMotorControllerを
+// 実時間で動かし、GPIO出力から針の機構 (ステップ数・リミットスイッチ) を模擬する
+// 原点復帰・時刻設定・振り付けの各段階を計測し、記録した針位置と模擬の位置が
+// 異なる場合・時間内に完了しない場合は終了コード1
+//
+//   cmake -S host -B build_host && cmake --build build_host
+//   ./build_host/motion_benchmark [振り付けの繰り返し回数] [-v]
+
+// Include ----------------------
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+#include "clock_management_task.h"
+#include "gpio_control.h"
+#include "hand_mechanism.h"
+#include "hare_tortoise_clock_interface.h"
+#include "util.h"
+
+using namespace HareTortoiseClockSystem;
+
+namespace {
+
+/// 設定する時刻 (2024/01/01 12:05:00 JST)
+constexpr std::time_t SET_UNIX_TIME = 1704078300;
+
+/// 振り付け 分針を1目盛(1/60)ずつ進める
+constexpr uint8_t CHOREOGRAPHY_MOVES = 12;
+constexpr uint16_t CHOREOGRAPHY_HZ = 3000;
+
+/// 各段階の待機上限
+constexpr auto PHASE_TIMEOUT = std::chrono::seconds(30);
+
+/// 段階の結果
+struct PhaseResult {
+  const char *name;
+  bool is_ok;
+  double elapsed_ms;
+  EdgeStats stats;
+};
+
+/// 段階の計測 (開始操作を行い、完了条件を満たすまでの時間とステップ周期)
+template <typename ACTION, typename CONDITION>
+PhaseResult RunPhase(const char *const name, HandMechanism &mechanism,
+                     ACTION action, CONDITION condition) {
+  portENTER_CRITICAL(&mechanism.mux);
+  mechanism.hour.ResetTotal();
+  mechanism.minute.ResetTotal();
+  portEXIT_CRITICAL(&mechanism.mux);
+
+  const auto start = std::chrono::steady_clock::now();
+  const bool is_ok = action() && WaitUntil(PHASE_TIMEOUT, condition);
+  const auto end = std::chrono::steady_clock::now();
+
+  PhaseResult result = {name, is_ok,
+                        std::chrono::duration<double, std::milli>(end - start)
+                            .count(),
+                        EMPTY_STATS};
+  portENTER_CRITICAL(&mechanism.mux);
+  for (const EdgeStats *const stats :
+       {&mechanism.hour.GetTotal(), &mechanism.minute.GetTotal()}) {
+    result.stats.moves += stats->moves;
+    result.stats.steps += stats->steps;
+    result.stats.intervals += stats->intervals;
+    result.stats.sum_ns += stats->sum_ns;
+    result.stats.late += stats->late;
+    result.stats.min_ns = std::min(result.stats.min_ns, stats->min_ns);
+    result.stats.max_ns = std::max(result.stats.max_ns, stats->max_ns);
+  }
+  portEXIT_CRITICAL(&mechanism.mux);
+  return result;
+}
+
+void PrintResult(const PhaseResult &result) {
+  const EdgeStats &stats = result.stats;
+  if (stats.intervals == 0) {
+    std::printf("%-14s %9.1f %6" PRIu32 " %7" PRIu32 " %9s %9s %9s %6s %s\n",
+                result.name, result.elapsed_ms, stats.moves, stats.steps, "-",
+                "-", "-", "-", result.is_ok ? "ok" : "NG");
+    return;
+  }
+  std::printf("%-14s %9.1f %6" PRIu32 " %7" PRIu32 " %9.1f %9.1f %9.1f %6" PRIu32
+              " %s\n",
+              result.name, result.elapsed_ms, stats.moves, stats.steps,
+              stats.min_ns / 1000.0, stats.max_ns / 1000.0,
+              (stats.max_ns - stats.min_ns) / 1000.0, stats.late,
+              result.is_ok ? "ok" : "NG");
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  uint32_t rounds = 2;
+  bool is_verbose = false;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "-v") == 0) {
+      is_verbose = true;
+    } else {
+      rounds = static_cast<uint32_t>(std::strtoul(argv[i], nullptr, 10));
+    }
+  }
+  rounds = std::clamp<uint32_t>(rounds, 1, Choreography::MAX_REPEAT);
+  esp_log_level_set("*", is_verbose ? ESP_LOG_INFO : ESP_LOG_WARN);
+
+  HandMechanism mechanism;
+  mechanism.Attach(is_verbose);
+
+  // hare_tortoise_clock.cc と同じ順序で開始 (BLE・時計の代替は不要)
+  Util::InitTimeZone();
+  GPIO::InitGpioIsrService();
+  std::shared_ptr<ClockManagementTask> task =
+      std::make_shared<ClockManagementTask>(HareTortoiseClockInterfaceWeakPtr());
+
+  std::printf("%-14s %9s %6s %7s %9s %9s %9s %6s\n", "phase", "time(ms)",
+              "moves", "steps", "min(us)", "max(us)", "jitter", "late");
+  bool is_ok = true;
+
+  // 原点復帰 (左リミットまで移動し、待機位置へ)
+  PhaseResult result = RunPhase(
+      "homing", mechanism,
+      [&] {
+        task->Start();
+        return true;
+      },
+      [&] {
+        const ClockState state = task->GetClockState();
+        return state.status == 3 && mechanism.IsSettled(state);
+      });
+  PrintResult(result);
+  is_ok = is_ok && result.is_ok;
+
+  // 時刻設定 (12:05の位置へ移動)
+  if (is_ok) {
+    result = RunPhase(
+        "set time", mechanism,
+        [&] {
+          task->SetUnixTime(SET_UNIX_TIME);
+          return true;
+        },
+        [&] {
+          const ClockState state = task->GetClockState();
+          return state.status == 4 && state.hour == 0 && state.minute == 5 &&
+                 mechanism.IsSettled(state);
+        });
+    PrintResult(result);
+    is_ok = is_ok && result.is_ok;
+  }
+
+  // 振り付け (分針を1目盛ずつ進める 終了後は時刻の位置へ戻る)
+  if (is_ok) {
+    Choreography choreography = {};
+    for (uint8_t i = 0; i < CHOREOGRAPHY_MOVES; ++i) {
+      Choreography::Step &step = choreography.steps[i];
+      step.hands = Choreography::HAND_MINUTE;
+      step.position = static_cast<uint16_t>(Choreography::POSITION_SCALE *
+                                            (i + 1) / 60);
+      step.minute_hz = CHOREOGRAPHY_HZ;
+    }
+    choreography.count = CHOREOGRAPHY_MOVES;
+    choreography.repeat = static_cast<uint8_t>(rounds);
+    // 振り付けの移動 + 時刻の位置への戻り
+    const uint32_t expected_moves = CHOREOGRAPHY_MOVES * rounds + 1;
+    result = RunPhase(
+        "choreography", mechanism,
+        [&] { return task->RunChoreography(choreography); },
+        [&] {
+          const ClockState state = task->GetClockState();
+          return expected_moves <= mechanism.GetMinuteMoves() &&
+                 state.status == 4 && mechanism.IsSettled(state);
+        });
+    PrintResult(result);
+    is_ok = is_ok && result.is_ok;
+  }
+
+  const ClockState state = task->GetClockState();
+  portENTER_CRITICAL(&mechanism.mux);
+  std::printf("status:%u position hour:%" PRId32 "/%" PRId32
+              " minute:%" PRId32 "/%" PRId32 " (recorded/mechanism)\n",
+              state.status, state.hour_pos, mechanism.hour.GetPosition(),
+              state.minute_pos, mechanism.minute.GetPosition());
+  portEXIT_CRITICAL(&mechanism.mux);
+
+  task->Stop();
+  task.reset();
+  mechanism.Detach();
+  return is_ok ? 0 : 1;
+}
@@ -0,0 +1,115 @@
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// ESP-IDF NVS のホスト環境用代替 (プロセス内のメモリに保持)
+
+// Include ----------------------
+#include <nvs.h>
+
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Namespace {
+  std::string name;
+  std::map<std::string, std::vector<uint8_t>> entries;
+};
+
+std::mutex nvs_mutex;
+/// ハンドルは名前空間の番号+1
+std::vector<Namespace> namespaces;
+
+Namespace *Find(const nvs_handle_t handle) {
+  if (handle == 0 || namespaces.size() < handle) {
+    return nullptr;
+  }
+  return &namespaces[handle - 1];
+}
+
+esp_err_t SetValue(const nvs_handle_t handle, const char *key,
+                   const void *value, const size_t length) {
+  std::lock_guard<std::mutex> lock(nvs_mutex);
+  Namespace *const name_space = Find(handle);
+  if (!name_space) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  const uint8_t *const bytes = static_cast<const uint8_t *>(value);
+  name_space->entries[key].assign(bytes, bytes + length);
+  return ESP_OK;
+}
+
+esp_err_t GetValue(const nvs_handle_t handle, const char *key, void *out_value,
+                   size_t *length) {
+  std::lock_guard<std::mutex> lock(nvs_mutex);
+  Namespace *const name_space = Find(handle);
+  if (!name_space) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  const auto entry = name_space->entries.find(key);
+  if (entry == name_space->entries.end()) {
+    return ESP_ERR_NVS_NOT_FOUND;
+  }
+  if (out_value) {
+    if (*length < entry->second.size()) {
+      return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    std::memcpy(out_value, entry->second.data(), entry->second.size());
+  }
+  *length = entry->second.size();
+  return ESP_OK;
+}
+
+}  // namespace
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode,
+                   nvs_handle_t *out_handle) {
+  std::lock_guard<std::mutex> lock(nvs_mutex);
+  for (size_t i = 0; i < namespaces.size(); ++i) {
+    if (namespaces[i].name == name) {
+      *out_handle = i + 1;
+      return ESP_OK;
+    }
+  }
+  if (open_mode == NVS_READONLY) {
+    return ESP_ERR_NVS_NOT_FOUND;
+  }
+  namespaces.push_back(Namespace{name, {}});
+  *out_handle = namespaces.size();
+  return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle) {}
+
+esp_err_t nvs_commit(nvs_handle_t handle) { return ESP_OK; }
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key) {
+  std::lock_guard<std::mutex> lock(nvs_mutex);
+  Namespace *const name_space = Find(handle);
+  if (!name_space) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  return name_space->entries.erase(key) ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_get_i32(nvs_handle_t handle, const char *key, int32_t *out_value) {
+  size_t length = sizeof(*out_value);
+  return GetValue(handle, key, out_value, &length);
+}
+
+esp_err_t nvs_set_i32(nvs_handle_t handle, const char *key, int32_t value) {
+  return SetValue(handle, key, &value, sizeof(value));
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value,
+                       size_t *length) {
+  return GetValue(handle, key, out_value, length);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value,
+                       size_t length) {
+  return SetValue(handle, key, value, length);
+}
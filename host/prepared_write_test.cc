@@ -0,0 +1,144 @@
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+//
+// Prepared Write (長い書き込み) の応答と適用 (ホスト環境)
+// GattStandIn経由でBleClockServiceへ書き込み、区間の途中で失敗した場合に
+// Execute Writeが失敗を応答して蓄積した値を適用しないこと、
+// 中止 (CANCEL) で破棄されること、正常な場合に連結した値が適用されることを
+// 確認する いずれかが異なれば終了コード1
+//
+//   cmake -S host -B build_host && cmake --build build_host
+//   ./build_host/prepared_write_test [-v]
+
+// Include ----------------------
+#include <esp_log.h>
+
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "ble_device.h"
+#include "ble_services.h"
+#include "gatt_stand_in.h"
+
+using namespace HareTortoiseClockSystem;
+
+namespace {
+
+constexpr uint16_t CONN_ID = 0;
+/// 1区間の長さ
+constexpr size_t CHUNK_LENGTH = 100;
+
+/// 書き込まれた値を記録する特性
+class RecordingCharacteristic final : public BleCharacteristicInterface {
+ public:
+  explicit RecordingCharacteristic(const esp_bt_uuid_t &uuid)
+      : uuid_(uuid), handle_(0), write_count_(0), value_() {}
+
+  void Write(ConstByteSpan data) override {
+    ++write_count_;
+    value_.assign(data.begin(), data.end());
+  }
+  size_t Read(MutableByteSpan data) override { return 0; }
+  void SetHandle(const uint16_t handle) override { handle_ = handle; }
+  uint16_t GetHandle() const override { return handle_; }
+  esp_bt_uuid_t GetUuid() const override { return uuid_; }
+  esp_gatt_char_prop_t GetProperty() const override {
+    return ESP_GATT_CHAR_PROP_BIT_WRITE;
+  }
+
+  uint32_t GetWriteCount() const { return write_count_; }
+  const std::vector<uint8_t> &GetValue() const { return value_; }
+
+ private:
+  esp_bt_uuid_t uuid_;
+  uint16_t handle_;
+  uint32_t write_count_;
+  std::vector<uint8_t> value_;
+};
+
+bool Check(const bool condition, const char *const name) {
+  std::printf("%-36s %s\n", name, condition ? "ok" : "NG");
+  return condition;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const bool is_verbose = 1 < argc && std::strcmp(argv[1], "-v") == 0;
+  esp_log_level_set("*", is_verbose ? ESP_LOG_INFO : ESP_LOG_WARN);
+
+  const std::shared_ptr<RecordingCharacteristic> characteristic =
+      std::make_shared<RecordingCharacteristic>(
+          COMMAND_CHARACTERISTIC_UUID.ToEspBtUuid());
+  BleServiceInterfaceSharedPtr service =
+      std::make_shared<BleClockService>(0, CLOCK_SERVICE_UUID.ToEspBtUuid());
+  service->AddCharacteristic(characteristic);
+
+  GattStandIn *const stand_in = GattStandIn::GetInstance();
+  BleDevice *const ble_device = BleDevice::GetInstance();
+  ble_device->Initialize();
+  ble_device->AddService(service);
+  ble_device->StartAdvertising();
+  stand_in->Pump();
+  const uint16_t handle =
+      stand_in->FindValueHandle(COMMAND_CHARACTERISTIC_UUID.ToEspBtUuid());
+  if (handle == 0) {
+    return Check(false, "attribute table registered") ? 0 : 1;
+  }
+  stand_in->Connect(CONN_ID);
+  stand_in->Pump();
+
+  std::array<uint8_t, CHUNK_LENGTH> chunk = {};
+  for (size_t i = 0; i < chunk.size(); ++i) {
+    chunk[i] = static_cast<uint8_t>(i);
+  }
+  bool is_ok = true;
+
+  // 上限を超える区間で失敗 → 以降の区間・Execute Writeも失敗し、適用しない
+  is_ok &= Check(
+      stand_in->PrepareWrite(CONN_ID, handle, 0, chunk) == ESP_GATT_OK &&
+          stand_in->PrepareWrite(CONN_ID, handle, ESP_GATT_MAX_ATTR_LEN,
+                                 chunk) == ESP_GATT_INVALID_ATTR_LEN &&
+          stand_in->PrepareWrite(CONN_ID, handle, CHUNK_LENGTH, chunk) ==
+              ESP_GATT_INVALID_ATTR_LEN,
+      "prepare fails after oversize chunk");
+  is_ok &= Check(stand_in->ExecuteWrite(CONN_ID, true) ==
+                         ESP_GATT_INVALID_ATTR_LEN &&
+                     characteristic->GetWriteCount() == 0,
+                 "exec rejects partial value");
+
+  // 別のハンドルの区間で失敗
+  is_ok &= Check(
+      stand_in->PrepareWrite(CONN_ID, handle, 0, chunk) == ESP_GATT_OK &&
+          stand_in->PrepareWrite(CONN_ID, handle + 1, CHUNK_LENGTH, chunk) ==
+              ESP_GATT_ERROR &&
+          stand_in->ExecuteWrite(CONN_ID, true) == ESP_GATT_ERROR &&
+          characteristic->GetWriteCount() == 0,
+      "exec rejects mixed handles");
+
+  // 中止は破棄のみ
+  is_ok &= Check(
+      stand_in->PrepareWrite(CONN_ID, handle, 0, chunk) == ESP_GATT_OK &&
+          stand_in->ExecuteWrite(CONN_ID, false) == ESP_GATT_OK &&
+          characteristic->GetWriteCount() == 0,
+      "cancel discards value");
+
+  // 失敗・中止の後も正常な書き込みは適用する
+  const bool is_applied =
+      stand_in->PrepareWrite(CONN_ID, handle, 0, chunk) == ESP_GATT_OK &&
+      stand_in->PrepareWrite(CONN_ID, handle, CHUNK_LENGTH, chunk) ==
+          ESP_GATT_OK &&
+      stand_in->ExecuteWrite(CONN_ID, true) == ESP_GATT_OK;
+  const std::vector<uint8_t> &value = characteristic->GetValue();
+  is_ok &= Check(is_applied && characteristic->GetWriteCount() == 1 &&
+                     value.size() == CHUNK_LENGTH * 2 &&
+                     std::memcmp(value.data(), chunk.data(), CHUNK_LENGTH) ==
+                         0 &&
+                     std::memcmp(value.data() + CHUNK_LENGTH, chunk.data(),
+                                 CHUNK_LENGTH) == 0,
+                 "exec applies joined value");
+  return is_ok ? 0 : 1;
+}
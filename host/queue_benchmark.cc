@@ -0,0 +1,137 @@
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+//
+// ISR → タスクの受け渡しの1件あたりの処理時間 (ホスト環境)
+// 送信スレッド (ISRの代替) から受信スレッド (タスク) へ連番を送り、
+// MessageQueue (1件毎・まとめて受信) と SpscRingBuffer (1件毎・まとめて受信) を
+// 比較する いずれもhal/linux の実装で、MessageQueueはFreeRTOSのキューと同じく
+// 送受信の毎にロックを取る (実機の所要時間とは異なるため、相対比較に用いる)
+// 受信した連番が欠落・重複した場合は終了コード1
+//
+//   cmake -S host -B build_host && cmake --build build_host
+//   ./build_host/queue_benchmark [件数]
+
+// Include ----------------------
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+#include "message_queue.h"
+#include "spsc_ring_buffer.h"
+
+namespace {
+
+/// キューの長さ (モーター制御のキュー以上 SPSCは2の累乗)
+constexpr int32_t QUEUE_SIZE = 16;
+/// まとめて受信する最大件数
+constexpr size_t BATCH_SIZE = QUEUE_SIZE;
+/// 受信待ちの上限(ms) (超えた場合は欠落として失敗)
+constexpr int32_t RECEIVE_WAIT_MS = 1000;
+
+/// 計測結果
+struct Result {
+  const char *name;
+  bool is_ok;
+  double elapsed_ns;
+};
+
+/// 送信スレッドを開始し、受信側で連番を確認する
+/// SEND: 1件送信 (満杯の場合false)  RECEIVE: 受信した件数を返す (0は待機超過)
+template <typename SEND, typename RECEIVE>
+Result Measure(const char *const name, const uint32_t count, SEND send,
+               RECEIVE receive) {
+  const auto start = std::chrono::steady_clock::now();
+  // 受信側が失敗した場合は送信を打ち切る (満杯のまま待ち続けないように)
+  std::atomic<bool> is_stopped(false);
+  std::thread producer([&] {
+    for (uint32_t i = 0; i < count; ++i) {
+      while (!send(i)) {
+        if (is_stopped.load()) {
+          return;
+        }
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  bool is_ok = true;
+  uint32_t expected = 0;
+  uint32_t values[BATCH_SIZE] = {};
+  while (is_ok && expected < count) {
+    const size_t received = receive(values);
+    is_ok = 0 < received;
+    for (size_t i = 0; i < received; ++i) {
+      is_ok = is_ok && values[i] == expected;
+      ++expected;
+    }
+  }
+  is_stopped.store(true);
+  producer.join();
+  const auto end = std::chrono::steady_clock::now();
+  return Result{name, is_ok,
+                std::chrono::duration<double, std::nano>(end - start).count()};
+}
+
+void PrintResult(const Result &result, const uint32_t count) {
+  std::printf("%-22s %9.1f %10.2f %s\n", result.name,
+              result.elapsed_ns / count, count / result.elapsed_ns * 1000.0,
+              result.is_ok ? "ok" : "NG");
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const uint32_t count =
+      1 < argc ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10))
+               : 1000000;
+  std::printf("%" PRIu32 " items each, queue size %" PRId32 "\n", count,
+              QUEUE_SIZE);
+  std::printf("%-22s %9s %10s\n", "path", "ns/item", "Mitems/s");
+
+  bool is_ok = true;
+  static StaticMessageQueue<uint32_t, QUEUE_SIZE> queue;
+  static SpscRingBuffer<uint32_t, QUEUE_SIZE> ring;
+  if (!queue.Create()) {
+    return 1;
+  }
+  ring.BindConsumer();
+
+  const Result results[] = {
+      Measure(
+          "queue", count, [](const uint32_t i) { return queue.Send(i); },
+          [](uint32_t *const values) {
+            return queue.ReceiveWait(values, RECEIVE_WAIT_MS) ? 1u : 0u;
+          }),
+      Measure(
+          "queue batch", count,
+          [](const uint32_t i) { return queue.SendBatch(&i, 1) == 1; },
+          [](uint32_t *const values) {
+            return queue.ReceiveBatch(values, BATCH_SIZE, RECEIVE_WAIT_MS);
+          }),
+      Measure(
+          "spsc", count,
+          [](const uint32_t i) { return ring.PushFromISRAndYield(i); },
+          [](uint32_t *const values) {
+            return ring.PopWait(values, RECEIVE_WAIT_MS) ? 1u : 0u;
+          }),
+      Measure(
+          "spsc batch", count,
+          [](const uint32_t i) { return ring.PushFromISRAndYield(i); },
+          [](uint32_t *const values) {
+            size_t received = ring.PopBatch(values, BATCH_SIZE);
+            // 空の場合は1件目のみ待機する
+            if (received == 0 && ring.PopWait(values, RECEIVE_WAIT_MS)) {
+              received = 1 + ring.PopBatch(values + 1, BATCH_SIZE - 1);
+            }
+            return received;
+          }),
+  };
+  for (const Result &result : results) {
+    PrintResult(result, count);
+    is_ok = is_ok && result.is_ok;
+  }
+  return is_ok ? 0 : 1;
+}
@@ -0,0 +1,228 @@
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+//
+// Characteristic Read/Write の1要求あたりの処理時間 (ホスト環境)
+// 受信値を vector へ複写していた従来の経路と、スタックのバッファを
+// Span で直接参照する経路を比較する
+// serviceはGattStandIn経由でBleDevice → BleClockService → Characteristic を
+// 実際に呼び出した場合 (イベントの振り分け・応答の記録を含む)
+// serviceの要求が失敗した場合は終了コード1
+//
+//   cmake -S host -B build_host && cmake --build build_host
+//   ./build_host/span_benchmark [繰り返し回数]
+
+// Include ----------------------
+#include <esp_log.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "ble_device.h"
+#include "ble_services.h"
+#include "byte_span.h"
+#include "fake_clock.h"
+#include "gatt_stand_in.h"
+
+using namespace HareTortoiseClockSystem;
+
+namespace {
+
+constexpr size_t MAX_ATTR_LEN = ESP_GATT_MAX_ATTR_LEN;
+constexpr size_t STATUS_LENGTH = BleStatusCharacteristic::VALUE_LENGTH;
+/// 接続するセントラル
+constexpr uint16_t CONN_ID = 0;
+
+/// 最適化で処理が消えないよう結果を集める
+volatile uint64_t sink = 0;
+
+/// スタックの書き込みイベント・応答に相当する領域
+struct StackBuffers {
+  std::array<uint8_t, sizeof(uint64_t)> write_value;
+  std::array<uint8_t, MAX_ATTR_LEN> response_value;
+};
+
+/// 従来: vector へ複写してから1byteずつ変換
+struct VectorPath {
+  std::vector<uint8_t> write_buffer;
+  std::vector<uint8_t> read_buffer;
+  std::array<uint8_t, STATUS_LENGTH> status;
+
+  VectorPath() : write_buffer(), read_buffer(), status() {
+    write_buffer.reserve(MAX_ATTR_LEN);
+    read_buffer.reserve(MAX_ATTR_LEN);
+  }
+
+  void Write(StackBuffers *const stack) {
+    write_buffer.assign(stack->write_value.begin(), stack->write_value.end());
+    uint64_t unixtime = 0;
+    for (const uint8_t byte : write_buffer) {
+      unixtime = (unixtime << 8) | byte;
+    }
+    sink = sink + unixtime;
+  }
+
+  void ReadTime(StackBuffers *const stack, const uint64_t unixtime) {
+    read_buffer.clear();
+    for (int32_t shift = 56; 0 <= shift; shift -= 8) {
+      read_buffer.push_back(static_cast<uint8_t>(unixtime >> shift));
+    }
+    std::memcpy(stack->response_value.data(), read_buffer.data(),
+                read_buffer.size());
+    sink = sink + read_buffer.size();
+  }
+
+  void ReadStatus(StackBuffers *const stack) {
+    read_buffer.clear();
+    read_buffer.insert(read_buffer.end(), status.begin(), status.end());
+    std::memcpy(stack->response_value.data(), read_buffer.data(),
+                read_buffer.size());
+    sink = sink + read_buffer.size();
+  }
+};
+
+/// 変更後: スタックのバッファを Span で直接参照
+struct SpanPath {
+  std::array<uint8_t, STATUS_LENGTH> status;
+
+  SpanPath() : status() {}
+
+  void Write(StackBuffers *const stack) {
+    const ConstByteSpan data(stack->write_value);
+    sink = sink + LoadBigEndian<uint64_t>(data.data());
+  }
+
+  void ReadTime(StackBuffers *const stack, const uint64_t unixtime) {
+    const MutableByteSpan data(stack->response_value);
+    sink = sink + StoreBigEndian(unixtime, data.data());
+  }
+
+  void ReadStatus(StackBuffers *const stack) {
+    const MutableByteSpan data(stack->response_value);
+    std::copy(status.begin(), status.end(), data.begin());
+    sink = sink + status.size();
+  }
+};
+
+/// GattStandIn経由のBleClockService (時刻・状態Characteristic)
+struct ServicePath {
+  std::array<uint8_t, STATUS_LENGTH> status;
+  uint32_t failures;
+  uint16_t time_handle;
+  uint16_t status_handle;
+  std::shared_ptr<FakeClock> clock;
+
+  ServicePath()
+      : status(),
+        failures(0),
+        time_handle(0),
+        status_handle(0),
+        clock(std::make_shared<FakeClock>()) {
+    HareTortoiseClockInterfaceSharedPtr clock_interface = clock;
+    BleServiceInterfaceSharedPtr service = std::make_shared<BleClockService>(
+        0, CLOCK_SERVICE_UUID.ToEspBtUuid());
+    service->AddCharacteristic(std::make_shared<BleTimeCharacteristic>(
+        TIME_CHARACTERISTIC_UUID.ToEspBtUuid(),
+        ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_WRITE,
+        clock_interface));
+    service->AddCharacteristic(std::make_shared<BleStatusCharacteristic>(
+        STATUS_CHARACTERISTIC_UUID.ToEspBtUuid(),
+        ESP_GATT_CHAR_PROP_BIT_READ));
+
+    GattStandIn *const stand_in = GattStandIn::GetInstance();
+    BleDevice *const ble_device = BleDevice::GetInstance();
+    ble_device->Initialize();
+    ble_device->AddService(service);
+    ble_device->StartAdvertising();
+    stand_in->Pump();
+    time_handle =
+        stand_in->FindValueHandle(TIME_CHARACTERISTIC_UUID.ToEspBtUuid());
+    status_handle =
+        stand_in->FindValueHandle(STATUS_CHARACTERISTIC_UUID.ToEspBtUuid());
+    stand_in->Connect(CONN_ID);
+    stand_in->Pump();
+  }
+
+  void Write(StackBuffers *const stack) {
+    GattStandIn *const stand_in = GattStandIn::GetInstance();
+    Count(stand_in->Write(CONN_ID, time_handle, stack->write_value));
+    sink = sink + static_cast<uint64_t>(clock->last_set_time);
+  }
+
+  void ReadTime(StackBuffers *const stack, const uint64_t unixtime) {
+    // 時刻は時計の代わりが返す (unixtimeは従来の経路の入力)
+    GattStandIn *const stand_in = GattStandIn::GetInstance();
+    Count(stand_in->Read(CONN_ID, time_handle));
+    sink = sink + stand_in->GetLastResponse().length;
+  }
+
+  void ReadStatus(StackBuffers *const stack) {
+    GattStandIn *const stand_in = GattStandIn::GetInstance();
+    Count(stand_in->Read(CONN_ID, status_handle));
+    sink = sink + stand_in->GetLastResponse().length;
+  }
+
+  void Count(const esp_gatt_status_t status) {
+    if (status != ESP_GATT_OK) {
+      ++failures;
+    }
+  }
+};
+
+template <typename FUNC>
+double MeasureNs(const uint32_t count, FUNC func) {
+  const auto begin = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < count; ++i) {
+    func(i);
+  }
+  const auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - begin).count() /
+         count;
+}
+
+template <typename PATH>
+void Run(const char *const name, const uint32_t count, PATH &path) {
+  StackBuffers stack = {};
+  const double write_ns = MeasureNs(count, [&](const uint32_t i) {
+    stack.write_value[7] = static_cast<uint8_t>(i);
+    path.Write(&stack);
+  });
+  const double read_time_ns = MeasureNs(count, [&](const uint32_t i) {
+    path.ReadTime(&stack, 1700000000ULL + i);
+  });
+  const double read_status_ns = MeasureNs(count, [&](const uint32_t i) {
+    path.status[0] = static_cast<uint8_t>(i);
+    path.ReadStatus(&stack);
+  });
+  std::printf("%-8s write:%7.2fns  read(time):%7.2fns  read(status):%7.2fns\n",
+              name, write_ns, read_time_ns, read_status_ns);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const uint32_t count =
+      (1 < argc) ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10))
+                 : 10000000u;
+  esp_log_level_set("*", ESP_LOG_WARN);
+  std::printf("%" PRIu32 " requests each\n", count);
+  VectorPath vector_path;
+  Run("vector", count, vector_path);
+  SpanPath span_path;
+  Run("span", count, span_path);
+  ServicePath service_path;
+  Run("service", count, service_path);
+  if (service_path.time_handle == 0 || service_path.status_handle == 0 ||
+      service_path.failures != 0) {
+    std::printf("service requests failed:%" PRIu32 "\n",
+                service_path.failures);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,361 @@
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+//
+// 時刻ビーコンの伝搬 (ホスト環境)
+// 直線上に並べた時計の間でアドバタイズを仮想時間で模擬し、time_beacon.cc の
+// 符号化・AD構造の検索・Selectorによる選択を ble_time_beacon.cc と同じ規則で
+// 動かす (隣の時計のみ受信 一部のアドバタイズは欠落)
+// 段数が距離と一致しない場合・時刻の誤差が推定誤差を超えた場合・
+// 子孫のビーコンを採用した場合 (同期の循環) は終了コード1
+//
+//   cmake -S host -B build_host && cmake --build build_host
+//   ./build_host/time_beacon_test [-v]
+
+// Include ----------------------
+#include <algorithm>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "time_beacon.h"
+
+using namespace HareTortoiseClockSystem;
+
+namespace {
+
+/// 時計の台数 (MAX_HOPSを超える時計を含める)
+constexpr size_t CLOCK_COUNT = TimeBeacon::MAX_HOPS + 2;
+/// 仮想時間の刻み(us)
+constexpr int64_t STEP_US = 10000;
+/// 直接同期した時計がアドバタイズを止める経過時間(us) (以降は子孫同士のみ)
+constexpr int64_t ROOT_STOP_US = 2ll * 3600 * 1000000;
+/// 模擬する時間(us) (停止後に再スキャンを2回以上含む)
+constexpr int64_t SIMULATED_US = 5ll * 3600 * 1000000;
+/// 開始時刻 (2024/01/01 12:05:00 JST)
+constexpr int64_t START_EPOCH_US = 1704078300ll * 1000000;
+
+/// ble_time_beacon.cc・ble_device.cc と同じ間隔
+constexpr int64_t SCAN_INTERVAL_US = 30ll * 1000000;
+constexpr int64_t RESCAN_INTERVAL_US = 3600ll * 1000000;
+constexpr int64_t SCAN_DURATION_US = 3ll * 1000000;
+constexpr int64_t ADV_INTERVAL_US = 1280000;
+/// アドバタイズの揺らぎ上限(us) (BLE仕様 advDelay 0-10ms)
+constexpr int64_t ADV_DELAY_MAX_US = 10000;
+/// アドバタイズの欠落率(%)
+constexpr uint32_t LOSS_PERCENT = 30;
+/// 時計のずれの上限(ppm) (推定誤差の前提と同じ)
+constexpr int32_t MAX_DRIFT_PPM = 20;
+
+/// ble_device.cc と同じAD Type
+constexpr uint8_t AD_TYPE_FLAGS = 0x01;
+constexpr uint8_t AD_TYPE_COMPLETE_NAME = 0x09;
+constexpr uint8_t AD_TYPE_MANUFACTURER_SPECIFIC = 0xFF;
+
+/// 模擬する時計 (HareTortoiseClockの同期状態とBleTimeBeaconの動作)
+struct SimClock {
+  /// ローカル時刻の誤差 (ローカル - 真の時刻 ns)
+  int64_t error_ns;
+  int32_t drift_ppm;
+  bool is_synced;
+  uint8_t hops;
+  uint16_t uncertainty_ms;
+  int64_t last_sync_us;
+  uint32_t adoptions;
+  /// 同期済みで段数が自身以上のビーコンを採用した回数 (子孫からの採用)
+  uint32_t loop_adoptions;
+
+  TimeBeacon::Selector selector;
+  /// 更新・アドバタイズは開始からの経過時間 スキャンは真の時刻(us)
+  int64_t next_update_us;
+  int64_t next_scan_us;
+  int64_t scan_end_us;
+  int64_t next_adv_us;
+  /// アドバタイズデータ (長さ0は送信なし)
+  uint8_t adv_data[31];
+  size_t adv_length;
+
+  int64_t LocalUs(const int64_t true_us) const {
+    return true_us + error_ns / 1000;
+  }
+  bool IsScanning() const { return scan_end_us != 0; }
+};
+
+int64_t Abs(const int64_t value) { return value < 0 ? -value : value; }
+
+/// ble_time_beacon.cc Advertise
+void Advertise(SimClock &clock, const int64_t true_us) {
+  if (!clock.is_synced || TimeBeacon::MAX_HOPS <= clock.hops + 1) {
+    clock.adv_length = 0;
+    return;
+  }
+  const int64_t now_us = clock.LocalUs(true_us);
+  TimeBeacon::Beacon beacon = {};
+  beacon.epoch_ms = now_us / 1000;
+  beacon.hops = clock.hops;
+  beacon.uncertainty_ms = TimeBeacon::EstimateUncertaintyMs(
+      clock.uncertainty_ms, now_us - clock.last_sync_us);
+
+  // ble_device.cc SetAdvertisingManufacturerData と同じ構成
+  uint8_t *const adv = clock.adv_data;
+  adv[0] = 2;
+  adv[1] = AD_TYPE_FLAGS;
+  adv[2] = 0x06;
+  const size_t length =
+      TimeBeacon::Encode(beacon, &adv[5], sizeof(clock.adv_data) - 5);
+  adv[3] = static_cast<uint8_t>(1 + length);
+  adv[4] = AD_TYPE_MANUFACTURER_SPECIFIC;
+  clock.adv_length = 5 + length;
+}
+
+/// ble_time_beacon.cc Scan (スキャン完了後の採用判定)
+void FinishScan(SimClock &clock, const int64_t true_us) {
+  clock.scan_end_us = 0;
+  clock.next_scan_us =
+      true_us + (clock.is_synced ? RESCAN_INTERVAL_US : SCAN_INTERVAL_US);
+
+  int64_t offset_us = 0;
+  TimeBeacon::Beacon best = {};
+  if (!clock.selector.GetBest(&offset_us, &best)) {
+    return;
+  }
+  const int64_t now_us = clock.LocalUs(true_us);
+  const uint16_t own_uncertainty_ms = TimeBeacon::EstimateUncertaintyMs(
+      clock.uncertainty_ms, now_us - clock.last_sync_us);
+  if (clock.is_synced && own_uncertainty_ms <= best.uncertainty_ms) {
+    return;
+  }
+  if (clock.is_synced && clock.hops <= best.hops) {
+    ++clock.loop_adoptions;
+  }
+  // HareTortoiseClock::AdoptTime
+  clock.error_ns += offset_us * 1000;
+  clock.is_synced = true;
+  clock.hops = best.hops + 1;
+  clock.uncertainty_ms = TimeBeacon::CalcAdoptedUncertaintyMs(best);
+  clock.last_sync_us = clock.LocalUs(true_us);
+  ++clock.adoptions;
+}
+
+/// ble_time_beacon.cc Update (更新間隔毎)
+void UpdateClock(SimClock &clock, const size_t index, const int64_t true_us) {
+  if (clock.IsScanning()) {
+    if (clock.scan_end_us <= true_us) {
+      FinishScan(clock, true_us);
+    } else {
+      return;
+    }
+  }
+  const bool is_root = index == 0;
+  if (!is_root && clock.next_scan_us <= true_us) {
+    // スキャン中は送信しない
+    clock.selector.Reset();
+    clock.adv_length = 0;
+    clock.scan_end_us = true_us + SCAN_DURATION_US;
+    return;
+  }
+  if (is_root && START_EPOCH_US + ROOT_STOP_US <= true_us) {
+    clock.adv_length = 0;
+    return;
+  }
+  Advertise(clock, true_us);
+}
+
+/// 受信 (ble_time_beacon.cc OnScanResult)
+void Receive(SimClock &clock, const uint8_t *const adv_data,
+             const size_t length, const int64_t true_us) {
+  const int64_t receive_local_us = clock.LocalUs(true_us);
+  size_t data_length = 0;
+  const uint8_t *const data =
+      TimeBeacon::FindManufacturerData(adv_data, length, &data_length);
+  TimeBeacon::Beacon beacon = {};
+  if (data == nullptr || !TimeBeacon::Decode(data, data_length, &beacon)) {
+    return;
+  }
+  clock.selector.Offer(beacon, receive_local_us);
+}
+
+bool Check(const bool condition, const char *const name) {
+  std::printf("%-34s %s\n", name, condition ? "ok" : "NG");
+  return condition;
+}
+
+/// 符号化・AD構造の検索・選択の単体確認
+bool CheckCodec() {
+  bool is_ok = true;
+
+  // 往復 (48bit時刻の上位バイトを含む)
+  const TimeBeacon::Beacon beacon = {0x0000F123456789ABll, 7, 0xBEEF};
+  uint8_t data[TimeBeacon::MANUFACTURER_DATA_LENGTH] = {};
+  TimeBeacon::Beacon decoded = {};
+  is_ok &= Check(TimeBeacon::Encode(beacon, data, sizeof(data)) ==
+                         TimeBeacon::MANUFACTURER_DATA_LENGTH &&
+                     TimeBeacon::Decode(data, sizeof(data), &decoded) &&
+                     decoded.epoch_ms == beacon.epoch_ms &&
+                     decoded.hops == beacon.hops &&
+                     decoded.uncertainty_ms == beacon.uncertainty_ms,
+                 "encode/decode round trip");
+  is_ok &= Check(TimeBeacon::Encode(beacon, data, sizeof(data) - 1) == 0 &&
+                     !TimeBeacon::Decode(data, sizeof(data) - 1, &decoded),
+                 "short buffer rejected");
+  uint8_t other[TimeBeacon::MANUFACTURER_DATA_LENGTH] = {};
+  std::memcpy(other, data, sizeof(other));
+  other[0] ^= 0x01;
+  bool is_rejected = !TimeBeacon::Decode(other, sizeof(other), &decoded);
+  std::memcpy(other, data, sizeof(other));
+  other[2] ^= 0x01;
+  is_rejected =
+      is_rejected && !TimeBeacon::Decode(other, sizeof(other), &decoded);
+  is_ok &= Check(is_rejected, "other company/beacon id rejected");
+
+  // 名前の後ろのManufacturer Specific Data
+  uint8_t adv[31] = {2, AD_TYPE_FLAGS, 0x06, 4, AD_TYPE_COMPLETE_NAME, 'H',
+                     'T', 'C', 1 + sizeof(data), AD_TYPE_MANUFACTURER_SPECIFIC};
+  std::memcpy(&adv[10], data, sizeof(data));
+  const size_t adv_length = 10 + sizeof(data);
+  size_t data_length = 0;
+  const uint8_t *found =
+      TimeBeacon::FindManufacturerData(adv, adv_length, &data_length);
+  is_ok &= Check(found == &adv[10] && data_length == sizeof(data),
+                 "manufacturer data found");
+  // 長さが範囲外のAD構造・長さ0で打ち切り
+  is_ok &= Check(TimeBeacon::FindManufacturerData(adv, adv_length - 1,
+                                                  &data_length) == nullptr,
+                 "truncated structure ignored");
+  adv[3] = 0;
+  found = TimeBeacon::FindManufacturerData(adv, adv_length, &data_length);
+  is_ok &= Check(found == nullptr, "zero length terminates");
+
+  // 選択 (誤差の小さいものを採用 上限の段数は採用しない)
+  TimeBeacon::Selector selector;
+  int64_t offset_us = 0;
+  TimeBeacon::Beacon best = {};
+  const int64_t receive_us = START_EPOCH_US;
+  const TimeBeacon::Beacon near = {START_EPOCH_US / 1000, 1, 200};
+  const TimeBeacon::Beacon far = {START_EPOCH_US / 1000 + 5000, 3, 500};
+  const TimeBeacon::Beacon limit = {START_EPOCH_US / 1000, TimeBeacon::MAX_HOPS,
+                                    10};
+  is_ok &= Check(!selector.GetBest(&offset_us, &best), "selector empty");
+  is_ok &= Check(selector.Offer(far, receive_us) &&
+                     selector.Offer(near, receive_us) &&
+                     !selector.Offer(far, receive_us) &&
+                     !selector.Offer(limit, receive_us) &&
+                     selector.GetBest(&offset_us, &best) && best.hops == 1 &&
+                     offset_us == TimeBeacon::UPDATE_INTERVAL_US / 2,
+                 "selector keeps lowest uncertainty");
+  selector.Reset();
+  is_ok &= Check(!selector.GetBest(&offset_us, &best), "selector reset");
+  return is_ok;
+}
+
+/// 直線上の時計の伝搬
+bool CheckPropagation(const bool is_verbose) {
+  std::mt19937 random(12345);
+  std::uniform_int_distribution<int64_t> initial_error_us(
+      -1800ll * 1000000, 1800ll * 1000000);
+  std::uniform_int_distribution<int32_t> drift_ppm(-MAX_DRIFT_PPM,
+                                                   MAX_DRIFT_PPM);
+  std::uniform_int_distribution<int64_t> adv_delay_us(0, ADV_DELAY_MAX_US);
+  std::uniform_int_distribution<int64_t> phase_us(0, ADV_INTERVAL_US);
+  std::uniform_int_distribution<uint32_t> percent(0, 99);
+
+  std::vector<SimClock> clocks(CLOCK_COUNT);
+  for (size_t i = 0; i < clocks.size(); ++i) {
+    SimClock &clock = clocks[i];
+    clock.error_ns = initial_error_us(random) * 1000;
+    clock.drift_ppm = drift_ppm(random);
+    clock.next_update_us = phase_us(random) % TimeBeacon::UPDATE_INTERVAL_US;
+    clock.next_scan_us = START_EPOCH_US + SCAN_INTERVAL_US + phase_us(random);
+    clock.next_adv_us = phase_us(random);
+  }
+  // 直接同期した時計 (SNTP・スマートフォン)
+  SimClock &root = clocks[0];
+  root.error_ns = 0;
+  root.drift_ppm = 0;
+  root.is_synced = true;
+  root.hops = 0;
+  root.uncertainty_ms = TimeBeacon::CalcBaseUncertaintyMs(0);
+  root.last_sync_us = START_EPOCH_US;
+
+  int64_t max_excess_us = INT64_MIN;
+  for (int64_t elapsed_us = 0; elapsed_us < SIMULATED_US;
+       elapsed_us += STEP_US) {
+    const int64_t true_us = START_EPOCH_US + elapsed_us;
+    for (size_t i = 0; i < clocks.size(); ++i) {
+      SimClock &clock = clocks[i];
+      clock.error_ns += STEP_US * clock.drift_ppm / 1000;
+      if (clock.next_update_us <= elapsed_us) {
+        UpdateClock(clock, i, true_us);
+        clock.next_update_us += TimeBeacon::UPDATE_INTERVAL_US;
+      }
+    }
+    // アドバタイズ (隣の時計のうちスキャン中のものが受信)
+    for (size_t i = 0; i < clocks.size(); ++i) {
+      SimClock &sender = clocks[i];
+      if (elapsed_us < sender.next_adv_us) {
+        continue;
+      }
+      sender.next_adv_us += ADV_INTERVAL_US + adv_delay_us(random);
+      if (sender.adv_length == 0) {
+        continue;
+      }
+      for (const size_t j : {i - 1, i + 1}) {
+        if (clocks.size() <= j || !clocks[j].IsScanning() ||
+            percent(random) < LOSS_PERCENT) {
+          continue;
+        }
+        Receive(clocks[j], sender.adv_data, sender.adv_length, true_us);
+      }
+    }
+    // 推定誤差の範囲内か (1ms未満の切り捨てを許容)
+    for (const SimClock &clock : clocks) {
+      if (!clock.is_synced) {
+        continue;
+      }
+      const int64_t now_us = clock.LocalUs(true_us);
+      const int64_t limit_us =
+          TimeBeacon::EstimateUncertaintyMs(clock.uncertainty_ms,
+                                            now_us - clock.last_sync_us) *
+              1000ll +
+          1000;
+      max_excess_us = std::max(max_excess_us,
+                               Abs(clock.error_ns / 1000) - limit_us);
+    }
+  }
+
+  bool is_hops_ok = true;
+  uint32_t loop_adoptions = 0;
+  for (size_t i = 0; i < clocks.size(); ++i) {
+    const SimClock &clock = clocks[i];
+    loop_adoptions += clock.loop_adoptions;
+    // 段数は距離と一致 上限の段数の時計は送信しないため、その先は未同期
+    const bool is_reachable = i < TimeBeacon::MAX_HOPS;
+    is_hops_ok = is_hops_ok && clock.is_synced == is_reachable &&
+                 (!is_reachable || clock.hops == i);
+    if (is_verbose) {
+      std::printf("  clock%-2zu synced:%d hops:%u uncertainty:%5ums "
+                  "error:%8.1fms adoptions:%" PRIu32 "\n",
+                  i, clock.is_synced, clock.hops, clock.uncertainty_ms,
+                  clock.error_ns / 1e6, clock.adoptions);
+    }
+  }
+
+  bool is_ok = true;
+  is_ok &= Check(is_hops_ok, "hops match distance");
+  std::printf("  max excess over uncertainty %.1fms\n", max_excess_us / 1e3);
+  is_ok &= Check(max_excess_us <= 0, "error within uncertainty");
+  is_ok &= Check(loop_adoptions == 0, "no adoption from descendants");
+  return is_ok;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const bool is_verbose = 1 < argc && std::strcmp(argv[1], "-v") == 0;
+  bool is_ok = CheckCodec();
+  is_ok = CheckPropagation(is_verbose) && is_ok;
+  return is_ok ? 0 : 1;
+}
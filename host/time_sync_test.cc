@@ -0,0 +1,112 @@
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+//
+// 時刻同期 (NTP方式) の接続毎の記録 (ホスト環境)
+// GattStandIn経由で2台の接続から同期要求を交互に書き込み、
+// 各接続のReadが自身の送信時刻t1を返すこと、切断した接続の記録が
+// 破棄されることを確認する いずれかが異なれば終了コード1
+//
+//   cmake -S host -B build_host && cmake --build build_host
+//   ./build_host/time_sync_test [-v]
+
+// Include ----------------------
+#include <esp_log.h>
+
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+#include "ble_device.h"
+#include "ble_services.h"
+#include "byte_span.h"
+#include "gatt_stand_in.h"
+
+using namespace HareTortoiseClockSystem;
+
+namespace {
+
+constexpr uint16_t FIRST_CONN_ID = 0;
+constexpr uint16_t SECOND_CONN_ID = 1;
+constexpr int64_t FIRST_SEND_US = 1000000;
+constexpr int64_t SECOND_SEND_US = 2000000;
+/// 応答 (24byte) が1パケットに収まるMTU
+constexpr uint16_t MTU = 64;
+
+bool Check(const bool condition, const char *const name) {
+  std::printf("%-36s %s\n", name, condition ? "ok" : "NG");
+  return condition;
+}
+
+/// 同期要求 [0x01][t1]
+bool WriteRequest(GattStandIn *const stand_in, const uint16_t conn_id,
+                  const uint16_t handle, const int64_t client_send_us) {
+  std::array<uint8_t, sizeof(uint8_t) + sizeof(int64_t)> value = {
+      BleTimeSyncCharacteristic::OPERATION_REQUEST};
+  StoreBigEndian(client_send_us, &value[1]);
+  return stand_in->Write(conn_id, handle, value) == ESP_GATT_OK;
+}
+
+/// 応答 [t1][t2][t3] のt1 (読み出せない場合-1)
+int64_t ReadClientSendUs(GattStandIn *const stand_in, const uint16_t conn_id,
+                         const uint16_t handle) {
+  if (stand_in->Read(conn_id, handle) != ESP_GATT_OK) {
+    return -1;
+  }
+  const GattStandIn::Response &response = stand_in->GetLastResponse();
+  if (response.length != sizeof(int64_t) * 3) {
+    return -1;
+  }
+  return LoadBigEndian<int64_t>(response.value.data());
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const bool is_verbose = 1 < argc && std::strcmp(argv[1], "-v") == 0;
+  esp_log_level_set("*", is_verbose ? ESP_LOG_INFO : ESP_LOG_WARN);
+
+  BleServiceInterfaceSharedPtr service =
+      std::make_shared<BleClockService>(0, CLOCK_SERVICE_UUID.ToEspBtUuid());
+  service->AddCharacteristic(std::make_shared<BleTimeSyncCharacteristic>(
+      TIME_SYNC_CHARACTERISTIC_UUID.ToEspBtUuid(),
+      ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_WRITE,
+      HareTortoiseClockInterfaceWeakPtr()));
+
+  GattStandIn *const stand_in = GattStandIn::GetInstance();
+  BleDevice *const ble_device = BleDevice::GetInstance();
+  ble_device->Initialize();
+  ble_device->AddService(service);
+  ble_device->StartAdvertising();
+  stand_in->Pump();
+  const uint16_t handle =
+      stand_in->FindValueHandle(TIME_SYNC_CHARACTERISTIC_UUID.ToEspBtUuid());
+  if (handle == 0) {
+    return Check(false, "attribute table registered") ? 0 : 1;
+  }
+  for (const uint16_t conn_id : {FIRST_CONN_ID, SECOND_CONN_ID}) {
+    stand_in->Connect(conn_id);
+    stand_in->ExchangeMtu(conn_id, MTU);
+  }
+  stand_in->Pump();
+
+  bool is_ok = true;
+  // 1台目の要求と応答の間に2台目が要求する
+  is_ok &= Check(
+      WriteRequest(stand_in, FIRST_CONN_ID, handle, FIRST_SEND_US) &&
+          WriteRequest(stand_in, SECOND_CONN_ID, handle, SECOND_SEND_US) &&
+          ReadClientSendUs(stand_in, FIRST_CONN_ID, handle) == FIRST_SEND_US &&
+          ReadClientSendUs(stand_in, SECOND_CONN_ID, handle) == SECOND_SEND_US,
+      "each connection reads its own t1");
+
+  // 切断した接続の記録は再接続時に残らない
+  stand_in->Disconnect(FIRST_CONN_ID);
+  stand_in->Connect(FIRST_CONN_ID);
+  stand_in->ExchangeMtu(FIRST_CONN_ID, MTU);
+  stand_in->Pump();
+  is_ok &= Check(
+      ReadClientSendUs(stand_in, FIRST_CONN_ID, handle) == 0 &&
+          ReadClientSendUs(stand_in, SECOND_CONN_ID, handle) == SECOND_SEND_US,
+      "request cleared on disconnect");
+  return is_ok ? 0 : 1;
+}
@@ -0,0 +1,143 @@
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include "ble_connection_policy.h"
+
+namespace HareTortoiseClockSystem {
+
+namespace {
+
+/// 段階毎の接続パラメータ
+/// 監視タイムアウトは 接続間隔 x (1 + Latency) の3倍以上とする
+constexpr BleConnectionParams PHASE_PARAMS[] = {
+    // BULK 7.5-15ms
+    {.min_interval = 6, .max_interval = 12, .latency = 0, .timeout = 400},
+    // INTERACTIVE 30-50ms
+    {.min_interval = 24, .max_interval = 40, .latency = 0, .timeout = 400},
+    // IDLE 400-500ms Latency 2 (最大1.5s)
+    {.min_interval = 320, .max_interval = 400, .latency = 2, .timeout = 600},
+};
+
+}  // namespace
+
+BleConnectionPolicy::BleConnectionPolicy()
+    : last_activity_us_(0),
+      requested_phase_(PHASE_NONE),
+      is_pending_(false),
+      stats_() {
+  stats_.phase = PHASE_NONE;
+}
+
+const BleConnectionParams &BleConnectionPolicy::GetParams(const Phase phase) {
+  return PHASE_PARAMS[(phase < PHASE_NONE) ? phase : PHASE_INTERACTIVE];
+}
+
+const char *BleConnectionPolicy::GetPhaseName(const Phase phase) {
+  switch (phase) {
+    case PHASE_BULK:
+      return "bulk";
+    case PHASE_INTERACTIVE:
+      return "interactive";
+    case PHASE_IDLE:
+      return "idle";
+    default:
+      return "none";
+  }
+}
+
+void BleConnectionPolicy::Reset(const int64_t now_us, const uint16_t interval,
+                                const uint16_t latency,
+                                const uint16_t timeout) {
+  const uint32_t update_count = stats_.update_count;
+  const uint32_t reject_count = stats_.reject_count;
+  stats_ = Stats();
+  stats_.phase = PHASE_NONE;
+  stats_.update_count = update_count;
+  stats_.reject_count = reject_count;
+  last_activity_us_ = now_us;
+  requested_phase_ = PHASE_NONE;
+  is_pending_ = false;
+  SetCurrent(interval, latency, timeout);
+}
+
+void BleConnectionPolicy::OnActivity(const int64_t now_us) {
+  last_activity_us_ = now_us;
+}
+
+bool BleConnectionPolicy::Poll(const int64_t now_us,
+                               BleConnectionParams *const request) {
+  if (is_pending_) {
+    return false;
+  }
+  const Phase phase = CalcPhase(now_us);
+  if (phase == requested_phase_) {
+    return false;
+  }
+  requested_phase_ = phase;
+  is_pending_ = true;
+  *request = GetParams(phase);
+  return true;
+}
+
+void BleConnectionPolicy::OnUpdated(const bool is_success,
+                                    const uint16_t interval,
+                                    const uint16_t latency,
+                                    const uint16_t timeout) {
+  // 要求していない更新 (セントラルからの変更) は値のみ反映する
+  if (is_pending_) {
+    is_pending_ = false;
+    if (is_success) {
+      ++stats_.update_count;
+      stats_.phase = requested_phase_;
+    } else {
+      // 拒否された段階は次の段階に移るまで再要求しない
+      ++stats_.reject_count;
+    }
+  }
+  SetCurrent(interval, latency, timeout);
+}
+
+int64_t BleConnectionPolicy::GetNextCheckDelayUs(const int64_t now_us) const {
+  const int64_t elapsed_us = now_us - last_activity_us_;
+  if (elapsed_us < INTERACTIVE_AFTER_US) {
+    return INTERACTIVE_AFTER_US - elapsed_us;
+  }
+  if (elapsed_us < IDLE_AFTER_US) {
+    return IDLE_AFTER_US - elapsed_us;
+  }
+  return -1;
+}
+
+BleConnectionPolicy::Stats BleConnectionPolicy::GetStats() const {
+  return stats_;
+}
+
+BleConnectionPolicy::Phase BleConnectionPolicy::CalcPhase(
+    const int64_t now_us) const {
+  const int64_t elapsed_us = now_us - last_activity_us_;
+  if (elapsed_us < INTERACTIVE_AFTER_US) {
+    return PHASE_BULK;
+  }
+  if (elapsed_us < IDLE_AFTER_US) {
+    return PHASE_INTERACTIVE;
+  }
+  return PHASE_IDLE;
+}
+
+void BleConnectionPolicy::SetCurrent(const uint16_t interval,
+                                     const uint16_t latency,
+                                     const uint16_t timeout) {
+  stats_.interval = interval;
+  stats_.latency = latency;
+  stats_.timeout = timeout;
+  // 接続イベントの実効間隔(us) = 接続間隔 x (1 + Latency)
+  const uint32_t effective_interval_us =
+      static_cast<uint32_t>(interval) * 1250 * (1 + latency);
+  stats_.max_latency_ms = effective_interval_us / 1000;
+  stats_.events_per_minute =
+      (0 < effective_interval_us) ? 60u * 1000 * 1000 / effective_interval_us
+                                  : 0;
+}
+
+}  // namespace HareTortoiseClockSystem
@@ -0,0 +1,92 @@
+#ifndef BLE_CONNECTION_POLICY_H_
+#define BLE_CONNECTION_POLICY_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include <cstdint>
+
+namespace HareTortoiseClockSystem {
+
+/// 接続パラメータ (BLE仕様の単位)
+struct BleConnectionParams {
+  /// 接続間隔 (x1.25ms)
+  uint16_t min_interval;
+  uint16_t max_interval;
+  /// 省略できる接続イベント数 (Slave Latency)
+  uint16_t latency;
+  /// 監視タイムアウト (x10ms)
+  uint16_t timeout;
+};
+
+/// 接続中の段階に応じた接続パラメータの選択
+/// 転送中は短い接続間隔、操作が無くなると段階的に長い間隔とSlave Latencyへ移行する
+/// 時刻は呼び出し側が渡す 要求の送信・再評価のタイマーはBleClockServiceが行う
+class BleConnectionPolicy final {
+ public:
+  enum Phase : uint8_t {
+    /// 同期・ログ取得・書き込み等の転送中
+    PHASE_BULK,
+    /// 転送直後 (続けて操作される可能性が高い)
+    PHASE_INTERACTIVE,
+    /// 放置 (ダッシュボード表示のみ等)
+    PHASE_IDLE,
+    PHASE_NONE,
+  };
+
+  /// 実際に適用された接続パラメータと目安
+  struct Stats {
+    Phase phase;
+    /// 接続間隔 (x1.25ms)
+    uint16_t interval;
+    uint16_t latency;
+    /// 監視タイムアウト (x10ms)
+    uint16_t timeout;
+    /// 周辺機器から送信するまでの最大遅延(ms)
+    uint32_t max_latency_ms;
+    /// 1分あたりの接続イベント数 (無線の消費電力の目安)
+    uint32_t events_per_minute;
+    uint32_t update_count;
+    uint32_t reject_count;
+  };
+
+  /// 最後の転送からINTERACTIVE・IDLEへ移行するまでの時間(us)
+  static constexpr int64_t INTERACTIVE_AFTER_US = 2 * 1000 * 1000;
+  static constexpr int64_t IDLE_AFTER_US = 30 * 1000 * 1000;
+
+  BleConnectionPolicy();
+
+  static const BleConnectionParams &GetParams(const Phase phase);
+  static const char *GetPhaseName(const Phase phase);
+
+  /// 接続時 (接続直後は同期等の転送が続くためBULKから開始)
+  void Reset(const int64_t now_us, const uint16_t interval,
+             const uint16_t latency, const uint16_t timeout);
+  /// 転送・操作があった
+  void OnActivity(const int64_t now_us);
+
+  /// 変更を要求する場合true (結果の通知までは次の要求を行わない)
+  bool Poll(const int64_t now_us, BleConnectionParams *const request);
+  /// 要求の結果 (拒否された場合も現在の値が通知される)
+  void OnUpdated(const bool is_success, const uint16_t interval,
+                 const uint16_t latency, const uint16_t timeout);
+
+  /// 次に段階が変わるまでの時間(us) 変わらない場合-1
+  int64_t GetNextCheckDelayUs(const int64_t now_us) const;
+  Stats GetStats() const;
+
+ private:
+  Phase CalcPhase(const int64_t now_us) const;
+  void SetCurrent(const uint16_t interval, const uint16_t latency,
+                  const uint16_t timeout);
+
+ private:
+  int64_t last_activity_us_;
+  Phase requested_phase_;
+  bool is_pending_;
+  Stats stats_;
+};
+
+}  // namespace HareTortoiseClockSystem
+
+#endif  // BLE_CONNECTION_POLICY_H_
@@ -4,12 +4,22 @@
 // Include ----------------------
 #include "ble_device.h"
 
+#include <algorithm>
+#include <cstring>
+
 #include "logger.h"
 
 namespace HareTortoiseClockSystem {
 
 constexpr char DEVICE_NAME[] = "HareTortoiseClock";
-constexpr uint16_t LOCAL_MTU = 500;
+/// 大容量転送のため最大のMTUを受け入れる
+constexpr uint16_t LOCAL_MTU = ESP_GATT_MAX_MTU_SIZE;
+/// アドバタイズ・スキャンレスポンスの最大長
+constexpr size_t ADV_DATA_MAX_LENGTH = 31;
+/// AD Type
+constexpr uint8_t AD_TYPE_FLAGS = 0x01;
+constexpr uint8_t AD_TYPE_COMPLETE_NAME = 0x09;
+constexpr uint8_t AD_TYPE_MANUFACTURER_SPECIFIC = 0xFF;
 
 static void gap_event(esp_gap_ble_cb_event_t event,
                       esp_ble_gap_cb_param_t *param) {
@@ -30,7 +40,14 @@ BleDevice *BleDevice::GetInstance() {
   return this_;
 }
 
-BleDevice::BleDevice() : services_() {}
+BleDevice::BleDevice()
+    : services_(),
+      conn_ids_(),
+      connection_count_(0),
+      scan_listener_(nullptr),
+      scan_duration_sec_(0) {
+  conn_ids_.reserve(CONFIG_BLE_MAX_CONNECTIONS);
+}
 
 void BleDevice::Initialize() {
   // Initialize Bluetooth
@@ -76,6 +93,9 @@ void BleDevice::Initialize() {
     ESP_LOGE(TAG, "gap register error, error code = %x", ret);
     return;
   }
+#ifdef CONFIG_BLE_OTA
+  ConfigureSecurity();
+#endif
 
   // Advertising
   esp_ble_adv_data_t adv_data = {
@@ -100,6 +120,8 @@ void BleDevice::Initialize() {
     ESP_LOGE(TAG, "config adv data failed, error code = %x", ret);
     return;
   }
+  // アドバタイズデータを差し替えてもデバイス名が分かるようスキャンレスポンスにも載せる
+  SetScanResponseManufacturerData(nullptr, 0);
 
   // GATT
   esp_err_t local_mtu_ret = esp_ble_gatt_set_local_mtu(LOCAL_MTU);
@@ -139,6 +161,47 @@ void BleDevice::GapEvent(esp_gap_ble_cb_event_t event,
     } else {
       ESP_LOGI(TAG, "Stop adv successfully");
     }
+  } else if (event == ESP_GAP_BLE_ADV_DATA_RAW_SET_COMPLETE_EVT ||
+             event == ESP_GAP_BLE_SCAN_RSP_DATA_RAW_SET_COMPLETE_EVT) {
+    // 時刻ビーコンで頻繁に更新されるためログは出さない
+  } else if (event == ESP_GAP_BLE_SCAN_PARAM_SET_COMPLETE_EVT) {
+    if (param->scan_param_cmpl.status == ESP_BT_STATUS_SUCCESS) {
+      esp_ble_gap_start_scanning(scan_duration_sec_);
+    } else {
+      ESP_LOGE(TAG, "Scan param set failed");
+      FinishScan();
+    }
+  } else if (event == ESP_GAP_BLE_SCAN_START_COMPLETE_EVT) {
+    if (param->scan_start_cmpl.status != ESP_BT_STATUS_SUCCESS) {
+      ESP_LOGE(TAG, "Scan start failed");
+      FinishScan();
+    }
+  } else if (event == ESP_GAP_BLE_SCAN_RESULT_EVT) {
+    BleScanListenerInterface *const listener = scan_listener_;
+    if (param->scan_rst.search_evt == ESP_GAP_SEARCH_INQ_RES_EVT) {
+      if (listener) {
+        listener->OnScanResult(param->scan_rst.ble_adv,
+                               param->scan_rst.adv_data_len,
+                               param->scan_rst.rssi);
+      }
+    } else if (param->scan_rst.search_evt == ESP_GAP_SEARCH_INQ_CMPL_EVT) {
+      FinishScan();
+    }
+#ifdef CONFIG_BLE_OTA
+  } else if (event == ESP_GAP_BLE_SEC_REQ_EVT) {
+    // セントラルからの暗号化要求 (ペアリング方式は設定したパラメータで決まる)
+    esp_ble_gap_security_rsp(param->ble_security.ble_req.bd_addr, true);
+  } else if (event == ESP_GAP_BLE_PASSKEY_NOTIF_EVT) {
+    ESP_LOGI(TAG, "Pairing passkey requested");
+  } else if (event == ESP_GAP_BLE_AUTH_CMPL_EVT) {
+    if (param->ble_security.auth_cmpl.success) {
+      ESP_LOGI(TAG, "Pairing complete, auth_mode = %d",
+               param->ble_security.auth_cmpl.auth_mode);
+    } else {
+      ESP_LOGW(TAG, "Pairing failed, reason = 0x%x",
+               param->ble_security.auth_cmpl.fail_reason);
+    }
+#endif
   } else if (event == ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT) {
     ESP_LOGI(
         TAG,
@@ -150,6 +213,10 @@ void BleDevice::GapEvent(esp_gap_ble_cb_event_t event,
   } else {
     ESP_LOGI(TAG, "GAP Event %d", event);
   }
+
+  for (BleServiceInterfaceSharedPtr bleService : services_) {
+    bleService->GapEvent(event, param);
+  }
 }
 
 void BleDevice::GattsEvent(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,
@@ -166,6 +233,10 @@ void BleDevice::GattsEvent(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,
                param->reg.status);
       return;
     }
+  } else if (event == ESP_GATTS_CONNECT_EVT) {
+    OnConnect(param->connect.conn_id);
+  } else if (event == ESP_GATTS_DISCONNECT_EVT) {
+    OnDisconnect(param->disconnect.conn_id);
   }
 
   for (BleServiceInterfaceSharedPtr bleService : services_) {
@@ -175,7 +246,87 @@ void BleDevice::GattsEvent(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,
   }
 }
 
+void BleDevice::ConfigureSecurity() {
+#ifdef CONFIG_BLE_OTA
+  // 表示・入力を持たないため、ビルド時の固定パスキーをセントラルで入力する
+  esp_ble_auth_req_t auth_req = ESP_LE_AUTH_REQ_SC_MITM_BOND;
+  esp_ble_io_cap_t io_cap = ESP_IO_CAP_OUT;
+  uint8_t key_size = 16;
+  uint8_t init_key = ESP_BLE_ENC_KEY_MASK | ESP_BLE_ID_KEY_MASK;
+  uint8_t rsp_key = ESP_BLE_ENC_KEY_MASK | ESP_BLE_ID_KEY_MASK;
+  uint32_t passkey = CONFIG_BLE_OTA_PASSKEY;
+  // MITM保護のない方式 (Just Works) へのダウングレードを拒否する
+  uint8_t auth_option = ESP_BLE_ONLY_ACCEPT_SPECIFIED_AUTH_ENABLE;
+  const esp_err_t rets[] = {
+      esp_ble_gap_set_security_param(ESP_BLE_SM_AUTHEN_REQ_MODE, &auth_req,
+                                     sizeof(auth_req)),
+      esp_ble_gap_set_security_param(ESP_BLE_SM_IOCAP_MODE, &io_cap,
+                                     sizeof(io_cap)),
+      esp_ble_gap_set_security_param(ESP_BLE_SM_MAX_KEY_SIZE, &key_size,
+                                     sizeof(key_size)),
+      esp_ble_gap_set_security_param(ESP_BLE_SM_SET_INIT_KEY, &init_key,
+                                     sizeof(init_key)),
+      esp_ble_gap_set_security_param(ESP_BLE_SM_SET_RSP_KEY, &rsp_key,
+                                     sizeof(rsp_key)),
+      esp_ble_gap_set_security_param(ESP_BLE_SM_SET_STATIC_PASSKEY, &passkey,
+                                     sizeof(passkey)),
+      esp_ble_gap_set_security_param(ESP_BLE_SM_ONLY_ACCEPT_SPECIFIED_SEC_AUTH,
+                                     &auth_option, sizeof(auth_option)),
+  };
+  for (const esp_err_t ret : rets) {
+    if (ret != ESP_OK) {
+      ESP_LOGE(TAG, "set security param failed, error code = %x", ret);
+      return;
+    }
+  }
+#endif
+}
+
+void BleDevice::OnConnect(const uint16_t conn_id) {
+  if (std::find(conn_ids_.begin(), conn_ids_.end(), conn_id) !=
+      conn_ids_.end()) {
+    return;
+  }
+  conn_ids_.push_back(conn_id);
+  connection_count_ = conn_ids_.size();
+  ESP_LOGI(TAG, "Connected %zu/%d", conn_ids_.size(),
+           CONFIG_BLE_MAX_CONNECTIONS);
+  // 接続でアドバタイズは停止するため、上限までは再開して次の接続を受け付ける
+  if (conn_ids_.size() < CONFIG_BLE_MAX_CONNECTIONS) {
+    StartAdvertising();
+  }
+}
+
+void BleDevice::OnDisconnect(const uint16_t conn_id) {
+  const auto it = std::find(conn_ids_.begin(), conn_ids_.end(), conn_id);
+  if (it == conn_ids_.end()) {
+    return;
+  }
+  const bool was_full = CONFIG_BLE_MAX_CONNECTIONS <= conn_ids_.size();
+  conn_ids_.erase(it);
+  connection_count_ = conn_ids_.size();
+  ESP_LOGI(TAG, "Disconnected %zu/%d", conn_ids_.size(),
+           CONFIG_BLE_MAX_CONNECTIONS);
+  // 上限未満の場合はアドバタイズを継続している
+  if (was_full) {
+    StartAdvertising();
+  }
+}
+
+void BleDevice::FinishScan() {
+  BleScanListenerInterface *const listener = scan_listener_;
+  scan_listener_ = nullptr;
+  if (listener) {
+    listener->OnScanComplete();
+  }
+}
+
+size_t BleDevice::GetConnectionCount() const { return connection_count_; }
+
 void BleDevice::StartAdvertising() {
+  if (CONFIG_BLE_MAX_CONNECTIONS <= connection_count_) {
+    return;
+  }
   esp_ble_adv_params_t adv_params = {
       .adv_int_min = 0x0800,  // Minimum Advertising Interval (range 0x0020 -
                               // 0x4000) N * 0.625ms
@@ -191,4 +342,76 @@ void BleDevice::StartAdvertising() {
   esp_ble_gap_start_advertising(&adv_params);
 }
 
+void BleDevice::SetAdvertisingManufacturerData(const uint8_t *const data,
+                                               const size_t length) {
+  // Flags(3) + Manufacturer Specific Data(2 + length)
+  if (ADV_DATA_MAX_LENGTH < 3 + 2 + length) {
+    ESP_LOGE(TAG, "Manufacturer data too long > %zu", length);
+    return;
+  }
+
+  uint8_t adv_data[ADV_DATA_MAX_LENGTH] = {};
+  adv_data[0] = 2;
+  adv_data[1] = AD_TYPE_FLAGS;
+  adv_data[2] = ESP_BLE_ADV_FLAG_GEN_DISC | ESP_BLE_ADV_FLAG_BREDR_NOT_SPT;
+  if (length == 0) {
+    // Flagsのみ
+    esp_ble_gap_config_adv_data_raw(adv_data, 3);
+    return;
+  }
+  adv_data[3] = static_cast<uint8_t>(1 + length);
+  adv_data[4] = AD_TYPE_MANUFACTURER_SPECIFIC;
+  std::memcpy(&adv_data[5], data, length);
+  esp_ble_gap_config_adv_data_raw(adv_data, 5 + length);
+}
+
+void BleDevice::SetScanResponseManufacturerData(const uint8_t *const data,
+                                                const size_t length) {
+  // Complete Name(2 + name) + Manufacturer Specific Data(2 + length)
+  constexpr size_t NAME_LENGTH = sizeof(DEVICE_NAME) - 1;
+  if (ADV_DATA_MAX_LENGTH < 2 + NAME_LENGTH + 2 + length) {
+    ESP_LOGE(TAG, "Scan response manufacturer data too long > %zu", length);
+    return;
+  }
+
+  uint8_t scan_response[ADV_DATA_MAX_LENGTH] = {};
+  size_t index = 0;
+  scan_response[index++] = static_cast<uint8_t>(1 + NAME_LENGTH);
+  scan_response[index++] = AD_TYPE_COMPLETE_NAME;
+  std::memcpy(&scan_response[index], DEVICE_NAME, NAME_LENGTH);
+  index += NAME_LENGTH;
+  if (0 < length) {
+    scan_response[index++] = static_cast<uint8_t>(1 + length);
+    scan_response[index++] = AD_TYPE_MANUFACTURER_SPECIFIC;
+    std::memcpy(&scan_response[index], data, length);
+    index += length;
+  }
+  esp_ble_gap_config_scan_rsp_data_raw(scan_response, index);
+}
+
+bool BleDevice::StartScan(BleScanListenerInterface *const listener,
+                          const uint32_t duration_sec) {
+  if (scan_listener_ != nullptr) {
+    return false;
+  }
+  scan_listener_ = listener;
+  scan_duration_sec_ = duration_sec;
+
+  // パッシブスキャン (他のアドバタイズを妨げない)
+  esp_ble_scan_params_t scan_params = {
+      .scan_type = BLE_SCAN_TYPE_PASSIVE,
+      .own_addr_type = BLE_ADDR_TYPE_PUBLIC,
+      .scan_filter_policy = BLE_SCAN_FILTER_ALLOW_ALL,
+      .scan_interval = 0x50,  // N * 0.625ms
+      .scan_window = 0x50,    // N * 0.625ms
+      .scan_duplicate = BLE_SCAN_DUPLICATE_DISABLE,
+  };
+  if (esp_ble_gap_set_scan_params(&scan_params) != ESP_OK) {
+    scan_listener_ = nullptr;
+    ESP_LOGE(TAG, "Scan param failed");
+    return false;
+  }
+  return true;
+}
+
 }  // namespace HareTortoiseClockSystem
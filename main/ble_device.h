@@ -11,23 +11,62 @@
 #include <esp_gatt_common_api.h>
 #include <esp_gatts_api.h>
 
+#include <atomic>
 #include <memory>
 #include <vector>
 
+#include "byte_span.h"
+
 namespace HareTortoiseClockSystem {
 
+/// Notify/Indicateの送信 (サービスが実装し、CCCDで購読されている場合のみ送信)
+class BleNotifierInterface {
+ public:
+  virtual ~BleNotifierInterface() {}
+
+  virtual bool Notify(const uint16_t handle, const uint8_t *const data,
+                      const size_t length) = 0;
+  /// 通知の予約 (値は送信時にReadで取得する 呼び出し元を待たせない)
+  virtual void ScheduleNotify(const uint16_t handle) = 0;
+  /// 1回のNotifyで送信できる最大長 (MTU - 3)
+  virtual size_t GetMaxNotifyLength() const = 0;
+  /// 送信可能か (接続中かつ輻輳しておらず、コントローラに空きがある)
+  virtual bool IsSendable() const = 0;
+  /// 大量転送中 (短い接続間隔を維持する)
+  virtual void RequestFastConnection() = 0;
+};
+
 class BleCharacteristicInterface {
  public:
   virtual ~BleCharacteristicInterface() {}
 
-  virtual void Write(const std::vector<uint8_t> *const data) = 0;
-  virtual void Read(std::vector<uint8_t> *const data) = 0;
+  /// 受信値 (スタックの受信バッファを直接参照する 呼び出し中のみ有効)
+  virtual void Write(ConstByteSpan data) = 0;
+  /// 値をdataへ書き込む (dataに収まらない分は切り詰める)
+  /// @return 書き込んだ長さ
+  virtual size_t Read(MutableByteSpan data) = 0;
+  /// 接続毎の状態を持つCharacteristicのみ利用 (既定は接続を区別しない)
+  virtual void WriteFrom(const uint16_t conn_id, ConstByteSpan data) {
+    Write(data);
+  }
+  virtual size_t ReadFor(const uint16_t conn_id, MutableByteSpan data) {
+    return Read(data);
+  }
+  /// 切断の通知 (接続毎の状態の破棄)
+  virtual void OnDisconnect(const uint16_t conn_id) {}
 
   virtual void SetHandle(const uint16_t handle) = 0;
   virtual uint16_t GetHandle() const = 0;
 
   virtual esp_bt_uuid_t GetUuid() const = 0;
   virtual esp_gatt_char_prop_t GetProperty() const = 0;
+
+  /// Notify/Indicateを行うCharacteristicのみ利用
+  virtual void SetNotifier(BleNotifierInterface *const notifier) {}
+  /// 値・CCCDのアクセス権 (暗号化が必要な場合はスタックがペアリングを要求する)
+  virtual esp_gatt_perm_t GetPermission() const {
+    return ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE;
+  }
 };
 
 using BleCharacteristicInterfaceSharedPtr =
@@ -39,6 +78,8 @@ class BleServiceInterface {
 
   virtual void GattsEvent(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,
                           esp_ble_gatts_cb_param_t *param) = 0;
+  virtual void GapEvent(esp_gap_ble_cb_event_t event,
+                        esp_ble_gap_cb_param_t *param) {}
   virtual void AddCharacteristic(
       BleCharacteristicInterfaceSharedPtr bleCharacteristic) = 0;
 
@@ -49,6 +90,16 @@ class BleServiceInterface {
 
 using BleServiceInterfaceSharedPtr = std::shared_ptr<BleServiceInterface>;
 
+/// スキャン結果の受信 (BTCタスクから呼び出し)
+class BleScanListenerInterface {
+ public:
+  virtual ~BleScanListenerInterface() {}
+
+  virtual void OnScanResult(const uint8_t *const adv_data,
+                            const size_t length, const int32_t rssi) = 0;
+  virtual void OnScanComplete() = 0;
+};
+
 class BleDevice final {
  public:
   static BleDevice *GetInstance();
@@ -62,13 +113,41 @@ class BleDevice final {
                   esp_ble_gatts_cb_param_t *param);
   void Initialize();
   void AddService(BleServiceInterfaceSharedPtr bleService);
+  /// アドバタイズの開始 (接続数が上限の場合は切断まで保留)
   void StartAdvertising();
+  /// 接続中のセントラル数 (BTCタスク以外からも呼び出し可能)
+  size_t GetConnectionCount() const;
+
+  /// アドバタイズデータのManufacturer Specific Dataを設定 (長さ0で削除)
+  /// 設定後、デバイス名はスキャンレスポンスのみで送信する
+  void SetAdvertisingManufacturerData(const uint8_t *const data,
+                                      const size_t length);
+  /// スキャンレスポンスのManufacturer Specific Dataを設定 (デバイス名の後)
+  void SetScanResponseManufacturerData(const uint8_t *const data,
+                                       const size_t length);
+
+  /// パッシブスキャンの開始 (完了時にlistener->OnScanComplete)
+  bool StartScan(BleScanListenerInterface *const listener,
+                 const uint32_t duration_sec);
 
  private:
   BleDevice();
 
+  /// MITM保護付きペアリング・ボンディングの設定 (固定パスキー)
+  void ConfigureSecurity();
+  void OnConnect(const uint16_t conn_id);
+  void OnDisconnect(const uint16_t conn_id);
+  /// スキャンの終了 (失敗時を含む) listenerを解除して通知
+  void FinishScan();
+
  private:
   std::vector<BleServiceInterfaceSharedPtr> services_;
+  /// 接続中のconn_id (CONNECT_EVTはアプリ毎に届くため重複を除く)
+  std::vector<uint16_t> conn_ids_;
+  /// conn_ids_の要素数 (conn_ids_はBTCタスクのみが参照する)
+  std::atomic<size_t> connection_count_;
+  BleScanListenerInterface *volatile scan_listener_;
+  uint32_t scan_duration_sec_;
 };
 
 }  // namespace HareTortoiseClockSystem
@@ -0,0 +1,354 @@
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include "ble_ota.h"
+
+#include <esp_system.h>
+#include <esp_timer.h>
+
+#include <algorithm>
+#include <cinttypes>
+
+#include "logger.h"
+
+#ifdef CONFIG_BLE_OTA
+
+namespace HareTortoiseClockSystem {
+
+/// 書き込み済み位置を通知する間隔 (ウィンドウの半分 送信側が止まらないように)
+constexpr uint32_t ACK_INTERVAL_CHUNKS =
+    std::max<uint32_t>(CONFIG_BLE_OTA_WINDOW / 2, 1);
+/// 受信キューのうち制御用に空けておく数
+constexpr int32_t CONTROL_QUEUE_SLACK = 2;
+
+BleOtaCharacteristic::BleOtaCharacteristic(
+    esp_bt_uuid_t characteristic_uuid, esp_gatt_char_prop_t property,
+    const HareTortoiseClockInterfaceWeakPtr hare_tortoise_clock_interface)
+    : BleCharacteristicInterface(),
+      Task(std::string(TASK_NAME).c_str(), PRIORITY, CORE_ID, STACK_DEPTH,
+           stack_buffer_),
+      stack_buffer_(),
+      characteristic_uuid_(characteristic_uuid),
+      property_(property),
+      handle_(0),
+      notifier_(nullptr),
+      hare_tortoise_clock_interface_(hare_tortoise_clock_interface),
+      request_queue_(),
+      receive_request_(),
+      is_receiving_(false),
+      receive_offset_(0),
+      is_nack_sent_(false),
+      write_request_(),
+      is_session_(false),
+      is_complete_(false),
+      ota_handle_(0),
+      partition_(nullptr),
+      sha256_(),
+      image_size_(0),
+      image_hash_(),
+      written_(0),
+      chunks_since_ack_(0),
+      begin_us_(0) {
+  mbedtls_sha256_init(&sha256_);
+}
+
+BleOtaCharacteristic::~BleOtaCharacteristic() { mbedtls_sha256_free(&sha256_); }
+
+void BleOtaCharacteristic::Initialize() {
+  if (!request_queue_.Create(CONFIG_BLE_OTA_WINDOW + CONTROL_QUEUE_SLACK)) {
+    ESP_LOGE(TAG, "Creating queue failed");
+  }
+#ifndef CONFIG_SECURE_SIGNED_APPS
+  // 署名の検証がない場合、ペアリング済みの端末からは任意のイメージを書き込める
+  ESP_LOGW(TAG, "OTA images are not signed");
+#endif
+}
+
+void BleOtaCharacteristic::Update() {
+  // Requestはデータを含むためスタックに置かない
+  Request &request = write_request_;
+  if (!request_queue_.ReceiveBlock(&request)) {
+    return;
+  }
+  switch (request.operation) {
+    case OPERATION_BEGIN:
+      Begin(request);
+      break;
+    case OPERATION_DATA:
+      WriteData(request);
+      break;
+    case OPERATION_END:
+      End();
+      break;
+    case OPERATION_ABORT:
+      Abort();
+      break;
+    case OPERATION_APPLY:
+      Apply();
+      break;
+    default:
+      break;
+  }
+}
+
+void BleOtaCharacteristic::Write(ConstByteSpan data) {
+  if (data.empty()) {
+    return;
+  }
+  const uint8_t operation = data[0];
+  if (operation == OPERATION_DATA) {
+    ReceiveData(data);
+    return;
+  }
+
+  // 制御は処理中のデータの後に実行する
+  receive_request_.operation = operation;
+  receive_request_.offset = 0;
+  receive_request_.length = 0;
+  if (operation == OPERATION_BEGIN) {
+    if (data.size() != 1 + sizeof(uint32_t) + HASH_LENGTH) {
+      return;
+    }
+    receive_request_.length = static_cast<uint16_t>(data.size() - 1);
+    std::copy(data.begin() + 1, data.end(), receive_request_.data.begin());
+  } else if (operation != OPERATION_END && operation != OPERATION_ABORT &&
+             operation != OPERATION_APPLY) {
+    return;
+  }
+  // 応答(開始)までデータは受け付けない
+  is_receiving_ = false;
+  if (!request_queue_.Send(receive_request_)) {
+    ESP_LOGW(TAG, "OTA request dropped > 0x%02x", operation);
+  }
+}
+
+void BleOtaCharacteristic::ReceiveData(ConstByteSpan data) {
+  if (!is_receiving_ || data.size() <= DATA_HEADER_LENGTH ||
+      MAX_DATA_LENGTH < data.size() - DATA_HEADER_LENGTH) {
+    return;
+  }
+  const uint32_t offset = LoadBigEndian<uint32_t>(&data[1]);
+  const uint32_t expected_offset = receive_offset_;
+  if (offset != expected_offset) {
+    // 欠落以降は破棄し、期待する位置から再送を要求 (Go-Back-N)
+    if (!is_nack_sent_) {
+      is_nack_sent_ = true;
+      SendNack(expected_offset);
+    }
+    return;
+  }
+
+  const ConstByteSpan payload = data.subspan(DATA_HEADER_LENGTH);
+  receive_request_.operation = OPERATION_DATA;
+  receive_request_.offset = offset;
+  receive_request_.length = static_cast<uint16_t>(payload.size());
+  std::copy(payload.begin(), payload.end(), receive_request_.data.begin());
+  if (!request_queue_.Send(receive_request_)) {
+    // ウィンドウを超えて送信された
+    if (!is_nack_sent_) {
+      is_nack_sent_ = true;
+      SendNack(expected_offset);
+    }
+    return;
+  }
+  is_nack_sent_ = false;
+  receive_offset_ = offset + static_cast<uint32_t>(payload.size());
+  if (notifier_) {
+    notifier_->RequestFastConnection();
+  }
+}
+
+void BleOtaCharacteristic::Begin(const Request &request) {
+  const uint32_t image_size = LoadBigEndian<uint32_t>(request.data.data());
+  std::array<uint8_t, HASH_LENGTH> image_hash = {};
+  std::copy_n(request.data.begin() + sizeof(uint32_t), HASH_LENGTH,
+              image_hash.begin());
+
+  Result result = RESULT_OK;
+  if (is_session_ && !is_complete_ && image_size == image_size_ &&
+      image_hash == image_hash_) {
+    // 同じイメージの転送中 (切断後の再接続など) は続きから
+    ESP_LOGI(TAG, "OTA resume > %" PRIu32 "/%" PRIu32 " byte", written_,
+             image_size_);
+  } else {
+    Abort();
+    partition_ = esp_ota_get_next_update_partition(nullptr);
+    if (partition_ == nullptr || image_size == 0 ||
+        partition_->size < image_size) {
+      result = RESULT_NO_SPACE;
+    } else if (esp_ota_begin(partition_, OTA_WITH_SEQUENTIAL_WRITES,
+                             &ota_handle_) != ESP_OK) {
+      // 消去は書き込みに合わせて行う (開始時に領域全体を消去しない)
+      result = RESULT_FLASH_ERROR;
+    } else {
+      is_session_ = true;
+      image_size_ = image_size;
+      image_hash_ = image_hash;
+      written_ = 0;
+      begin_us_ = esp_timer_get_time();
+      mbedtls_sha256_starts(&sha256_, 0);
+      ESP_LOGI(TAG, "OTA begin > %s %" PRIu32 " byte", partition_->label,
+               image_size_);
+    }
+  }
+  chunks_since_ack_ = 0;
+
+  if (result == RESULT_OK) {
+    receive_offset_ = written_;
+    is_nack_sent_ = false;
+    is_receiving_ = true;
+  }
+  std::array<uint8_t, 2 + sizeof(uint32_t) + sizeof(uint16_t) * 2> reply = {};
+  size_t index = 0;
+  reply[index++] = REPLY_READY;
+  reply[index++] = result;
+  index += StoreBigEndian(written_, &reply[index]);
+  index += StoreBigEndian(static_cast<uint16_t>(CONFIG_BLE_OTA_WINDOW),
+                          &reply[index]);
+  index +=
+      StoreBigEndian(static_cast<uint16_t>(MAX_DATA_LENGTH), &reply[index]);
+  Send(reply);
+}
+
+void BleOtaCharacteristic::WriteData(const Request &request) {
+  // 開始前・中止後に残っていたデータは破棄
+  if (!is_session_ || is_complete_ || request.offset != written_) {
+    return;
+  }
+  if (image_size_ - written_ < request.length ||
+      esp_ota_write(ota_handle_, request.data.data(), request.length) !=
+          ESP_OK) {
+    ESP_LOGE(TAG, "OTA write failed > %" PRIu32 " byte", written_);
+    Abort();
+    SendDone(RESULT_FLASH_ERROR, 0, 0);
+    return;
+  }
+  mbedtls_sha256_update(&sha256_, request.data.data(), request.length);
+  written_ += request.length;
+
+  if (ACK_INTERVAL_CHUNKS <= ++chunks_since_ack_ || written_ == image_size_) {
+    chunks_since_ack_ = 0;
+    std::array<uint8_t, 1 + sizeof(uint32_t)> reply = {};
+    reply[0] = REPLY_ACK;
+    StoreBigEndian(written_, &reply[1]);
+    Send(reply);
+  }
+}
+
+void BleOtaCharacteristic::End() {
+  if (!is_session_ || is_complete_ || written_ != image_size_) {
+    SendDone(RESULT_INVALID_STATE, 0, 0);
+    return;
+  }
+
+  std::array<uint8_t, HASH_LENGTH> hash = {};
+  mbedtls_sha256_finish(&sha256_, hash.data());
+  if (hash != image_hash_) {
+    ESP_LOGE(TAG, "OTA hash mismatch");
+    Abort();
+    SendDone(RESULT_HASH_MISMATCH, 0, 0);
+    return;
+  }
+  // esp_ota_endでイメージのヘッダ・チェックサムを検証する
+  is_session_ = false;
+  if (esp_ota_end(ota_handle_) != ESP_OK) {
+    ESP_LOGE(TAG, "OTA invalid image");
+    SendDone(RESULT_INVALID_IMAGE, 0, 0);
+    return;
+  }
+  if (esp_ota_set_boot_partition(partition_) != ESP_OK) {
+    SendDone(RESULT_FLASH_ERROR, 0, 0);
+    return;
+  }
+  is_complete_ = true;
+
+  const int64_t elapsed_us =
+      std::max<int64_t>(esp_timer_get_time() - begin_us_, 1);
+  const uint32_t bytes_per_sec =
+      static_cast<uint32_t>(static_cast<int64_t>(image_size_) * 1000000 /
+                            elapsed_us);
+  ESP_LOGI(TAG,
+           "OTA complete > %" PRIu32 " byte %" PRId64 "ms %" PRIu32
+           ".%" PRIu32 "kB/s (next boot:%s)",
+           image_size_, elapsed_us / 1000, bytes_per_sec / 1000,
+           bytes_per_sec % 1000 / 100, partition_->label);
+  SendDone(RESULT_OK, bytes_per_sec, static_cast<uint32_t>(elapsed_us / 1000));
+}
+
+void BleOtaCharacteristic::Abort() {
+  is_receiving_ = false;
+  if (is_session_) {
+    ESP_LOGW(TAG, "OTA abort > %" PRIu32 "/%" PRIu32 " byte", written_,
+             image_size_);
+    esp_ota_abort(ota_handle_);
+    is_session_ = false;
+  }
+  written_ = 0;
+}
+
+void BleOtaCharacteristic::Apply() {
+  if (!is_complete_) {
+    SendDone(RESULT_INVALID_STATE, 0, 0);
+    return;
+  }
+  ESP_LOGI(TAG, "OTA apply > restart");
+  HareTortoiseClockInterfaceSharedPtr hare_tortoise_clock =
+      hare_tortoise_clock_interface_.lock();
+  if (!hare_tortoise_clock) {
+    esp_restart();
+  }
+  // 針の移動の完了後に状態を記録してから再起動
+  hare_tortoise_clock->Restart();
+}
+
+void BleOtaCharacteristic::SendNack(const uint32_t expected_offset) {
+  std::array<uint8_t, 1 + sizeof(uint32_t)> reply = {};
+  reply[0] = REPLY_NACK;
+  StoreBigEndian(expected_offset, &reply[1]);
+  Send(reply);
+}
+
+void BleOtaCharacteristic::SendDone(const Result result,
+                                    const uint32_t bytes_per_sec,
+                                    const uint32_t elapsed_ms) {
+  std::array<uint8_t, 2 + sizeof(uint32_t) * 2> reply = {};
+  size_t index = 0;
+  reply[index++] = REPLY_DONE;
+  reply[index++] = result;
+  index += StoreBigEndian(bytes_per_sec, &reply[index]);
+  index += StoreBigEndian(elapsed_ms, &reply[index]);
+  Send(reply);
+}
+
+void BleOtaCharacteristic::Send(ConstByteSpan data) {
+  if (notifier_) {
+    notifier_->Notify(handle_, data.data(), data.size());
+  }
+}
+
+void BleOtaCharacteristic::SetHandle(const uint16_t handle) {
+  handle_ = handle;
+}
+
+uint16_t BleOtaCharacteristic::GetHandle() const { return handle_; }
+
+esp_bt_uuid_t BleOtaCharacteristic::GetUuid() const {
+  return characteristic_uuid_;
+}
+
+esp_gatt_char_prop_t BleOtaCharacteristic::GetProperty() const {
+  return property_;
+}
+
+void BleOtaCharacteristic::SetNotifier(BleNotifierInterface *const notifier) {
+  notifier_ = notifier;
+}
+
+esp_gatt_perm_t BleOtaCharacteristic::GetPermission() const {
+  return ESP_GATT_PERM_READ_ENC_MITM | ESP_GATT_PERM_WRITE_ENC_MITM;
+}
+
+}  // namespace HareTortoiseClockSystem
+
+#endif  // CONFIG_BLE_OTA
@@ -0,0 +1,157 @@
+#ifndef BLE_OTA_H_
+#define BLE_OTA_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include <esp_gatts_api.h>
+#include <esp_ota_ops.h>
+#include <freertos/FreeRTOS.h>
+#include <mbedtls/sha256.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+#include "ble_device.h"
+#include "hare_tortoise_clock_interface.h"
+#include "message_queue.h"
+#include "task.h"
+
+namespace HareTortoiseClockSystem {
+
+/// BLEによるファームウェア更新 (未使用のOTA領域へ書き込む)
+/// Write [0x01][イメージ長(uint32_t)][SHA-256(32byte)] : 開始・再開
+///   Notify [0x81][結果][再開位置(uint32_t)][ウィンドウ(uint16_t)][最大データ長(uint16_t)]
+///   同じイメージの転送が途中であれば書き込み済みの位置から再開する
+/// Write Without Response [0x02][位置(uint32_t)][データ] : データ
+///   ウィンドウ数のデータまで応答を待たずに送信できる
+///   Notify [0x82][書き込み済み位置(uint32_t)] : ウィンドウの半分毎と最後
+///   Notify [0x83][期待する位置(uint32_t)] : 位置の不一致・受信溢れ (再送要求)
+/// Write [0x03] : 完了 (ハッシュとイメージを検証して起動領域に設定)
+///   Notify [0x84][結果][転送速度(byte/s uint32_t)][所要時間(ms uint32_t)]
+/// Write [0x04] : 中止
+/// Write [0x05] : 更新したファームウェアで再起動
+/// 応答が途絶えた場合は開始を再送して再開位置を得る
+/// 値はすべてビッグエンディアン
+class BleOtaCharacteristic final : public BleCharacteristicInterface,
+                                   public Task {
+ public:
+  static constexpr std::string_view TASK_NAME = "BleOta";
+  static constexpr int32_t PRIORITY = Task::PRIORITY_LOW;
+  static constexpr int32_t CORE_ID = PRO_CPU_NUM;
+  static constexpr uint32_t STACK_DEPTH = 4096;
+
+  /// データのヘッダ長 [操作][位置]
+  static constexpr size_t DATA_HEADER_LENGTH = 1 + sizeof(uint32_t);
+  /// 1回のデータの最大長 (最大MTUのWrite Without Responseに収まる長さ)
+  static constexpr size_t MAX_DATA_LENGTH =
+      ESP_GATT_MAX_MTU_SIZE - 3 - DATA_HEADER_LENGTH;
+  static constexpr size_t HASH_LENGTH = 32;
+
+  enum Operation : uint8_t {
+    OPERATION_BEGIN = 0x01,
+    OPERATION_DATA = 0x02,
+    OPERATION_END = 0x03,
+    OPERATION_ABORT = 0x04,
+    OPERATION_APPLY = 0x05,
+  };
+
+  enum Reply : uint8_t {
+    REPLY_READY = 0x81,
+    REPLY_ACK = 0x82,
+    REPLY_NACK = 0x83,
+    REPLY_DONE = 0x84,
+  };
+
+  enum Result : uint8_t {
+    RESULT_OK = 0,
+    /// 更新先の領域がない・イメージが大きすぎる
+    RESULT_NO_SPACE,
+    /// 転送が開始されていない・未完了
+    RESULT_INVALID_STATE,
+    /// ハッシュの不一致
+    RESULT_HASH_MISMATCH,
+    /// イメージの検証に失敗
+    RESULT_INVALID_IMAGE,
+    /// フラッシュの書き込みに失敗
+    RESULT_FLASH_ERROR,
+  };
+
+  BleOtaCharacteristic(
+      esp_bt_uuid_t characteristic_uuid, esp_gatt_char_prop_t property,
+      const HareTortoiseClockInterfaceWeakPtr hare_tortoise_clock_interface);
+  ~BleOtaCharacteristic();
+
+  void Write(ConstByteSpan data) override;
+  size_t Read(MutableByteSpan data) override { return 0; }
+
+  void SetHandle(const uint16_t handle) override;
+  uint16_t GetHandle() const override;
+  esp_bt_uuid_t GetUuid() const override;
+  esp_gatt_char_prop_t GetProperty() const override;
+  void SetNotifier(BleNotifierInterface *const notifier) override;
+  /// MITM保護の暗号化接続のみ (パスキーでペアリングした端末のみ更新できる)
+  esp_gatt_perm_t GetPermission() const override;
+
+  void Initialize() override;
+  void Update() override;
+
+ private:
+  /// 書き込みタスクへの要求 (データと制御を同じキューで順序を保つ)
+  struct Request {
+    uint8_t operation;
+    uint16_t length;
+    uint32_t offset;
+    std::array<uint8_t, MAX_DATA_LENGTH> data;
+  };
+
+  void ReceiveData(ConstByteSpan data);
+  void Begin(const Request &request);
+  void WriteData(const Request &request);
+  void End();
+  void Abort();
+  void Apply();
+
+  void SendNack(const uint32_t expected_offset);
+  void SendDone(const Result result, const uint32_t bytes_per_sec,
+                const uint32_t elapsed_ms);
+  void Send(ConstByteSpan data);
+
+ private:
+  StackType_t stack_buffer_[STACK_DEPTH];
+  const esp_bt_uuid_t characteristic_uuid_;
+  const esp_gatt_char_prop_t property_;
+  uint16_t handle_;
+  BleNotifierInterface *notifier_;
+  const HareTortoiseClockInterfaceWeakPtr hare_tortoise_clock_interface_;
+  /// 深さはウィンドウ数+制御分 (開始時に確保)
+  MessageQueue<Request> request_queue_;
+  /// 受信側 (BLEスレッド) の状態
+  Request receive_request_;
+  /// データを受け付けるか・次に受け付ける位置 (開始の応答時に書き込みタスクが設定)
+  std::atomic<bool> is_receiving_;
+  std::atomic<uint32_t> receive_offset_;
+  /// 再送要求後、期待する位置のデータを受信するまで再送要求しない
+  bool is_nack_sent_;
+  /// 書き込み側 (書き込みタスク) の状態
+  Request write_request_;
+  bool is_session_;
+  bool is_complete_;
+  esp_ota_handle_t ota_handle_;
+  const esp_partition_t *partition_;
+  mbedtls_sha256_context sha256_;
+  uint32_t image_size_;
+  std::array<uint8_t, HASH_LENGTH> image_hash_;
+  uint32_t written_;
+  uint32_t chunks_since_ack_;
+  int64_t begin_us_;
+};
+
+using BleOtaCharacteristicSharedPtr = std::shared_ptr<BleOtaCharacteristic>;
+
+}  // namespace HareTortoiseClockSystem
+
+#endif  // BLE_OTA_H_
@@ -13,6 +13,40 @@
 
 namespace HareTortoiseClockSystem {
 
+static_assert(CommandProtocol::HAND_HOUR == Choreography::HAND_HOUR &&
+                  CommandProtocol::HAND_MINUTE == Choreography::HAND_MINUTE,
+              "hand flags must match between the protocol and the clock");
+
+/// LE Data Length Extensionの最大データ長(byte)
+constexpr uint16_t BLE_MAX_DATA_LENGTH = 251;
+
+namespace {
+
+/// 属性テーブルが参照する宣言のUUID・初期値 (スタックはポインタのみ保持する)
+const uint16_t PRIMARY_SERVICE_UUID = ESP_GATT_UUID_PRI_SERVICE;
+const uint16_t CHARACTERISTIC_DECLARATION_UUID = ESP_GATT_UUID_CHAR_DECLARE;
+const uint16_t CLIENT_CONFIG_UUID = ESP_GATT_UUID_CHAR_CLIENT_CONFIG;
+const uint8_t CLIENT_CONFIG_DEFAULT[sizeof(uint16_t)] = {0x00, 0x00};
+
+esp_gatts_attr_db_t MakeAttribute(const uint8_t auto_rsp,
+                                  const uint16_t uuid_length,
+                                  const void *const uuid, const uint16_t perm,
+                                  const uint16_t max_length,
+                                  const uint16_t length,
+                                  const void *const value) {
+  return esp_gatts_attr_db_t{
+      .attr_control = {.auto_rsp = auto_rsp},
+      .att_desc = {.uuid_length = uuid_length,
+                   .uuid_p = static_cast<uint8_t *>(const_cast<void *>(uuid)),
+                   .perm = perm,
+                   .max_length = max_length,
+                   .length = length,
+                   .value =
+                       static_cast<uint8_t *>(const_cast<void *>(value))}};
+}
+
+}  // namespace
+
 BleTimeCharacteristic::BleTimeCharacteristic(
     esp_bt_uuid_t characteristic_uuid, esp_gatt_char_prop_t property,
     const HareTortoiseClockInterfaceWeakPtr hare_tortoise_clock_interface)
@@ -21,7 +55,7 @@ BleTimeCharacteristic::BleTimeCharacteristic(
       property_(property),
       hare_tortoise_clock_interface_(hare_tortoise_clock_interface) {}
 
-void BleTimeCharacteristic::Write(const std::vector<uint8_t> *const data) {
+void BleTimeCharacteristic::Write(ConstByteSpan data) {
   HareTortoiseClockInterfaceSharedPtr hare_tortoise_clock = hare_tortoise_clock_interface_.lock();
   if (!hare_tortoise_clock) {
     return;
@@ -29,32 +63,23 @@ void BleTimeCharacteristic::Write(const std::vector<uint8_t> *const data) {
 
   // [time_t型(uint64_t)] ビッグエンディアン
   ESP_LOGI(TAG, "RECV Time");
-  // esp_log_buffer_hex(TAG, data->data(), data->size());
-  if (data->size() == sizeof(uint64_t)) {
-    // ネットワークバイトオーダー(Big-Endian)をLittle-Endianに変換
-    std::vector<uint8_t> reverse(*data);
-    std::reverse(reverse.begin(), reverse.end());
-    const uint64_t unixtime = *reinterpret_cast<uint64_t *>(reverse.data());
+  // esp_log_buffer_hex(TAG, data.data(), data.size());
+  if (data.size() == sizeof(uint64_t)) {
+    const uint64_t unixtime = LoadBigEndian<uint64_t>(data.data());
     ESP_LOGI(TAG, "RECV TIME %" PRId64, unixtime);
     hare_tortoise_clock->SetUnixTime(unixtime);
   }
 }
 
-void BleTimeCharacteristic::Read(std::vector<uint8_t> *const data) {
+size_t BleTimeCharacteristic::Read(MutableByteSpan data) {
   HareTortoiseClockInterfaceSharedPtr hare_tortoise_clock = hare_tortoise_clock_interface_.lock();
-  if (!hare_tortoise_clock) {
-    return;
+  if (!hare_tortoise_clock || data.size() < sizeof(uint64_t)) {
+    return 0;
   }
 
   // [time_t型(uint64_t)] ビッグエンディアン
-  std::vector<uint8_t> payload(8);
-  uint64_t *const view = reinterpret_cast<uint64_t *>(payload.data());
-  *view = hare_tortoise_clock->GetUnixTime();
-  std::reverse(
-      payload.begin(),
-      payload
-          .end());  // Little-Endianをネットワークバイトオーダー(Big-Endian)に変換
-  data->insert(data->end(), payload.begin(), payload.end());
+  const uint64_t unixtime = hare_tortoise_clock->GetUnixTime();
+  return StoreBigEndian(unixtime, data.data());
 }
 
 void BleTimeCharacteristic::SetHandle(const uint16_t handle) {
@@ -71,26 +96,128 @@ esp_gatt_char_prop_t BleTimeCharacteristic::GetProperty() const {
   return property_;
 }
 
-BleCommandCharacteristic::BleCommandCharacteristic(
+BleTimeSyncCharacteristic::BleTimeSyncCharacteristic(
     esp_bt_uuid_t characteristic_uuid, esp_gatt_char_prop_t property,
     const HareTortoiseClockInterfaceWeakPtr hare_tortoise_clock_interface)
     : BleCharacteristicInterface(),
       characteristic_uuid_(characteristic_uuid),
       property_(property),
-      hare_tortoise_clock_interface_(hare_tortoise_clock_interface) {}
+      hare_tortoise_clock_interface_(hare_tortoise_clock_interface),
+      requests_() {}
 
-void BleCommandCharacteristic::Write(const std::vector<uint8_t> *const data) {
-  esp_log_buffer_hex(TAG, data->data(), data->size());
+void BleTimeSyncCharacteristic::WriteFrom(const uint16_t conn_id,
+                                          ConstByteSpan data) {
+  // 受信時刻は最初に取得する
+  const int64_t receive_us = Util::GetEpochMicroseconds();
 
-  if (data->size() != 1) {
+  // [操作(uint8_t)][int64_t] ビッグエンディアン
+  if (data.size() != sizeof(uint8_t) + sizeof(int64_t)) {
     return;
   }
+  const int64_t value = LoadBigEndian<int64_t>(&data[1]);
+
+  const uint8_t operation = data[0];
+  if (operation == OPERATION_REQUEST) {
+    Request *request = FindRequest(conn_id);
+    if (!request) {
+      // 空きを使う (接続数の上限と同じ数を持つため通常は不足しない)
+      request = FindRequest(conn_id, false);
+    }
+    if (!request) {
+      ESP_LOGW(TAG, "TIME SYNC request dropped, conn_id %d", conn_id);
+      return;
+    }
+    *request = Request{true, conn_id, value, receive_us};
+  } else if (operation == OPERATION_ADJUST) {
+    HareTortoiseClockInterfaceSharedPtr hare_tortoise_clock =
+        hare_tortoise_clock_interface_.lock();
+    if (!hare_tortoise_clock) {
+      return;
+    }
+    const int64_t offset_us = value;
+    ESP_LOGI(TAG, "RECV TIME SYNC offset:%" PRId64 "us", offset_us);
+    hare_tortoise_clock->AdjustTime(offset_us);
+  }
+}
+
+size_t BleTimeSyncCharacteristic::ReadFor(const uint16_t conn_id,
+                                          MutableByteSpan data) {
+  // [t1][t2][t3] int64_t ビッグエンディアン (同期要求がない接続はt1・t2が0)
+  const int64_t send_us = Util::GetEpochMicroseconds();
+  if (data.size() < sizeof(int64_t) * 3) {
+    return 0;
+  }
+  const Request *const request = FindRequest(conn_id);
+  size_t index = 0;
+  for (const int64_t value : {request ? request->client_send_us : 0,
+                              request ? request->receive_us : 0, send_us}) {
+    index += StoreBigEndian(value, &data[index]);
+  }
+  return index;
+}
+
+void BleTimeSyncCharacteristic::OnDisconnect(const uint16_t conn_id) {
+  Request *const request = FindRequest(conn_id);
+  if (request) {
+    request->is_used = false;
+  }
+}
+
+BleTimeSyncCharacteristic::Request *BleTimeSyncCharacteristic::FindRequest(
+    const uint16_t conn_id, const bool is_used) {
+  for (Request &request : requests_) {
+    if (request.is_used == is_used &&
+        (!is_used || request.conn_id == conn_id)) {
+      return &request;
+    }
+  }
+  return nullptr;
+}
+
+void BleTimeSyncCharacteristic::SetHandle(const uint16_t handle) {
+  handle_ = handle;
+}
+
+uint16_t BleTimeSyncCharacteristic::GetHandle() const { return handle_; }
 
-  const uint8_t cmd = *data->data();
+esp_bt_uuid_t BleTimeSyncCharacteristic::GetUuid() const {
+  return characteristic_uuid_;
+}
+
+esp_gatt_char_prop_t BleTimeSyncCharacteristic::GetProperty() const {
+  return property_;
+}
+
+BleCommandCharacteristic::BleCommandCharacteristic(
+    esp_bt_uuid_t characteristic_uuid, esp_gatt_char_prop_t property,
+    const HareTortoiseClockInterfaceWeakPtr hare_tortoise_clock_interface)
+    : BleCharacteristicInterface(),
+      characteristic_uuid_(characteristic_uuid),
+      property_(property),
+      handle_(0),
+      notifier_(nullptr),
+      hare_tortoise_clock_interface_(hare_tortoise_clock_interface),
+      response_buffer_() {}
 
+void BleCommandCharacteristic::Write(ConstByteSpan data) {
+  esp_log_buffer_hex(TAG, data.data(), data.size());
+
+  if (data.size() == 1) {
+    ExecuteLegacy(data[0]);
+    return;
+  }
+  ExecuteFrame(data);
+}
+
+void BleCommandCharacteristic::ExecuteLegacy(const uint8_t cmd) {
   if (cmd == 1) {
     ESP_LOGI(TAG, "Command 1 > System Restart");
-    esp_restart();
+    HareTortoiseClockInterfaceSharedPtr hare_tortoise_clock = hare_tortoise_clock_interface_.lock();
+    if (!hare_tortoise_clock) {
+      esp_restart();
+    }
+    // 状態を記録してから再起動
+    hare_tortoise_clock->Restart();
   }
   if (cmd == 2) {
     ESP_LOGI(TAG, "Command 2 > Emergency Stop");
@@ -102,6 +229,195 @@ void BleCommandCharacteristic::Write(const std::vector<uint8_t> *const data) {
   }
 }
 
+void BleCommandCharacteristic::ExecuteFrame(ConstByteSpan data) {
+  using namespace CommandProtocol;
+
+  Header header = {};
+  if (!ParseHeader(data, &header)) {
+    return;
+  }
+  MutableByteSpan response(response_buffer_);
+  if (notifier_) {
+    response = response.first(notifier_->GetMaxNotifyLength());
+  }
+  Writer writer(response, Header{VERSION, 0, header.sequence});
+
+  bool is_reply_required = (header.flags & FLAG_NO_REPLY) == 0;
+  if (header.version != VERSION) {
+    writer.Append(TYPE_FRAME, RESULT_UNSUPPORTED_VERSION);
+    is_reply_required = true;
+  } else {
+    FrameContext context = {};
+    Reader reader(data);
+    Tlv tlv = {};
+    size_t count = 0;
+    while (reader.Next(&tlv)) {
+      ++count;
+      const bool is_query = TYPE_QUERY_STATE <= tlv.type &&
+                            tlv.type <= TYPE_QUERY_TIME;
+      const Result result = Execute(tlv, &context, &writer);
+      if (result != RESULT_OK || is_query) {
+        is_reply_required = true;
+      }
+    }
+    if (reader.IsMalformed()) {
+      writer.Append(TYPE_FRAME, RESULT_MALFORMED);
+      is_reply_required = true;
+    }
+    // 実行指示のない針移動・待機は1回実行
+    if (context.choreography.count != 0 &&
+        SubmitChoreography(&context, 1, &writer) != RESULT_OK) {
+      is_reply_required = true;
+    }
+    ESP_LOGI(TAG, "Command Frame seq:%u count:%zu", header.sequence, count);
+  }
+
+  if (is_reply_required && notifier_) {
+    notifier_->Notify(handle_, response_buffer_.data(), writer.GetLength());
+  }
+}
+
+CommandProtocol::Result BleCommandCharacteristic::Execute(
+    const CommandProtocol::Tlv &tlv, FrameContext *const context,
+    CommandProtocol::Writer *const writer) {
+  using namespace CommandProtocol;
+
+  HareTortoiseClockInterfaceSharedPtr hare_tortoise_clock =
+      hare_tortoise_clock_interface_.lock();
+  Result result = RESULT_OK;
+  // 応答の値 (問い合わせのみ)
+  std::array<uint8_t, 16> value = {};
+  size_t value_length = 0;
+
+  const auto expect_length = [&tlv, &result](const size_t length) {
+    if (tlv.length != length) {
+      result = RESULT_INVALID_LENGTH;
+      return false;
+    }
+    return true;
+  };
+
+  if (!hare_tortoise_clock) {
+    result = RESULT_NOT_READY;
+  } else if (tlv.type == TYPE_RESTART) {
+    if (expect_length(0)) {
+      ESP_LOGI(TAG, "Command > System Restart");
+      hare_tortoise_clock->Restart();
+    }
+  } else if (tlv.type == TYPE_EMERGENCY_STOP) {
+    if (expect_length(0)) {
+      ESP_LOGI(TAG, "Command > Emergency Stop");
+      hare_tortoise_clock->EmergencyStop();
+    }
+  } else if (tlv.type == TYPE_SET_TIME) {
+    if (expect_length(sizeof(uint64_t))) {
+      hare_tortoise_clock->SetUnixTime(
+          static_cast<std::time_t>(LoadBigEndian<uint64_t>(tlv.value)));
+    }
+  } else if (tlv.type == TYPE_ADJUST_TIME) {
+    if (expect_length(sizeof(int64_t))) {
+      hare_tortoise_clock->AdjustTime(LoadBigEndian<int64_t>(tlv.value));
+    }
+  } else if (tlv.type == TYPE_SET_SPEED) {
+    if (expect_length(sizeof(uint16_t) * 2)) {
+      context->hour_hz = LoadBigEndian<uint16_t>(tlv.value);
+      context->minute_hz =
+          LoadBigEndian<uint16_t>(tlv.value + sizeof(uint16_t));
+    }
+  } else if (tlv.type == TYPE_MOVE_HAND || tlv.type == TYPE_WAIT) {
+    Choreography &choreography = context->choreography;
+    Choreography::Step step = {};
+    if (tlv.type == TYPE_MOVE_HAND && expect_length(3)) {
+      step.hands = tlv.value[0];
+      step.position = LoadBigEndian<uint16_t>(tlv.value + 1);
+      step.hour_hz = context->hour_hz;
+      step.minute_hz = context->minute_hz;
+      if (step.hands == 0 ||
+          (step.hands & ~(HAND_HOUR | HAND_MINUTE)) != 0 ||
+          Choreography::POSITION_SCALE < step.position) {
+        result = RESULT_INVALID_VALUE;
+      }
+    } else if (tlv.type == TYPE_WAIT && expect_length(sizeof(uint16_t))) {
+      step.wait_ms = LoadBigEndian<uint16_t>(tlv.value);
+    }
+    if (result == RESULT_OK) {
+      if (Choreography::MAX_STEPS <= choreography.count) {
+        result = RESULT_BUSY;
+      } else {
+        choreography.steps[choreography.count++] = step;
+      }
+    }
+  } else if (tlv.type == TYPE_RUN_CHOREOGRAPHY) {
+    if (expect_length(sizeof(uint8_t))) {
+      return SubmitChoreography(context, tlv.value[0], writer);
+    }
+  } else if (tlv.type == TYPE_QUERY_STATE) {
+    if (expect_length(0)) {
+      const std::array<uint8_t, BleStatusCharacteristic::VALUE_LENGTH> state =
+          BleStatusCharacteristic::EncodeValue(
+              hare_tortoise_clock->GetClockState());
+      std::copy(state.begin(), state.end(), value.begin());
+      value_length = state.size();
+    }
+  } else if (tlv.type == TYPE_QUERY_SYNC) {
+    if (expect_length(0)) {
+      const HareTortoiseClockInterface::TimeSyncState state =
+          hare_tortoise_clock->GetTimeSyncState();
+      value[value_length++] = state.is_synced ? 1 : 0;
+      value[value_length++] = state.hops;
+      value_length +=
+          StoreBigEndian(state.uncertainty_ms, &value[value_length]);
+      value_length += StoreBigEndian(state.last_sync_us, &value[value_length]);
+      value_length += StoreBigEndian(state.drift_ppb, &value[value_length]);
+    }
+  } else if (tlv.type == TYPE_QUERY_TIME) {
+    if (expect_length(0)) {
+      value_length = StoreBigEndian(
+          static_cast<uint64_t>(hare_tortoise_clock->GetUnixTime()), &value[0]);
+    }
+  } else {
+    result = RESULT_UNKNOWN_TYPE;
+  }
+
+  if (result != RESULT_OK) {
+    ESP_LOGW(TAG, "Command type:0x%02x len:%u result:%u", tlv.type,
+             tlv.length, result);
+  }
+  writer->Append(tlv.type, result,
+                 ConstByteSpan(value).first(result == RESULT_OK ? value_length
+                                                                : 0));
+  return result;
+}
+
+CommandProtocol::Result BleCommandCharacteristic::SubmitChoreography(
+    FrameContext *const context, const uint8_t repeat,
+    CommandProtocol::Writer *const writer) {
+  using namespace CommandProtocol;
+
+  Choreography &choreography = context->choreography;
+  HareTortoiseClockInterfaceSharedPtr hare_tortoise_clock =
+      hare_tortoise_clock_interface_.lock();
+  Result result = RESULT_OK;
+  if (choreography.count == 0 || repeat == 0 ||
+      Choreography::MAX_REPEAT < repeat) {
+    result = RESULT_INVALID_VALUE;
+  } else if (!hare_tortoise_clock) {
+    result = RESULT_NOT_READY;
+  } else {
+    choreography.repeat = repeat;
+    if (!hare_tortoise_clock->RunChoreography(choreography)) {
+      result = RESULT_BUSY;
+    }
+  }
+  choreography.count = 0;
+
+  if (result != RESULT_OK) {
+    ESP_LOGW(TAG, "Choreography repeat:%u result:%u", repeat, result);
+  }
+  writer->Append(TYPE_RUN_CHOREOGRAPHY, result);
+  return result;
+}
+
 void BleCommandCharacteristic::SetHandle(const uint16_t handle) {
   handle_ = handle;
 }
@@ -116,16 +432,99 @@ esp_gatt_char_prop_t BleCommandCharacteristic::GetProperty() const {
   return property_;
 }
 
+void BleCommandCharacteristic::SetNotifier(
+    BleNotifierInterface *const notifier) {
+  notifier_ = notifier;
+}
+
+BleStatusCharacteristic::BleStatusCharacteristic(
+    esp_bt_uuid_t characteristic_uuid, esp_gatt_char_prop_t property)
+    : BleCharacteristicInterface(),
+      characteristic_uuid_(characteristic_uuid),
+      property_(property),
+      handle_(0),
+      notifier_(nullptr),
+      mux_(portMUX_INITIALIZER_UNLOCKED),
+      value_() {}
+
+size_t BleStatusCharacteristic::Read(MutableByteSpan data) {
+  if (data.size() < VALUE_LENGTH) {
+    return 0;
+  }
+  portENTER_CRITICAL(&mux_);
+  std::copy(value_.begin(), value_.end(), data.begin());
+  portEXIT_CRITICAL(&mux_);
+  return VALUE_LENGTH;
+}
+
+std::array<uint8_t, BleStatusCharacteristic::VALUE_LENGTH>
+BleStatusCharacteristic::EncodeValue(const ClockState &state) {
+  std::array<uint8_t, VALUE_LENGTH> value = {};
+  value[0] = state.status;
+  value[1] = state.hour;
+  value[2] = state.minute;
+  value[3] = state.hour_move_result;
+  value[4] = state.minute_move_result;
+  size_t index = 5;
+  for (const int32_t position : {state.hour_pos, state.minute_pos}) {
+    index += StoreBigEndian(position, &value[index]);
+  }
+  return value;
+}
+
+void BleStatusCharacteristic::OnClockStateChanged(const ClockState &state) {
+  const std::array<uint8_t, VALUE_LENGTH> value = EncodeValue(state);
+
+  portENTER_CRITICAL(&mux_);
+  value_ = value;
+  portEXIT_CRITICAL(&mux_);
+
+  // 送信はBLE側で行う (移動の処理を待たせない)
+  if (notifier_) {
+    notifier_->ScheduleNotify(handle_);
+  }
+}
+
+void BleStatusCharacteristic::SetHandle(const uint16_t handle) {
+  handle_ = handle;
+}
+
+uint16_t BleStatusCharacteristic::GetHandle() const { return handle_; }
+
+esp_bt_uuid_t BleStatusCharacteristic::GetUuid() const {
+  return characteristic_uuid_;
+}
+
+esp_gatt_char_prop_t BleStatusCharacteristic::GetProperty() const {
+  return property_;
+}
+
+void BleStatusCharacteristic::SetNotifier(BleNotifierInterface *const notifier) {
+  notifier_ = notifier;
+}
+
 BleClockService::BleClockService(const uint16_t app_id,
-                                 esp_bt_uuid_t service_uuid,
-                                 const uint16_t handle_num)
+                                 esp_bt_uuid_t service_uuid)
     : BleServiceInterface(),
       app_id_(app_id),
       gatts_if_(0),
-      gatts_handle_num_(handle_num)  // 必要なハンドルの数(Attribute数)
-      ,
       service_uuid_(service_uuid),
-      characteristics_() {}
+      entries_(),
+      attribute_table_(),
+      attribute_refs_(),
+      base_handle_(0),
+      mux_(portMUX_INITIALIZER_UNLOCKED),
+      connections_(),
+      connection_timer_(nullptr),
+      notify_timer_(nullptr),
+      notify_buffer_(),
+      skipped_notify_count_(0) {
+  for (Connection &connection : connections_) {
+    connection.is_used = false;
+    connection.prepare_buffer.reserve(ESP_GATT_MAX_ATTR_LEN);
+    connection.prepare_status = ESP_GATT_OK;
+  }
+}
 
 void BleClockService::GattsEvent(esp_gatts_cb_event_t event,
                                  esp_gatt_if_t gatts_if,
@@ -134,30 +533,95 @@ void BleClockService::GattsEvent(esp_gatts_cb_event_t event,
     ESP_LOGI(TAG, "REGISTER_APP_EVT, status %d, app_id %d", param->reg.status,
              param->reg.app_id);
 
-    esp_gatt_srvc_id_t service_id = {
-        .id = {.uuid = service_uuid_, .inst_id = 0x00}, .is_primary = true};
-    esp_ble_gatts_create_service(gatts_if, &service_id, gatts_handle_num_);
+    const esp_timer_create_args_t connection_timer_args = {
+        .callback = ConnectionTimerCallback,
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "ble_conn",
+        .skip_unhandled_events = true,
+    };
+    const esp_timer_create_args_t notify_timer_args = {
+        .callback = NotifyTimerCallback,
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "ble_notify",
+        .skip_unhandled_events = true,
+    };
+    if (esp_timer_create(&connection_timer_args, &connection_timer_) !=
+            ESP_OK ||
+        esp_timer_create(&notify_timer_args, &notify_timer_) != ESP_OK) {
+      ESP_LOGE(TAG, "Failed create timer");
+    }
+
+    CreateAttributeTable(gatts_if);
+
+  } else if (event == ESP_GATTS_CREAT_ATTR_TAB_EVT) {
+    ESP_LOGI(TAG, "CREAT_ATTR_TAB_EVT, status %d, num_handle %d",
+             param->add_attr_tab.status, param->add_attr_tab.num_handle);
+    if (param->add_attr_tab.status != ESP_GATT_OK ||
+        param->add_attr_tab.num_handle != attribute_table_.size()) {
+      ESP_LOGE(TAG, "Failed Create Attribute Table");
+      return;
+    }
+    OnAttributeTableCreated(param->add_attr_tab.handles,
+                            param->add_attr_tab.num_handle);
 
   } else if (event == ESP_GATTS_READ_EVT) {
     ESP_LOGI(TAG, "GATT_READ_EVT, conn_id %d, trans_id %" PRIu32 ", handle %d",
              param->read.conn_id, param->read.trans_id, param->read.handle);
+    OnConnectionActivity(param->read.conn_id);
 
-    for (BleCharacteristicInterfaceSharedPtr bleCharacteristic :
-         characteristics_) {
-      if (bleCharacteristic->GetHandle() == param->read.handle) {
-        std::vector<uint8_t> data;
-        bleCharacteristic->Read(&data);
+    // BTCタスクのみが変更するため読み出しは排他不要
+    const Connection *const connection = FindConnection(param->read.conn_id);
+    const Entry *const cccd_entry =
+        FindEntry(param->read.handle, ATTRIBUTE_CCCD);
+    if (cccd_entry && connection) {
+      // CCCD [値(uint16_t)] リトルエンディアン
+      const uint16_t cccd_value =
+          connection->cccd_values[cccd_entry - entries_.data()];
+      esp_gatt_rsp_t rsp = {
+          .attr_value = {.value = {},
+                         .handle = param->read.handle,
+                         .offset = 0,
+                         .len = sizeof(uint16_t),
+                         .auth_req = 0}};
+      rsp.attr_value.value[0] = static_cast<uint8_t>(cccd_value);
+      rsp.attr_value.value[1] = static_cast<uint8_t>(cccd_value >> 8);
+      esp_ble_gatts_send_response(gatts_if, param->read.conn_id,
+                                  param->read.trans_id, ESP_GATT_OK, &rsp);
+      return;
+    }
 
-        esp_gatt_rsp_t rsp = {
-            .attr_value = {.value = {},
-                           .handle = param->read.handle,
-                           .offset = 0,
-                           .len = static_cast<uint16_t>(data.size()),
-                           .auth_req = 0}};
-        std::memcpy(rsp.attr_value.value, data.data(), data.size());
+    const Entry *const entry = FindEntry(param->read.handle, ATTRIBUTE_VALUE);
+    if (entry) {
+      // 応答の領域へ直接読み出す
+      esp_gatt_rsp_t rsp = {
+          .attr_value = {.value = {},
+                         .handle = param->read.handle,
+                         .offset = param->read.offset,
+                         .len = 0,
+                         .auth_req = 0}};
+      const size_t length = entry->characteristic->ReadFor(
+          param->read.conn_id, MutableByteSpan(rsp.attr_value.value));
+
+      // Read Blob (長い読み出し) は指定位置から1パケット分を返す
+      const size_t offset = param->read.offset;
+      if (length < offset) {
         esp_ble_gatts_send_response(gatts_if, param->read.conn_id,
-                                    param->read.trans_id, ESP_GATT_OK, &rsp);
+                                    param->read.trans_id,
+                                    ESP_GATT_INVALID_OFFSET, nullptr);
+        return;
+      }
+      const uint16_t mtu =
+          connection ? connection->mtu : ESP_GATT_DEF_BLE_MTU_SIZE;
+      rsp.attr_value.len = static_cast<uint16_t>(
+          std::min<size_t>(length - offset, static_cast<size_t>(mtu - 1)));
+      if (offset != 0) {
+        std::memmove(rsp.attr_value.value, rsp.attr_value.value + offset,
+                     rsp.attr_value.len);
       }
+      esp_ble_gatts_send_response(gatts_if, param->read.conn_id,
+                                  param->read.trans_id, ESP_GATT_OK, &rsp);
     }
 
   } else if (event == ESP_GATTS_WRITE_EVT) {
@@ -166,14 +630,68 @@ void BleClockService::GattsEvent(esp_gatts_cb_event_t event,
              ", handle %d, need_resp %d",
              param->write.conn_id, param->write.trans_id, param->write.handle,
              param->write.need_rsp ? 1 : 0);
+    OnConnectionActivity(param->write.conn_id);
+
+    Connection *const connection = FindConnection(param->write.conn_id);
+    const Entry *const cccd_entry =
+        FindEntry(param->write.handle, ATTRIBUTE_CCCD);
+    if (cccd_entry && connection && param->write.len == sizeof(uint16_t)) {
+      const uint16_t value = static_cast<uint16_t>(
+          param->write.value[0] | (param->write.value[1] << 8));
+      portENTER_CRITICAL(&mux_);
+      connection->cccd_values[cccd_entry - entries_.data()] = value;
+      portEXIT_CRITICAL(&mux_);
+      ESP_LOGI(TAG, "CCCD conn_id:%d handle:%d notify:%d indicate:%d",
+               param->write.conn_id, cccd_entry->cccd_handle,
+               (value & 0x0001) ? 1 : 0, (value & 0x0002) ? 1 : 0);
+    }
 
-    for (BleCharacteristicInterfaceSharedPtr bleCharacteristic :
-         characteristics_) {
-      if (bleCharacteristic->GetHandle() == param->write.handle) {
-        std::vector<uint8_t> data(param->write.value,
-                                  param->write.value + param->write.len);
-        bleCharacteristic->Write(&data);
+    if (param->write.is_prep && connection) {
+      // Prepared Write: Execute Writeまで蓄積し、受信値をそのまま応答する
+      // 失敗した場合は蓄積を破棄し、Execute Writeまで以降の分も受け付けない
+      esp_gatt_status_t status = connection->prepare_status;
+      const size_t end = param->write.offset + param->write.len;
+      if (status != ESP_GATT_OK) {
+      } else if (connection->prepare_handle != 0 &&
+                 connection->prepare_handle != param->write.handle) {
+        status = ESP_GATT_ERROR;
+      } else if (ESP_GATT_MAX_ATTR_LEN < end) {
+        status = ESP_GATT_INVALID_ATTR_LEN;
+      } else {
+        connection->prepare_handle = param->write.handle;
+        if (connection->prepare_buffer.size() < end) {
+          connection->prepare_buffer.resize(end);
+        }
+        std::memcpy(connection->prepare_buffer.data() + param->write.offset,
+                    param->write.value, param->write.len);
       }
+      if (status != ESP_GATT_OK) {
+        connection->prepare_buffer.clear();
+        connection->prepare_handle = 0;
+        connection->prepare_status = status;
+      }
+      if (param->write.need_rsp) {
+        esp_gatt_rsp_t rsp = {
+            .attr_value = {.value = {},
+                           .handle = param->write.handle,
+                           .offset = param->write.offset,
+                           .len = param->write.len,
+                           .auth_req = 0}};
+        std::memcpy(rsp.attr_value.value, param->write.value,
+                    std::min<size_t>(param->write.len, ESP_GATT_MAX_ATTR_LEN));
+        esp_ble_gatts_send_response(gatts_if, param->write.conn_id,
+                                    param->write.trans_id, status, &rsp);
+      }
+      return;
+    }
+
+    const Entry *const entry =
+        FindEntry(param->write.handle, ATTRIBUTE_VALUE);
+    if (entry) {
+      // スタックの受信バッファをそのまま渡す
+      entry->characteristic->WriteFrom(
+          param->write.conn_id,
+          ConstByteSpan(param->write.value, param->write.len));
     }
 
     if (param->write.need_rsp) {
@@ -181,82 +699,78 @@ void BleClockService::GattsEvent(esp_gatts_cb_event_t event,
                                   param->write.trans_id, ESP_GATT_OK, nullptr);
     }
 
-  } else if (event == ESP_GATTS_MTU_EVT) {
-    ESP_LOGI(TAG, "ESP_GATTS_MTU_EVT, MTU %d", param->mtu.mtu);
-
-  } else if (event == ESP_GATTS_CREATE_EVT) {
-    ESP_LOGI(TAG, "CREATE_SERVICE_EVT, status %d,  service_handle %d",
-             param->create.status, param->create.service_handle);
-    const uint16_t service_handle = param->create.service_handle;
-    esp_ble_gatts_start_service(service_handle);
-
-    for (BleCharacteristicInterfaceSharedPtr bleCharacteristic :
-         characteristics_) {
-      esp_bt_uuid_t uuid = bleCharacteristic->GetUuid();
-      esp_err_t add_char_ret = esp_ble_gatts_add_char(
-          service_handle, &uuid, ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
-          bleCharacteristic->GetProperty(), nullptr, nullptr);
-      if (add_char_ret) {
-        ESP_LOGE(TAG, "add char failed, error code =%x", add_char_ret);
+  } else if (event == ESP_GATTS_EXEC_WRITE_EVT) {
+    esp_gatt_status_t status = ESP_GATT_OK;
+    Connection *const connection = FindConnection(param->exec_write.conn_id);
+    if (connection) {
+      ESP_LOGI(TAG,
+               "ESP_GATTS_EXEC_WRITE_EVT, conn_id %d, handle %d, length %zu, "
+               "flag %d, status %d",
+               param->exec_write.conn_id, connection->prepare_handle,
+               connection->prepare_buffer.size(),
+               param->exec_write.exec_write_flag, connection->prepare_status);
+      // 中止 (CANCEL) の場合は蓄積を破棄するのみ
+      if (param->exec_write.exec_write_flag == ESP_GATT_PREP_WRITE_EXEC) {
+        status = connection->prepare_status;
+        const Entry *const entry =
+            FindEntry(connection->prepare_handle, ATTRIBUTE_VALUE);
+        // 一部のみ受け付けた値は適用しない
+        if (status == ESP_GATT_OK && entry) {
+          entry->characteristic->WriteFrom(
+              connection->conn_id,
+              ConstByteSpan(connection->prepare_buffer.data(),
+                            connection->prepare_buffer.size()));
+        }
       }
+      connection->prepare_buffer.clear();
+      connection->prepare_handle = 0;
+      connection->prepare_status = ESP_GATT_OK;
     }
+    esp_ble_gatts_send_response(gatts_if, param->exec_write.conn_id,
+                                param->exec_write.trans_id, status, nullptr);
 
-  } else if (event == ESP_GATTS_ADD_CHAR_EVT) {
-    ESP_LOGI(TAG, "GATTS_ADD_CHAR_EVT, status %d, service_handle %d",
-             param->start.status, param->start.service_handle);
-    if (param->start.status != 0) {
-      ESP_LOGE(TAG, "Failed Add Char Event");
-      return;
+  } else if (event == ESP_GATTS_MTU_EVT) {
+    ESP_LOGI(TAG, "ESP_GATTS_MTU_EVT, conn_id %d, MTU %d", param->mtu.conn_id,
+             param->mtu.mtu);
+    portENTER_CRITICAL(&mux_);
+    Connection *const connection = FindConnection(param->mtu.conn_id);
+    if (connection) {
+      connection->mtu = param->mtu.mtu;
     }
+    portEXIT_CRITICAL(&mux_);
 
-    for (BleCharacteristicInterfaceSharedPtr bleCharacteristic :
-         characteristics_) {
-      esp_bt_uuid_t uuid = bleCharacteristic->GetUuid();
-      if (std::memcmp(&uuid, &param->add_char.char_uuid,
-                      sizeof(param->add_char.char_uuid)) == 0) {
-        ESP_LOGI(TAG, "Set Characteristic Handle, handle:%d",
-                 param->start.service_handle);
-        bleCharacteristic->SetHandle(param->start.service_handle);
-      }
+  } else if (event == ESP_GATTS_CONGEST_EVT) {
+    portENTER_CRITICAL(&mux_);
+    Connection *const connection = FindConnection(param->congest.conn_id);
+    if (connection) {
+      connection->is_congested = param->congest.congested;
     }
+    portEXIT_CRITICAL(&mux_);
 
   } else if (event == ESP_GATTS_START_EVT) {
     ESP_LOGI(TAG, "SERVICE_START_EVT, status %d, service_handle %d",
              param->start.status, param->start.service_handle);
 
   } else if (event == ESP_GATTS_CONNECT_EVT) {
-    ESP_LOGI(TAG,
-             "ESP_GATTS_CONNECT_EVT, conn_id %d, remote "
-             "%02x:%02x:%02x:%02x:%02x:%02x:",
-             param->connect.conn_id, param->connect.remote_bda[0],
-             param->connect.remote_bda[1], param->connect.remote_bda[2],
-             param->connect.remote_bda[3], param->connect.remote_bda[4],
-             param->connect.remote_bda[5]);
-
-    esp_ble_conn_update_params_t conn_params = {
-        .bda = {},        // Bluetooth device address
-        .min_int = 0x10,  // Min connection interval 0x10 * 1.25ms = 20ms
-        .max_int = 0x20,  // Max connection interval 0x20 * 1.25ms = 40ms
-        .latency = 0,     // Slave latency for the connection in number of
-                          // connection events. Range: 0x0000 to 0x01F3
-        .timeout = 1000,  // Supervision timeout for the LE Link. (Range:0 -
-                          // 3200) (X * 10msec) 1000 = 10s
-    };
-    std::memcpy(conn_params.bda, param->connect.remote_bda,
-                sizeof(esp_bd_addr_t));
-    esp_ble_gap_update_conn_params(&conn_params);
+    OnConnect(*param);
 
   } else if (event == ESP_GATTS_DISCONNECT_EVT) {
-    ESP_LOGI(TAG, "ESP_GATTS_DISCONNECT_EVT, disconnect reason 0x%x",
-             param->disconnect.reason);
-    BleDevice::GetInstance()->StartAdvertising();
+    OnDisconnect(*param);
 
   } else if (event == ESP_GATTS_CONF_EVT) {
-    ESP_LOGI(TAG, "ESP_GATTS_CONF_EVT, status %d attr_handle %d",
-             param->conf.status, param->conf.handle);
+    ESP_LOGD(TAG, "ESP_GATTS_CONF_EVT, conn_id %d, status %d attr_handle %d",
+             param->conf.conn_id, param->conf.status, param->conf.handle);
     if (param->conf.status != ESP_GATT_OK) {
       esp_log_buffer_hex(TAG, param->conf.value, param->conf.len);
     }
+    // Indicationの確認応答 (Notifyの送信完了でも発生するためハンドルで区別)
+    portENTER_CRITICAL(&mux_);
+    Connection *const connection = FindConnection(param->conf.conn_id);
+    if (connection &&
+        connection->pending_indication_handle == param->conf.handle) {
+      connection->pending_indication_handle = 0;
+    }
+    portEXIT_CRITICAL(&mux_);
 
   } else if (event == ESP_GATTS_RESPONSE_EVT) {
     // ESP_LOGI(TAG, "GATTS_RESPONSE_EVT, status %d service_handle %d",
@@ -267,9 +781,457 @@ void BleClockService::GattsEvent(esp_gatts_cb_event_t event,
   }
 }
 
+void BleClockService::OnConnect(const esp_ble_gatts_cb_param_t &param) {
+  ESP_LOGI(TAG,
+           "ESP_GATTS_CONNECT_EVT, conn_id %d, remote "
+           "%02x:%02x:%02x:%02x:%02x:%02x:",
+           param.connect.conn_id, param.connect.remote_bda[0],
+           param.connect.remote_bda[1], param.connect.remote_bda[2],
+           param.connect.remote_bda[3], param.connect.remote_bda[4],
+           param.connect.remote_bda[5]);
+
+  portENTER_CRITICAL(&mux_);
+  Connection *connection = nullptr;
+  for (Connection &candidate : connections_) {
+    if (!candidate.is_used) {
+      connection = &candidate;
+      break;
+    }
+  }
+  if (connection) {
+    connection->is_used = true;
+    connection->is_congested = false;
+    connection->conn_id = param.connect.conn_id;
+    connection->mtu = ESP_GATT_DEF_BLE_MTU_SIZE;
+    std::memcpy(connection->remote_bda, param.connect.remote_bda,
+                sizeof(esp_bd_addr_t));
+    connection->pending_indication_handle = 0;
+    std::fill(connection->cccd_values.begin(), connection->cccd_values.end(),
+              0);
+    connection->prepare_buffer.clear();
+    connection->prepare_handle = 0;
+    connection->prepare_status = ESP_GATT_OK;
+    connection->policy.Reset(esp_timer_get_time(),
+                             param.connect.conn_params.interval,
+                             param.connect.conn_params.latency,
+                             param.connect.conn_params.timeout);
+  }
+  portEXIT_CRITICAL(&mux_);
+
+  if (connection == nullptr) {
+    // アドバタイズは上限で停止するため通常は起きない
+    ESP_LOGW(TAG, "Connection limit reached > disconnect conn_id %d",
+             param.connect.conn_id);
+    esp_bd_addr_t remote_bda = {};
+    std::memcpy(remote_bda, param.connect.remote_bda, sizeof(esp_bd_addr_t));
+    esp_ble_gap_disconnect(remote_bda);
+    return;
+  }
+
+  // 1パケットのデータ長を最大に (大容量転送の効率化)
+  esp_bd_addr_t remote_bda = {};
+  std::memcpy(remote_bda, param.connect.remote_bda, sizeof(esp_bd_addr_t));
+  esp_ble_gap_set_pkt_data_len(remote_bda, BLE_MAX_DATA_LENGTH);
+
+  // 接続直後は同期等の転送が続くため短い接続間隔を要求する
+  ApplyConnectionPolicy();
+}
+
+void BleClockService::OnDisconnect(const esp_ble_gatts_cb_param_t &param) {
+  ESP_LOGI(TAG, "ESP_GATTS_DISCONNECT_EVT, conn_id %d, reason 0x%x",
+           param.disconnect.conn_id, param.disconnect.reason);
+
+  // 購読は接続毎 (再接続時はクライアントが再設定する)
+  portENTER_CRITICAL(&mux_);
+  Connection *const connection = FindConnection(param.disconnect.conn_id);
+  if (connection) {
+    connection->is_used = false;
+  }
+  portEXIT_CRITICAL(&mux_);
+  for (Entry &entry : entries_) {
+    entry.characteristic->OnDisconnect(param.disconnect.conn_id);
+  }
+}
+
 void BleClockService::AddCharacteristic(
     BleCharacteristicInterfaceSharedPtr bleCharacteristic) {
-  characteristics_.push_back(bleCharacteristic);
+  if (!attribute_table_.empty()) {
+    ESP_LOGE(TAG, "Characteristic added after registration");
+    return;
+  }
+  entries_.push_back(Entry{bleCharacteristic, bleCharacteristic->GetUuid(),
+                           bleCharacteristic->GetProperty(),
+                           bleCharacteristic->GetPermission(), 0, false});
+  if (IsNotifiable(bleCharacteristic->GetProperty())) {
+    bleCharacteristic->SetNotifier(this);
+  }
+}
+
+void BleClockService::CreateAttributeTable(const esp_gatt_if_t gatts_if) {
+  attribute_table_.clear();
+  attribute_table_.reserve(1 + entries_.size() * 3);
+
+  attribute_table_.push_back(MakeAttribute(
+      ESP_GATT_AUTO_RSP, ESP_UUID_LEN_16, &PRIMARY_SERVICE_UUID,
+      ESP_GATT_PERM_READ, service_uuid_.len, service_uuid_.len,
+      &service_uuid_.uuid));
+  for (const Entry &entry : entries_) {
+    attribute_table_.push_back(MakeAttribute(
+        ESP_GATT_AUTO_RSP, ESP_UUID_LEN_16, &CHARACTERISTIC_DECLARATION_UUID,
+        ESP_GATT_PERM_READ, sizeof(entry.property), sizeof(entry.property),
+        &entry.property));
+    // 値は各Characteristicが応答する
+    attribute_table_.push_back(MakeAttribute(
+        ESP_GATT_RSP_BY_APP, entry.uuid.len, &entry.uuid.uuid, entry.permission,
+        ESP_GATT_MAX_ATTR_LEN, 0, nullptr));
+    if (IsNotifiable(entry.property)) {
+      attribute_table_.push_back(MakeAttribute(
+          ESP_GATT_RSP_BY_APP, ESP_UUID_LEN_16, &CLIENT_CONFIG_UUID,
+          entry.permission, sizeof(CLIENT_CONFIG_DEFAULT), sizeof(CLIENT_CONFIG_DEFAULT),
+          CLIENT_CONFIG_DEFAULT));
+    }
+  }
+
+  const esp_err_t ret = esp_ble_gatts_create_attr_tab(
+      attribute_table_.data(), gatts_if,
+      static_cast<uint16_t>(attribute_table_.size()), 0);
+  if (ret != ESP_OK) {
+    ESP_LOGE(TAG, "create attr tab failed, error code =%x", ret);
+  }
+}
+
+void BleClockService::OnAttributeTableCreated(const uint16_t *const handles,
+                                              const uint16_t num_handle) {
+  // 属性テーブルのハンドルは連番で割り当てられる
+  std::vector<AttributeRef> attribute_refs(num_handle,
+                                           AttributeRef{ATTRIBUTE_NONE, 0});
+  size_t index = 1;
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    Entry &entry = entries_[i];
+    const uint8_t entry_index = static_cast<uint8_t>(i);
+    ++index;  // Characteristic宣言
+    entry.characteristic->SetHandle(handles[index]);
+    attribute_refs[index] = AttributeRef{ATTRIBUTE_VALUE, entry_index};
+    ++index;
+    if (IsNotifiable(entry.property)) {
+      entry.cccd_handle = handles[index];
+      attribute_refs[index] = AttributeRef{ATTRIBUTE_CCCD, entry_index};
+      ++index;
+    }
+    ESP_LOGI(TAG, "Set Characteristic Handle, handle:%d cccd:%d",
+             entry.characteristic->GetHandle(), entry.cccd_handle);
+  }
+
+  // 接続毎のCCCDは登録時に確保する (接続時に確保しない)
+  for (Connection &connection : connections_) {
+    connection.cccd_values.assign(entries_.size(), 0);
+  }
+
+  portENTER_CRITICAL(&mux_);
+  base_handle_ = handles[0];
+  attribute_refs_.swap(attribute_refs);
+  portEXIT_CRITICAL(&mux_);
+
+  esp_ble_gatts_start_service(handles[0]);
+}
+
+bool BleClockService::Notify(const uint16_t handle, const uint8_t *const data,
+                             const size_t length) {
+  struct Target {
+    uint16_t conn_id;
+    bool need_confirm;
+  };
+  std::array<Target, CONFIG_BLE_MAX_CONNECTIONS> targets = {};
+  size_t target_count = 0;
+  uint32_t skipped_count = 0;
+
+  portENTER_CRITICAL(&mux_);
+  const Entry *const entry = FindEntry(handle, ATTRIBUTE_VALUE);
+  if (entry) {
+    const size_t entry_index = entry - entries_.data();
+    for (Connection &connection : connections_) {
+      if (!connection.is_used) {
+        continue;
+      }
+      // 購読されていない場合は送信しない (無線の使用を抑える)
+      const uint16_t cccd_value = connection.cccd_values[entry_index];
+      if ((cccd_value & 0x0003) == 0) {
+        continue;
+      }
+      // 輻輳・確認応答待ちの接続は飛ばす (他の接続と送信元を待たせない)
+      const bool need_confirm = (cccd_value & 0x0001) == 0;
+      if (connection.is_congested ||
+          (need_confirm && connection.pending_indication_handle != 0)) {
+        ++skipped_count;
+        continue;
+      }
+      if (need_confirm) {
+        connection.pending_indication_handle = handle;
+      }
+      targets[target_count++] = Target{connection.conn_id, need_confirm};
+    }
+  }
+  skipped_notify_count_ += skipped_count;
+  const uint32_t total_skipped_count = skipped_notify_count_;
+  portEXIT_CRITICAL(&mux_);
+
+  size_t sent_count = 0;
+  for (size_t i = 0; i < target_count; ++i) {
+    if (esp_ble_gatts_send_indicate(
+            gatts_if_, targets[i].conn_id, handle,
+            static_cast<uint16_t>(length), const_cast<uint8_t *>(data),
+            targets[i].need_confirm) == ESP_OK) {
+      ++sent_count;
+    } else if (targets[i].need_confirm) {
+      portENTER_CRITICAL(&mux_);
+      Connection *const connection = FindConnection(targets[i].conn_id);
+      if (connection) {
+        connection->pending_indication_handle = 0;
+      }
+      portEXIT_CRITICAL(&mux_);
+    }
+  }
+  if (0 < skipped_count) {
+    ESP_LOGD(TAG,
+             "Notify skipped > handle:%d %" PRIu32 " connection(s) (total:%" PRIu32
+             ")",
+             handle, skipped_count, total_skipped_count);
+  }
+  return 0 < sent_count;
+}
+
+void BleClockService::ScheduleNotify(const uint16_t handle) {
+  portENTER_CRITICAL(&mux_);
+  Entry *const entry = FindEntry(handle, ATTRIBUTE_VALUE);
+  if (entry) {
+    entry->is_notify_scheduled = true;
+  }
+  portEXIT_CRITICAL(&mux_);
+  if (entry && notify_timer_ && !esp_timer_is_active(notify_timer_)) {
+    esp_timer_start_once(notify_timer_, 0);
+  }
+}
+
+void BleClockService::SendScheduledNotifications() {
+  for (Entry &entry : entries_) {
+    portENTER_CRITICAL(&mux_);
+    const bool is_scheduled = entry.is_notify_scheduled;
+    entry.is_notify_scheduled = false;
+    portEXIT_CRITICAL(&mux_);
+    if (!is_scheduled) {
+      continue;
+    }
+    // 予約後に更新された場合も最新の値を1回だけ送る
+    const size_t length = entry.characteristic->Read(notify_buffer_);
+    Notify(entry.characteristic->GetHandle(), notify_buffer_.data(), length);
+  }
+}
+
+void BleClockService::NotifyTimerCallback(void *arg) {
+  static_cast<BleClockService *>(arg)->SendScheduledNotifications();
+}
+
+size_t BleClockService::GetMaxNotifyLength() const {
+  // 全ての接続で送信できる長さ
+  uint16_t mtu = ESP_GATT_MAX_MTU_SIZE;
+  bool is_connected = false;
+  portENTER_CRITICAL(&mux_);
+  for (const Connection &connection : connections_) {
+    if (connection.is_used) {
+      mtu = std::min(mtu, connection.mtu);
+      is_connected = true;
+    }
+  }
+  portEXIT_CRITICAL(&mux_);
+  // ATTヘッダ(Opcode + Handle)を除く
+  return (is_connected ? mtu : ESP_GATT_DEF_BLE_MTU_SIZE) - 3;
+}
+
+bool BleClockService::IsSendable() const {
+  std::array<uint16_t, CONFIG_BLE_MAX_CONNECTIONS> conn_ids = {};
+  size_t count = 0;
+  bool is_congested = false;
+  portENTER_CRITICAL(&mux_);
+  for (const Connection &connection : connections_) {
+    if (connection.is_used) {
+      conn_ids[count++] = connection.conn_id;
+      is_congested = is_congested || connection.is_congested;
+    }
+  }
+  portEXIT_CRITICAL(&mux_);
+  if (count == 0 || is_congested) {
+    return false;
+  }
+  // 最も遅い接続に合わせる (通知は全接続へ送信するため)
+  for (size_t i = 0; i < count; ++i) {
+    if (esp_ble_get_cur_sendable_packets_num(conn_ids[i]) == 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+BleClockService::Connection *BleClockService::FindConnection(
+    const uint16_t conn_id) {
+  for (Connection &connection : connections_) {
+    if (connection.is_used && connection.conn_id == conn_id) {
+      return &connection;
+    }
+  }
+  return nullptr;
+}
+
+BleClockService::Entry *BleClockService::FindEntry(
+    const uint16_t handle, const AttributeKind kind) {
+  if (handle < base_handle_) {
+    return nullptr;
+  }
+  const size_t index = handle - base_handle_;
+  if (attribute_refs_.size() <= index) {
+    return nullptr;
+  }
+  const AttributeRef &ref = attribute_refs_[index];
+  if (ref.kind != kind) {
+    return nullptr;
+  }
+  return &entries_[ref.entry_index];
+}
+
+void BleClockService::GapEvent(esp_gap_ble_cb_event_t event,
+                               esp_ble_gap_cb_param_t *param) {
+  if (event != ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT) {
+    return;
+  }
+  const bool is_success =
+      param->update_conn_params.status == ESP_BT_STATUS_SUCCESS;
+  bool is_target = false;
+  uint16_t conn_id = 0;
+  BleConnectionPolicy::Stats stats = {};
+  portENTER_CRITICAL(&mux_);
+  for (Connection &connection : connections_) {
+    if (connection.is_used &&
+        std::memcmp(connection.remote_bda, param->update_conn_params.bda,
+                    sizeof(esp_bd_addr_t)) == 0) {
+      connection.policy.OnUpdated(is_success,
+                                  param->update_conn_params.conn_int,
+                                  param->update_conn_params.latency,
+                                  param->update_conn_params.timeout);
+      stats = connection.policy.GetStats();
+      conn_id = connection.conn_id;
+      is_target = true;
+      break;
+    }
+  }
+  portEXIT_CRITICAL(&mux_);
+  if (!is_target) {
+    return;
+  }
+
+  ESP_LOGI(TAG,
+           "Connection params %s > conn_id:%d phase:%s interval:%" PRIu32
+           "us latency:%d timeout:%dms max delay:%" PRIu32
+           "ms events:%" PRIu32 "/min (update:%" PRIu32 " reject:%" PRIu32
+           ")",
+           is_success ? "updated" : "rejected", conn_id,
+           BleConnectionPolicy::GetPhaseName(stats.phase),
+           static_cast<uint32_t>(stats.interval) * 1250, stats.latency,
+           stats.timeout * 10, stats.max_latency_ms, stats.events_per_minute,
+           stats.update_count, stats.reject_count);
+
+  // 結果待ちの間に段階が変わっている場合がある
+  ApplyConnectionPolicy();
+}
+
+void BleClockService::RequestFastConnection() {
+  // 通知は全接続へ送信するため全ての接続を対象とする
+  const int64_t now_us = esp_timer_get_time();
+  portENTER_CRITICAL(&mux_);
+  for (Connection &connection : connections_) {
+    if (connection.is_used) {
+      connection.policy.OnActivity(now_us);
+    }
+  }
+  portEXIT_CRITICAL(&mux_);
+  ApplyConnectionPolicy();
+}
+
+void BleClockService::OnConnectionActivity(const uint16_t conn_id) {
+  portENTER_CRITICAL(&mux_);
+  Connection *const connection = FindConnection(conn_id);
+  if (connection) {
+    connection->policy.OnActivity(esp_timer_get_time());
+  }
+  portEXIT_CRITICAL(&mux_);
+  ApplyConnectionPolicy();
+}
+
+void BleClockService::ApplyConnectionPolicy() {
+  std::array<esp_ble_conn_update_params_t, CONFIG_BLE_MAX_CONNECTIONS>
+      requests = {};
+  size_t request_count = 0;
+  int64_t next_check_delay_us = -1;
+  const int64_t now_us = esp_timer_get_time();
+  portENTER_CRITICAL(&mux_);
+  for (Connection &connection : connections_) {
+    if (!connection.is_used) {
+      continue;
+    }
+    BleConnectionParams request = {};
+    if (connection.policy.Poll(now_us, &request)) {
+      esp_ble_conn_update_params_t &conn_params = requests[request_count++];
+      std::memcpy(conn_params.bda, connection.remote_bda,
+                  sizeof(esp_bd_addr_t));
+      conn_params.min_int = request.min_interval;
+      conn_params.max_int = request.max_interval;
+      conn_params.latency = request.latency;
+      conn_params.timeout = request.timeout;
+    }
+    const int64_t delay_us = connection.policy.GetNextCheckDelayUs(now_us);
+    if (0 < delay_us &&
+        (next_check_delay_us < 0 || delay_us < next_check_delay_us)) {
+      next_check_delay_us = delay_us;
+    }
+  }
+  portEXIT_CRITICAL(&mux_);
+
+  for (size_t i = 0; i < request_count; ++i) {
+    const esp_err_t ret = esp_ble_gap_update_conn_params(&requests[i]);
+    if (ret != ESP_OK) {
+      ESP_LOGE(TAG, "update conn params failed, error code =%x", ret);
+      // 結果は通知されないため拒否として扱う
+      portENTER_CRITICAL(&mux_);
+      for (Connection &connection : connections_) {
+        if (connection.is_used &&
+            std::memcmp(connection.remote_bda, requests[i].bda,
+                        sizeof(esp_bd_addr_t)) == 0) {
+          const BleConnectionPolicy::Stats stats =
+              connection.policy.GetStats();
+          connection.policy.OnUpdated(false, stats.interval, stats.latency,
+                                      stats.timeout);
+        }
+      }
+      portEXIT_CRITICAL(&mux_);
+    }
+  }
+
+  // 接続のうち最も早い段階の移行時刻に再評価する
+  // 動作中のタイマーより早い場合 (新しい接続等) があるため常に張り直す
+  if (connection_timer_) {
+    esp_timer_stop(connection_timer_);
+    if (0 < next_check_delay_us) {
+      esp_timer_start_once(connection_timer_,
+                           static_cast<uint64_t>(next_check_delay_us));
+    }
+  }
+}
+
+void BleClockService::ConnectionTimerCallback(void *arg) {
+  static_cast<BleClockService *>(arg)->ApplyConnectionPolicy();
+}
+
+bool BleClockService::IsNotifiable(const esp_gatt_char_prop_t property) {
+  return (property & (ESP_GATT_CHAR_PROP_BIT_NOTIFY |
+                      ESP_GATT_CHAR_PROP_BIT_INDICATE)) != 0;
 }
 
 void BleClockService::SetGattsIf(const uint16_t gatts_if) {
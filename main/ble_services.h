@@ -10,64 +10,270 @@
 #include <esp_gap_ble_api.h>
 #include <esp_gatt_common_api.h>
 #include <esp_gatts_api.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
 
+#include <array>
 #include <vector>
 
+#include "ble_connection_policy.h"
 #include "ble_device.h"
+#include "ble_uuid.h"
+#include "command_protocol.h"
 #include "hare_tortoise_clock_interface.h"
 
 namespace HareTortoiseClockSystem {
 
+/// BLE Service・CharacteristicのUUID
+constexpr BleUuid128 CLOCK_SERVICE_UUID("f5c85862-dd4b-4874-9089-3b9e8bcb7099");
+constexpr BleUuid128 TIME_CHARACTERISTIC_UUID(
+    "157c64df-ca4b-4647-b26b-4ddc2ab42797");
+constexpr BleUuid128 TIME_SYNC_CHARACTERISTIC_UUID(
+    "4a9c1f3e-7b2d-4c8e-a6f1-2e5d8b9c0a17");
+constexpr BleUuid128 COMMAND_CHARACTERISTIC_UUID(
+    "bd902d82-f4bd-45c8-baf8-040b3d877abe");
+constexpr BleUuid128 STATUS_CHARACTERISTIC_UUID(
+    "8e3f5a21-6c4d-4b7e-9a12-3d5c7e9f1b60");
+/// 設定で有効な場合のみ登録する
+constexpr BleUuid128 TELEMETRY_CHARACTERISTIC_UUID(
+    "2d7e4c19-8a3b-4f56-b1c2-9e0d6a5f7b34");
+constexpr BleUuid128 OTA_CHARACTERISTIC_UUID(
+    "6b1e9d47-3c25-4a8f-9e60-c4d2b7a1f853");
+
 class BleTimeCharacteristic final : public BleCharacteristicInterface {
  public:
   BleTimeCharacteristic(
       esp_bt_uuid_t characteristic_uuid, esp_gatt_char_prop_t property,
       const HareTortoiseClockInterfaceWeakPtr hare_tortoise_clock_interface);
 
-  void Write(const std::vector<uint8_t> *const data) override;
-  void Read(std::vector<uint8_t> *const data) override;
+  void Write(ConstByteSpan data) override;
+  size_t Read(MutableByteSpan data) override;
+
+  void SetHandle(const uint16_t handle) override;
+  uint16_t GetHandle() const override;
+  esp_bt_uuid_t GetUuid() const override;
+  esp_gatt_char_prop_t GetProperty() const override;
+
+ private:
+  const esp_bt_uuid_t characteristic_uuid_;
+  const esp_gatt_char_prop_t property_;
+  uint16_t handle_;
+  const HareTortoiseClockInterfaceWeakPtr hare_tortoise_clock_interface_;
+};
+
+/// NTP方式の時刻同期 (マイクロ秒精度)
+/// Write [0x01][t1] : 同期要求 (t1:クライアント送信時刻) 受信時刻t2を記録
+/// Read  [t1][t2][t3] : t3:応答送信時刻
+/// Write [0x02][offset] : 補正量(クライアント時刻 - デバイス時刻)を反映
+/// 値はすべてUnix時間(us)のint64_t ビッグエンディアン
+/// t1・t2は接続毎に記録する (同時に接続した端末の同期要求が混ざらないように)
+class BleTimeSyncCharacteristic final : public BleCharacteristicInterface {
+ public:
+  enum Operation : uint8_t {
+    OPERATION_REQUEST = 1,
+    OPERATION_ADJUST = 2,
+  };
+
+  BleTimeSyncCharacteristic(
+      esp_bt_uuid_t characteristic_uuid, esp_gatt_char_prop_t property,
+      const HareTortoiseClockInterfaceWeakPtr hare_tortoise_clock_interface);
+
+  /// 接続を区別できないため応答しない (WriteFrom・ReadForを使う)
+  void Write(ConstByteSpan data) override {}
+  size_t Read(MutableByteSpan data) override { return 0; }
+  void WriteFrom(const uint16_t conn_id, ConstByteSpan data) override;
+  size_t ReadFor(const uint16_t conn_id, MutableByteSpan data) override;
+  void OnDisconnect(const uint16_t conn_id) override;
 
   void SetHandle(const uint16_t handle) override;
   uint16_t GetHandle() const override;
   esp_bt_uuid_t GetUuid() const override;
   esp_gatt_char_prop_t GetProperty() const override;
 
+ private:
+  /// 接続毎の同期要求
+  struct Request {
+    bool is_used;
+    uint16_t conn_id;
+    int64_t client_send_us;
+    int64_t receive_us;
+  };
+
+  /// is_used=falseの場合は空きを検索する
+  Request *FindRequest(const uint16_t conn_id, const bool is_used = true);
+
  private:
   const esp_bt_uuid_t characteristic_uuid_;
   const esp_gatt_char_prop_t property_;
   uint16_t handle_;
   const HareTortoiseClockInterfaceWeakPtr hare_tortoise_clock_interface_;
+  /// GATTSのイベント (BTCタスク) からのみ参照する
+  std::array<Request, CONFIG_BLE_MAX_CONNECTIONS> requests_;
 };
 
+/// コマンド (Write / Write Without Response / Notify)
+/// 1byteの場合は従来のコマンド (1:再起動 2:緊急停止)
+/// それ以外は一括コマンド形式 (CommandProtocol) 結果は1回のNotifyで応答する
 class BleCommandCharacteristic final : public BleCharacteristicInterface {
  public:
+  /// 応答の最大長 (通知できる長さが短い場合はそちらに合わせる)
+  static constexpr size_t RESPONSE_MAX_LENGTH = 128;
+
   BleCommandCharacteristic(
       esp_bt_uuid_t characteristic_uuid, esp_gatt_char_prop_t property,
       const HareTortoiseClockInterfaceWeakPtr hare_tortoise_clock_interface);
 
-  void Write(const std::vector<uint8_t> *const data) override;
-  void Read(std::vector<uint8_t> *const data) override {}
+  void Write(ConstByteSpan data) override;
+  size_t Read(MutableByteSpan data) override { return 0; }
 
   void SetHandle(const uint16_t handle) override;
   uint16_t GetHandle() const override;
   esp_bt_uuid_t GetUuid() const override;
   esp_gatt_char_prop_t GetProperty() const override;
+  void SetNotifier(BleNotifierInterface *const notifier) override;
+
+ private:
+  /// 1フレーム内で引き継ぐ値
+  struct FrameContext {
+    Choreography choreography;
+    uint16_t hour_hz;
+    uint16_t minute_hz;
+  };
+
+  void ExecuteLegacy(const uint8_t cmd);
+  void ExecuteFrame(ConstByteSpan data);
+  CommandProtocol::Result Execute(const CommandProtocol::Tlv &tlv,
+                                  FrameContext *const context,
+                                  CommandProtocol::Writer *const writer);
+  CommandProtocol::Result SubmitChoreography(
+      FrameContext *const context, const uint8_t repeat,
+      CommandProtocol::Writer *const writer);
 
  private:
   const esp_bt_uuid_t characteristic_uuid_;
   const esp_gatt_char_prop_t property_;
   uint16_t handle_;
+  BleNotifierInterface *notifier_;
   const HareTortoiseClockInterfaceWeakPtr hare_tortoise_clock_interface_;
+  /// 応答の組み立て (BLEスレッドのみ利用)
+  std::array<uint8_t, RESPONSE_MAX_LENGTH> response_buffer_;
+};
+
+/// 時計の状態 (Read / Notify 変化した場合のみ通知)
+/// [状態][時][分][時針の移動結果][分針の移動結果][時針位置][分針位置]
+/// 位置はint32_t(step) ビッグエンディアン
+class BleStatusCharacteristic final : public BleCharacteristicInterface,
+                                      public ClockStateListenerInterface {
+ public:
+  static constexpr size_t VALUE_LENGTH = 13;
+
+  /// 状態を値の形式に変換
+  static std::array<uint8_t, VALUE_LENGTH> EncodeValue(
+      const ClockState &state);
+
+  BleStatusCharacteristic(esp_bt_uuid_t characteristic_uuid,
+                          esp_gatt_char_prop_t property);
+
+  void Write(ConstByteSpan data) override {}
+  size_t Read(MutableByteSpan data) override;
+
+  void SetHandle(const uint16_t handle) override;
+  uint16_t GetHandle() const override;
+  esp_bt_uuid_t GetUuid() const override;
+  esp_gatt_char_prop_t GetProperty() const override;
+  void SetNotifier(BleNotifierInterface *const notifier) override;
+
+  /// 時計タスクから呼び出し (通知は予約のみで待たない)
+  void OnClockStateChanged(const ClockState &state) override;
+
+ private:
+  const esp_bt_uuid_t characteristic_uuid_;
+  const esp_gatt_char_prop_t property_;
+  uint16_t handle_;
+  BleNotifierInterface *notifier_;
+  /// value_の排他 (時計タスクとBTCタスク)
+  portMUX_TYPE mux_;
+  std::array<uint8_t, VALUE_LENGTH> value_;
 };
 
-class BleClockService final : public BleServiceInterface {
+/// 属性テーブルで一括登録するService
+/// Characteristicの追加はBleDevice::AddService(登録)より前に行う
+/// 最大CONFIG_BLE_MAX_CONNECTIONSの接続を同時に扱い、通知は購読中の全接続へ送信する
+class BleClockService final : public BleServiceInterface,
+                              public BleNotifierInterface {
  public:
-  BleClockService(const uint16_t app_id, esp_bt_uuid_t service_uuid,
-                  const uint16_t handle_num);
+  BleClockService(const uint16_t app_id, esp_bt_uuid_t service_uuid);
+
+  bool Notify(const uint16_t handle, const uint8_t *const data,
+              const size_t length) override;
+  void ScheduleNotify(const uint16_t handle) override;
+  size_t GetMaxNotifyLength() const override;
+  bool IsSendable() const override;
+  void RequestFastConnection() override;
+
+ private:
+  /// Characteristic毎の属性 (属性テーブルが値を参照するため登録後は移動しない)
+  struct Entry {
+    BleCharacteristicInterfaceSharedPtr characteristic;
+    esp_bt_uuid_t uuid;
+    esp_gatt_char_prop_t property;
+    esp_gatt_perm_t permission;
+    uint16_t cccd_handle;
+    /// ScheduleNotifyで予約された通知
+    bool is_notify_scheduled;
+  };
+  /// ハンドルの参照先
+  enum AttributeKind : uint8_t {
+    ATTRIBUTE_NONE,
+    ATTRIBUTE_VALUE,
+    ATTRIBUTE_CCCD,
+  };
+  struct AttributeRef {
+    AttributeKind kind;
+    uint8_t entry_index;
+  };
+  /// 接続毎の状態
+  struct Connection {
+    bool is_used;
+    bool is_congested;
+    uint16_t conn_id;
+    uint16_t mtu;
+    esp_bd_addr_t remote_bda;
+    /// 確認応答待ちのIndicationのハンドル (0:なし ATTでは同時に1つまで)
+    uint16_t pending_indication_handle;
+    /// CCCDの値 (entries_と同じ順) bit0:Notify bit1:Indicate
+    std::vector<uint16_t> cccd_values;
+    /// Prepared Write (長い書き込み) の受信バッファと対象ハンドル
+    std::vector<uint8_t> prepare_buffer;
+    uint16_t prepare_handle;
+    /// Prepared Writeの失敗 (Execute Writeで応答し、蓄積した値は適用しない)
+    esp_gatt_status_t prepare_status;
+    /// 接続パラメータの方針
+    BleConnectionPolicy policy;
+  };
+
+  void CreateAttributeTable(const esp_gatt_if_t gatts_if);
+  void OnAttributeTableCreated(const uint16_t *const handles,
+                               const uint16_t num_handle);
+  Entry *FindEntry(const uint16_t handle, const AttributeKind kind);
+  Connection *FindConnection(const uint16_t conn_id);
+  static bool IsNotifiable(const esp_gatt_char_prop_t property);
+
+  void OnConnect(const esp_ble_gatts_cb_param_t &param);
+  void OnDisconnect(const esp_ble_gatts_cb_param_t &param);
+  void OnConnectionActivity(const uint16_t conn_id);
+  /// 接続パラメータの方針を評価し、必要であれば変更を要求する
+  void ApplyConnectionPolicy();
+  static void ConnectionTimerCallback(void *arg);
+  /// 予約された通知の送信 (esp_timerタスク)
+  void SendScheduledNotifications();
+  static void NotifyTimerCallback(void *arg);
 
  private:
   void GattsEvent(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,
                   esp_ble_gatts_cb_param_t *param) override;
+  void GapEvent(esp_gap_ble_cb_event_t event,
+                esp_ble_gap_cb_param_t *param) override;
   void AddCharacteristic(
       BleCharacteristicInterfaceSharedPtr bleCharacteristic) override;
 
@@ -78,9 +284,24 @@ class BleClockService final : public BleServiceInterface {
  private:
   const uint16_t app_id_;
   uint16_t gatts_if_;
-  uint16_t gatts_handle_num_;
   esp_bt_uuid_t service_uuid_;
-  std::vector<BleCharacteristicInterfaceSharedPtr> characteristics_;
+  std::vector<Entry> entries_;
+  /// 登録する属性テーブル (Service宣言, [宣言, 値, (CCCD)] x Characteristic)
+  std::vector<esp_gatts_attr_db_t> attribute_table_;
+  /// ハンドルから参照先への直接索引 (index = handle - base_handle_)
+  std::vector<AttributeRef> attribute_refs_;
+  uint16_t base_handle_;
+  /// connections_・entries_の予約の排他 (Notifyは他のタスクから呼び出される)
+  mutable portMUX_TYPE mux_;
+  std::array<Connection, CONFIG_BLE_MAX_CONNECTIONS> connections_;
+  /// 次の段階への移行時刻に評価するタイマー
+  esp_timer_handle_t connection_timer_;
+  /// 予約された通知を送信するタイマー (呼び出し元を待たせない)
+  esp_timer_handle_t notify_timer_;
+  /// 予約した通知の値の読み出し先 (Read/Writeはスタックのバッファを直接使う)
+  std::array<uint8_t, ESP_GATT_MAX_ATTR_LEN> notify_buffer_;
+  /// 輻輳・確認応答待ちで送信しなかった通知の数
+  uint32_t skipped_notify_count_;
 };
 
 }  // namespace HareTortoiseClockSystem
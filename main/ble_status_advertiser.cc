@@ -0,0 +1,72 @@
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include "ble_status_advertiser.h"
+
+#include <algorithm>
+
+#include "ble_device.h"
+#include "logger.h"
+#include "util.h"
+#include "version.h"
+
+namespace HareTortoiseClockSystem {
+
+BleStatusAdvertiser::BleStatusAdvertiser(
+    const HareTortoiseClockInterfaceWeakPtr hare_tortoise_clock_interface)
+    : hare_tortoise_clock_interface_(hare_tortoise_clock_interface),
+      version_hash_(StatusBeacon::CalcVersionHash(GIT_VERSION)),
+      mux_(portMUX_INITIALIZER_UNLOCKED),
+      clock_state_(),
+      data_(),
+      is_data_set_(false) {}
+
+void BleStatusAdvertiser::OnClockStateChanged(const ClockState &state) {
+  portENTER_CRITICAL(&mux_);
+  clock_state_ = state;
+  portEXIT_CRITICAL(&mux_);
+}
+
+void BleStatusAdvertiser::Update() {
+  HareTortoiseClockInterfaceSharedPtr hare_tortoise_clock =
+      hare_tortoise_clock_interface_.lock();
+  if (!hare_tortoise_clock) {
+    return;
+  }
+  const HareTortoiseClockInterface::TimeSyncState sync_state =
+      hare_tortoise_clock->GetTimeSyncState();
+  portENTER_CRITICAL(&mux_);
+  const ClockState clock_state = clock_state_;
+  portEXIT_CRITICAL(&mux_);
+
+  StatusBeacon::Status status = {};
+  status.clock_status = clock_state.status;
+  status.sync_hops =
+      sync_state.is_synced
+          ? std::min<uint8_t>(sync_state.hops, StatusBeacon::HOPS_UNSYNCED - 1)
+          : StatusBeacon::HOPS_UNSYNCED;
+  status.hour_move_result = clock_state.hour_move_result;
+  status.minute_move_result = clock_state.minute_move_result;
+  status.sync_age_min = StatusBeacon::CalcSyncAgeMinutes(
+      sync_state.is_synced,
+      Util::GetEpochMicroseconds() - sync_state.last_sync_us);
+  status.drift_ppb = sync_state.drift_ppb;
+  status.version_hash = version_hash_;
+
+  std::array<uint8_t, StatusBeacon::MANUFACTURER_DATA_LENGTH> data = {};
+  const size_t length = StatusBeacon::Encode(status, data.data(), data.size());
+  if (is_data_set_ && data == data_) {
+    return;
+  }
+  data_ = data;
+  is_data_set_ = true;
+  BleDevice::GetInstance()->SetScanResponseManufacturerData(data.data(),
+                                                            length);
+  ESP_LOGD(TAG, "Status block > status:%d hops:%d age:%dmin drift:%" PRId32
+           "ppb",
+           status.clock_status, status.sync_hops, status.sync_age_min,
+           status.drift_ppb);
+}
+
+}  // namespace HareTortoiseClockSystem
@@ -0,0 +1,44 @@
+#ifndef BLE_STATUS_ADVERTISER_H_
+#define BLE_STATUS_ADVERTISER_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include <freertos/FreeRTOS.h>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+
+#include "hare_tortoise_clock_interface.h"
+#include "status_beacon.h"
+
+namespace HareTortoiseClockSystem {
+
+/// 状態監視ブロックをスキャンレスポンスで送信する (接続せずに状態を確認できる)
+class BleStatusAdvertiser final : public ClockStateListenerInterface {
+ public:
+  explicit BleStatusAdvertiser(
+      const HareTortoiseClockInterfaceWeakPtr hare_tortoise_clock_interface);
+
+  /// 時計タスクから呼び出し (保持のみ)
+  void OnClockStateChanged(const ClockState &state) override;
+
+  /// 内容が変わった場合のみスキャンレスポンスを更新する (メインループから呼び出し)
+  void Update();
+
+ private:
+  const HareTortoiseClockInterfaceWeakPtr hare_tortoise_clock_interface_;
+  const uint16_t version_hash_;
+  /// clock_state_の排他 (時計タスクとの間)
+  portMUX_TYPE mux_;
+  ClockState clock_state_;
+  std::array<uint8_t, StatusBeacon::MANUFACTURER_DATA_LENGTH> data_;
+  bool is_data_set_;
+};
+
+using BleStatusAdvertiserSharedPtr = std::shared_ptr<BleStatusAdvertiser>;
+
+}  // namespace HareTortoiseClockSystem
+
+#endif  // BLE_STATUS_ADVERTISER_H_
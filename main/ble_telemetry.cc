@@ -0,0 +1,178 @@
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include "ble_telemetry.h"
+
+#include <esp_rom_crc.h>
+#include <esp_timer.h>
+
+#include <algorithm>
+#include <cinttypes>
+
+#include "logger.h"
+#include "telemetry_log.h"
+#include "util.h"
+
+#ifdef CONFIG_BLE_TELEMETRY
+
+namespace HareTortoiseClockSystem {
+
+/// 属性値の最大長 (Read Blobで読み出せる範囲)
+constexpr size_t MAX_READ_LENGTH = 512;
+/// 連番の長さ
+constexpr size_t SEQUENCE_LENGTH = sizeof(uint16_t);
+/// 終端フレームの連番
+constexpr uint16_t END_SEQUENCE = 0xFFFF;
+/// 送信可能になるまでの待機上限(ms)
+constexpr int64_t SENDABLE_WAIT_LIMIT_MS = 5000;
+
+BleTelemetryCharacteristic::BleTelemetryCharacteristic(
+    esp_bt_uuid_t characteristic_uuid, esp_gatt_char_prop_t property)
+    : BleCharacteristicInterface(),
+      Task(std::string(TASK_NAME).c_str(), PRIORITY, CORE_ID, STACK_DEPTH,
+           stack_buffer_),
+      stack_buffer_(),
+      characteristic_uuid_(characteristic_uuid),
+      property_(property),
+      handle_(0),
+      notifier_(nullptr),
+      request_queue_(),
+      is_streaming_(false),
+      snapshot_(CONFIG_BLE_TELEMETRY_BUFFER_SIZE),
+      snapshot_length_(0),
+      read_offset_(0) {}
+
+void BleTelemetryCharacteristic::Initialize() {
+  if (!request_queue_.Create()) {
+    ESP_LOGE(TAG, "Creating queue failed");
+  }
+}
+
+void BleTelemetryCharacteristic::Update() {
+  uint8_t request = 0;
+  if (!request_queue_.ReceiveBlock(&request)) {
+    return;
+  }
+  Stream();
+  is_streaming_ = false;
+}
+
+void BleTelemetryCharacteristic::Write(ConstByteSpan data) {
+  if (data.empty() || is_streaming_) {
+    return;
+  }
+  const uint8_t operation = data[0];
+  if (operation == OPERATION_STREAM && data.size() == 1) {
+    // 複写の更新を止めてから送信タスクへ要求 (送信中の要求は受け付けない)
+    if (!is_streaming_.exchange(true) && !request_queue_.Send(operation)) {
+      is_streaming_ = false;
+    }
+  } else if (operation == OPERATION_SEEK &&
+             data.size() == 1 + sizeof(uint32_t)) {
+    const uint32_t offset = LoadBigEndian<uint32_t>(&data[1]);
+    if (offset == 0) {
+      snapshot_length_ =
+          TelemetryLog::Snapshot(snapshot_.data(), snapshot_.size());
+    }
+    read_offset_ = std::min<size_t>(offset, snapshot_length_);
+  }
+}
+
+size_t BleTelemetryCharacteristic::Read(MutableByteSpan data) {
+  if (is_streaming_) {
+    return 0;
+  }
+  const size_t length = std::min(
+      {snapshot_length_ - read_offset_, MAX_READ_LENGTH, data.size()});
+  std::copy_n(snapshot_.data() + read_offset_, length, data.data());
+  return length;
+}
+
+bool BleTelemetryCharacteristic::WaitSendable() {
+  // コントローラの送信バッファが空くまで待つ (溢れた通知は破棄されるため)
+  const int64_t limit_us =
+      esp_timer_get_time() + SENDABLE_WAIT_LIMIT_MS * 1000;
+  while (!notifier_->IsSendable()) {
+    if (limit_us < esp_timer_get_time()) {
+      return false;
+    }
+    vTaskDelay(1);
+  }
+  return true;
+}
+
+bool BleTelemetryCharacteristic::Stream() {
+  if (notifier_ == nullptr) {
+    return false;
+  }
+  snapshot_length_ = TelemetryLog::Snapshot(snapshot_.data(), snapshot_.size());
+  read_offset_ = 0;
+  const size_t payload_length =
+      std::min<size_t>(notifier_->GetMaxNotifyLength(), ESP_GATT_MAX_MTU_SIZE) -
+      SEQUENCE_LENGTH;
+
+  uint8_t frame[ESP_GATT_MAX_MTU_SIZE] = {};
+  uint16_t sequence = 0;
+  const int64_t begin_us = esp_timer_get_time();
+  for (size_t offset = 0; offset < snapshot_length_;
+       offset += payload_length) {
+    const size_t length = std::min(payload_length, snapshot_length_ - offset);
+    StoreBigEndian(sequence, frame);
+    std::copy_n(snapshot_.data() + offset, length, &frame[SEQUENCE_LENGTH]);
+    notifier_->RequestFastConnection();
+    if (!WaitSendable() ||
+        !notifier_->Notify(handle_, frame, SEQUENCE_LENGTH + length)) {
+      ESP_LOGW(TAG, "Telemetry stream aborted > %zu/%zu byte", offset,
+               snapshot_length_);
+      return false;
+    }
+    // 終端の連番と重ならないよう折り返す
+    sequence = (sequence + 1) % END_SEQUENCE;
+  }
+  const int64_t elapsed_us = std::max<int64_t>(esp_timer_get_time() - begin_us, 1);
+  const uint32_t bytes_per_sec =
+      static_cast<uint32_t>(snapshot_length_ * 1000000 / elapsed_us);
+
+  size_t index = 0;
+  index += StoreBigEndian(END_SEQUENCE, &frame[index]);
+  index += StoreBigEndian(static_cast<uint32_t>(snapshot_length_),
+                          &frame[index]);
+  index += StoreBigEndian(
+      esp_rom_crc32_le(0, snapshot_.data(), snapshot_length_), &frame[index]);
+  index += StoreBigEndian(bytes_per_sec, &frame[index]);
+  index += StoreBigEndian(TelemetryLog::GetDroppedCount(), &frame[index]);
+  if (!WaitSendable() || !notifier_->Notify(handle_, frame, index)) {
+    return false;
+  }
+
+  ESP_LOGI(TAG,
+           "Telemetry stream > %zu byte %" PRId64 "ms %" PRIu32
+           "byte/s (frame:%zu byte)",
+           snapshot_length_, elapsed_us / 1000, bytes_per_sec,
+           payload_length + SEQUENCE_LENGTH);
+  return true;
+}
+
+void BleTelemetryCharacteristic::SetHandle(const uint16_t handle) {
+  handle_ = handle;
+}
+
+uint16_t BleTelemetryCharacteristic::GetHandle() const { return handle_; }
+
+esp_bt_uuid_t BleTelemetryCharacteristic::GetUuid() const {
+  return characteristic_uuid_;
+}
+
+esp_gatt_char_prop_t BleTelemetryCharacteristic::GetProperty() const {
+  return property_;
+}
+
+void BleTelemetryCharacteristic::SetNotifier(
+    BleNotifierInterface *const notifier) {
+  notifier_ = notifier;
+}
+
+}  // namespace HareTortoiseClockSystem
+
+#endif  // CONFIG_BLE_TELEMETRY
@@ -0,0 +1,82 @@
+#ifndef BLE_TELEMETRY_H_
+#define BLE_TELEMETRY_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include <esp_gatts_api.h>
+#include <freertos/FreeRTOS.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "ble_device.h"
+#include "message_queue.h"
+#include "task.h"
+
+namespace HareTortoiseClockSystem {
+
+/// テレメトリ(ログ記録)の一括転送
+/// Write [0x01] : 取得開始 記録の複写をNotifyで連続送信する
+///   Notify [連番(uint16_t)][データ]
+///   終端   [0xFFFF][総バイト数][CRC32][転送速度(byte/s)][破棄した記録数]
+///          (各uint32_t)
+/// Write [0x02][位置(uint32_t)] : Readの開始位置 (位置0で記録を複写し直す)
+///   Read : 指定位置から最大512byte (Read Blobによる長い読み出しに対応)
+/// 値はすべてビッグエンディアン
+class BleTelemetryCharacteristic final : public BleCharacteristicInterface,
+                                         public Task {
+ public:
+  static constexpr std::string_view TASK_NAME = "BleTelemetry";
+  static constexpr int32_t PRIORITY = Task::PRIORITY_LOW;
+  static constexpr int32_t CORE_ID = PRO_CPU_NUM;
+  static constexpr uint32_t STACK_DEPTH = 3072;
+
+  enum Operation : uint8_t {
+    OPERATION_STREAM = 1,
+    OPERATION_SEEK = 2,
+  };
+
+  BleTelemetryCharacteristic(esp_bt_uuid_t characteristic_uuid,
+                             esp_gatt_char_prop_t property);
+
+  void Write(ConstByteSpan data) override;
+  size_t Read(MutableByteSpan data) override;
+
+  void SetHandle(const uint16_t handle) override;
+  uint16_t GetHandle() const override;
+  esp_bt_uuid_t GetUuid() const override;
+  esp_gatt_char_prop_t GetProperty() const override;
+  void SetNotifier(BleNotifierInterface *const notifier) override;
+
+  void Initialize() override;
+  void Update() override;
+
+ private:
+  bool Stream();
+  bool WaitSendable();
+
+ private:
+  StackType_t stack_buffer_[STACK_DEPTH];
+  const esp_bt_uuid_t characteristic_uuid_;
+  const esp_gatt_char_prop_t property_;
+  uint16_t handle_;
+  BleNotifierInterface *notifier_;
+  StaticMessageQueue<uint8_t, 1> request_queue_;
+  /// 送信中は複写を更新しない
+  std::atomic<bool> is_streaming_;
+  /// 記録の複写 (転送中に記録が追加されても内容が変わらないように)
+  std::vector<uint8_t> snapshot_;
+  size_t snapshot_length_;
+  size_t read_offset_;
+};
+
+using BleTelemetryCharacteristicSharedPtr =
+    std::shared_ptr<BleTelemetryCharacteristic>;
+
+}  // namespace HareTortoiseClockSystem
+
+#endif  // BLE_TELEMETRY_H_
@@ -0,0 +1,169 @@
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include "ble_time_beacon.h"
+
+#include <esp_timer.h>
+
+#include <cinttypes>
+
+#include "logger.h"
+#include "util.h"
+
+namespace HareTortoiseClockSystem {
+
+/// 未同期時のスキャン間隔(us)
+constexpr int64_t SCAN_INTERVAL_US = 30ll * 1000000;
+/// ビーコン経由で同期した時計が、より良いビーコンを探す間隔(us)
+constexpr int64_t RESCAN_INTERVAL_US = 3600ll * 1000000;
+/// スキャン時間(sec) (アドバタイズ間隔1.28sを2回以上含む)
+constexpr uint32_t SCAN_DURATION_SEC = 3;
+/// スキャン完了の待機上限(ms)
+constexpr int32_t SCAN_COMPLETE_LIMIT_MS = (SCAN_DURATION_SEC + 2) * 1000;
+
+BleTimeBeacon::BleTimeBeacon(
+    const HareTortoiseClockInterfaceWeakPtr hare_tortoise_clock_interface)
+    : Task(std::string(TASK_NAME).c_str(), PRIORITY, CORE_ID, STACK_DEPTH,
+           stack_buffer_),
+      stack_buffer_(),
+      hare_tortoise_clock_interface_(std::move(hare_tortoise_clock_interface)),
+      mux_(portMUX_INITIALIZER_UNLOCKED),
+      selector_(),
+      scan_complete_queue_(),
+      next_scan_us_(0),
+      is_advertising_(false) {}
+
+void BleTimeBeacon::Initialize() {
+  if (!scan_complete_queue_.Create()) {
+    ESP_LOGE(TAG, "Creating queue failed");
+  }
+  next_scan_us_ = esp_timer_get_time() + SCAN_INTERVAL_US;
+}
+
+void BleTimeBeacon::Update() {
+  HareTortoiseClockInterfaceSharedPtr hare_tortoise_clock =
+      hare_tortoise_clock_interface_.lock();
+  if (!hare_tortoise_clock) {
+    Util::SleepMillisecond(1000);
+    return;
+  }
+  const HareTortoiseClockInterface::TimeSyncState state =
+      hare_tortoise_clock->GetTimeSyncState();
+  hare_tortoise_clock.reset();
+
+  if (IsScanRequired(state)) {
+    Scan(state);
+    next_scan_us_ = esp_timer_get_time() +
+                    (state.is_synced ? RESCAN_INTERVAL_US : SCAN_INTERVAL_US);
+  }
+
+  Advertise(state);
+  Util::SleepMillisecond(TimeBeacon::UPDATE_INTERVAL_US / 1000);
+}
+
+bool BleTimeBeacon::IsScanRequired(
+    const HareTortoiseClockInterface::TimeSyncState &state) const {
+  // 直接同期した時計はスキャンしない
+  if (state.is_synced && state.hops == 0) {
+    return false;
+  }
+  return next_scan_us_ <= esp_timer_get_time();
+}
+
+void BleTimeBeacon::Advertise(
+    const HareTortoiseClockInterface::TimeSyncState &state) {
+  if (!state.is_synced || TimeBeacon::MAX_HOPS <= state.hops + 1) {
+    // 受信側で採用されないビーコンは送信しない
+    if (is_advertising_) {
+      BleDevice::GetInstance()->SetAdvertisingManufacturerData(nullptr, 0);
+      is_advertising_ = false;
+    }
+    return;
+  }
+
+  const int64_t now_us = Util::GetEpochMicroseconds();
+  TimeBeacon::Beacon beacon = {};
+  beacon.epoch_ms = now_us / 1000;
+  beacon.hops = state.hops;
+  beacon.uncertainty_ms = TimeBeacon::EstimateUncertaintyMs(
+      state.uncertainty_ms, now_us - state.last_sync_us);
+
+  uint8_t data[TimeBeacon::MANUFACTURER_DATA_LENGTH] = {};
+  const size_t length = TimeBeacon::Encode(beacon, data, sizeof(data));
+  BleDevice::GetInstance()->SetAdvertisingManufacturerData(data, length);
+  is_advertising_ = true;
+}
+
+void BleTimeBeacon::Scan(
+    const HareTortoiseClockInterface::TimeSyncState &state) {
+  // スキャン中は送信内容を更新できないため、古い時刻を送信しない
+  if (is_advertising_) {
+    BleDevice::GetInstance()->SetAdvertisingManufacturerData(nullptr, 0);
+    is_advertising_ = false;
+  }
+
+  portENTER_CRITICAL(&mux_);
+  selector_.Reset();
+  portEXIT_CRITICAL(&mux_);
+
+  uint8_t complete = 0;
+  scan_complete_queue_.ReceiveNonBlock(&complete);
+  const int64_t begin_us = esp_timer_get_time();
+  if (!BleDevice::GetInstance()->StartScan(this, SCAN_DURATION_SEC)) {
+    return;
+  }
+  if (!scan_complete_queue_.ReceiveWait(&complete, SCAN_COMPLETE_LIMIT_MS)) {
+    ESP_LOGW(TAG, "Beacon scan timeout");
+  }
+
+  int64_t offset_us = 0;
+  TimeBeacon::Beacon best = {};
+  portENTER_CRITICAL(&mux_);
+  const bool is_found = selector_.GetBest(&offset_us, &best);
+  portEXIT_CRITICAL(&mux_);
+  if (!is_found) {
+    ESP_LOGI(TAG, "Beacon not found (scan:%" PRId64 "ms)",
+             (esp_timer_get_time() - begin_us) / 1000);
+    return;
+  }
+
+  // 同期済みの場合は自身より誤差の小さいビーコンのみ採用
+  const uint16_t own_uncertainty_ms = TimeBeacon::EstimateUncertaintyMs(
+      state.uncertainty_ms, Util::GetEpochMicroseconds() - state.last_sync_us);
+  if (state.is_synced && own_uncertainty_ms <= best.uncertainty_ms) {
+    return;
+  }
+
+  ESP_LOGI(TAG,
+           "Adopt Beacon > offset:%" PRId64 "us hops:%u uncertainty:%ums "
+           "(scan:%" PRId64 "ms)",
+           offset_us, best.hops, best.uncertainty_ms,
+           (esp_timer_get_time() - begin_us) / 1000);
+  HareTortoiseClockInterfaceSharedPtr hare_tortoise_clock =
+      hare_tortoise_clock_interface_.lock();
+  if (hare_tortoise_clock) {
+    hare_tortoise_clock->AdoptTime(offset_us, best.hops + 1,
+                                   TimeBeacon::CalcAdoptedUncertaintyMs(best));
+  }
+}
+
+void BleTimeBeacon::OnScanResult(const uint8_t *const adv_data,
+                                 const size_t length, const int32_t rssi) {
+  // 受信直後の時刻で時刻差を求める (BTCタスク)
+  const int64_t receive_local_us = Util::GetEpochMicroseconds();
+  size_t data_length = 0;
+  const uint8_t *const data =
+      TimeBeacon::FindManufacturerData(adv_data, length, &data_length);
+  TimeBeacon::Beacon beacon = {};
+  if (data == nullptr || !TimeBeacon::Decode(data, data_length, &beacon)) {
+    return;
+  }
+  portENTER_CRITICAL(&mux_);
+  selector_.Offer(beacon, receive_local_us);
+  portEXIT_CRITICAL(&mux_);
+}
+
+void BleTimeBeacon::OnScanComplete() { scan_complete_queue_.Send(1); }
+
+}  // namespace HareTortoiseClockSystem
@@ -0,0 +1,64 @@
+#ifndef BLE_TIME_BEACON_H_
+#define BLE_TIME_BEACON_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include <freertos/FreeRTOS.h>
+
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+#include "ble_device.h"
+#include "hare_tortoise_clock_interface.h"
+#include "message_queue.h"
+#include "task.h"
+#include "time_beacon.h"
+
+namespace HareTortoiseClockSystem {
+
+/// 時刻ビーコン
+/// 同期済みの時計はアドバタイズに時刻を載せ、未同期の時計はスキャンして採用する
+class BleTimeBeacon final : public Task, public BleScanListenerInterface {
+ public:
+  static constexpr std::string_view TASK_NAME = "BleTimeBeacon";
+  static constexpr int32_t PRIORITY = Task::PRIORITY_LOW;
+  static constexpr int32_t CORE_ID = PRO_CPU_NUM;
+  static constexpr uint32_t STACK_DEPTH = 3072;
+
+ public:
+  explicit BleTimeBeacon(
+      const HareTortoiseClockInterfaceWeakPtr hare_tortoise_clock_interface);
+
+  void Initialize() override;
+  void Update() override;
+
+  void OnScanResult(const uint8_t *const adv_data, const size_t length,
+                    const int32_t rssi) override;
+  void OnScanComplete() override;
+
+ private:
+  void Advertise(const HareTortoiseClockInterface::TimeSyncState &state);
+  void Scan(const HareTortoiseClockInterface::TimeSyncState &state);
+  bool IsScanRequired(
+      const HareTortoiseClockInterface::TimeSyncState &state) const;
+
+ private:
+  StackType_t stack_buffer_[STACK_DEPTH];
+  const HareTortoiseClockInterfaceWeakPtr hare_tortoise_clock_interface_;
+  /// selector_の排他 (BTCタスクとの間)
+  portMUX_TYPE mux_;
+  TimeBeacon::Selector selector_;
+  StaticMessageQueue<uint8_t, 1> scan_complete_queue_;
+  /// 次回スキャンのモノトニック時刻(us)
+  int64_t next_scan_us_;
+  /// アドバタイズ中か (未同期の間は送信しない)
+  bool is_advertising_;
+};
+
+using BleTimeBeaconSharedPtr = std::shared_ptr<BleTimeBeacon>;
+
+}  // namespace HareTortoiseClockSystem
+
+#endif  // BLE_TIME_BEACON_H_
@@ -0,0 +1,79 @@
+#ifndef BLE_UUID_H_
+#define BLE_UUID_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include <esp_bt_defs.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace HareTortoiseClockSystem {
+
+namespace BleUuidDetail {
+
+/// 定数式で呼び出すとコンパイルエラーになる (定義しない)
+void InvalidUuidString();
+
+constexpr uint8_t HexValue(const char c) {
+  if ('0' <= c && c <= '9') {
+    return static_cast<uint8_t>(c - '0');
+  }
+  if ('a' <= c && c <= 'f') {
+    return static_cast<uint8_t>(c - 'a' + 10);
+  }
+  if ('A' <= c && c <= 'F') {
+    return static_cast<uint8_t>(c - 'A' + 10);
+  }
+  InvalidUuidString();
+  return 0;
+}
+
+}  // namespace BleUuidDetail
+
+/// 128bit UUID
+/// 正規の文字列表記 "xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx" からコンパイル時に変換する
+class BleUuid128 final {
+ public:
+  static constexpr size_t STRING_LENGTH = 36;
+
+  constexpr explicit BleUuid128(const char (&str)[STRING_LENGTH + 1])
+      : bytes_() {
+    // esp_bt_uuid_tはリトルエンディアン (文字列の末尾が先頭バイト)
+    size_t byte_index = ESP_UUID_LEN_128;
+    size_t i = 0;
+    while (i < STRING_LENGTH) {
+      if (i == 8 || i == 13 || i == 18 || i == 23) {
+        if (str[i] != '-') {
+          BleUuidDetail::InvalidUuidString();
+        }
+        ++i;
+        continue;
+      }
+      bytes_[--byte_index] =
+          static_cast<uint8_t>((BleUuidDetail::HexValue(str[i]) << 4) |
+                               BleUuidDetail::HexValue(str[i + 1]));
+      i += 2;
+    }
+  }
+
+  constexpr const std::array<uint8_t, ESP_UUID_LEN_128> &GetBytes() const {
+    return bytes_;
+  }
+
+  esp_bt_uuid_t ToEspBtUuid() const {
+    esp_bt_uuid_t uuid = {.len = ESP_UUID_LEN_128, .uuid = {.uuid128 = {}}};
+    std::memcpy(uuid.uuid.uuid128, bytes_.data(), ESP_UUID_LEN_128);
+    return uuid;
+  }
+
+ private:
+  std::array<uint8_t, ESP_UUID_LEN_128> bytes_;
+};
+
+}  // namespace HareTortoiseClockSystem
+
+#endif  // BLE_UUID_H_
@@ -0,0 +1,95 @@
+#ifndef BYTE_SPAN_H_
+#define BYTE_SPAN_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace HareTortoiseClockSystem {
+
+/// 連続領域の参照 (所有しない) C++20 std::spanの代替
+/// std::spanへ置き換えられるよう名前は標準に合わせる
+template <typename T>
+class Span final {
+ public:
+  constexpr Span() : data_(nullptr), size_(0) {}
+  constexpr Span(T *const data, const size_t size) : data_(data), size_(size) {}
+  template <size_t N>
+  constexpr Span(T (&array)[N]) : data_(array), size_(N) {}
+  template <typename U, size_t N,
+            typename =
+                std::enable_if_t<std::is_convertible_v<U (*)[], T (*)[]>>>
+  constexpr Span(std::array<U, N> &array) : data_(array.data()), size_(N) {}
+  template <typename U, size_t N,
+            typename = std::enable_if_t<
+                std::is_convertible_v<const U (*)[], T (*)[]>>>
+  constexpr Span(const std::array<U, N> &array)
+      : data_(array.data()), size_(N) {}
+  /// 書き込み可能な参照から読み出し専用の参照への変換
+  template <typename U, typename = std::enable_if_t<
+                            std::is_convertible_v<U (*)[], T (*)[]>>>
+  constexpr Span(const Span<U> &other)
+      : data_(other.data()), size_(other.size()) {}
+
+  constexpr T *data() const { return data_; }
+  constexpr size_t size() const { return size_; }
+  constexpr bool empty() const { return size_ == 0; }
+  constexpr T *begin() const { return data_; }
+  constexpr T *end() const { return data_ + size_; }
+  constexpr T &operator[](const size_t index) const { return data_[index]; }
+
+  /// 先頭からcount要素 (範囲外は切り詰める)
+  constexpr Span first(const size_t count) const {
+    return Span(data_, count < size_ ? count : size_);
+  }
+  /// offsetから末尾まで (範囲外は空)
+  constexpr Span subspan(const size_t offset) const {
+    return offset < size_ ? Span(data_ + offset, size_ - offset)
+                          : Span(end(), 0);
+  }
+  /// offsetからcount要素 (範囲外は切り詰める)
+  constexpr Span subspan(const size_t offset, const size_t count) const {
+    return subspan(offset).first(count);
+  }
+
+ private:
+  T *data_;
+  size_t size_;
+};
+
+/// 受信値など読み出し専用のバイト列
+using ConstByteSpan = Span<const uint8_t>;
+/// 応答値を書き込むバイト列
+using MutableByteSpan = Span<uint8_t>;
+
+/// ビッグエンディアンの整数の読み出し (GATTの値はビッグエンディアン)
+template <typename T>
+constexpr T LoadBigEndian(const uint8_t *const data) {
+  static_assert(std::is_integral_v<T>, "T must be an integer");
+  std::make_unsigned_t<T> value = 0;
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    value = static_cast<std::make_unsigned_t<T>>(value << 8 | data[i]);
+  }
+  return static_cast<T>(value);
+}
+
+/// ビッグエンディアンの整数の書き込み
+/// @return 書き込んだ長さ
+template <typename T>
+constexpr size_t StoreBigEndian(const T value, uint8_t *const data) {
+  static_assert(std::is_integral_v<T>, "T must be an integer");
+  auto bits = static_cast<std::make_unsigned_t<T>>(value);
+  for (size_t i = sizeof(T); 0 < i; --i) {
+    data[i - 1] = static_cast<uint8_t>(bits);
+    bits = static_cast<std::make_unsigned_t<T>>(bits >> 8);
+  }
+  return sizeof(T);
+}
+
+}  // namespace HareTortoiseClockSystem
+
+#endif  // BYTE_SPAN_H_
@@ -0,0 +1,167 @@
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include "clock_checkpoint.h"
+
+#include <esp_attr.h>
+#include <esp_rom_crc.h>
+#include <esp_system.h>
+#include <freertos/FreeRTOS.h>
+
+#include <cstddef>
+#include <cstring>
+
+#include "logger.h"
+
+namespace HareTortoiseClockSystem {
+
+/// NVS 名前空間・キー
+constexpr char NVS_NAMESPACE[] = "clock";
+constexpr char NVS_KEY_CHECKPOINT[] = "checkpoint";
+/// 記録の識別子 (構造を変更した場合は更新)
+constexpr uint32_t CHECKPOINT_MAGIC = 0x48544302;
+
+namespace {
+
+struct Record {
+  uint32_t magic;
+  ClockCheckpoint::Data data;
+  uint32_t crc;
+};
+
+/// RTC低速メモリ (電源投入以外の再起動では保持される)
+RTC_NOINIT_ATTR Record rtc_record;
+/// rtc_recordの排他 (タスクとISR)
+portMUX_TYPE rtc_record_mux = portMUX_INITIALIZER_UNLOCKED;
+/// 電源断の記録後は上書きしない
+volatile bool is_frozen = false;
+
+uint32_t IRAM_ATTR CalcCrc(const Record &record) {
+  return esp_rom_crc32_le(0, reinterpret_cast<const uint8_t *>(&record),
+                          offsetof(Record, crc));
+}
+
+bool IsValid(const Record &record) {
+  return record.magic == CHECKPOINT_MAGIC && record.crc == CalcCrc(record);
+}
+
+Record IRAM_ATTR MakeRecord(const ClockCheckpoint::Data &data) {
+  // パディングもCRCの対象となるため0で埋める
+  Record record;
+  std::memset(&record, 0, sizeof(record));
+  record.magic = CHECKPOINT_MAGIC;
+  record.data = data;
+  record.crc = CalcCrc(record);
+  return record;
+}
+
+}  // namespace
+
+ClockCheckpoint::ClockCheckpoint() : handle_(0), is_open_(false) {}
+
+ClockCheckpoint::~ClockCheckpoint() {
+  if (is_open_) {
+    nvs_close(handle_);
+  }
+}
+
+void ClockCheckpoint::Open() {
+  if (is_open_) {
+    return;
+  }
+  if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle_) != ESP_OK) {
+    ESP_LOGE(TAG, "Failed open nvs");
+    return;
+  }
+  is_open_ = true;
+}
+
+bool ClockCheckpoint::IsRtcRetained() {
+  const esp_reset_reason_t reason = esp_reset_reason();
+  return reason != ESP_RST_POWERON && reason != ESP_RST_UNKNOWN;
+}
+
+bool ClockCheckpoint::IsWarmBoot() {
+  return IsRtcRetained() && esp_reset_reason() != ESP_RST_BROWNOUT;
+}
+
+bool ClockCheckpoint::LoadRtc(Data *const data) {
+  portENTER_CRITICAL(&rtc_record_mux);
+  const Record record = rtc_record;
+  portEXIT_CRITICAL(&rtc_record_mux);
+  if (!IsValid(record)) {
+    return false;
+  }
+  *data = record.data;
+  return true;
+}
+
+bool ClockCheckpoint::LoadNvs(Data *const data) const {
+  if (!is_open_) {
+    return false;
+  }
+  Record record = {};
+  size_t size = sizeof(record);
+  if (nvs_get_blob(handle_, NVS_KEY_CHECKPOINT, &record, &size) != ESP_OK ||
+      size != sizeof(record) || !IsValid(record)) {
+    return false;
+  }
+  *data = record.data;
+  return true;
+}
+
+void ClockCheckpoint::Save(const Data &data) {
+  const Record record = MakeRecord(data);
+  portENTER_CRITICAL(&rtc_record_mux);
+  const bool is_skip = is_frozen;
+  if (!is_skip) {
+    rtc_record = record;
+  }
+  portEXIT_CRITICAL(&rtc_record_mux);
+  if (is_skip) {
+    return;
+  }
+
+  // 書き込みは移動の開始・完了時のみ (1分あたり2回程度)
+  if (is_open_) {
+    nvs_set_blob(handle_, NVS_KEY_CHECKPOINT, &record, sizeof(record));
+    nvs_commit(handle_);
+  }
+}
+
+void ClockCheckpoint::Invalidate() {
+  portENTER_CRITICAL(&rtc_record_mux);
+  const bool is_skip = is_frozen;
+  if (!is_skip) {
+    rtc_record.magic = 0;
+  }
+  portEXIT_CRITICAL(&rtc_record_mux);
+  if (is_skip) {
+    return;
+  }
+  if (is_open_) {
+    nvs_erase_key(handle_, NVS_KEY_CHECKPOINT);
+    nvs_commit(handle_);
+  }
+}
+
+void IRAM_ATTR ClockCheckpoint::SaveFromISR(const Data &data) {
+  const Record record = MakeRecord(data);
+  portENTER_CRITICAL_ISR(&rtc_record_mux);
+  rtc_record = record;
+  is_frozen = true;
+  portEXIT_CRITICAL_ISR(&rtc_record_mux);
+}
+
+void ClockCheckpoint::FlushToNvs() {
+  portENTER_CRITICAL(&rtc_record_mux);
+  const Record record = rtc_record;
+  portEXIT_CRITICAL(&rtc_record_mux);
+  if (is_open_ && IsValid(record)) {
+    nvs_set_blob(handle_, NVS_KEY_CHECKPOINT, &record, sizeof(record));
+    nvs_commit(handle_);
+  }
+}
+
+}  // namespace HareTortoiseClockSystem
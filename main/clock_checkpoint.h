@@ -0,0 +1,69 @@
+#ifndef CLOCK_CHECKPOINT_H_
+#define CLOCK_CHECKPOINT_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include <nvs.h>
+
+#include <cstdint>
+
+namespace HareTortoiseClockSystem {
+
+/// 再起動後に原点復帰せず再開するための状態記録
+/// RTCメモリ(ウォームブート用)とNVS(電源断用)の両方にチェックサム付きで保存
+class ClockCheckpoint final {
+ public:
+  struct Data {
+    /// 針位置(step)
+    int32_t hour_pos;
+    int32_t minute_pos;
+    /// 保存時のシステム時刻(Unix時間 us)
+    int64_t saved_us;
+    /// 同期情報 (DriftCompensator)
+    int64_t last_sync_us;
+    int64_t last_precise_sync_us;
+    /// 時刻設定済み(運転中)か
+    uint8_t is_time_set;
+    /// 移動中か (移動中の記録は針位置が不確定)
+    uint8_t is_moving;
+    /// 同期元からの段数 (時刻ビーコン)
+    uint8_t sync_hops;
+    uint8_t reserved;
+  };
+
+  ClockCheckpoint();
+  ~ClockCheckpoint();
+
+  /// NVSを開く (以降の保存で確保を行わないため開いたままにする)
+  void Open();
+
+  /// RTCメモリが保持される再起動か (電源投入以外)
+  static bool IsRtcRetained();
+  /// ウォームブート(システム時刻も保持される再起動)か
+  static bool IsWarmBoot();
+
+  /// RTCメモリから読み込み 不正な場合false
+  static bool LoadRtc(Data *const data);
+  /// NVSから読み込み 不正な場合false
+  bool LoadNvs(Data *const data) const;
+
+  /// RTCメモリとNVSへ保存
+  void Save(const Data &data);
+  /// 記録を無効化 (針位置が不明になった場合)
+  void Invalidate();
+
+  /// 電源断検出時のRTCメモリへの保存 (ISRから呼び出し)
+  /// 以降のSave/Invalidateは無視する
+  static void SaveFromISR(const Data &data);
+  /// ISRで保存したRTCメモリの記録をNVSへ反映
+  void FlushToNvs();
+
+ private:
+  nvs_handle_t handle_;
+  bool is_open_;
+};
+
+}  // namespace HareTortoiseClockSystem
+
+#endif  // CLOCK_CHECKPOINT_H_
@@ -4,33 +4,74 @@
 // Include ----------------------
 #include "clock_management_task.h"
 
-#include <driver/gpio.h>
-#include <driver/gptimer.h>
+#include <esp_system.h>
 
+#include <algorithm>
+
+#include "deep_sleep.h"
 #include "gpio_control.h"
+#include "heap_audit.h"
 #include "logger.h"
 #include "message_queue.h"
 #include "hare_tortoise_clock_interface.h"
+#include "local_time.h"
 #include "stepper_motor_util.h"
+#include "time_beacon.h"
 #include "util.h"
 
 namespace HareTortoiseClockSystem {
 
 constexpr int32_t HALF_DAY_HOUR = 12;
 
+/// 時針 ステッピングモーター ピン定義
+using HourHandPins = StepperMotorPins<
+    CONFIG_HOUR_HAND_ENABLE_OUTPUT_GPIO_NO, CONFIG_HOUR_HAND_STEP_OUTPUT_GPIO_NO,
+    CONFIG_HOUR_HAND_DIR_OUTPUT_GPIO_NO,
+    CONFIG_HOUR_HAND_RIGHT_LIMIT_INPUT_GPIO_NO,
+    CONFIG_HOUR_HAND_LEFT_LIMIT_INPUT_GPIO_NO>;
+/// 分針 ステッピングモーター ピン定義
+using MinuteHandPins = StepperMotorPins<
+    CONFIG_MINUTE_HAND_ENABLE_OUTPUT_GPIO_NO,
+    CONFIG_MINUTE_HAND_STEP_OUTPUT_GPIO_NO,
+    CONFIG_MINUTE_HAND_DIR_OUTPUT_GPIO_NO,
+    CONFIG_MINUTE_HAND_RIGHT_LIMIT_INPUT_GPIO_NO,
+    CONFIG_MINUTE_HAND_LEFT_LIMIT_INPUT_GPIO_NO>;
+
+// 時刻補正をスルー(adjtime)で行う上限 これを超える場合はステップで補正(us)
+constexpr int64_t TIME_SLEW_LIMIT_US = 1000000;
+// 秒単位の時刻設定の推定誤差(ms)
+constexpr uint16_t SECOND_SYNC_UNCERTAINTY_MS = 1000;
+
 // ClockMangementTask Updateタスク スリープ時間
 constexpr int32_t CLOCK_MANAGEMENT_TASK_UPDATE_SLEEP_MS = 1000;
+// 運転中に分の切替から遅らせて起床する余裕(ms) (ティック丸めで手前に起きないよう)
+constexpr int64_t MINUTE_BOUNDARY_MARGIN_MS = 20;
 
 // 左から見た絶対位置
-constexpr uint32_t POSITION_LEFT_RESET_MM = 0;
-constexpr uint32_t POSITION_LEFT_LIMIT_MM = 10;
-constexpr uint32_t POSITION_CLOCK_START_MM = 35;
-constexpr uint32_t POSITION_CLOCK_END_MM = 635;
-constexpr uint32_t POSITION_RIGHT_LIMIT_MM = 660;
-constexpr uint32_t POSITION_RESET_MOVE_MM = 700;
-constexpr uint32_t CLOCK_LENGTH_MM = 600;
-constexpr uint32_t CLOCK_HOUR_MM = CLOCK_LENGTH_MM / HALF_DAY_HOUR;
-constexpr uint32_t CLOCK_MINUTE_MM = CLOCK_LENGTH_MM / 60;
+constexpr Steps POSITION_LEFT_RESET =
+    StepperMotorUtil::ToSteps(Millimetres(0));
+constexpr Steps POSITION_LEFT_LIMIT =
+    StepperMotorUtil::ToSteps(Millimetres(10));
+constexpr Steps POSITION_CLOCK_START =
+    StepperMotorUtil::ToSteps(Millimetres(35));
+constexpr Steps POSITION_CLOCK_END =
+    StepperMotorUtil::ToSteps(Millimetres(635));
+constexpr Steps POSITION_RIGHT_LIMIT =
+    StepperMotorUtil::ToSteps(Millimetres(660));
+constexpr Steps POSITION_RESET_MOVE =
+    StepperMotorUtil::ToSteps(Millimetres(700));
+constexpr Micrometres CLOCK_LENGTH = Millimetres(600);
+constexpr Steps CLOCK_HOUR =
+    StepperMotorUtil::ToSteps(CLOCK_LENGTH / HALF_DAY_HOUR);
+constexpr Steps CLOCK_MINUTE = StepperMotorUtil::ToSteps(CLOCK_LENGTH / 60);
+// 再開時の位置確認の移動量
+constexpr Steps VERIFY_MOVE = StepperMotorUtil::ToSteps(Millimetres(1));
+
+static_assert(POSITION_CLOCK_START + CLOCK_HOUR * HALF_DAY_HOUR ==
+                  POSITION_CLOCK_END,
+              "hour marks must land exactly on the clock end");
+static_assert(POSITION_CLOCK_START + CLOCK_MINUTE * 60 == POSITION_CLOCK_END,
+              "minute marks must land exactly on the clock end");
 
 /// 動作スピード(周波数) (AT2100 (1/16step) MAX 20khz) ----
 // ポジションリセット時
@@ -48,6 +89,9 @@ constexpr uint32_t HOUR_MOVE_HZ =
     (MINUTE_RETURN_MOVE_HZ / HALF_DAY_HOUR);  // - 30; // 補正
 /// Hour動作速度
 constexpr uint32_t HOUR_MOVE_SLOW_HZ = 400;
+/// 振り付けの速度範囲
+constexpr uint32_t CHOREOGRAPHY_MIN_MOVE_HZ = 50;
+constexpr uint32_t CHOREOGRAPHY_MAX_MOVE_HZ = SET_TIME_MOVE_HZ;
 
 const std::function<void(ClockManagementTask&)>
     ClockManagementTask::UPDATE_TASKS[MAX_CLOCK_STATUS] = {
@@ -57,59 +101,188 @@ const std::function<void(ClockManagementTask&)>
         &ClockManagementTask::TaskDummy,       // STATUS_SETTING_WAIT,
         &ClockManagementTask::TaskEnable,      // STATUS_ENABLE,
         &ClockManagementTask::TaskSetting,     // STATUS_SETTING,
+        &ClockManagementTask::TaskResume,      // STATUS_RESUME,
 };
 
 ClockManagementTask::ClockManagementTask(
     const HareTortoiseClockInterfaceWeakPtr hare_tortoise_clock_interface)
-    : Task(std::string(TASK_NAME).c_str(), PRIORITY, CORE_ID),
+    : Task(std::string(TASK_NAME).c_str(), PRIORITY, CORE_ID, STACK_DEPTH,
+           stack_buffer_),
+      stack_buffer_(),
       hare_tortoise_clock_interface_(std::move(hare_tortoise_clock_interface)),
       clock_status_(STATUS_NONE),
       stepper_motor_hour_(),
       stepper_motor_minute_(),
       hour_(0),
       minute_(0),
-      hour_pos_left_mm_(0),
-      minute_pos_left_mm_(0) {}
+      hour_pos_left_(),
+      minute_pos_left_(),
+      drift_compensator_(),
+      checkpoint_(),
+      power_fail_monitor_(),
+      is_moving_(false),
+      is_position_known_(false),
+      is_restart_requested_(false),
+      sync_mux_(portMUX_INITIALIZER_UNLOCKED),
+      sync_hops_(0),
+      sync_uncertainty_ms_(TimeBeacon::CalcBaseUncertaintyMs(0)),
+      sync_request_(),
+      is_sync_pending_(false),
+      hour_move_result_(RESULT_NONE),
+      minute_move_result_(RESULT_NONE),
+      state_listeners_(),
+      published_state_(),
+      is_state_published_(false),
+      state_mux_(portMUX_INITIALIZER_UNLOCKED),
+      shared_state_(),
+      choreography_mux_(portMUX_INITIALIZER_UNLOCKED),
+      choreography_(),
+      is_choreography_pending_(false),
+      is_choreography_playing_(false) {}
 
 void ClockManagementTask::Initialize() {
   ESP_LOGI(TAG, "Start Clock Management Task");
 
+  HeapAudit::WatchCurrentTask();
+
+  drift_compensator_.Load();
+
   // Create StepperMotorController
-  stepper_motor_hour_ = std::make_shared<StepperMotorController>(
-      STEPPER_MOTOR_RESOLUTION,
-      static_cast<gpio_num_t>(CONFIG_HOUR_HAND_ENABLE_OUTPUT_GPIO_NO),
-      static_cast<gpio_num_t>(CONFIG_HOUR_HAND_STEP_OUTPUT_GPIO_NO),
-      static_cast<gpio_num_t>(CONFIG_HOUR_HAND_DIR_OUTPUT_GPIO_NO),
-      static_cast<gpio_num_t>(CONFIG_HOUR_HAND_RIGHT_LIMIT_INPUT_GPIO_NO),
-      static_cast<gpio_num_t>(CONFIG_HOUR_HAND_LEFT_LIMIT_INPUT_GPIO_NO),
-      CONFIG_IS_STEPPER_MOTOR_ROTATE_RIGHT_IS_DIR_UP);
-
-  stepper_motor_minute_ = std::make_shared<StepperMotorController>(
-      STEPPER_MOTOR_RESOLUTION,
-      static_cast<gpio_num_t>(CONFIG_MINUTE_HAND_ENABLE_OUTPUT_GPIO_NO),
-      static_cast<gpio_num_t>(CONFIG_MINUTE_HAND_STEP_OUTPUT_GPIO_NO),
-      static_cast<gpio_num_t>(CONFIG_MINUTE_HAND_DIR_OUTPUT_GPIO_NO),
-      static_cast<gpio_num_t>(CONFIG_MINUTE_HAND_RIGHT_LIMIT_INPUT_GPIO_NO),
-      static_cast<gpio_num_t>(CONFIG_MINUTE_HAND_LEFT_LIMIT_INPUT_GPIO_NO),
-      CONFIG_IS_STEPPER_MOTOR_ROTATE_RIGHT_IS_DIR_UP);
+  stepper_motor_hour_ = std::make_shared<StepperMotorController<HourHandPins>>(
+      STEPPER_MOTOR_RESOLUTION, CONFIG_IS_STEPPER_MOTOR_ROTATE_RIGHT_IS_DIR_UP);
+
+  stepper_motor_minute_ =
+      std::make_shared<StepperMotorController<MinuteHandPins>>(
+          STEPPER_MOTOR_RESOLUTION,
+          CONFIG_IS_STEPPER_MOTOR_ROTATE_RIGHT_IS_DIR_UP);
 
   clock_status_ = STATUS_INITIALIZE;
-  hour_pos_left_mm_ = 0;
-  minute_pos_left_mm_ = 0;
+  hour_pos_left_ = POSITION_LEFT_RESET;
+  minute_pos_left_ = POSITION_LEFT_RESET;
+
+  // 再起動前の記録があれば原点復帰を省略
+  checkpoint_.Open();
+  ClockCheckpoint::Data checkpoint = {};
+  const bool is_rtc_loaded = ClockCheckpoint::IsRtcRetained() &&
+                             ClockCheckpoint::LoadRtc(&checkpoint);
+  const bool is_warm_boot = is_rtc_loaded && ClockCheckpoint::IsWarmBoot();
+  if ((is_rtc_loaded || checkpoint_.LoadNvs(&checkpoint)) &&
+      !checkpoint.is_moving) {
+    hour_pos_left_ = Steps(checkpoint.hour_pos);
+    minute_pos_left_ = Steps(checkpoint.minute_pos);
+    is_position_known_ = true;
+
+    // 電源断ではシステム時刻が失われるため、時刻はウォームブートのみ再開
+    if (is_warm_boot && checkpoint.is_time_set &&
+        checkpoint.saved_us <= Util::GetEpochMicroseconds()) {
+      drift_compensator_.RestoreSync(checkpoint.last_sync_us,
+                                     checkpoint.last_precise_sync_us);
+      drift_compensator_.CompensateSleep(DeepSleep::GetSleptMicroseconds());
+      portENTER_CRITICAL(&sync_mux_);
+      sync_hops_ = checkpoint.sync_hops;
+      sync_uncertainty_ms_ =
+          TimeBeacon::CalcBaseUncertaintyMs(checkpoint.sync_hops);
+      portEXIT_CRITICAL(&sync_mux_);
+      clock_status_ = STATUS_RESUME;
+      // deep sleep中は針を動かしていないため、位置確認を省略して運転を続ける
+      if (DeepSleep::IsWakeFromSleep() && RestoreDisplayedTime()) {
+        clock_status_ = STATUS_ENABLE;
+      }
+    }
+    ESP_LOGI(TAG, "Restore Checkpoint %s Hour:%dstep Minute:%dstep",
+             is_rtc_loaded ? "RTC" : "NVS", hour_pos_left_.Count(),
+             minute_pos_left_.Count());
+  }
+  stepper_motor_hour_->SetPosition(hour_pos_left_);
+  stepper_motor_minute_->SetPosition(minute_pos_left_);
+
+  power_fail_monitor_.Start(&checkpoint_, stepper_motor_hour_.get(),
+                            stepper_motor_minute_.get());
 }
 
 void ClockManagementTask::Update() {
+  // 電源断検出後は針を動かさない (記録はPowerFailMonitorで保存済み)
+  if (power_fail_monitor_.IsTriggered()) {
+    Util::SleepMillisecond(CLOCK_MANAGEMENT_TASK_UPDATE_SLEEP_MS);
+    return;
+  }
+
+  ApplySync();
+  PlayChoreography();
+
   if (0 < clock_status_ && clock_status_ < MAX_CLOCK_STATUS) {
     UPDATE_TASKS[clock_status_](*this);
   }
-  Util::SleepMillisecond(CLOCK_MANAGEMENT_TASK_UPDATE_SLEEP_MS);
+
+  // 移動が完了したら位置を記録 (エラー時は位置が不明のため破棄)
+  if (is_moving_) {
+    if (clock_status_ == STATUS_ERROR) {
+      checkpoint_.Invalidate();
+      is_moving_ = false;
+    } else {
+      SaveCheckpoint();
+    }
+  }
+
+  if (is_restart_requested_) {
+    ESP_LOGI(TAG, "System Restart");
+    if (clock_status_ != STATUS_ERROR) {
+      SaveCheckpoint();
+    }
+    esp_restart();
+  }
+
+  PublishState();
+
+  drift_compensator_.Update();
+  power_fail_monitor_.UpdateClockState(
+      drift_compensator_.GetLastSyncUs(),
+      drift_compensator_.GetLastPreciseSyncUs(),
+      clock_status_ == STATUS_ENABLE);
+  WaitNextUpdate();
+}
+
+void ClockManagementTask::WaitNextUpdate() {
+  int64_t wait_ms = CLOCK_MANAGEMENT_TASK_UPDATE_SLEEP_MS;
+  if (clock_status_ == STATUS_ENABLE) {
+    // 運転中は表示が変わる次の分の切替まで待機 (設定要求はWakeで起床)
+    wait_ms = LocalTime::MicrosecondsUntilNextMinute(
+                  Util::GetEpochMicroseconds()) /
+                  1000 +
+              MINUTE_BOUNDARY_MARGIN_MS;
+    // 受付期間外はdeep sleepで待機 (成功した場合は戻らない)
+    if (!is_restart_requested_ && DeepSleep::TrySleep(wait_ms * 1000)) {
+      return;
+    }
+    // 受付期間中は終了時に再度確認する
+    const int64_t window_ms = DeepSleep::GetBleWindowRemainingMs();
+    if (0 < window_ms) {
+      wait_ms = std::min(wait_ms, window_ms);
+    }
+  }
+  WaitNotification(wait_ms);
 }
 
+void ClockManagementTask::Wake() { Notify(); }
+
 void ClockManagementTask::TaskDummy() {}
 
 void ClockManagementTask::TaskInitialize() {
   ESP_LOGI(TAG, "Start Initialize ----------");
 
+  // 記録から位置が分かっている場合は待機位置へ直接移動
+  if (is_position_known_) {
+    is_position_known_ = false;
+    ESP_LOGI(TAG, "Set Position Home (Restored)");
+    if (SetBothPosition(POSITION_LEFT_LIMIT, NORMAL_MOVE_HZ,
+                        POSITION_LEFT_LIMIT, NORMAL_MOVE_HZ)) {
+      clock_status_ = STATUS_SETTING_WAIT;
+      ESP_LOGI(TAG, "Finish Initialize ----------");
+      return;
+    }
+    ESP_LOGW(TAG, "Failed Restored Position. Reset Position");
+  }
+
   // モーター位置をリセット
   if (!ResetAllPosition(RESET_MOVE_HZ)) {
     ESP_LOGE(TAG, "Failed Reset Position.");
@@ -119,8 +292,8 @@ void ClockManagementTask::TaskInitialize() {
 
   // 初期待機位置に移動
   ESP_LOGI(TAG, "Set Position Home");
-  if (!SetBothPosition(POSITION_LEFT_LIMIT_MM, NORMAL_MOVE_HZ,
-                       POSITION_LEFT_LIMIT_MM, NORMAL_MOVE_HZ)) {
+  if (!SetBothPosition(POSITION_LEFT_LIMIT, NORMAL_MOVE_HZ,
+                       POSITION_LEFT_LIMIT, NORMAL_MOVE_HZ)) {
     ESP_LOGE(TAG, "Failed Motor Error.");
     clock_status_ = STATUS_ERROR;
     return;
@@ -150,15 +323,16 @@ void ClockManagementTask::TaskSetting() {
     return;
   }
   clock_status_ = STATUS_ENABLE;
+  HeapAudit::ResetSteadyState();
 
   ESP_LOGI(TAG, "Finish Setting ----------");
 }
 
 void ClockManagementTask::TaskEnable() {
   const std::tm time_info = Util::GetLocalTime();
-  const std::string time_str = Util::TimeToStr(time_info);
+  const Util::TimeStrBuffer time_str = Util::TimeToStrBuffer(time_info);
 
-  ESP_LOGI(TAG, "Status Enable. Now > %s", time_str.c_str());
+  ESP_LOGI(TAG, "Status Enable. Now > %s", time_str.data());
 
   if ((time_info.tm_hour % HALF_DAY_HOUR) != hour_) {
     hour_ = time_info.tm_hour % HALF_DAY_HOUR;
@@ -179,13 +353,15 @@ void ClockManagementTask::TaskEnable() {
       clock_status_ = STATUS_ERROR;
     }
   }
+
+  HeapAudit::CheckSteadyState("enable");
 }
 
 void ClockManagementTask::NextHour() {
   ESP_LOGI(TAG, "Begin Next Hour ----------");
 
   // Minuteを右リミット位置まで進める
-  if (SetMinutePosition(POSITION_RIGHT_LIMIT_MM, MINUTE_MOVE_HZ) !=
+  if (SetMinutePosition(POSITION_RIGHT_LIMIT, MINUTE_MOVE_HZ) !=
       RESULT_STEP_FINISH) {
     ESP_LOGE(TAG, "Failed Motor Error.");
     clock_status_ = STATUS_ERROR;
@@ -196,7 +372,7 @@ void ClockManagementTask::NextHour() {
   Util::SleepMillisecond(2000);
 
   // Minuteを60秒の位置まで一旦戻す(次の同時戻しと同じ速度で)
-  if (SetMinutePosition(POSITION_CLOCK_END_MM, MINUTE_RETURN_MOVE_HZ) !=
+  if (SetMinutePosition(POSITION_CLOCK_END, MINUTE_RETURN_MOVE_HZ) !=
       RESULT_STEP_FINISH) {
     ESP_LOGE(TAG, "Failed Motor Error.");
     clock_status_ = STATUS_ERROR;
@@ -205,7 +381,7 @@ void ClockManagementTask::NextHour() {
 
   // Hourを1時間進め、Minuteを0に戻す(同時・同時間)
   if (!SetBothPosition(CalcHourPos(hour_), HOUR_MOVE_HZ,
-                       POSITION_CLOCK_START_MM, MINUTE_RETURN_MOVE_HZ)) {
+                       POSITION_CLOCK_START, MINUTE_RETURN_MOVE_HZ)) {
     ESP_LOGE(TAG, "Failed Motor Error.");
     clock_status_ = STATUS_ERROR;
     return;
@@ -218,7 +394,7 @@ void ClockManagementTask::Next12Hour() {
   ESP_LOGI(TAG, "Begin Next 12Hour ----------");
 
   // Hourをゆっくり12時間位置まで進める
-  if (SetHourPosition(POSITION_CLOCK_END_MM, HOUR_MOVE_SLOW_HZ) !=
+  if (SetHourPosition(POSITION_CLOCK_END, HOUR_MOVE_SLOW_HZ) !=
       RESULT_STEP_FINISH) {
     ESP_LOGE(TAG, "Failed Motor Error.");
     clock_status_ = STATUS_ERROR;
@@ -229,7 +405,7 @@ void ClockManagementTask::Next12Hour() {
   Util::SleepMillisecond(2000);
 
   // Minuteを60秒位置まで進める。
-  if (SetMinutePosition(POSITION_CLOCK_END_MM, NORMAL_MOVE_HZ) !=
+  if (SetMinutePosition(POSITION_CLOCK_END, NORMAL_MOVE_HZ) !=
       RESULT_STEP_FINISH) {
     ESP_LOGE(TAG, "Failed Motor Error.");
     clock_status_ = STATUS_ERROR;
@@ -250,7 +426,7 @@ void ClockManagementTask::Next12Hour() {
   //Util::SleepMillisecond(1000);
 
   // Minuteを0位置に進める
-  if (SetMinutePosition(POSITION_CLOCK_START_MM, NORMAL_MOVE_HZ) !=
+  if (SetMinutePosition(POSITION_CLOCK_START, NORMAL_MOVE_HZ) !=
       RESULT_STEP_FINISH) {
     ESP_LOGE(TAG, "Failed Motor Error.");
     clock_status_ = STATUS_ERROR;
@@ -261,7 +437,7 @@ void ClockManagementTask::Next12Hour() {
   Util::SleepMillisecond(1000);
 
   // Hourをゆっくり0位置に進める
-  if (SetHourPosition(POSITION_CLOCK_START_MM, HOUR_MOVE_SLOW_HZ) !=
+  if (SetHourPosition(POSITION_CLOCK_START, HOUR_MOVE_SLOW_HZ) !=
       RESULT_STEP_FINISH) {
     ESP_LOGE(TAG, "Failed Motor Error.");
     clock_status_ = STATUS_ERROR;
@@ -271,12 +447,171 @@ void ClockManagementTask::Next12Hour() {
   ESP_LOGI(TAG, "Finish Next 12Hour ----------");
 }
 
+void ClockManagementTask::PlayChoreography() {
+  portENTER_CRITICAL(&choreography_mux_);
+  const bool is_pending = is_choreography_pending_;
+  is_choreography_pending_ = false;
+  is_choreography_playing_ = is_pending;
+  portEXIT_CRITICAL(&choreography_mux_);
+  if (!is_pending) {
+    return;
+  }
+
+  // 予約後に状態が変わった場合は実行しない
+  if (clock_status_ == STATUS_SETTING_WAIT || clock_status_ == STATUS_ENABLE) {
+    ESP_LOGI(TAG, "Begin Choreography (%u steps x%u) ----------",
+             choreography_.count, choreography_.repeat);
+
+    const auto to_hz = [](const uint16_t hz) {
+      if (hz == 0) {
+        return NORMAL_MOVE_HZ;
+      }
+      return std::clamp<uint32_t>(hz, CHOREOGRAPHY_MIN_MOVE_HZ,
+                                  CHOREOGRAPHY_MAX_MOVE_HZ);
+    };
+    bool is_success = true;
+    for (uint8_t round = 0; is_success && round < choreography_.repeat;
+         ++round) {
+      for (uint8_t i = 0; is_success && i < choreography_.count; ++i) {
+        const Choreography::Step& step = choreography_.steps[i];
+        if (step.hands == 0) {
+          Util::SleepMillisecond(step.wait_ms);
+          continue;
+        }
+        const Steps position =
+            POSITION_CLOCK_START +
+            StepperMotorUtil::ToSteps(
+                CLOCK_LENGTH *
+                std::min(step.position, Choreography::POSITION_SCALE) /
+                Choreography::POSITION_SCALE);
+        if (step.hands ==
+            (Choreography::HAND_HOUR | Choreography::HAND_MINUTE)) {
+          is_success = SetBothPosition(position, to_hz(step.hour_hz), position,
+                                       to_hz(step.minute_hz));
+        } else if (step.hands == Choreography::HAND_HOUR) {
+          is_success = SetHourPosition(position, to_hz(step.hour_hz)) ==
+                       RESULT_STEP_FINISH;
+        } else {
+          is_success = SetMinutePosition(position, to_hz(step.minute_hz)) ==
+                       RESULT_STEP_FINISH;
+        }
+      }
+    }
+
+    if (!is_success) {
+      ESP_LOGE(TAG, "Failed Motor Error.");
+      clock_status_ = STATUS_ERROR;
+    } else if (clock_status_ == STATUS_ENABLE) {
+      // 時刻の位置へ戻す
+      clock_status_ = STATUS_SETTING;
+    }
+    ESP_LOGI(TAG, "Finish Choreography ----------");
+  }
+
+  portENTER_CRITICAL(&choreography_mux_);
+  is_choreography_playing_ = false;
+  portEXIT_CRITICAL(&choreography_mux_);
+}
+
 void ClockManagementTask::TaskError() {
   // Monitoring LED ON
   GPIO::SetLevel(static_cast<gpio_num_t>(CONFIG_MONITORING_OUTPUT_GPIO_NO),
                  true);
 }
 
+void ClockManagementTask::TaskResume() {
+  ESP_LOGI(TAG, "Start Resume ----------");
+
+  // 記録位置の確認のため短く往復 (リミットに触れた場合は記録が不正)
+  const Steps hour_pos = hour_pos_left_;
+  const Steps minute_pos = minute_pos_left_;
+  if (!SetBothPosition(hour_pos - VERIFY_MOVE, SET_TIME_MOVE_HZ,
+                       minute_pos - VERIFY_MOVE, SET_TIME_MOVE_HZ) ||
+      !SetBothPosition(hour_pos, SET_TIME_MOVE_HZ, minute_pos,
+                       SET_TIME_MOVE_HZ)) {
+    ESP_LOGW(TAG, "Failed Verify Position. Reset Position");
+    checkpoint_.Invalidate();
+    is_moving_ = false;
+    is_position_known_ = false;
+    clock_status_ = STATUS_INITIALIZE;
+    return;
+  }
+
+  // 停止中に進んだ時刻へ移動して運転再開
+  clock_status_ = STATUS_SETTING;
+
+  ESP_LOGI(TAG, "Finish Resume ----------");
+}
+
+void ClockManagementTask::BeginMotion() {
+  if (is_moving_) {
+    return;
+  }
+  is_moving_ = true;
+  DeepSleep::OnMoveStart();
+
+  ClockCheckpoint::Data data = {};
+  data.hour_pos = hour_pos_left_.Count();
+  data.minute_pos = minute_pos_left_.Count();
+  data.saved_us = Util::GetEpochMicroseconds();
+  data.is_moving = 1;
+  checkpoint_.Save(data);
+}
+
+void ClockManagementTask::SaveCheckpoint() {
+  is_moving_ = false;
+
+  ClockCheckpoint::Data data = {};
+  data.hour_pos = hour_pos_left_.Count();
+  data.minute_pos = minute_pos_left_.Count();
+  data.saved_us = Util::GetEpochMicroseconds();
+  data.last_sync_us = drift_compensator_.GetLastSyncUs();
+  data.last_precise_sync_us = drift_compensator_.GetLastPreciseSyncUs();
+  data.is_time_set = (clock_status_ == STATUS_ENABLE) ? 1 : 0;
+  data.is_moving = 0;
+  data.sync_hops = sync_hops_;
+  checkpoint_.Save(data);
+}
+
+void ClockManagementTask::AddStateListener(
+    const ClockStateListenerInterfaceWeakPtr listener) {
+  state_listeners_.push_back(listener);
+}
+
+void ClockManagementTask::PublishState() {
+  ClockState state = {};
+  state.status = static_cast<uint8_t>(clock_status_);
+  state.hour = static_cast<uint8_t>(hour_);
+  state.minute = static_cast<uint8_t>(minute_);
+  state.hour_move_result = static_cast<uint8_t>(hour_move_result_);
+  state.minute_move_result = static_cast<uint8_t>(minute_move_result_);
+  state.hour_pos = hour_pos_left_.Count();
+  state.minute_pos = minute_pos_left_.Count();
+
+  if (is_state_published_ && state.status == published_state_.status &&
+      state.hour == published_state_.hour &&
+      state.minute == published_state_.minute &&
+      state.hour_move_result == published_state_.hour_move_result &&
+      state.minute_move_result == published_state_.minute_move_result &&
+      state.hour_pos == published_state_.hour_pos &&
+      state.minute_pos == published_state_.minute_pos) {
+    return;
+  }
+  published_state_ = state;
+  is_state_published_ = true;
+  portENTER_CRITICAL(&state_mux_);
+  shared_state_ = state;
+  portEXIT_CRITICAL(&state_mux_);
+
+  for (const ClockStateListenerInterfaceWeakPtr &weak_listener :
+       state_listeners_) {
+    ClockStateListenerInterfaceSharedPtr listener = weak_listener.lock();
+    if (listener) {
+      listener->OnClockStateChanged(state);
+    }
+  }
+}
+
 void ClockManagementTask::EmergencyStop() {
   ESP_LOGW(TAG, "Emergency Stop ----------");
   if (stepper_motor_hour_) {
@@ -287,50 +622,57 @@ void ClockManagementTask::EmergencyStop() {
   }
 }
 
-MoveResult ClockManagementTask::SetHourPosition(const uint32_t position_left_mm,
+MoveResult ClockManagementTask::SetHourPosition(const Steps position_left,
                                                 const uint32_t freq) {
-  const int32_t move_length_mm = position_left_mm - hour_pos_left_mm_;
-  const RotateDir rotate_dir =
-      (0 <= move_length_mm) ? RotateDir::ROTATE_RIGHT : RotateDir::ROTATE_LEFT;
+  const Steps move_length = position_left - hour_pos_left_;
+  const RotateDir rotate_dir = (Steps() <= move_length)
+                                   ? RotateDir::ROTATE_RIGHT
+                                   : RotateDir::ROTATE_LEFT;
 
-  ESP_LOGI(TAG, "Move Hour now_pos:%dmm new_hour_pos:%dmm move_len:%dmm",
-           hour_pos_left_mm_, position_left_mm, move_length_mm);
+  ESP_LOGI(TAG, "Move Hour now_pos:%dstep new_hour_pos:%dstep move_len:%dstep",
+           hour_pos_left_.Count(), position_left.Count(), move_length.Count());
 
   if (!stepper_motor_hour_) {
     return RESULT_ERROR;
   }
+  BeginMotion();
   MoveResultFuture exec_future =
       stepper_motor_hour_->ExecMoveAsync(StepperMotorExecInfo(
           rotate_dir, StepperMotorUtil::FrequencyToTick(freq),
-          StepperMotorUtil::MMtoStep(std::abs(move_length_mm))));
+          move_length.Abs()));
 
   MoveResult move_result = exec_future.get();
+  hour_move_result_ = move_result;
   if (move_result == RESULT_STEP_FINISH) {
-    hour_pos_left_mm_ = position_left_mm;
+    hour_pos_left_ = position_left;
   }
   return move_result;
 }
 
-MoveResult ClockManagementTask::SetMinutePosition(
-    const uint32_t position_left_mm, const uint32_t freq) {
-  const int32_t move_length_mm = position_left_mm - minute_pos_left_mm_;
-  const RotateDir rotate_dir =
-      (0 <= move_length_mm) ? RotateDir::ROTATE_RIGHT : RotateDir::ROTATE_LEFT;
+MoveResult ClockManagementTask::SetMinutePosition(const Steps position_left,
+                                                  const uint32_t freq) {
+  const Steps move_length = position_left - minute_pos_left_;
+  const RotateDir rotate_dir = (Steps() <= move_length)
+                                   ? RotateDir::ROTATE_RIGHT
+                                   : RotateDir::ROTATE_LEFT;
 
-  ESP_LOGI(TAG, "Move Min now_pos:%dmm new_minute_pos:%dmm move_len:%dmm",
-           minute_pos_left_mm_, position_left_mm, move_length_mm);
+  ESP_LOGI(TAG, "Move Min now_pos:%dstep new_minute_pos:%dstep move_len:%dstep",
+           minute_pos_left_.Count(), position_left.Count(),
+           move_length.Count());
 
   if (!stepper_motor_minute_) {
     return RESULT_ERROR;
   }
+  BeginMotion();
   MoveResultFuture exec_future =
       stepper_motor_minute_->ExecMoveAsync(StepperMotorExecInfo(
           rotate_dir, StepperMotorUtil::FrequencyToTick(freq),
-          StepperMotorUtil::MMtoStep(std::abs(move_length_mm))));
+          move_length.Abs()));
 
   MoveResult move_result = exec_future.get();
+  minute_move_result_ = move_result;
   if (move_result == RESULT_STEP_FINISH) {
-    minute_pos_left_mm_ = position_left_mm;
+    minute_pos_left_ = position_left;
   }
   return move_result;
 }
@@ -341,40 +683,47 @@ bool ClockManagementTask::ResetAllPosition(const uint32_t move_hz) {
   if (!stepper_motor_hour_ || !stepper_motor_minute_) {
     return false;
   }
+  BeginMotion();
 
   MoveResultFuture hour_reset_future = stepper_motor_hour_->ExecMoveAsync(
       StepperMotorExecInfo(RotateDir::ROTATE_LEFT,
                            StepperMotorUtil::FrequencyToTick(move_hz),
-                           StepperMotorUtil::MMtoStep(POSITION_RESET_MOVE_MM)));
+                           POSITION_RESET_MOVE));
 
   MoveResultFuture minute_reset_future = stepper_motor_minute_->ExecMoveAsync(
       StepperMotorExecInfo(RotateDir::ROTATE_LEFT,
                            StepperMotorUtil::FrequencyToTick(move_hz),
-                           StepperMotorUtil::MMtoStep(POSITION_RESET_MOVE_MM)));
+                           POSITION_RESET_MOVE));
 
   const MoveResult hour_reset_result = hour_reset_future.get();
   const MoveResult minute_reset_result = minute_reset_future.get();
+  hour_move_result_ = hour_reset_result;
+  minute_move_result_ = minute_reset_result;
 
   ESP_LOGI(TAG, "Reset Position Result Hour:%d Minute:%d", hour_reset_result,
            minute_reset_result);
 
-  hour_pos_left_mm_ = 0;
-  minute_pos_left_mm_ = 0;
+  hour_pos_left_ = POSITION_LEFT_RESET;
+  minute_pos_left_ = POSITION_LEFT_RESET;
+  stepper_motor_hour_->SetPosition(POSITION_LEFT_RESET);
+  stepper_motor_minute_->SetPosition(POSITION_LEFT_RESET);
 
   return hour_reset_result == RESULT_LEFT_LIMIT &&
          minute_reset_result == RESULT_LEFT_LIMIT;
 }
 
-bool ClockManagementTask::SetBothPosition(const uint32_t hour_pos,
+bool ClockManagementTask::SetBothPosition(const Steps hour_pos,
                                           const uint32_t hour_hz,
-                                          const uint32_t minute_pos,
+                                          const Steps minute_pos,
                                           const uint32_t minute_hz) {
-  const int32_t move_length_mm = hour_pos - hour_pos_left_mm_;
-  const RotateDir rotate_dir =
-      (0 <= move_length_mm) ? RotateDir::ROTATE_RIGHT : RotateDir::ROTATE_LEFT;
-  ESP_LOGI(TAG, "Move Hour now_pos:%dmm new_hour_pos:%dmm move_len:%dmm",
-           hour_pos_left_mm_, hour_pos, move_length_mm);
-  hour_pos_left_mm_ = hour_pos;
+  const Steps move_length = hour_pos - hour_pos_left_;
+  const RotateDir rotate_dir = (Steps() <= move_length)
+                                   ? RotateDir::ROTATE_RIGHT
+                                   : RotateDir::ROTATE_LEFT;
+  ESP_LOGI(TAG, "Move Hour now_pos:%dstep new_hour_pos:%dstep move_len:%dstep",
+           hour_pos_left_.Count(), hour_pos.Count(), move_length.Count());
+  BeginMotion();
+  hour_pos_left_ = hour_pos;
 
   if (!stepper_motor_hour_) {
     return false;
@@ -382,24 +731,95 @@ bool ClockManagementTask::SetBothPosition(const uint32_t hour_pos,
   MoveResultFuture hour_future =
       stepper_motor_hour_->ExecMoveAsync(StepperMotorExecInfo(
           rotate_dir, StepperMotorUtil::FrequencyToTick(hour_hz),
-          StepperMotorUtil::MMtoStep(std::abs(move_length_mm))));
+          move_length.Abs()));
 
   MoveResult minute_result = SetMinutePosition(minute_pos, minute_hz);
   MoveResult hour_result = hour_future.get();
+  hour_move_result_ = hour_result;
 
   return hour_result == RESULT_STEP_FINISH &&
          minute_result == RESULT_STEP_FINISH;
 }
 
 void ClockManagementTask::SetUnixTime(const std::time_t epoc) {
-  // BLEスレッドから利用されるため、処理は最低限で
-  if (clock_status_ == STATUS_SETTING_WAIT || clock_status_ == STATUS_ENABLE) {
-    // 設定中状態
-    clock_status_ = STATUS_SETTING;
-    Util::SetSystemTime(epoc);
-    const std::string time_str = Util::TimeToStr(Util::GetLocalTime());
-    ESP_LOGI(TAG, "Set Time > %s", time_str.c_str());
+  // BLEスレッドから利用されるため、予約のみ行いUpdateで適用
+  SyncRequest request = {};
+  request.offset_us =
+      static_cast<int64_t>(epoc) * 1000000 - Util::GetEpochMicroseconds();
+  request.uncertainty_ms = SECOND_SYNC_UNCERTAINTY_MS;
+  request.hops = 0;
+  request.is_precise = false;
+  request.is_step_required = true;
+  RequestSync(request);
+}
+
+void ClockManagementTask::AdjustTime(const int64_t offset_us) {
+  AdoptTime(offset_us, 0, TimeBeacon::CalcBaseUncertaintyMs(0));
+}
+
+void ClockManagementTask::AdoptTime(const int64_t offset_us,
+                                    const uint8_t hops,
+                                    const uint16_t uncertainty_ms) {
+  // BLE・SNTP・ビーコンのスレッドから利用されるため、予約のみ行いUpdateで適用
+  // 中継された時刻は中継元の誤差を含むため、ずれの推定には直接の同期のみ使う
+  SyncRequest request = {};
+  request.offset_us = offset_us;
+  request.uncertainty_ms = uncertainty_ms;
+  request.hops = hops;
+  request.is_precise = hops == 0;
+  request.is_step_required = false;
+  RequestSync(request);
+}
+
+void ClockManagementTask::RequestSync(const SyncRequest& request) {
+  portENTER_CRITICAL(&sync_mux_);
+  sync_request_ = request;
+  is_sync_pending_ = true;
+  portEXIT_CRITICAL(&sync_mux_);
+  Wake();
+}
+
+void ClockManagementTask::ApplySync() {
+  portENTER_CRITICAL(&sync_mux_);
+  const bool is_pending = is_sync_pending_;
+  const SyncRequest request = sync_request_;
+  is_sync_pending_ = false;
+  portEXIT_CRITICAL(&sync_mux_);
+  if (!is_pending) {
+    return;
+  }
+  // システム時刻の補正は時計管理タスクのみで行う (DriftCompensator::Updateと同じ)
+  if (clock_status_ != STATUS_SETTING_WAIT && clock_status_ != STATUS_ENABLE) {
+    return;
   }
+
+  drift_compensator_.OnSync(request.offset_us, request.is_precise);
+  portENTER_CRITICAL(&sync_mux_);
+  sync_hops_ = request.hops;
+  sync_uncertainty_ms_ = request.uncertainty_ms;
+  portEXIT_CRITICAL(&sync_mux_);
+
+  if (clock_status_ == STATUS_ENABLE && !request.is_step_required &&
+      std::abs(request.offset_us) <= TIME_SLEW_LIMIT_US) {
+    // 運転中の小さなずれは針を止めずに徐々に補正
+    Util::SlewSystemTime(request.offset_us);
+    ESP_LOGI(TAG, "Slew Time > %" PRId64 "us", request.offset_us);
+    return;
+  }
+
+  // 設定中状態
+  clock_status_ = STATUS_SETTING;
+  Util::StepSystemTime(request.offset_us);
+  const Util::TimeStrBuffer time_str =
+      Util::TimeToStrBuffer(Util::GetLocalTime());
+  ESP_LOGI(TAG, "Step Time > %s (%" PRId64 "us)", time_str.data(),
+           request.offset_us);
+}
+
+void ClockManagementTask::Restart() {
+  // BLEスレッドから利用されるため、移動の完了後にUpdateで記録して再起動
+  is_restart_requested_ = true;
+  Wake();
 }
 
 std::time_t ClockManagementTask::GetUnixTime() const {
@@ -409,12 +829,75 @@ std::time_t ClockManagementTask::GetUnixTime() const {
   return 0u;
 }
 
-int32_t ClockManagementTask::CalcHourPos(const int32_t hour) const {
-  return POSITION_CLOCK_START_MM + ((hour_ % HALF_DAY_HOUR) * CLOCK_HOUR_MM);
+HareTortoiseClockInterface::TimeSyncState
+ClockManagementTask::GetTimeSyncState() const {
+  HareTortoiseClockInterface::TimeSyncState state = {};
+  state.last_sync_us = drift_compensator_.GetLastSyncUs();
+  state.is_synced = STATUS_ENABLE <= clock_status_ && state.last_sync_us != 0;
+  portENTER_CRITICAL(&sync_mux_);
+  state.hops = sync_hops_;
+  state.uncertainty_ms = sync_uncertainty_ms_;
+  portEXIT_CRITICAL(&sync_mux_);
+  state.drift_ppb = drift_compensator_.GetDriftPpb();
+  return state;
+}
+
+ClockState ClockManagementTask::GetClockState() const {
+  portENTER_CRITICAL(&state_mux_);
+  const ClockState state = shared_state_;
+  portEXIT_CRITICAL(&state_mux_);
+  return state;
+}
+
+bool ClockManagementTask::RunChoreography(const Choreography& choreography) {
+  // BLEスレッドから利用されるため、予約のみ行いUpdateで実行
+  if (clock_status_ != STATUS_SETTING_WAIT && clock_status_ != STATUS_ENABLE) {
+    return false;
+  }
+  if (choreography.count == 0 ||
+      Choreography::MAX_STEPS < choreography.count) {
+    return false;
+  }
+  portENTER_CRITICAL(&choreography_mux_);
+  const bool is_busy = is_choreography_pending_ || is_choreography_playing_;
+  if (!is_busy) {
+    choreography_ = choreography;
+    is_choreography_pending_ = true;
+  }
+  portEXIT_CRITICAL(&choreography_mux_);
+  if (is_busy) {
+    return false;
+  }
+  Wake();
+  return true;
+}
+
+bool ClockManagementTask::RestoreDisplayedTime() {
+  // 運転中の記録は目盛の位置にある
+  const int32_t hour_offset = (hour_pos_left_ - POSITION_CLOCK_START).Count();
+  const int32_t minute_offset =
+      (minute_pos_left_ - POSITION_CLOCK_START).Count();
+  if (hour_offset < 0 || minute_offset < 0 ||
+      hour_offset % CLOCK_HOUR.Count() != 0 ||
+      minute_offset % CLOCK_MINUTE.Count() != 0) {
+    return false;
+  }
+  const int32_t hour = hour_offset / CLOCK_HOUR.Count();
+  const int32_t minute = minute_offset / CLOCK_MINUTE.Count();
+  if (HALF_DAY_HOUR <= hour || 60 <= minute) {
+    return false;
+  }
+  hour_ = hour;
+  minute_ = minute;
+  return true;
+}
+
+Steps ClockManagementTask::CalcHourPos(const int32_t hour) const {
+  return POSITION_CLOCK_START + CLOCK_HOUR * (hour % HALF_DAY_HOUR);
 }
 
-int32_t ClockManagementTask::CalcMinutePos(const int32_t min) const {
-  return POSITION_CLOCK_START_MM + (minute_ * CLOCK_MINUTE_MM);
+Steps ClockManagementTask::CalcMinutePos(const int32_t min) const {
+  return POSITION_CLOCK_START + CLOCK_MINUTE * min;
 }
 
 }  // namespace HareTortoiseClockSystem
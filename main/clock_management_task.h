@@ -4,12 +4,18 @@
 // (C)2024 bekki.jp
 
 // Include ----------------------
+#include <atomic>
 #include <chrono>
 #include <functional>
+#include <vector>
 
+#include "clock_checkpoint.h"
+#include "drift_compensator.h"
 #include "hare_tortoise_clock_interface.h"
+#include "power_fail_monitor.h"
 #include "stepper_motor_controller.h"
 #include "task.h"
+#include "units.h"
 
 namespace HareTortoiseClockSystem {
 
@@ -18,8 +24,9 @@ class ClockManagementTask final : public Task {
   static constexpr std::string_view TASK_NAME = "ClockManagementTask";
   static constexpr int32_t PRIORITY = Task::PRIORITY_LOW;
   static constexpr int32_t CORE_ID = PRO_CPU_NUM;
+  static constexpr uint32_t STACK_DEPTH = 4096;
 
- private:
+  /// 時計の状態 (ClockState::statusの値)
   enum ClockStatus {
     STATUS_NONE = 0,
     STATUS_ERROR,
@@ -27,9 +34,11 @@ class ClockManagementTask final : public Task {
     STATUS_SETTING_WAIT,
     STATUS_ENABLE,
     STATUS_SETTING,
+    STATUS_RESUME,
     MAX_CLOCK_STATUS,
   };
 
+ private:
   static const std::function<void(ClockManagementTask&)>
       UPDATE_TASKS[MAX_CLOCK_STATUS];
 
@@ -42,39 +51,105 @@ class ClockManagementTask final : public Task {
 
   void EmergencyStop();
 
+  /// 状態変化の通知先の追加 (Start前に設定)
+  void AddStateListener(const ClockStateListenerInterfaceWeakPtr listener);
+
   void SetUnixTime(const std::time_t epoc);
+  void AdjustTime(const int64_t offset_us);
+  void AdoptTime(const int64_t offset_us, const uint8_t hops,
+                 const uint16_t uncertainty_ms);
+  void Restart();
   std::time_t GetUnixTime() const;
+  HareTortoiseClockInterface::TimeSyncState GetTimeSyncState() const;
+  ClockState GetClockState() const;
+  bool RunChoreography(const Choreography& choreography);
 
  private:
   bool ResetAllPosition(const uint32_t move_hz);
-  bool SetBothPosition(const uint32_t hour_pos, const uint32_t hour_hz,
-                       const uint32_t minute_pos, const uint32_t minute_hz);
-  MoveResult SetHourPosition(const uint32_t position_left_mm,
-                             const uint32_t freq);
-  MoveResult SetMinutePosition(const uint32_t position_left_mm,
-                               const uint32_t freq);
+  bool SetBothPosition(const Steps hour_pos, const uint32_t hour_hz,
+                       const Steps minute_pos, const uint32_t minute_hz);
+  MoveResult SetHourPosition(const Steps position_left, const uint32_t freq);
+  MoveResult SetMinutePosition(const Steps position_left, const uint32_t freq);
+
+  /// 記録した針位置から表示中の時刻を復元 (目盛の位置にない場合false)
+  bool RestoreDisplayedTime();
 
-  int32_t CalcHourPos(const int32_t hour) const;
-  int32_t CalcMinutePos(const int32_t min) const;
+  Steps CalcHourPos(const int32_t hour) const;
+  Steps CalcMinutePos(const int32_t min) const;
 
   void TaskDummy();
   void TaskInitialize();
   void TaskSetting();
   void TaskEnable();
   void TaskError();
+  void TaskResume();
+
+  /// 他タスクからの時刻の同期要求 (Updateで時計管理タスクが適用する)
+  struct SyncRequest {
+    /// 要求時点のシステム時刻とのずれ(us)
+    int64_t offset_us;
+    uint16_t uncertainty_ms;
+    uint8_t hops;
+    /// ずれの推定に使う直接の同期か
+    bool is_precise;
+    /// ずれが小さくても針を止めて設定し直す (時刻の設定)
+    bool is_step_required;
+  };
+  void RequestSync(const SyncRequest& request);
+  void ApplySync();
+
+  void WaitNextUpdate();
+  void Wake();
+
+  void BeginMotion();
+  void SaveCheckpoint();
+  void PublishState();
 
   void NextHour();
   void Next12Hour();
+  void PlayChoreography();
 
  private:
+  StackType_t stack_buffer_[STACK_DEPTH];
   const HareTortoiseClockInterfaceWeakPtr hare_tortoise_clock_interface_;
-  ClockStatus clock_status_;
+  /// 時計管理タスクのみが変更する (他タスクは参照のみ)
+  std::atomic<ClockStatus> clock_status_;
   StepperMotorControllerSharedPtr stepper_motor_hour_;
   StepperMotorControllerSharedPtr stepper_motor_minute_;
   int32_t hour_;
   int32_t minute_;
-  int32_t hour_pos_left_mm_;
-  int32_t minute_pos_left_mm_;
+  Steps hour_pos_left_;
+  Steps minute_pos_left_;
+  DriftCompensator drift_compensator_;
+  ClockCheckpoint checkpoint_;
+  PowerFailMonitor power_fail_monitor_;
+  /// 移動開始を記録済みで、完了の記録が未了か
+  bool is_moving_;
+  /// 記録から針位置を復元済みか (原点復帰を省略できる)
+  bool is_position_known_;
+  std::atomic<bool> is_restart_requested_;
+  /// 同期元からの段数と同期時点の推定誤差(ms) (時刻ビーコン)
+  /// 時計管理タスクのみが変更し、他タスクはsync_mux_内で参照する
+  mutable portMUX_TYPE sync_mux_;
+  uint8_t sync_hops_;
+  uint16_t sync_uncertainty_ms_;
+  /// 未適用の同期要求 (後の要求で置き換える 要求時点のずれのため加算しない)
+  SyncRequest sync_request_;
+  bool is_sync_pending_;
+  MoveResult hour_move_result_;
+  MoveResult minute_move_result_;
+  std::vector<ClockStateListenerInterfaceWeakPtr> state_listeners_;
+  /// 最後に通知した状態 (変化した場合のみ通知する)
+  ClockState published_state_;
+  bool is_state_published_;
+  /// 他タスクから参照する状態 (published_state_の写し)
+  mutable portMUX_TYPE state_mux_;
+  ClockState shared_state_;
+  /// 予約された振り付け (BLEスレッドから設定)
+  portMUX_TYPE choreography_mux_;
+  Choreography choreography_;
+  bool is_choreography_pending_;
+  bool is_choreography_playing_;
 };
 
 using ClockManagementSharedPtr = std::shared_ptr<ClockManagementTask>;
@@ -0,0 +1,73 @@
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include "command_protocol.h"
+
+#include <algorithm>
+
+namespace HareTortoiseClockSystem::CommandProtocol {
+
+bool ParseHeader(ConstByteSpan data, Header *const header) {
+  if (data.size() < HEADER_LENGTH) {
+    return false;
+  }
+  header->version = data[0];
+  header->flags = data[1];
+  header->sequence = data[2];
+  return true;
+}
+
+Reader::Reader(ConstByteSpan data)
+    : data_(data),
+      offset_(HEADER_LENGTH),
+      is_malformed_(data.size() < HEADER_LENGTH) {}
+
+bool Reader::Next(Tlv *const tlv) {
+  if (is_malformed_ || data_.size() <= offset_) {
+    return false;
+  }
+  const ConstByteSpan rest = data_.subspan(offset_);
+  if (rest.size() < TLV_HEADER_LENGTH ||
+      rest.size() - TLV_HEADER_LENGTH < rest[1]) {
+    is_malformed_ = true;
+    return false;
+  }
+  tlv->type = rest[0];
+  tlv->length = rest[1];
+  tlv->value = rest.data() + TLV_HEADER_LENGTH;
+  offset_ += TLV_HEADER_LENGTH + tlv->length;
+  return true;
+}
+
+Writer::Writer(MutableByteSpan buffer, const Header &header)
+    : buffer_(buffer), length_(0) {
+  if (buffer_.size() < HEADER_LENGTH) {
+    return;
+  }
+  buffer_[0] = header.version;
+  buffer_[1] = header.flags;
+  buffer_[2] = header.sequence;
+  length_ = HEADER_LENGTH;
+}
+
+bool Writer::Append(const uint8_t type, const Result result,
+                    ConstByteSpan value) {
+  // [種別][長さ][結果][値]
+  const size_t entry_length = TLV_HEADER_LENGTH + 1 + value.size();
+  if (length_ == 0 || UINT8_MAX < 1 + value.size() ||
+      buffer_.size() - length_ < entry_length) {
+    if (length_ != 0) {
+      buffer_[1] |= FLAG_TRUNCATED;
+    }
+    return false;
+  }
+  buffer_[length_] = type;
+  buffer_[length_ + 1] = static_cast<uint8_t>(1 + value.size());
+  buffer_[length_ + 2] = result;
+  std::copy(value.begin(), value.end(), &buffer_[length_ + 3]);
+  length_ += entry_length;
+  return true;
+}
+
+}  // namespace HareTortoiseClockSystem::CommandProtocol
@@ -0,0 +1,137 @@
+#ifndef COMMAND_PROTOCOL_H_
+#define COMMAND_PROTOCOL_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include <cstddef>
+#include <cstdint>
+
+#include "byte_span.h"
+
+/// コマンドCharacteristicの一括コマンド形式 (TLV)
+/// 要求: [版][フラグ][連番] + ([種別][長さ][値])*
+/// 応答: [版][フラグ][連番] + ([種別][長さ][結果][値])*  長さは結果を含む
+/// 数値はビッグエンディアン (他のCharacteristicに合わせる LoadBigEndianで読み出す)
+/// 受信バッファを直接走査しヒープ確保を行わない
+/// 各コマンドの実行はBleCommandCharacteristic::Executeが行う
+namespace HareTortoiseClockSystem::CommandProtocol {
+
+/// 形式の版
+constexpr uint8_t VERSION = 1;
+/// ヘッダ長 [版][フラグ][連番]
+constexpr size_t HEADER_LENGTH = 3;
+/// TLVのヘッダ長 [種別][長さ]
+constexpr size_t TLV_HEADER_LENGTH = 2;
+
+/// 要求フラグ: 全て成功した場合は応答しない (Write Without Responseでの連続送信用)
+constexpr uint8_t FLAG_NO_REPLY = 0x01;
+/// 応答フラグ: 応答が通知長に収まらず一部を省略した
+constexpr uint8_t FLAG_TRUNCATED = 0x80;
+
+/// コマンド種別
+enum Type : uint8_t {
+  /// 再起動 []
+  TYPE_RESTART = 0x01,
+  /// 緊急停止 []
+  TYPE_EMERGENCY_STOP = 0x02,
+  /// 時刻設定 [Unix時間(秒) uint64]
+  TYPE_SET_TIME = 0x10,
+  /// 時刻補正 [補正量(us) int64]
+  TYPE_ADJUST_TIME = 0x11,
+  /// 以降の針移動の速度 [時針(Hz) uint16][分針(Hz) uint16] 0は標準速度
+  TYPE_SET_SPEED = 0x20,
+  /// 針移動 [対象(HAND_*) uint8][位置(目盛の千分率) uint16]
+  TYPE_MOVE_HAND = 0x21,
+  /// 待機 [時間(ms) uint16]
+  TYPE_WAIT = 0x22,
+  /// それまでの針移動・待機を振り付けとして実行 [繰り返し回数 uint8]
+  TYPE_RUN_CHOREOGRAPHY = 0x23,
+  /// 時計の状態 [] -> 状態Characteristicと同じ13byte
+  TYPE_QUERY_STATE = 0x30,
+  /// 同期状態 [] -> [同期済み][段数][誤差(ms) uint16][最終同期(us) int64]
+  ///                 [ずれ(ppb) int32]
+  TYPE_QUERY_SYNC = 0x31,
+  /// 時刻 [] -> [Unix時間(秒) uint64]
+  TYPE_QUERY_TIME = 0x32,
+  /// フレーム全体に対する結果 (応答のみ)
+  TYPE_FRAME = 0xFF,
+};
+
+/// 針移動の対象
+constexpr uint8_t HAND_HOUR = 0x01;
+constexpr uint8_t HAND_MINUTE = 0x02;
+
+/// 処理結果
+enum Result : uint8_t {
+  RESULT_OK = 0,
+  /// 未知の種別
+  RESULT_UNKNOWN_TYPE,
+  /// 値の長さが不正
+  RESULT_INVALID_LENGTH,
+  /// 値が範囲外
+  RESULT_INVALID_VALUE,
+  /// 現在の状態では実行できない
+  RESULT_NOT_READY,
+  /// 実行中の処理がある・振り付けが長すぎる
+  RESULT_BUSY,
+  /// 未対応の版
+  RESULT_UNSUPPORTED_VERSION,
+  /// フレームの途中で切れている
+  RESULT_MALFORMED,
+};
+
+struct Header {
+  uint8_t version;
+  uint8_t flags;
+  uint8_t sequence;
+};
+
+struct Tlv {
+  uint8_t type;
+  uint8_t length;
+  /// 受信バッファ内を指す (コピーしない)
+  const uint8_t *value;
+};
+
+/// ヘッダの解析 (長さ不足時false 版は呼び出し側で確認)
+bool ParseHeader(ConstByteSpan data, Header *const header);
+
+/// 要求フレームのTLVを順に取り出す
+class Reader final {
+ public:
+  /// dataはヘッダを含むフレーム全体
+  explicit Reader(ConstByteSpan data);
+
+  /// 次のTLV (終端または不正な場合false)
+  bool Next(Tlv *const tlv);
+  /// 途中で切れたTLVがあったか
+  bool IsMalformed() const { return is_malformed_; }
+
+ private:
+  const ConstByteSpan data_;
+  size_t offset_;
+  bool is_malformed_;
+};
+
+/// 応答フレームを固定長バッファに組み立てる
+class Writer final {
+ public:
+  Writer(MutableByteSpan buffer, const Header &header);
+
+  /// 結果を追加 (収まらない場合は省略してFLAG_TRUNCATEDを立てる)
+  bool Append(const uint8_t type, const Result result,
+              ConstByteSpan value = ConstByteSpan());
+
+  size_t GetLength() const { return length_; }
+  /// 結果を追加したか
+  bool IsEmpty() const { return length_ <= HEADER_LENGTH; }
+
+ private:
+  const MutableByteSpan buffer_;
+  size_t length_;
+};
+
+}  // namespace HareTortoiseClockSystem::CommandProtocol
+
+#endif  // COMMAND_PROTOCOL_H_
@@ -0,0 +1,253 @@
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include "deep_sleep.h"
+
+#include <sdkconfig.h>
+
+// 無効時は停止処理を含まないため、ESP-IDF固有の機能は有効時のみ参照する
+#ifdef CONFIG_DEEP_SLEEP
+#include <driver/gpio.h>
+#include <driver/rtc_io.h>
+#include <esp_attr.h>
+#include <esp_bt.h>
+#include <esp_bt_main.h>
+#include <esp_ota_ops.h>
+#include <esp_sleep.h>
+#include <esp_timer.h>
+
+#include <algorithm>
+#include <cinttypes>
+
+#include "ble_device.h"
+#include "logger.h"
+#include "util.h"
+#endif
+
+namespace HareTortoiseClockSystem::DeepSleep {
+
+#ifdef CONFIG_DEEP_SLEEP
+namespace {
+
+/// 針ドライバの有効化出力 (HIGHで無効) deep sleep中も無効のまま保持する
+constexpr gpio_num_t DRIVER_ENABLE_GPIOS[] = {
+    static_cast<gpio_num_t>(CONFIG_HOUR_HAND_ENABLE_OUTPUT_GPIO_NO),
+    static_cast<gpio_num_t>(CONFIG_MINUTE_HAND_ENABLE_OUTPUT_GPIO_NO),
+};
+/// 受付期間を開くボタン (LOWで押下 RTC GPIOのみ)
+constexpr gpio_num_t WAKE_BUTTON_GPIO =
+    static_cast<gpio_num_t>(CONFIG_DEEP_SLEEP_WAKE_BUTTON_GPIO_NO);
+
+/// 受付期間(us) 起動から数える
+constexpr int64_t BLE_WINDOW_US = CONFIG_DEEP_SLEEP_BLE_WINDOW_SEC * 1000000ll;
+
+/// 平均電流の推定に用いる消費電流(uA)
+/// ESP32単体の代表値 (モータードライバ・周辺回路は含まない)
+constexpr int64_t ACTIVE_CURRENT_UA = 40000;  // 160MHz 無線停止
+constexpr int64_t RADIO_CURRENT_UA = 100000;  // BLE起動中
+constexpr int64_t SLEEP_CURRENT_UA = 10;      // RTCタイマー・RTCメモリ
+
+/// deep sleepをまたいで保持する状態 (電源投入・リセットで0に初期化)
+struct State {
+  /// 次の受付期間までの起床回数
+  int32_t wakes_until_window;
+  /// sleep開始時刻・起床予定時刻 (Unix時間 us)
+  int64_t sleep_begin_us;
+  int64_t wake_target_us;
+  /// 統計 (前回の報告以降)
+  uint32_t wake_count;
+  uint32_t latency_count;
+  int64_t latency_total_us;
+  int64_t latency_max_us;
+  int64_t active_us;
+  int64_t radio_us;
+  int64_t sleep_us;
+};
+RTC_DATA_ATTR State rtc_state;
+
+/// 今回の起動の状態
+esp_sleep_wakeup_cause_t wake_cause = ESP_SLEEP_WAKEUP_UNDEFINED;
+bool is_ble_window = true;
+int64_t slept_us = 0;
+/// 起床時点のesp_timer時刻(us) (ROM・ブートローダの時間の分だけ負)
+int64_t wake_monotonic_us = 0;
+bool is_latency_recorded = false;
+
+/// 更新後の初回起動で検証待ちか (再起動とみなされ以前のファームウェアに戻る)
+bool IsPendingVerify() {
+  const esp_partition_t *const running = esp_ota_get_running_partition();
+  esp_ota_img_states_t state = ESP_OTA_IMG_UNDEFINED;
+  return running != nullptr &&
+         esp_ota_get_state_partition(running, &state) == ESP_OK &&
+         state == ESP_OTA_IMG_PENDING_VERIFY;
+}
+
+void ReportStatistics() {
+  State &state = rtc_state;
+  const int64_t total_us = state.active_us + state.radio_us + state.sleep_us;
+  if (total_us <= 0) {
+    return;
+  }
+  // 状態毎の時間で重み付けした平均
+  const int64_t average_ua =
+      (ACTIVE_CURRENT_UA * state.active_us + RADIO_CURRENT_UA * state.radio_us +
+       SLEEP_CURRENT_UA * state.sleep_us) /
+      total_us;
+  const int64_t latency_average_us =
+      state.latency_count == 0 ? 0
+                               : state.latency_total_us / state.latency_count;
+  ESP_LOGI(TAG,
+           "Deep Sleep Stats > wakes:%" PRIu32 " wake to move avg:%" PRId64
+           "ms max:%" PRId64 "ms active:%" PRId64 "ms radio:%" PRId64
+           "ms sleep:%" PRId64 "s average:%" PRId64 "uA (estimate)",
+           state.wake_count, latency_average_us / 1000,
+           state.latency_max_us / 1000, state.active_us / 1000,
+           state.radio_us / 1000, state.sleep_us / 1000000, average_ua);
+
+  state.wake_count = 0;
+  state.latency_count = 0;
+  state.latency_total_us = 0;
+  state.latency_max_us = 0;
+  state.active_us = 0;
+  state.radio_us = 0;
+  state.sleep_us = 0;
+}
+
+}  // namespace
+
+void Initialize() {
+  // 無効(HIGH)を設定してから保持を解除 (解除時に一瞬でも有効にしない)
+  for (const gpio_num_t gpio : DRIVER_ENABLE_GPIOS) {
+    gpio_set_level(gpio, 1);
+    gpio_set_direction(gpio, GPIO_MODE_OUTPUT);
+    gpio_hold_dis(gpio);
+  }
+  gpio_deep_sleep_hold_dis();
+
+  const int64_t now_us = Util::GetEpochMicroseconds();
+  wake_cause = esp_sleep_get_wakeup_cause();
+  int64_t wake_us = now_us - esp_timer_get_time();
+  if (wake_cause == ESP_SLEEP_WAKEUP_TIMER) {
+    // RTCタイマーは予定時刻に起床させる
+    wake_us = rtc_state.wake_target_us;
+    wake_monotonic_us = esp_timer_get_time() - (now_us - wake_us);
+    is_ble_window = --rtc_state.wakes_until_window <= 0;
+  } else if (wake_cause == ESP_SLEEP_WAKEUP_EXT0) {
+    rtc_gpio_deinit(WAKE_BUTTON_GPIO);
+  }
+
+  if (IsWakeFromSleep()) {
+    slept_us = std::max<int64_t>(0, wake_us - rtc_state.sleep_begin_us);
+    rtc_state.sleep_us += slept_us;
+    ++rtc_state.wake_count;
+  }
+  if (is_ble_window) {
+    rtc_state.wakes_until_window = CONFIG_DEEP_SLEEP_BLE_WINDOW_INTERVAL_MIN;
+  }
+
+  ESP_LOGI(TAG, "Wake %s > slept:%" PRId64 "ms boot:%" PRId64 "ms ble:%s",
+           wake_cause == ESP_SLEEP_WAKEUP_TIMER  ? "timer"
+           : wake_cause == ESP_SLEEP_WAKEUP_EXT0 ? "button"
+                                                 : "reset",
+           slept_us / 1000, (now_us - wake_us) / 1000,
+           is_ble_window ? "on" : "off");
+}
+
+bool IsWakeFromSleep() {
+  return wake_cause == ESP_SLEEP_WAKEUP_TIMER ||
+         wake_cause == ESP_SLEEP_WAKEUP_EXT0;
+}
+
+bool IsBleWindowRequired() { return is_ble_window; }
+
+int64_t GetSleptMicroseconds() { return slept_us; }
+
+void OnMoveStart() {
+  if (wake_cause != ESP_SLEEP_WAKEUP_TIMER || is_latency_recorded) {
+    return;
+  }
+  is_latency_recorded = true;
+  const int64_t latency_us = esp_timer_get_time() - wake_monotonic_us;
+  rtc_state.latency_total_us += latency_us;
+  rtc_state.latency_max_us = std::max(rtc_state.latency_max_us, latency_us);
+  ++rtc_state.latency_count;
+  ESP_LOGI(TAG, "Wake to move > %" PRId64 "ms", latency_us / 1000);
+}
+
+int64_t GetBleWindowRemainingMs() {
+  if (!is_ble_window) {
+    return 0;
+  }
+  return std::max<int64_t>(0, BLE_WINDOW_US - esp_timer_get_time()) / 1000;
+}
+
+bool TrySleep(const int64_t wait_us) {
+  if (wait_us < MIN_SLEEP_US || 0 < GetBleWindowRemainingMs()) {
+    return false;
+  }
+  // 接続中は切断まで受付期間を延長する
+  if (is_ble_window && 0 < BleDevice::GetInstance()->GetConnectionCount()) {
+    return false;
+  }
+  if (IsPendingVerify()) {
+    return false;
+  }
+  // 停止処理の時間で起床が遅れないよう先に起床時刻を決める
+  const int64_t wake_target_us = Util::GetEpochMicroseconds() + wait_us;
+
+  const int64_t awake_us = esp_timer_get_time() - wake_monotonic_us;
+  if (is_ble_window) {
+    rtc_state.radio_us += awake_us;
+  } else {
+    rtc_state.active_us += awake_us;
+  }
+  ESP_LOGI(TAG, "Deep Sleep > awake:%" PRId64 "ms sleep:%" PRId64 "ms",
+           awake_us / 1000, wait_us / 1000);
+  if (is_ble_window) {
+    ReportStatistics();
+  }
+
+  // 無線を停止してから (起動中のままではdeep sleepできない)
+  if (esp_bluedroid_get_status() == ESP_BLUEDROID_STATUS_ENABLED) {
+    esp_bluedroid_disable();
+  }
+  if (esp_bt_controller_get_status() == ESP_BT_CONTROLLER_STATUS_ENABLED) {
+    esp_bt_controller_disable();
+  }
+
+  // 針ドライバは無効のまま保持 (出力が解放されると有効になり得る)
+  for (const gpio_num_t gpio : DRIVER_ENABLE_GPIOS) {
+    gpio_hold_en(gpio);
+  }
+  gpio_deep_sleep_hold_en();
+
+  rtc_gpio_pullup_en(WAKE_BUTTON_GPIO);
+  rtc_gpio_pulldown_dis(WAKE_BUTTON_GPIO);
+  esp_sleep_enable_ext0_wakeup(WAKE_BUTTON_GPIO, 0);
+
+  const int64_t now_us = Util::GetEpochMicroseconds();
+  esp_sleep_enable_timer_wakeup(
+      static_cast<uint64_t>(std::max<int64_t>(1, wake_target_us - now_us)));
+  rtc_state.sleep_begin_us = now_us;
+  rtc_state.wake_target_us = wake_target_us;
+  esp_deep_sleep_start();
+  return false;
+}
+#else
+void Initialize() {}
+
+bool IsWakeFromSleep() { return false; }
+
+bool IsBleWindowRequired() { return true; }
+
+int64_t GetSleptMicroseconds() { return 0; }
+
+void OnMoveStart() {}
+
+int64_t GetBleWindowRemainingMs() { return 0; }
+
+bool TrySleep(const int64_t wait_us) { return false; }
+#endif
+
+}  // namespace HareTortoiseClockSystem::DeepSleep
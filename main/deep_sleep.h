@@ -0,0 +1,40 @@
+#ifndef DEEP_SLEEP_H_
+#define DEEP_SLEEP_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include <cstdint>
+
+namespace HareTortoiseClockSystem::DeepSleep {
+
+/// deep sleepする最短の待機時間(us) (これより短い場合は起きたまま待つ)
+constexpr int64_t MIN_SLEEP_US = 2000000;
+
+/// 起床時の処理 (起床要因の判定・針ドライバの無効保持の解除)
+/// 起動直後、ステッピングモーターの初期化より前に呼び出す
+void Initialize();
+
+/// deep sleepからの起床か (針位置と時刻はRTCメモリ・RTCタイマーで保持)
+bool IsWakeFromSleep();
+
+/// 今回の起動でBLEを起動するか (電源投入・ボタン・定期の受付期間)
+bool IsBleWindowRequired();
+
+/// 直前のdeep sleepの時間(us) (起床でない場合0)
+int64_t GetSleptMicroseconds();
+
+/// 針移動の開始 (起床後の最初の移動までの遅延を記録)
+void OnMoveStart();
+
+/// 受付期間の残り時間(ms) 期間外・deep sleep無効時は0
+int64_t GetBleWindowRemainingMs();
+
+/// 次の分の切替までdeep sleepする (成功した場合は戻らない)
+/// 受付期間中・接続中・ファームウェアの検証待ち・待機時間が短い場合はfalse
+/// @param wait_us 起床までの時間
+bool TrySleep(const int64_t wait_us);
+
+}  // namespace HareTortoiseClockSystem::DeepSleep
+
+#endif  // DEEP_SLEEP_H_
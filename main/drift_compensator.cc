@@ -0,0 +1,193 @@
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include "drift_compensator.h"
+
+#include <esp_timer.h>
+#include <nvs.h>
+
+#include <cstdint>
+#include <cstdlib>
+
+#include "logger.h"
+#include "util.h"
+
+namespace HareTortoiseClockSystem {
+
+/// NVS 名前空間・キー
+constexpr char NVS_NAMESPACE[] = "clock";
+constexpr char NVS_KEY_DRIFT_PPB[] = "drift_ppb";
+constexpr char NVS_KEY_DRIFT_SAMPLES[] = "drift_n";
+/// 推定に利用する同期間隔の下限(us) 短いと通信遅延の誤差が支配的になる
+constexpr int64_t MIN_ESTIMATE_INTERVAL_US = 6ll * 60 * 60 * 1000000;
+/// 推定に利用するoffsetの上限(us) 超える場合は時刻の変更とみなし推定しない
+/// (ppbへの換算でint64が桁あふれしない範囲 約2.5時間)
+constexpr int64_t MAX_ESTIMATE_OFFSET_US = INT64_MAX / 1000000000ll;
+/// 推定値として採用する上限(ppb) 超える場合は異常値として破棄
+constexpr int32_t MAX_DRIFT_PPB = 500000;
+/// 補正を反映する間隔(us)
+constexpr int64_t APPLY_INTERVAL_US = 60ll * 1000000;
+/// 推定値の更新ゲインの分母上限 (過去のサンプルとの加重平均)
+constexpr int32_t MAX_SAMPLE_WEIGHT = 4;
+
+DriftCompensator::DriftCompensator()
+    : mux_(portMUX_INITIALIZER_UNLOCKED),
+      drift_ppb_(0),
+      sample_count_(0),
+      last_precise_sync_us_(0),
+      last_sync_us_(0),
+      last_apply_monotonic_us_(0),
+      correction_remainder_ns_(0) {}
+
+void DriftCompensator::Load() {
+  nvs_handle_t handle;
+  if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+    return;
+  }
+  int32_t drift_ppb = 0;
+  int32_t sample_count = 0;
+  if (nvs_get_i32(handle, NVS_KEY_DRIFT_PPB, &drift_ppb) == ESP_OK &&
+      nvs_get_i32(handle, NVS_KEY_DRIFT_SAMPLES, &sample_count) == ESP_OK &&
+      std::abs(drift_ppb) <= MAX_DRIFT_PPB) {
+    portENTER_CRITICAL(&mux_);
+    drift_ppb_ = drift_ppb;
+    sample_count_ = sample_count;
+    portEXIT_CRITICAL(&mux_);
+    ESP_LOGI(TAG, "Load Drift %dppb (samples:%d)", drift_ppb, sample_count);
+  }
+  nvs_close(handle);
+}
+
+void DriftCompensator::OnSync(const int64_t offset_us, const bool is_precise) {
+  const int64_t reference_us = Util::GetEpochMicroseconds() + offset_us;
+
+  bool is_updated = false;
+  int32_t drift_ppb = 0;
+  int32_t sample_count = 0;
+  int64_t interval_us = 0;
+
+  portENTER_CRITICAL(&mux_);
+  interval_us = reference_us - last_precise_sync_us_;
+  if (is_precise && last_precise_sync_us_ != 0 &&
+      MIN_ESTIMATE_INTERVAL_US <= interval_us &&
+      std::llabs(offset_us) <= MAX_ESTIMATE_OFFSET_US) {
+    // 補正適用後の残差からずれを求める (ローカルが進むとoffsetは負)
+    const int64_t residual_ppb = -offset_us * 1000000000ll / interval_us;
+    const int32_t weight = (sample_count_ < MAX_SAMPLE_WEIGHT)
+                               ? sample_count_ + 1
+                               : MAX_SAMPLE_WEIGHT;
+    const int64_t estimate_ppb = drift_ppb_ + residual_ppb / weight;
+    if (std::llabs(estimate_ppb) <= MAX_DRIFT_PPB) {
+      drift_ppb_ = static_cast<int32_t>(estimate_ppb);
+      ++sample_count_;
+      is_updated = true;
+    }
+  }
+  if (is_precise) {
+    last_precise_sync_us_ = reference_us;
+  } else {
+    // 秒精度の同期からは推定しない
+    last_precise_sync_us_ = 0;
+  }
+  last_sync_us_ = reference_us;
+  correction_remainder_ns_ = 0;
+  drift_ppb = drift_ppb_;
+  sample_count = sample_count_;
+  portEXIT_CRITICAL(&mux_);
+
+  if (is_updated) {
+    ESP_LOGI(TAG, "Update Drift %dppb (interval:%" PRId64 "s offset:%" PRId64
+             "us)", drift_ppb, interval_us / 1000000, offset_us);
+    Save(drift_ppb, sample_count);
+  }
+}
+
+void DriftCompensator::Update() {
+  const int64_t now_us = esp_timer_get_time();
+  if (last_apply_monotonic_us_ == 0) {
+    last_apply_monotonic_us_ = now_us;
+    return;
+  }
+  const int64_t elapsed_us = now_us - last_apply_monotonic_us_;
+  if (elapsed_us < APPLY_INTERVAL_US) {
+    return;
+  }
+  last_apply_monotonic_us_ = now_us;
+
+  int64_t correction_us = 0;
+  portENTER_CRITICAL(&mux_);
+  if (last_sync_us_ != 0 && drift_ppb_ != 0) {
+    // ローカル時計が進む分だけ戻す (端数は次回へ持ち越し)
+    const int64_t correction_ns =
+        -elapsed_us * drift_ppb_ / 1000000 + correction_remainder_ns_;
+    correction_us = correction_ns / 1000;
+    correction_remainder_ns_ = correction_ns % 1000;
+  }
+  portEXIT_CRITICAL(&mux_);
+
+  if (correction_us != 0) {
+    Util::SlewSystemTime(correction_us);
+    ESP_LOGD(TAG, "Drift Correction %" PRId64 "us", correction_us);
+  }
+}
+
+void DriftCompensator::CompensateSleep(const int64_t slept_us) {
+  int64_t correction_us = 0;
+  portENTER_CRITICAL(&mux_);
+  if (last_sync_us_ != 0 && drift_ppb_ != 0) {
+    correction_us = -slept_us * drift_ppb_ / 1000000000;
+  }
+  portEXIT_CRITICAL(&mux_);
+
+  // slewの残量はdeep sleepで失われるため直接反映
+  if (correction_us != 0) {
+    Util::StepSystemTime(correction_us);
+    ESP_LOGD(TAG, "Sleep Drift Correction %" PRId64 "us", correction_us);
+  }
+}
+
+int32_t DriftCompensator::GetDriftPpb() const {
+  portENTER_CRITICAL(&mux_);
+  const int32_t drift_ppb = drift_ppb_;
+  portEXIT_CRITICAL(&mux_);
+  return drift_ppb;
+}
+
+int64_t DriftCompensator::GetLastSyncUs() const {
+  portENTER_CRITICAL(&mux_);
+  const int64_t last_sync_us = last_sync_us_;
+  portEXIT_CRITICAL(&mux_);
+  return last_sync_us;
+}
+
+int64_t DriftCompensator::GetLastPreciseSyncUs() const {
+  portENTER_CRITICAL(&mux_);
+  const int64_t last_precise_sync_us = last_precise_sync_us_;
+  portEXIT_CRITICAL(&mux_);
+  return last_precise_sync_us;
+}
+
+void DriftCompensator::RestoreSync(const int64_t last_sync_us,
+                                   const int64_t last_precise_sync_us) {
+  portENTER_CRITICAL(&mux_);
+  last_sync_us_ = last_sync_us;
+  last_precise_sync_us_ = last_precise_sync_us;
+  correction_remainder_ns_ = 0;
+  portEXIT_CRITICAL(&mux_);
+}
+
+void DriftCompensator::Save(const int32_t drift_ppb,
+                            const int32_t sample_count) const {
+  nvs_handle_t handle;
+  if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+    ESP_LOGE(TAG, "Failed open nvs");
+    return;
+  }
+  nvs_set_i32(handle, NVS_KEY_DRIFT_PPB, drift_ppb);
+  nvs_set_i32(handle, NVS_KEY_DRIFT_SAMPLES, sample_count);
+  nvs_commit(handle);
+  nvs_close(handle);
+}
+
+}  // namespace HareTortoiseClockSystem
@@ -0,0 +1,64 @@
+#ifndef DRIFT_COMPENSATOR_H_
+#define DRIFT_COMPENSATOR_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include <freertos/FreeRTOS.h>
+
+#include <cstdint>
+
+namespace HareTortoiseClockSystem {
+
+/// 水晶発振子のずれ(ppb)を同期毎に推定し、同期間の時刻を連続的に補正する
+class DriftCompensator final {
+ public:
+  DriftCompensator();
+
+  /// NVSから推定値を読み込み
+  void Load();
+
+  /// 同期時の記録 (BLEスレッドからも利用)
+  /// @param offset_us 基準時刻 - ローカル時刻
+  /// @param is_precise 秒未満の精度がある同期か (推定に利用するか)
+  void OnSync(const int64_t offset_us, const bool is_precise);
+
+  /// 定期的に呼び出し、経過時間分の補正をslewで反映する
+  void Update();
+
+  /// deep sleep中の経過時間分の補正をstepで反映する (起床時に呼び出し)
+  void CompensateSleep(const int64_t slept_us);
+
+  /// 推定値(ppb) 正:ローカル時計が進む
+  int32_t GetDriftPpb() const;
+
+  /// 最終同期時刻(Unix時間 us) 未同期の場合0
+  int64_t GetLastSyncUs() const;
+
+  /// 最終の精度のある同期時刻(Unix時間 us) なしの場合0
+  int64_t GetLastPreciseSyncUs() const;
+
+  /// 再起動前の同期情報を復元
+  void RestoreSync(const int64_t last_sync_us,
+                   const int64_t last_precise_sync_us);
+
+ private:
+  void Save(const int32_t drift_ppb, const int32_t sample_count) const;
+
+ private:
+  mutable portMUX_TYPE mux_;
+  int32_t drift_ppb_;
+  int32_t sample_count_;
+  /// 前回の精度のある同期時刻 (基準時刻 us) 0:なし
+  int64_t last_precise_sync_us_;
+  /// 前回の同期時刻 (基準時刻 us) 0:なし
+  int64_t last_sync_us_;
+  /// 前回補正を反映したモノトニック時刻(us)
+  int64_t last_apply_monotonic_us_;
+  /// 補正量の端数(ns)
+  int64_t correction_remainder_ns_;
+};
+
+}  // namespace HareTortoiseClockSystem
+
+#endif  // DRIFT_COMPENSATOR_H_
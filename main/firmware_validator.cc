@@ -0,0 +1,85 @@
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include "firmware_validator.h"
+
+#include <esp_ota_ops.h>
+
+#include <cinttypes>
+
+#include "clock_management_task.h"
+#include "logger.h"
+
+#ifdef CONFIG_BLE_OTA
+
+namespace HareTortoiseClockSystem {
+
+FirmwareValidator::FirmwareValidator()
+    : mux_(portMUX_INITIALIZER_UNLOCKED),
+      status_(0),
+      is_pending_verify_(false),
+      elapsed_sec_(0) {}
+
+void FirmwareValidator::Initialize() {
+  const esp_partition_t *const running = esp_ota_get_running_partition();
+  esp_ota_img_states_t state = ESP_OTA_IMG_UNDEFINED;
+  if (running == nullptr ||
+      esp_ota_get_state_partition(running, &state) != ESP_OK) {
+    return;
+  }
+  is_pending_verify_ = (state == ESP_OTA_IMG_PENDING_VERIFY);
+  if (is_pending_verify_) {
+    ESP_LOGW(TAG, "Firmware pending verify > %s", running->label);
+  }
+}
+
+void FirmwareValidator::OnClockStateChanged(const ClockState &state) {
+  portENTER_CRITICAL(&mux_);
+  status_ = state.status;
+  portEXIT_CRITICAL(&mux_);
+}
+
+void FirmwareValidator::Update() {
+  if (!is_pending_verify_) {
+    return;
+  }
+  portENTER_CRITICAL(&mux_);
+  const uint8_t status = status_;
+  portEXIT_CRITICAL(&mux_);
+
+  // 原点検出または針の位置の復元 (再開時の確認の移動を含む) が完了した
+  if (status == ClockManagementTask::STATUS_SETTING_WAIT ||
+      status == ClockManagementTask::STATUS_ENABLE) {
+    MarkValid();
+    return;
+  }
+  if (status == ClockManagementTask::STATUS_ERROR) {
+    Rollback("clock error");
+    return;
+  }
+  if (VERIFY_TIMEOUT_SEC <= ++elapsed_sec_) {
+    Rollback("timeout");
+  }
+}
+
+void FirmwareValidator::MarkValid() {
+  is_pending_verify_ = false;
+  if (esp_ota_mark_app_valid_cancel_rollback() != ESP_OK) {
+    ESP_LOGE(TAG, "Firmware mark valid failed");
+    return;
+  }
+  ESP_LOGI(TAG, "Firmware verified > %" PRId32 "sec", elapsed_sec_);
+}
+
+void FirmwareValidator::Rollback(const char *const reason) {
+  is_pending_verify_ = false;
+  ESP_LOGE(TAG, "Firmware rollback > %s", reason);
+  // 成功した場合は戻らない
+  esp_ota_mark_app_invalid_rollback_and_reboot();
+  ESP_LOGE(TAG, "Firmware rollback failed");
+}
+
+}  // namespace HareTortoiseClockSystem
+
+#endif  // CONFIG_BLE_OTA
@@ -0,0 +1,51 @@
+#ifndef FIRMWARE_VALIDATOR_H_
+#define FIRMWARE_VALIDATOR_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include <freertos/FreeRTOS.h>
+
+#include <cstdint>
+#include <memory>
+
+#include "hare_tortoise_clock_interface.h"
+
+namespace HareTortoiseClockSystem {
+
+/// 更新後の初回起動でファームウェアを検証する (ブートローダのロールバック)
+/// 時計が運転可能な状態に達したら有効とし、エラー・時間切れでは
+/// 以前のファームウェアに戻して再起動する
+class FirmwareValidator final : public ClockStateListenerInterface {
+ public:
+  /// 運転可能な状態に達するまでの制限時間(sec)
+  static constexpr int32_t VERIFY_TIMEOUT_SEC = 120;
+
+  FirmwareValidator();
+
+  /// 起動中のファームウェアが検証待ちか確認
+  void Initialize();
+
+  /// 時計タスクから呼び出し (保持のみ)
+  void OnClockStateChanged(const ClockState &state) override;
+
+  /// 検証待ちの場合に判定する (メインループから1秒毎に呼び出し)
+  void Update();
+
+ private:
+  void MarkValid();
+  void Rollback(const char *const reason);
+
+ private:
+  /// status_の排他 (時計タスクとの間)
+  portMUX_TYPE mux_;
+  uint8_t status_;
+  bool is_pending_verify_;
+  int32_t elapsed_sec_;
+};
+
+using FirmwareValidatorSharedPtr = std::shared_ptr<FirmwareValidator>;
+
+}  // namespace HareTortoiseClockSystem
+
+#endif  // FIRMWARE_VALIDATOR_H_
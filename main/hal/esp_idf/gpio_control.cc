@@ -36,7 +36,7 @@ void InitOutput(const gpio_num_t gpio_number, const bool level) {
 }
 
 /// Init GPIO (Input:Pulldown inner enable)
-void InitInput(const gpio_num_t gpio_number) {
+void InitInput(const gpio_num_t gpio_number, const InputEdge edge) {
   // Input
   gpio_config_t io_input_conf = {
       .pin_bit_mask = 1ull << gpio_number,
@@ -44,11 +44,23 @@ void InitInput(const gpio_num_t gpio_number) {
       .pull_up_en =
           GPIO_PULLUP_ENABLE,  // IO34～IO39は内部プルアップ/プルダウン抵抗は無し
       .pull_down_en = GPIO_PULLDOWN_DISABLE,
-      .intr_type = GPIO_INTR_ANYEDGE,
+      .intr_type = (edge == INPUT_EDGE_FALLING) ? GPIO_INTR_NEGEDGE
+                                                : GPIO_INTR_ANYEDGE,
   };
   gpio_config(&io_input_conf);
 }
 
+/// Add GPIO ISR Handler
+void AddIsrHandler(const gpio_num_t gpio_number, void (*handler)(void*),
+                   void* const arg) {
+  gpio_isr_handler_add(gpio_number, handler, arg);
+}
+
+/// Remove GPIO ISR Handler
+void RemoveIsrHandler(const gpio_num_t gpio_number) {
+  gpio_isr_handler_remove(gpio_number);
+}
+
 /// Set GPIO Level (Output)
 void SetLevel(const gpio_num_t gpio_number, const bool level) {
   gpio_set_level(gpio_number, level);
@@ -0,0 +1,97 @@
+#ifndef GPIO_H_
+#define GPIO_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include <driver/gpio.h>
+#include <esp_attr.h>
+#include <soc/gpio_struct.h>
+#include <stdint.h>
+
+namespace HareTortoiseClockSystem::GPIO {
+
+/// 入力割り込みのエッジ
+enum InputEdge {
+  INPUT_EDGE_ANY = 0,
+  INPUT_EDGE_FALLING = 1,
+};
+
+/// Init GPIO ISR Service
+void InitGpioIsrService();
+
+/// Reset GPIO 
+void Reset(const gpio_num_t gpio_number);
+
+/// Init GPIO (Output)
+void InitOutput(const gpio_num_t gpio_number, const bool level = false);
+
+/// Init GPIO (Input:Pulldown inner enable)
+void InitInput(const gpio_num_t gpio_number,
+               const InputEdge edge = INPUT_EDGE_ANY);
+
+/// Add GPIO ISR Handler (InitGpioIsrService後)
+void AddIsrHandler(const gpio_num_t gpio_number, void (*handler)(void*),
+                   void* const arg);
+
+/// Remove GPIO ISR Handler
+void RemoveIsrHandler(const gpio_num_t gpio_number);
+
+/// Set GPIO Level (Output)
+void SetLevel(const gpio_num_t gpio_number, const bool level);
+
+/// Gett GPIO Level (Input)
+bool GetLevel(const gpio_num_t gpio_number);
+
+/// GPIO Bit Mask (GPIO0-31:下位32bit GPIO32-39:上位32bit)
+constexpr uint64_t PinMask(const gpio_num_t gpio_number) {
+  return 1ull << gpio_number;
+}
+
+/// Set GPIO Bits (Output / Direct Register)
+/// マスクはコンパイル時定数とし、w1tsレジスタへの単一ストアに展開する
+template <uint64_t MASK>
+FORCE_INLINE_ATTR void SetBits() {
+  if constexpr (static_cast<uint32_t>(MASK) != 0) {
+    ::GPIO.out_w1ts = static_cast<uint32_t>(MASK);
+  }
+  if constexpr ((MASK >> 32) != 0) {
+    ::GPIO.out1_w1ts.val = static_cast<uint32_t>(MASK >> 32);
+  }
+}
+
+/// Clear GPIO Bits (Output / Direct Register)
+template <uint64_t MASK>
+FORCE_INLINE_ATTR void ClearBits() {
+  if constexpr (static_cast<uint32_t>(MASK) != 0) {
+    ::GPIO.out_w1tc = static_cast<uint32_t>(MASK);
+  }
+  if constexpr ((MASK >> 32) != 0) {
+    ::GPIO.out1_w1tc.val = static_cast<uint32_t>(MASK >> 32);
+  }
+}
+
+/// Write GPIO Bits (Output / Direct Register)
+template <uint64_t MASK>
+FORCE_INLINE_ATTR void WriteBits(const bool level) {
+  if (level) {
+    SetBits<MASK>();
+  } else {
+    ClearBits<MASK>();
+  }
+}
+
+/// Test GPIO Bit (Input / Direct Register)
+template <uint64_t MASK>
+FORCE_INLINE_ATTR bool TestBit() {
+  static_assert((MASK & (MASK - 1)) == 0, "single pin only");
+  if constexpr (static_cast<uint32_t>(MASK) != 0) {
+    return (::GPIO.in & static_cast<uint32_t>(MASK)) != 0;
+  } else {
+    return (::GPIO.in1.val & static_cast<uint32_t>(MASK >> 32)) != 0;
+  }
+}
+
+}  // namespace HareTortoiseClockSystem::GPIO
+
+#endif  // GPIO_H_
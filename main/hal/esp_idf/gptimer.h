@@ -8,7 +8,7 @@
 
 class GPTimer {
  public:
-  GPTimer() : gptimer_(nullptr) {}
+  GPTimer() : gptimer_(nullptr), is_enabled_(false) {}
 
   ~GPTimer() { Destroy(); }
 
@@ -25,19 +25,34 @@ class GPTimer {
     // SetCallback
     gptimer_event_callbacks_t gptimer_callback = {.on_alarm = function};
     gptimer_register_event_callbacks(gptimer_, &gptimer_callback, user_data);
-
-    // Enable
-    gptimer_enable(gptimer_);
   }
 
   void Destroy() {
     if (gptimer_) {
-      gptimer_disable(gptimer_);
+      Disable();
       gptimer_del_timer(gptimer_);
       gptimer_ = nullptr;
     }
   }
 
+  /// 有効化 (CONFIG_PM_ENABLE時は有効の間APB周波数を最大に固定する)
+  void Enable() {
+    if (!gptimer_ || is_enabled_) {
+      return;
+    }
+    gptimer_enable(gptimer_);
+    is_enabled_ = true;
+  }
+
+  /// 無効化 (停止後に呼び出す)
+  void Disable() {
+    if (!gptimer_ || !is_enabled_) {
+      return;
+    }
+    gptimer_disable(gptimer_);
+    is_enabled_ = false;
+  }
+
   void Start(const uint64_t wait_count) const {
     if (!gptimer_) {
       return;
@@ -59,6 +74,7 @@ class GPTimer {
 
  private:
   mutable gptimer_handle_t gptimer_;
+  bool is_enabled_;
 };
 
 #endif  // GPTIMER_H_
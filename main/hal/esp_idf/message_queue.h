@@ -0,0 +1,146 @@
+#ifndef MESSAGE_QUEUE_H_
+#define MESSAGE_QUEUE_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+
+#include <cstddef>
+
+template <typename T>
+class MessageQueue {
+ public:
+  MessageQueue() : queue_(nullptr) {}
+
+  virtual ~MessageQueue() { Destroy(); }
+
+  bool Create(const int32_t queueSize = 1) {
+    if (queue_) {
+      return true;
+    }
+    queue_ = xQueueCreate(queueSize, sizeof(T));
+    if (!queue_) {
+      return false;
+    }
+    return true;
+  }
+
+  void Destroy() {
+    if (queue_) {
+      xQueueReset(queue_);
+      vQueueDelete(queue_);
+      queue_ = nullptr;
+    }
+  }
+
+  bool ReceiveWait(T *const receive_data, const int32_t max_wait_millisecond) {
+    if (!queue_) {
+      return false;
+    }
+    return xQueueReceive(queue_, receive_data,
+                         pdMS_TO_TICKS(max_wait_millisecond));
+  }
+
+  bool ReceiveNonBlock(T *const receive_data) {
+    if (!queue_) {
+      return false;
+    }
+    return xQueueReceive(queue_, receive_data, 0);
+  }
+
+  /// 受信まで待機 (Task::Stopで待機を中断された場合はfalse)
+  bool ReceiveBlock(T *const receive_data) {
+    if (!queue_) {
+      return false;
+    }
+    return xQueueReceive(queue_, receive_data, portMAX_DELAY);
+  }
+
+  bool Send(const T &data) {
+    if (!queue_) {
+      return false;
+    }
+    return xQueueSend(queue_, &data, 0) == pdTRUE;
+  }
+
+  /// 複数件送信 (キューが満杯になった時点で打ち切り)
+  /// @return 送信できた件数
+  size_t SendBatch(const T *const data, const size_t count) {
+    if (!queue_) {
+      return 0;
+    }
+    size_t sent = 0;
+    while (sent < count && xQueueSend(queue_, &data[sent], 0) == pdTRUE) {
+      ++sent;
+    }
+    return sent;
+  }
+
+  /// 複数件受信 (1件目のみ待機し、以降はキューに残っている分を取り出す)
+  /// @return 受信できた件数
+  size_t ReceiveBatch(T *const receive_data, const size_t max_count,
+                      const int32_t max_wait_millisecond) {
+    if (!queue_ || max_count == 0) {
+      return 0;
+    }
+    if (!xQueueReceive(queue_, &receive_data[0],
+                       pdMS_TO_TICKS(max_wait_millisecond))) {
+      return 0;
+    }
+    size_t received = 1;
+    while (received < max_count &&
+           xQueueReceive(queue_, &receive_data[received], 0) == pdTRUE) {
+      ++received;
+    }
+    return received;
+  }
+
+  /// ISRから送信
+  /// @return 高優先度タスクが起床した場合true (呼び出し元でyieldすること)
+  bool SendFromISR(const T &data) {
+    if (!queue_) {
+      return false;
+    }
+    BaseType_t high_task_awoken = pdFALSE;
+    xQueueSendFromISR(queue_, &data, &high_task_awoken);
+    return (high_task_awoken == pdTRUE);
+  }
+
+  /// ISRから送信し、必要であればISR終了時にコンテキストスイッチする
+  /// (戻り値でyieldを要求できないGPIO ISRなどから利用)
+  void SendFromISRAndYield(const T &data) {
+    if (!queue_) {
+      return;
+    }
+    BaseType_t high_task_awoken = pdFALSE;
+    xQueueSendFromISR(queue_, &data, &high_task_awoken);
+    portYIELD_FROM_ISR(high_task_awoken);
+  }
+
+ protected:
+  QueueHandle_t queue_;
+};
+
+/// 静的領域を利用するMessageQueue (ヒープ確保なし)
+template <typename T, int32_t QUEUE_SIZE>
+class StaticMessageQueue final : public MessageQueue<T> {
+ public:
+  StaticMessageQueue() : MessageQueue<T>(), storage_(), queue_buffer_() {}
+
+  bool Create() {
+    if (this->queue_) {
+      return true;
+    }
+    this->queue_ =
+        xQueueCreateStatic(QUEUE_SIZE, sizeof(T), storage_, &queue_buffer_);
+    return this->queue_ != nullptr;
+  }
+
+ private:
+  uint8_t storage_[QUEUE_SIZE * sizeof(T)];
+  StaticQueue_t queue_buffer_;
+};
+
+#endif  // MESSAGE_QUEUE_H_
@@ -0,0 +1,108 @@
+#ifndef SPSC_RING_BUFFER_H_
+#define SPSC_RING_BUFFER_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/// ISR(送信1箇所) -> タスク(受信1箇所) 向けロックフリーリングバッファ
+/// 受信待ちはタスク通知で行い、送信側は必要に応じてISR終了時にyieldする
+template <typename T, uint32_t CAPACITY>
+class SpscRingBuffer final {
+  static_assert((CAPACITY & (CAPACITY - 1)) == 0,
+                "CAPACITY must be a power of two");
+
+ public:
+  SpscRingBuffer() : buffer_(), head_(0), tail_(0), consumer_(nullptr) {}
+
+  /// コピー禁止
+  SpscRingBuffer(const SpscRingBuffer &) = delete;
+  SpscRingBuffer &operator=(const SpscRingBuffer &) = delete;
+
+  /// 受信タスクを登録 (受信タスク自身から呼び出す)
+  void BindConsumer() { consumer_ = xTaskGetCurrentTaskHandle(); }
+
+  /// 全件破棄 (受信側から呼び出す)
+  void Clear() { tail_.store(head_.load(std::memory_order_acquire)); }
+
+  /// ISRから送信
+  /// @param high_task_awoken 受信タスクが起床した場合pdTRUEが設定される
+  bool PushFromISR(const T &data, BaseType_t *const high_task_awoken) {
+    const uint32_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) == CAPACITY) {
+      return false;
+    }
+    buffer_[head & (CAPACITY - 1)] = data;
+    head_.store(head + 1, std::memory_order_release);
+    if (consumer_) {
+      vTaskNotifyGiveFromISR(consumer_, high_task_awoken);
+    }
+    return true;
+  }
+
+  /// ISRから送信し、必要であればISR終了時にコンテキストスイッチする
+  bool PushFromISRAndYield(const T &data) {
+    BaseType_t high_task_awoken = pdFALSE;
+    const bool is_pushed = PushFromISR(data, &high_task_awoken);
+    portYIELD_FROM_ISR(high_task_awoken);
+    return is_pushed;
+  }
+
+  /// 受信 (ノンブロック)
+  bool Pop(T *const receive_data) {
+    const uint32_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    *receive_data = buffer_[tail & (CAPACITY - 1)];
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// 受信 (最大max_wait_millisecond待機)
+  bool PopWait(T *const receive_data, const int32_t max_wait_millisecond) {
+    if (Pop(receive_data)) {
+      return true;
+    }
+    // 通知の取りこぼしを避けるため、起床後に再確認する
+    // Pop済みの分の通知が残っている場合は空のまま起床するため、期限まで待ち直す
+    const TickType_t wait_ticks = pdMS_TO_TICKS(max_wait_millisecond);
+    const TickType_t start_tick = xTaskGetTickCount();
+    TickType_t remaining_ticks = wait_ticks;
+    while (ulTaskNotifyTake(pdTRUE, remaining_ticks) != 0) {
+      if (Pop(receive_data)) {
+        return true;
+      }
+      const TickType_t elapsed_ticks = xTaskGetTickCount() - start_tick;
+      if (wait_ticks <= elapsed_ticks) {
+        return false;
+      }
+      remaining_ticks = wait_ticks - elapsed_ticks;
+    }
+    return Pop(receive_data);
+  }
+
+  /// まとめて受信 (ノンブロック)
+  /// @return 受信できた件数
+  size_t PopBatch(T *const receive_data, const size_t max_count) {
+    size_t received = 0;
+    while (received < max_count && Pop(&receive_data[received])) {
+      ++received;
+    }
+    return received;
+  }
+
+ private:
+  T buffer_[CAPACITY];
+  std::atomic<uint32_t> head_;
+  std::atomic<uint32_t> tail_;
+  TaskHandle_t consumer_;
+};
+
+#endif  // SPSC_RING_BUFFER_H_
@@ -0,0 +1,66 @@
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// 時刻・待機 (util.hのうちプラットフォームに依存する部分)
+
+// Include ----------------------
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <sys/time.h>
+
+#include <chrono>
+
+#include "util.h"
+
+namespace HareTortoiseClockSystem {
+namespace Util {
+
+/// Sleep
+void SleepMillisecond(const uint32_t sleep_milliseconds) {
+  TickType_t lastWakeTime = xTaskGetTickCount();
+  vTaskDelayUntil(&lastWakeTime, sleep_milliseconds / portTICK_PERIOD_MS);
+}
+
+std::time_t GetEpoch() {
+  std::chrono::system_clock::time_point now_time_point =
+      std::chrono::system_clock::now();
+  return std::chrono::system_clock::to_time_t(now_time_point);
+}
+
+/// SetTime
+void SetSystemTime(const std::time_t set_epoch_time) {
+  timeval set_time;
+  set_time.tv_sec = set_epoch_time;
+  set_time.tv_usec = 0;
+  settimeofday(&set_time, nullptr);
+}
+
+int64_t GetEpochMicroseconds() {
+  timeval now;
+  gettimeofday(&now, nullptr);
+  return static_cast<int64_t>(now.tv_sec) * 1000000 + now.tv_usec;
+}
+
+void StepSystemTime(const int64_t offset_microseconds) {
+  const int64_t set_microseconds = GetEpochMicroseconds() + offset_microseconds;
+  timeval set_time;
+  set_time.tv_sec = set_microseconds / 1000000;
+  set_time.tv_usec = set_microseconds % 1000000;
+  settimeofday(&set_time, nullptr);
+}
+
+void SlewSystemTime(const int64_t offset_microseconds) {
+  // 補正中の残量に加算する (上書きすると前回の補正が失われる)
+  timeval outstanding = {};
+  adjtime(nullptr, &outstanding);
+  const int64_t total_microseconds =
+      static_cast<int64_t>(outstanding.tv_sec) * 1000000 +
+      outstanding.tv_usec + offset_microseconds;
+  timeval delta;
+  delta.tv_sec = total_microseconds / 1000000;
+  delta.tv_usec = total_microseconds % 1000000;
+  adjtime(&delta, nullptr);
+}
+
+}  // namespace Util
+}  // namespace HareTortoiseClockSystem
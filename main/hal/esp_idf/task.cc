@@ -0,0 +1,209 @@
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include "task.h"
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include <cinttypes>
+#include <cstring>
+
+#include "logger.h"
+
+namespace HareTortoiseClockSystem {
+
+/// スタック使用量報告対象のタスク
+static Task* s_RegisteredTasks[Task::MAX_REGISTERED_TASKS] = {};
+static portMUX_TYPE s_RegisteredTasksMux = portMUX_INITIALIZER_UNLOCKED;
+
+/// Stopでの終了確認の間隔(ms) (待機中のタスクはこの間隔で待機を中断する)
+static constexpr uint32_t STOP_POLL_MS = 100;
+/// Stopでの終了待ちの上限(ms) (超えた場合は終了を待たずに削除する)
+static constexpr uint32_t STOP_WAIT_LIMIT_MS = 3000;
+
+Task::Task() = default;
+
+Task::Task(const std::string& taskName, const int32_t priority,
+           const int coreId)
+    : Task(taskName, priority, coreId, TASK_STAC_DEPTH, nullptr) {}
+
+Task::Task(const std::string& taskName, const int32_t priority,
+           const int coreId, const uint32_t stackDepth,
+           StackType_t* const stackBuffer)
+    : m_Status(TASK_STATUS_READY),
+      m_TaskName(taskName),
+      m_Priority(priority),
+      m_CoreId(coreId),
+      m_StackDepth(stackDepth),
+      m_StackBuffer(stackBuffer),
+      m_TaskBuffer(),
+      m_TaskHandle(nullptr),
+      m_StopMux(portMUX_INITIALIZER_UNLOCKED),
+      m_IsStopWaiting(false),
+      m_ExitSemaphoreBuffer(),
+      m_ExitSemaphore(xSemaphoreCreateBinaryStatic(&m_ExitSemaphoreBuffer)) {}
+
+Task::~Task() {
+  Stop();
+  vSemaphoreDelete(m_ExitSemaphore);
+}
+
+void Task::Start() {
+  if (m_Status != TASK_STATUS_READY) {
+    return;
+  }
+  m_Status = TASK_STATUS_RUN;
+  if (m_StackBuffer) {
+    m_TaskHandle = xTaskCreateStaticPinnedToCore(
+        this->Listener, m_TaskName.c_str(), m_StackDepth, this, m_Priority,
+        m_StackBuffer, &m_TaskBuffer, m_CoreId);
+  } else {
+    xTaskCreatePinnedToCore(this->Listener, m_TaskName.c_str(), m_StackDepth,
+                            this, m_Priority, &m_TaskHandle, m_CoreId);
+  }
+}
+
+void Task::Stop() {
+  if (m_Status == TASK_STATUS_RUN) {
+    m_Status = TASK_STATUS_END;
+  }
+  portENTER_CRITICAL(&m_StopMux);
+  const TaskHandle_t handle = m_TaskHandle;
+  const bool is_self = handle == xTaskGetCurrentTaskHandle();
+  if (handle && !is_self) {
+    m_IsStopWaiting = true;
+  }
+  portEXIT_CRITICAL(&m_StopMux);
+  // 自タスクからの呼び出しはループの終了のみ
+  if (!handle || is_self) {
+    return;
+  }
+  // Runの終了を待ち、中断状態になったタスクを削除する
+  // (スタック/TCBを解放する前にタスクが確実に停止していることを保証)
+  // キューの受信などで無期限に待機しているタスクは、待機を中断してループの終了を確認させる
+  bool is_exited = false;
+  for (uint32_t waited_ms = 0; waited_ms < STOP_WAIT_LIMIT_MS;
+       waited_ms += STOP_POLL_MS) {
+    if (xSemaphoreTake(m_ExitSemaphore, pdMS_TO_TICKS(STOP_POLL_MS)) ==
+        pdTRUE) {
+      is_exited = true;
+      break;
+    }
+    xTaskAbortDelay(handle);
+  }
+  if (is_exited) {
+    while (eTaskGetState(handle) != eSuspended) {
+      vTaskDelay(1);
+    }
+  } else {
+    ESP_LOGE(TAG, "Task %s not stopped > delete", m_TaskName.c_str());
+  }
+  vTaskDelete(handle);
+  m_TaskHandle = nullptr;
+}
+
+void Task::Run() {
+  m_TaskHandle = xTaskGetCurrentTaskHandle();
+  Register(this);
+  Initialize();
+  while (m_Status == TASK_STATUS_RUN) {
+    Update();
+  }
+  Unregister(this);
+}
+
+void Task::Listener(void* const pParam) {
+  if (!pParam) {
+    vTaskDelete(nullptr);
+    return;
+  }
+  Task* const task = static_cast<Task*>(pParam);
+  task->Run();
+  // 他タスクのStopが待機中、または静的確保のスタックの場合は、削除をStopを呼んだ側で行う
+  // (静的確保のスタックを使用中に解放させない)
+  portENTER_CRITICAL(&task->m_StopMux);
+  const bool is_deleted_by_owner =
+      task->m_IsStopWaiting || task->m_StackBuffer != nullptr;
+  if (!is_deleted_by_owner) {
+    task->m_TaskHandle = nullptr;
+  }
+  portEXIT_CRITICAL(&task->m_StopMux);
+  if (!is_deleted_by_owner) {
+    // 自タスクからStopした場合 ヒープのスタック/TCBはアイドルタスクが解放する
+    vTaskDelete(nullptr);
+    return;
+  }
+  xSemaphoreGive(task->m_ExitSemaphore);
+  vTaskSuspend(nullptr);
+}
+
+void Task::LogStackHighWaterMarks() {
+  // クリティカルセクション内ではログ出力できないため、名前と空き容量を複製してから出力
+  // 登録の解除は削除より前のため、クリティカルセクション内ではハンドルが有効
+  char names[MAX_REGISTERED_TASKS][configMAX_TASK_NAME_LEN] = {};
+  uint32_t stack_depths[MAX_REGISTERED_TASKS] = {};
+  uint32_t free_sizes[MAX_REGISTERED_TASKS] = {};
+  bool is_statics[MAX_REGISTERED_TASKS] = {};
+  bool is_registered[MAX_REGISTERED_TASKS] = {};
+  portENTER_CRITICAL(&s_RegisteredTasksMux);
+  for (int32_t i = 0; i < MAX_REGISTERED_TASKS; ++i) {
+    const Task* const task = s_RegisteredTasks[i];
+    if (task && task->m_TaskHandle) {
+      std::strncpy(names[i], pcTaskGetName(task->m_TaskHandle),
+                   sizeof(names[i]) - 1);
+      stack_depths[i] = task->m_StackDepth;
+      free_sizes[i] = uxTaskGetStackHighWaterMark(task->m_TaskHandle);
+      is_statics[i] = task->m_StackBuffer != nullptr;
+      is_registered[i] = true;
+    }
+  }
+  portEXIT_CRITICAL(&s_RegisteredTasksMux);
+
+  for (int32_t i = 0; i < MAX_REGISTERED_TASKS; ++i) {
+    if (is_registered[i]) {
+      ESP_LOGI(TAG, "Stack %s depth:%" PRIu32 " free:%" PRIu32 "%s", names[i],
+               stack_depths[i], free_sizes[i],
+               is_statics[i] ? " (static)" : "");
+    }
+  }
+}
+
+uint32_t Task::GetCurrentStackHighWaterMark() {
+  return uxTaskGetStackHighWaterMark(nullptr);
+}
+
+void Task::Notify() {
+  if (m_TaskHandle) {
+    xTaskNotifyGive(m_TaskHandle);
+  }
+}
+
+bool Task::WaitNotification(const uint32_t max_wait_millisecond) {
+  return ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(max_wait_millisecond)) != 0;
+}
+
+void Task::Register(Task* const task) {
+  portENTER_CRITICAL(&s_RegisteredTasksMux);
+  for (Task*& slot : s_RegisteredTasks) {
+    if (!slot) {
+      slot = task;
+      break;
+    }
+  }
+  portEXIT_CRITICAL(&s_RegisteredTasksMux);
+}
+
+void Task::Unregister(Task* const task) {
+  portENTER_CRITICAL(&s_RegisteredTasksMux);
+  for (Task*& slot : s_RegisteredTasks) {
+    if (slot == task) {
+      slot = nullptr;
+    }
+  }
+  portEXIT_CRITICAL(&s_RegisteredTasksMux);
+}
+
+}  // namespace HareTortoiseClockSystem
@@ -0,0 +1,119 @@
+#ifndef TASK_H_
+#define TASK_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include <string>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <soc/soc.h>
+
+namespace HareTortoiseClockSystem {
+
+/// FreeRTOS xTask Wrap
+class Task {
+ public:
+  enum TaskStatus {
+    TASK_STATUS_READY,
+    TASK_STATUS_RUN,
+    TASK_STATUS_END,
+  };
+
+  static constexpr int32_t TASK_STAC_DEPTH = 8192;
+
+  /// スタック使用量を報告するタスクの最大数
+  static constexpr int32_t MAX_REGISTERED_TASKS = 8;
+
+  /// Task Priority
+  static constexpr int32_t PRIORITY_TOP = (configMAX_PRIORITIES) - 1;
+  static constexpr int32_t PRIORITY_LOW = 0;
+  static constexpr int32_t PRIORITY_NORMAL = PRIORITY_TOP - 4;
+  static constexpr int32_t PRIORITY_HIGH = PRIORITY_TOP - 3;
+
+ private:
+  Task();
+
+ public:
+  Task(const std::string& taskName, const int32_t priority, const int coreId);
+  /// stack_bufferを指定した場合はxTaskCreateStaticで生成する(ヒープ確保なし)
+  Task(const std::string& taskName, const int32_t priority, const int coreId,
+       const uint32_t stackDepth, StackType_t* const stackBuffer = nullptr);
+  virtual ~Task();
+
+  /// Start Task
+  void Start();
+
+  /// Stop Task (他タスクから呼んだ場合はタスクの終了まで待機して削除する)
+  /// 待機中のタスクは待機を中断させ、終了しない場合も上限時間で削除する
+  /// 自タスクから呼んだ場合はループを終了し、ヒープのスタックのタスクは自身を削除する
+  /// Updateやスタックを持つ派生クラスは自身の破棄の最初に呼び出すこと
+  void Stop();
+
+  /// Initialize (Called when the Start function is executed.)
+  virtual void Initialize() {}
+
+  /// (override) sub class processing
+  virtual void Update() = 0;
+
+ public:
+  /// Task Running
+  void Run();
+
+  /// Task Listener
+  static void Listener(void* const pParam);
+
+  /// Log stack high water mark (Unused stack bytes) of every running task
+  static void LogStackHighWaterMarks();
+  /// Stack high water mark (Unused stack bytes) of the calling task
+  static uint32_t GetCurrentStackHighWaterMark();
+
+ protected:
+  /// 通知で起床 (他タスクから呼び出し 待機中でなければ次の待機を即時終了)
+  void Notify();
+  /// 通知を待機 (通知を受けた場合true)
+  bool WaitNotification(const uint32_t max_wait_millisecond);
+
+ private:
+  static void Register(Task* const task);
+  static void Unregister(Task* const task);
+
+ protected:
+  /// Task Status
+  TaskStatus m_Status;
+
+  /// Task Name
+  std::string m_TaskName;
+
+  /// Task Priority
+  int32_t m_Priority;
+
+  /// Use Core Id
+  int32_t m_CoreId;
+
+  /// Stack Depth (byte)
+  uint32_t m_StackDepth;
+
+  /// Stack Buffer (nullptr: heap)
+  StackType_t* m_StackBuffer;
+
+  /// TCB Buffer (Static allocation)
+  StaticTask_t m_TaskBuffer;
+
+  /// Task Handle
+  TaskHandle_t m_TaskHandle;
+
+  /// m_TaskHandle・m_IsStopWaitingの排他 (Stopと終了時の自己削除の間)
+  portMUX_TYPE m_StopMux;
+  /// 他タスクのStopが終了を待機中 (終了時に自己削除しない)
+  bool m_IsStopWaiting;
+
+  /// Run終了通知 (Stopでの待ち合わせ用)
+  StaticSemaphore_t m_ExitSemaphoreBuffer;
+  SemaphoreHandle_t m_ExitSemaphore;
+};
+
+}  // namespace HareTortoiseClockSystem
+
+#endif  // TASK_H_
@@ -6,33 +6,56 @@
 
 #include <driver/gpio.h>
 #include <esp_system.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
 #include <nvs_flash.h>
 
-#include <cstring>
 #include <memory>
 
 #include "gpio_control.h"
 #include "logger.h"
+#include "task.h"
+#include "telemetry_log.h"
 #include "util.h"
 #include "version.h"
 #include "ble_device.h"
 #include "ble_services.h"
+#include "deep_sleep.h"
+#include "power_management.h"
 
 namespace HareTortoiseClockSystem {
 
-HareTortoiseClock::HareTortoiseClock() : clock_management_task_() {}
+/// スタック使用量の報告間隔(sec)
+constexpr int32_t STACK_REPORT_INTERVAL_SEC = 600;
+
+HareTortoiseClock::HareTortoiseClock()
+    : clock_management_task_(),
+      sntp_sync_task_(),
+      ble_time_beacon_(),
+      clock_state_listener_(),
+      ble_telemetry_characteristic_(),
+      ble_ota_characteristic_(),
+      firmware_validator_(),
+      ble_status_advertiser_() {}
 
 HareTortoiseClock::~HareTortoiseClock() = default;
 
 void HareTortoiseClock::Start() {
   // Initialize Log
   Logger::InitializeLogLevel();
+#ifdef CONFIG_BLE_TELEMETRY
+  TelemetryLog::Initialize();
+#endif
 
   ESP_LOGI(TAG, "Startup Hare Tortoise Clock. Version:%s", std::string(GIT_VERSION).c_str());
 
-  // Monitoring LED Init And ON
+  // 起床要因の判定 (針ドライバの無効保持の解除を含むためモーターより前)
+  DeepSleep::Initialize();
+  const bool is_wake_from_sleep = DeepSleep::IsWakeFromSleep();
+
+  // Monitoring LED Init And ON (deep sleepからの起床は運転を続けるためOFF)
   GPIO::InitOutput(static_cast<gpio_num_t>(CONFIG_MONITORING_OUTPUT_GPIO_NO),
-                   1);
+                   !is_wake_from_sleep);
 
   // Initialize NVS
   esp_err_t ret = nvs_flash_init();
@@ -44,74 +67,156 @@ void HareTortoiseClock::Start() {
   }
   ESP_ERROR_CHECK(ret);
 
+  // 動的周波数制御・自動light sleep (BLE・モーターのロック生成より前)
+  PowerManagement::Initialize();
+
   // Init GPIO ISR Service
   GPIO::InitGpioIsrService();
 
   // Timezone init
   Util::InitTimeZone();
 
-  // Bluetooth GATT Server
-  CreateBLEService();
+  // Bluetooth GATT Server (deep sleep時は受付期間のみ)
+  const bool is_ble_enabled = DeepSleep::IsBleWindowRequired();
+  if (is_ble_enabled) {
+    CreateBLEService();
+  }
 
   // ClockManagementTask
   clock_management_task_ =
       std::make_shared<ClockManagementTask>(weak_from_this());
+  clock_management_task_->AddStateListener(clock_state_listener_);
+  clock_management_task_->AddStateListener(ble_status_advertiser_);
+#ifdef CONFIG_BLE_OTA
+  // 更新後の初回起動であれば、原点検出と針位置の復元まで検証する
+  firmware_validator_ = std::make_shared<FirmwareValidator>();
+  firmware_validator_->Initialize();
+  clock_management_task_->AddStateListener(firmware_validator_);
+#endif
   clock_management_task_->Start();
 
+#ifdef CONFIG_SNTP_SYNC
+  // SNTP Sync (Wi-Fi Burst) deep sleepからの起床では行わない
+  if (!is_wake_from_sleep) {
+    sntp_sync_task_ = std::make_shared<SntpSyncTask>(weak_from_this());
+    sntp_sync_task_->Start();
+  }
+#endif
+
+#ifdef CONFIG_TIME_BEACON
+  // 時刻ビーコン (時計間の時刻伝搬)
+  if (is_ble_enabled) {
+    ble_time_beacon_ = std::make_shared<BleTimeBeacon>(weak_from_this());
+    ble_time_beacon_->Start();
+  }
+#endif
+
   ESP_LOGI(TAG, "Activation Complete Hare Tortoise Clock System.");
 
+  int32_t elapsed_sec = 0;
   while (true) {
     Util::SleepMillisecond(1000);
+
+    // 内容が変わった場合のみ更新 (同期経過時間は分単位)
+    if (ble_status_advertiser_) {
+      ble_status_advertiser_->Update();
+    }
+    if (firmware_validator_) {
+      firmware_validator_->Update();
+    }
+
+    if (STACK_REPORT_INTERVAL_SEC <= ++elapsed_sec) {
+      elapsed_sec = 0;
+      ESP_LOGI(TAG, "Stack main free:%u", uxTaskGetStackHighWaterMark(nullptr));
+      Task::LogStackHighWaterMarks();
+      PowerManagement::ReportStatistics();
+    }
   }
 }
 
 void HareTortoiseClock::CreateBLEService() {
-  // Create BleTimeCharacteristic 157c64df-ca4b-4647-b26b-4ddc2ab42797
+  // Create BleTimeCharacteristic
   constexpr esp_gatt_char_prop_t time_char_property =
       ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_WRITE;
-  constexpr uint8_t TIME_CHARACTERISTIC_UUID_RAW[ESP_UUID_LEN_128] = {
-      0x97, 0x27, 0xb4, 0x2a, 0xdc, 0x4d, 0x6b, 0xb2,
-      0x47, 0x46, 0x4b, 0xca, 0xdf, 0x64, 0x7c, 0x15};
-  esp_bt_uuid_t time_characteristic_uuid = {.len = ESP_UUID_LEN_128,
-                                            .uuid = {.uuid128 = {}}};
-  std::memcpy(time_characteristic_uuid.uuid.uuid128,
-              TIME_CHARACTERISTIC_UUID_RAW, ESP_UUID_LEN_128);
   BleCharacteristicInterfaceSharedPtr ble_time_characteristic =
       std::make_shared<BleTimeCharacteristic>(
-          time_characteristic_uuid, time_char_property, weak_from_this());
+          TIME_CHARACTERISTIC_UUID.ToEspBtUuid(), time_char_property,
+          weak_from_this());
+
+  // Create BleTimeSyncCharacteristic
+  constexpr esp_gatt_char_prop_t time_sync_char_property =
+      ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_WRITE;
+  BleCharacteristicInterfaceSharedPtr ble_time_sync_characteristic =
+      std::make_shared<BleTimeSyncCharacteristic>(
+          TIME_SYNC_CHARACTERISTIC_UUID.ToEspBtUuid(), time_sync_char_property,
+          weak_from_this());
 
-  // Create BleCommandCharacteristic bd902d82-f4bd-45c8-baf8-040b3d877abe
+  // Create BleCommandCharacteristic
   constexpr esp_gatt_char_prop_t command_char_property =
-      ESP_GATT_CHAR_PROP_BIT_WRITE;
-  constexpr uint8_t DEMO_CHARACTERISTIC_UUID_RAW[ESP_UUID_LEN_128] = {
-      0xbe, 0x7a, 0x87, 0x3d, 0x0b, 0x04, 0xf8, 0xba,
-      0xc8, 0x45, 0xbd, 0xf4, 0x82, 0x2d, 0x90, 0xbd};
-  esp_bt_uuid_t command_characteristic_uuid = {.len = ESP_UUID_LEN_128,
-                                               .uuid = {.uuid128 = {}}};
-  std::memcpy(command_characteristic_uuid.uuid.uuid128,
-              DEMO_CHARACTERISTIC_UUID_RAW, ESP_UUID_LEN_128);
+      ESP_GATT_CHAR_PROP_BIT_WRITE | ESP_GATT_CHAR_PROP_BIT_WRITE_NR |
+      ESP_GATT_CHAR_PROP_BIT_NOTIFY;
   BleCharacteristicInterfaceSharedPtr ble_command_characteristic =
       std::make_shared<BleCommandCharacteristic>(
-          command_characteristic_uuid, command_char_property, weak_from_this());
+          COMMAND_CHARACTERISTIC_UUID.ToEspBtUuid(), command_char_property,
+          weak_from_this());
+
+  // Create BleStatusCharacteristic
+  constexpr esp_gatt_char_prop_t status_char_property =
+      ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_NOTIFY;
+  std::shared_ptr<BleStatusCharacteristic> ble_status_characteristic =
+      std::make_shared<BleStatusCharacteristic>(
+          STATUS_CHARACTERISTIC_UUID.ToEspBtUuid(), status_char_property);
+  clock_state_listener_ = ble_status_characteristic;
+
+#ifdef CONFIG_BLE_TELEMETRY
+  // Create BleTelemetryCharacteristic
+  constexpr esp_gatt_char_prop_t telemetry_char_property =
+      ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_WRITE |
+      ESP_GATT_CHAR_PROP_BIT_NOTIFY;
+  ble_telemetry_characteristic_ = std::make_shared<BleTelemetryCharacteristic>(
+      TELEMETRY_CHARACTERISTIC_UUID.ToEspBtUuid(), telemetry_char_property);
+#endif
 
-  // Create BleClockService f5c85862-dd4b-4874-9089-3b9e8bcb7099
-  constexpr uint8_t SERVICE_UUID_RAW[ESP_UUID_LEN_128] = {
-      0x99, 0x70, 0xcb, 0x8b, 0x9e, 0x3b, 0x89, 0x90,
-      0x74, 0x48, 0x4b, 0xdd, 0x62, 0x58, 0xc8, 0xf5};
-  esp_bt_uuid_t service_uuid = {.len = ESP_UUID_LEN_128,
-                                .uuid = {.uuid128 = {}}};
+#ifdef CONFIG_BLE_OTA
+  // Create BleOtaCharacteristic
+  constexpr esp_gatt_char_prop_t ota_char_property =
+      ESP_GATT_CHAR_PROP_BIT_WRITE | ESP_GATT_CHAR_PROP_BIT_WRITE_NR |
+      ESP_GATT_CHAR_PROP_BIT_NOTIFY;
+  ble_ota_characteristic_ = std::make_shared<BleOtaCharacteristic>(
+      OTA_CHARACTERISTIC_UUID.ToEspBtUuid(), ota_char_property,
+      weak_from_this());
+#endif
 
-  std::memcpy(service_uuid.uuid.uuid128, SERVICE_UUID_RAW, ESP_UUID_LEN_128);
+  // Create BleClockService
   BleServiceInterfaceSharedPtr ble_clock_service =
-      std::make_shared<BleClockService>(0, service_uuid, 8);
+      std::make_shared<BleClockService>(0, CLOCK_SERVICE_UUID.ToEspBtUuid());
   ble_clock_service->AddCharacteristic(ble_time_characteristic);
+  ble_clock_service->AddCharacteristic(ble_time_sync_characteristic);
   ble_clock_service->AddCharacteristic(ble_command_characteristic);
+  ble_clock_service->AddCharacteristic(ble_status_characteristic);
+  if (ble_telemetry_characteristic_) {
+    ble_clock_service->AddCharacteristic(ble_telemetry_characteristic_);
+  }
+  if (ble_ota_characteristic_) {
+    ble_clock_service->AddCharacteristic(ble_ota_characteristic_);
+  }
+
+  // 接続不要の状態監視ブロック
+  ble_status_advertiser_ =
+      std::make_shared<BleStatusAdvertiser>(weak_from_this());
 
   // Start Bletooth Low Energy
   BleDevice *const ble_device = BleDevice::GetInstance();
   ble_device->Initialize();
   ble_device->AddService(ble_clock_service);
   ble_device->StartAdvertising();
+
+  if (ble_telemetry_characteristic_) {
+    ble_telemetry_characteristic_->Start();
+  }
+  if (ble_ota_characteristic_) {
+    ble_ota_characteristic_->Start();
+  }
 }
 
 void HareTortoiseClock::SetUnixTime(const std::time_t epoc) {
@@ -120,6 +225,20 @@ void HareTortoiseClock::SetUnixTime(const std::time_t epoc) {
   }
 }
 
+void HareTortoiseClock::AdjustTime(const int64_t offset_us) {
+  if (clock_management_task_) {
+    clock_management_task_->AdjustTime(offset_us);
+  }
+}
+
+void HareTortoiseClock::Restart() {
+  if (clock_management_task_) {
+    clock_management_task_->Restart();
+  } else {
+    esp_restart();
+  }
+}
+
 void HareTortoiseClock::EmergencyStop() {
   if (clock_management_task_) {
     clock_management_task_->EmergencyStop();
@@ -133,4 +252,33 @@ std::time_t HareTortoiseClock::GetUnixTime() const {
   return 0;
 }
 
+void HareTortoiseClock::AdoptTime(const int64_t offset_us, const uint8_t hops,
+                                  const uint16_t uncertainty_ms) {
+  if (clock_management_task_) {
+    clock_management_task_->AdoptTime(offset_us, hops, uncertainty_ms);
+  }
+}
+
+HareTortoiseClockInterface::TimeSyncState HareTortoiseClock::GetTimeSyncState()
+    const {
+  if (clock_management_task_) {
+    return clock_management_task_->GetTimeSyncState();
+  }
+  return TimeSyncState{};
+}
+
+ClockState HareTortoiseClock::GetClockState() const {
+  if (clock_management_task_) {
+    return clock_management_task_->GetClockState();
+  }
+  return ClockState{};
+}
+
+bool HareTortoiseClock::RunChoreography(const Choreography &choreography) {
+  if (clock_management_task_) {
+    return clock_management_task_->RunChoreography(choreography);
+  }
+  return false;
+}
+
 }  // namespace HareTortoiseClockSystem
@@ -6,8 +6,14 @@
 // Include ----------------------
 #include <memory>
 
+#include "ble_ota.h"
+#include "ble_status_advertiser.h"
+#include "ble_telemetry.h"
+#include "ble_time_beacon.h"
 #include "clock_management_task.h"
+#include "firmware_validator.h"
 #include "hare_tortoise_clock_interface.h"
+#include "sntp_sync_task.h"
 
 namespace HareTortoiseClockSystem {
 
@@ -21,14 +27,31 @@ class HareTortoiseClock final : public HareTortoiseClockInterface,
   void Start();
 
   void SetUnixTime(const std::time_t epoc) override;
+  void AdjustTime(const int64_t offset_us) override;
   void EmergencyStop() override;
+  void Restart() override;
   std::time_t GetUnixTime() const override;
+  void AdoptTime(const int64_t offset_us, const uint8_t hops,
+                 const uint16_t uncertainty_ms) override;
+  TimeSyncState GetTimeSyncState() const override;
+  ClockState GetClockState() const override;
+  bool RunChoreography(const Choreography &choreography) override;
 
  private:
   void CreateBLEService();
 
  private:
   ClockManagementSharedPtr clock_management_task_;
+  SntpSyncTaskSharedPtr sntp_sync_task_;
+  BleTimeBeaconSharedPtr ble_time_beacon_;
+  /// 状態通知のCharacteristic
+  ClockStateListenerInterfaceSharedPtr clock_state_listener_;
+  BleTelemetryCharacteristicSharedPtr ble_telemetry_characteristic_;
+  BleOtaCharacteristicSharedPtr ble_ota_characteristic_;
+  /// 更新後の初回起動の検証 (ロールバック)
+  FirmwareValidatorSharedPtr firmware_validator_;
+  /// 状態監視ブロック (スキャンレスポンス)
+  BleStatusAdvertiserSharedPtr ble_status_advertiser_;
 };
 
 }  // namespace HareTortoiseClockSystem
@@ -4,18 +4,97 @@
 // (C)2024 bekki.jp
 
 // Include ----------------------
+#include <array>
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 
 namespace HareTortoiseClockSystem {
 
+/// 時計の状態 (状態通知用)
+struct ClockState {
+  /// 1:エラー 2:初期化 3:設定待ち 4:運転中 5:設定中 6:再開
+  uint8_t status;
+  /// 表示中の時刻
+  uint8_t hour;
+  uint8_t minute;
+  /// 最後の移動結果 (MoveResult)
+  uint8_t hour_move_result;
+  uint8_t minute_move_result;
+  /// 針位置(step)
+  int32_t hour_pos;
+  int32_t minute_pos;
+};
+
+/// 針の振り付け (コマンドで指定した針移動・待機の並び)
+struct Choreography {
+  static constexpr size_t MAX_STEPS = 16;
+  static constexpr uint8_t MAX_REPEAT = 10;
+  /// 位置の分解能 (目盛の始点0 - 終点POSITION_SCALE)
+  static constexpr uint16_t POSITION_SCALE = 1000;
+  /// 対象
+  static constexpr uint8_t HAND_HOUR = 0x01;
+  static constexpr uint8_t HAND_MINUTE = 0x02;
+
+  struct Step {
+    /// 移動する針 (0:待機)
+    uint8_t hands;
+    uint16_t position;
+    /// 移動速度(Hz) 0は標準速度
+    uint16_t hour_hz;
+    uint16_t minute_hz;
+    uint16_t wait_ms;
+  };
+
+  std::array<Step, MAX_STEPS> steps;
+  uint8_t count;
+  uint8_t repeat;
+};
+
+/// 時計の状態変化の通知先
+class ClockStateListenerInterface {
+ public:
+  virtual ~ClockStateListenerInterface() = default;
+
+  virtual void OnClockStateChanged(const ClockState &state) = 0;
+};
+
+using ClockStateListenerInterfaceSharedPtr =
+    std::shared_ptr<ClockStateListenerInterface>;
+using ClockStateListenerInterfaceWeakPtr =
+    std::weak_ptr<ClockStateListenerInterface>;
+
 class HareTortoiseClockInterface {
  public:
+  /// 時刻の同期状態 (時刻ビーコン用)
+  struct TimeSyncState {
+    bool is_synced;
+    /// 直接同期した時計からの段数 (0:直接同期)
+    uint8_t hops;
+    /// 同期時点の推定誤差(ms)
+    uint16_t uncertainty_ms;
+    /// 最終同期時刻(Unix時間 us)
+    int64_t last_sync_us;
+    /// 推定した水晶のずれ(ppb)
+    int32_t drift_ppb;
+  };
+
   virtual ~HareTortoiseClockInterface() = default;
 
   virtual void SetUnixTime(const std::time_t epoc) = 0;
+  virtual void AdjustTime(const int64_t offset_us) = 0;
   virtual void EmergencyStop() = 0;
+  virtual void Restart() = 0;
   virtual std::time_t GetUnixTime() const = 0;
+  /// 他の時計のビーコンから得た時刻差の採用
+  virtual void AdoptTime(const int64_t offset_us, const uint8_t hops,
+                         const uint16_t uncertainty_ms) = 0;
+  virtual TimeSyncState GetTimeSyncState() const = 0;
+  virtual ClockState GetClockState() const = 0;
+  /// 振り付けの実行予約 (設定待ち・運転中のみ 実行中・予約済みの場合false)
+  /// 運転中は実行後に時刻の位置へ戻る
+  virtual bool RunChoreography(const Choreography &choreography) = 0;
 };
 
 using HareTortoiseClockInterfaceSharedPtr = std::shared_ptr<HareTortoiseClockInterface>;
@@ -0,0 +1,85 @@
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include "heap_audit.h"
+
+#include <esp_attr.h>
+#include <sdkconfig.h>
+
+#include <atomic>
+
+#include "logger.h"
+
+namespace HareTortoiseClockSystem::HeapAudit {
+
+#if CONFIG_HEAP_ALLOCATION_AUDIT
+static TaskHandle_t s_WatchTasks[MAX_WATCH_TASKS] = {};
+static std::atomic<uint32_t> s_AllocationCount(0);
+static std::atomic<uint32_t> s_LastAllocationSize(0);
+static uint32_t s_CheckedCount = 0;
+
+static bool IRAM_ATTR IsWatchedTask(const TaskHandle_t task) {
+  for (const TaskHandle_t watch_task : s_WatchTasks) {
+    if (watch_task && watch_task == task) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void WatchCurrentTask() {
+  const TaskHandle_t task = xTaskGetCurrentTaskHandle();
+  for (TaskHandle_t& watch_task : s_WatchTasks) {
+    if (!watch_task) {
+      watch_task = task;
+      return;
+    }
+  }
+  ESP_LOGW(TAG, "Heap audit watch list is full");
+}
+
+uint32_t GetAllocationCount() { return s_AllocationCount.load(); }
+
+uint32_t GetLastAllocationSize() { return s_LastAllocationSize.load(); }
+
+void ResetSteadyState() { s_CheckedCount = GetAllocationCount(); }
+
+bool CheckSteadyState(const char* const phase) {
+  const uint32_t count = GetAllocationCount();
+  const uint32_t diff = count - s_CheckedCount;
+  s_CheckedCount = count;
+  if (diff != 0) {
+    ESP_LOGE(TAG,
+             "Heap allocation in steady state. phase:%s count:%u "
+             "last_size:%u",
+             phase, diff, GetLastAllocationSize());
+    return false;
+  }
+  return true;
+}
+#else
+void WatchCurrentTask() {}
+
+uint32_t GetAllocationCount() { return 0; }
+
+uint32_t GetLastAllocationSize() { return 0; }
+
+void ResetSteadyState() {}
+
+bool CheckSteadyState(const char* const phase) { return true; }
+#endif
+
+}  // namespace HareTortoiseClockSystem::HeapAudit
+
+#if CONFIG_HEAP_ALLOCATION_AUDIT
+/// ESP-IDF heap hook (CONFIG_HEAP_USE_HOOKS)
+extern "C" void IRAM_ATTR esp_heap_trace_alloc_hook(void* ptr, size_t size,
+                                                     uint32_t caps) {
+  using namespace HareTortoiseClockSystem::HeapAudit;
+  if (IsWatchedTask(xTaskGetCurrentTaskHandle())) {
+    s_AllocationCount.fetch_add(1);
+    s_LastAllocationSize.store(size);
+  }
+}
+#endif
@@ -0,0 +1,35 @@
+#ifndef HEAP_AUDIT_H_
+#define HEAP_AUDIT_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <cstdint>
+
+namespace HareTortoiseClockSystem::HeapAudit {
+
+/// 監視対象タスクの最大数
+constexpr int32_t MAX_WATCH_TASKS = 4;
+
+/// 呼び出し元タスクを監視対象に追加
+void WatchCurrentTask();
+
+/// 監視対象タスクで発生したヒープ確保回数
+uint32_t GetAllocationCount();
+
+/// 監視対象タスクで最後に確保されたサイズ
+uint32_t GetLastAllocationSize();
+
+/// 定常状態の基準点を現在の確保回数に設定
+void ResetSteadyState();
+
+/// 前回呼び出しからの確保回数を確認 (0以外の場合はエラーログ)
+/// @return 確保が発生していなければtrue
+bool CheckSteadyState(const char* const phase);
+
+}  // namespace HareTortoiseClockSystem::HeapAudit
+
+#endif  // HEAP_AUDIT_H_
@@ -0,0 +1,410 @@
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include "local_time.h"
+
+#include <freertos/FreeRTOS.h>
+
+#include <limits>
+
+namespace HareTortoiseClockSystem::LocalTime {
+
+constexpr int64_t SECONDS_PER_DAY = 24 * 60 * 60;
+constexpr int64_t MICROSECONDS_PER_SECOND = 1000000;
+constexpr int64_t MICROSECONDS_PER_MINUTE = 60 * MICROSECONDS_PER_SECOND;
+constexpr int64_t MICROSECONDS_PER_HOUR = 60 * MICROSECONDS_PER_MINUTE;
+/// 夏時間の切替時刻の既定値 (02:00:00)
+constexpr int32_t DEFAULT_TRANSITION_TIME_SEC = 2 * 60 * 60;
+/// 夏時間のオフセット省略時は標準時+1時間
+constexpr int32_t DEFAULT_DST_SHIFT_SEC = 60 * 60;
+/// 切替規則の省略時 (POSIX既定 米国 M3.2.0,M11.1.0)
+constexpr TransitionRule DEFAULT_DST_START = {
+    TransitionRule::MONTH_WEEK_DAY, 0, 3, 2, 0, DEFAULT_TRANSITION_TIME_SEC};
+constexpr TransitionRule DEFAULT_DST_END = {
+    TransitionRule::MONTH_WEEK_DAY, 0, 11, 1, 0, DEFAULT_TRANSITION_TIME_SEC};
+
+namespace {
+
+/// 設定中のタイムゾーンと直近の期間 (BLEスレッドからも参照)
+portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+TimeZoneRule time_zone = {};
+Period cached_period = {};
+
+int64_t FloorDiv(const int64_t value, const int64_t divisor) {
+  const int64_t quotient = value / divisor;
+  return (value % divisor < 0) ? quotient - 1 : quotient;
+}
+
+bool IsLeapYear(const int32_t year) {
+  return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+/// 曜日 (0:日曜) 1970/1/1は木曜
+int32_t Weekday(const int64_t days) {
+  const int64_t weekday = (days + 4) % 7;
+  return static_cast<int32_t>(weekday < 0 ? weekday + 7 : weekday);
+}
+
+void CivilFromDays(int64_t days, int32_t *const year, int32_t *const month,
+                   int32_t *const day) {
+  days += 719468;
+  const int64_t era = FloorDiv(days, 146097);
+  const int64_t day_of_era = days - era * 146097;
+  const int64_t year_of_era =
+      (day_of_era - day_of_era / 1460 + day_of_era / 36524 -
+       day_of_era / 146096) /
+      365;
+  const int64_t day_of_year =
+      day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+  const int64_t month_index = (5 * day_of_year + 2) / 153;
+  *day = static_cast<int32_t>(day_of_year - (153 * month_index + 2) / 5 + 1);
+  *month = static_cast<int32_t>(month_index < 10 ? month_index + 3
+                                                 : month_index - 9);
+  *year = static_cast<int32_t>(year_of_era + era * 400 + (*month <= 2));
+}
+
+/// 数値 (桁数の上限あり)
+bool ParseNumber(std::string_view *const text, const int32_t max_digits,
+                 int32_t *const value) {
+  int32_t digits = 0;
+  int32_t result = 0;
+  while (!text->empty() && '0' <= text->front() && text->front() <= '9' &&
+         digits < max_digits) {
+    result = result * 10 + (text->front() - '0');
+    text->remove_prefix(1);
+    ++digits;
+  }
+  *value = result;
+  return 0 < digits;
+}
+
+/// 名前 (英字3文字以上 もしくは <...>)
+bool ParseName(std::string_view *const text) {
+  if (!text->empty() && text->front() == '<') {
+    const size_t close = text->find('>');
+    if (close == std::string_view::npos) {
+      return false;
+    }
+    text->remove_prefix(close + 1);
+    return true;
+  }
+  size_t length = 0;
+  while (length < text->size() &&
+         (('A' <= (*text)[length] && (*text)[length] <= 'Z') ||
+          ('a' <= (*text)[length] && (*text)[length] <= 'z'))) {
+    ++length;
+  }
+  text->remove_prefix(length);
+  return 3 <= length;
+}
+
+/// [+-]hh[:mm[:ss]] (秒)
+bool ParseTime(std::string_view *const text, int32_t *const seconds) {
+  int32_t sign = 1;
+  if (!text->empty() && (text->front() == '+' || text->front() == '-')) {
+    sign = (text->front() == '-') ? -1 : 1;
+    text->remove_prefix(1);
+  }
+  int32_t hour = 0;
+  int32_t minute = 0;
+  int32_t second = 0;
+  if (!ParseNumber(text, 3, &hour)) {
+    return false;
+  }
+  if (!text->empty() && text->front() == ':') {
+    text->remove_prefix(1);
+    if (!ParseNumber(text, 2, &minute)) {
+      return false;
+    }
+    if (!text->empty() && text->front() == ':') {
+      text->remove_prefix(1);
+      if (!ParseNumber(text, 2, &second)) {
+        return false;
+      }
+    }
+  }
+  *seconds = sign * (hour * 3600 + minute * 60 + second);
+  return true;
+}
+
+/// Jn / n / Mm.w.d [/time]
+bool ParseRule(std::string_view *const text, TransitionRule *const rule) {
+  int32_t value = 0;
+  *rule = {};
+  if (!text->empty() && text->front() == 'M') {
+    text->remove_prefix(1);
+    int32_t week = 0;
+    int32_t weekday = 0;
+    if (!ParseNumber(text, 2, &value) || text->empty() ||
+        text->front() != '.') {
+      return false;
+    }
+    text->remove_prefix(1);
+    if (!ParseNumber(text, 1, &week) || text->empty() ||
+        text->front() != '.') {
+      return false;
+    }
+    text->remove_prefix(1);
+    if (!ParseNumber(text, 1, &weekday) || value < 1 || 12 < value ||
+        week < 1 || 5 < week || 6 < weekday) {
+      return false;
+    }
+    rule->type = TransitionRule::MONTH_WEEK_DAY;
+    rule->month = static_cast<int8_t>(value);
+    rule->week = static_cast<int8_t>(week);
+    rule->weekday = static_cast<int8_t>(weekday);
+  } else if (!text->empty() && text->front() == 'J') {
+    text->remove_prefix(1);
+    if (!ParseNumber(text, 3, &value) || value < 1 || 365 < value) {
+      return false;
+    }
+    rule->type = TransitionRule::JULIAN_NO_LEAP;
+    rule->day = static_cast<int16_t>(value);
+  } else {
+    if (!ParseNumber(text, 3, &value) || 365 < value) {
+      return false;
+    }
+    rule->type = TransitionRule::ZERO_BASED;
+    rule->day = static_cast<int16_t>(value);
+  }
+
+  rule->time_sec = DEFAULT_TRANSITION_TIME_SEC;
+  if (!text->empty() && text->front() == '/') {
+    text->remove_prefix(1);
+    return ParseTime(text, &rule->time_sec);
+  }
+  return true;
+}
+
+/// 切替日 (1970/1/1からの日数)
+int64_t TransitionDays(const TransitionRule &rule, const int32_t year) {
+  const int64_t year_begin = DaysFromCivil(year, 1, 1);
+  if (rule.type == TransitionRule::JULIAN_NO_LEAP) {
+    const bool is_after_leap_day = IsLeapYear(year) && 60 <= rule.day;
+    return year_begin + rule.day - 1 + (is_after_leap_day ? 1 : 0);
+  }
+  if (rule.type == TransitionRule::ZERO_BASED) {
+    return year_begin + rule.day;
+  }
+  const int64_t month_begin = DaysFromCivil(year, rule.month, 1);
+  const int64_t next_month_begin =
+      (rule.month == 12) ? DaysFromCivil(year + 1, 1, 1)
+                         : DaysFromCivil(year, rule.month + 1, 1);
+  int64_t days = month_begin + (rule.weekday - Weekday(month_begin) + 7) % 7 +
+                 (rule.week - 1) * 7;
+  // 第5週は最終週 (月を超えた場合は1週戻す)
+  if (next_month_begin <= days) {
+    days -= 7;
+  }
+  return days;
+}
+
+/// 切替時刻(Unix時間) 切替前のオフセットの地方時で指定される
+int64_t TransitionSeconds(const TransitionRule &rule, const int32_t year,
+                          const int32_t offset_before_sec) {
+  return TransitionDays(rule, year) * SECONDS_PER_DAY + rule.time_sec -
+         offset_before_sec;
+}
+
+Period GetPeriod(const int64_t epoch_sec) {
+  portENTER_CRITICAL(&mux);
+  const Period cached = cached_period;
+  const TimeZoneRule rule = time_zone;
+  portEXIT_CRITICAL(&mux);
+  if (cached.begin_sec <= epoch_sec && epoch_sec < cached.end_sec) {
+    return cached;
+  }
+
+  // 期間外のみ再計算 (通常は夏時間の切替時のみ)
+  const Period period = CalcPeriod(rule, epoch_sec);
+  portENTER_CRITICAL(&mux);
+  cached_period = period;
+  portEXIT_CRITICAL(&mux);
+  return period;
+}
+
+int64_t MicrosecondsUntilNext(const int64_t epoch_us, const int64_t unit_us) {
+  const Period period = GetPeriod(FloorDiv(epoch_us, MICROSECONDS_PER_SECOND));
+  const int64_t local_us =
+      epoch_us + static_cast<int64_t>(period.offset_sec) *
+                     MICROSECONDS_PER_SECOND;
+  int64_t until_us = unit_us - (local_us - FloorDiv(local_us, unit_us) * unit_us);
+
+  // 夏時間の切替でも表示が変わる
+  if (period.end_sec != std::numeric_limits<int64_t>::max()) {
+    const int64_t until_transition_us =
+        period.end_sec * MICROSECONDS_PER_SECOND - epoch_us;
+    if (until_transition_us < until_us) {
+      until_us = until_transition_us;
+    }
+  }
+  return until_us;
+}
+
+}  // namespace
+
+int64_t DaysFromCivil(int32_t year, const int32_t month, const int32_t day) {
+  year -= (month <= 2) ? 1 : 0;
+  const int64_t era = FloorDiv(year, 400);
+  const int64_t year_of_era = year - era * 400;
+  const int64_t day_of_year =
+      (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+  const int64_t day_of_era =
+      year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+  return era * 146097 + day_of_era - 719468;
+}
+
+bool ParseTimeZone(std::string_view posix_tz, TimeZoneRule *const rule) {
+  *rule = {};
+
+  // 標準時 (POSIXのオフセットは西が正のため反転)
+  int32_t offset_sec = 0;
+  if (!ParseName(&posix_tz) || !ParseTime(&posix_tz, &offset_sec)) {
+    return false;
+  }
+  rule->std_offset_sec = -offset_sec;
+  if (posix_tz.empty()) {
+    return true;
+  }
+
+  // 夏時間
+  if (!ParseName(&posix_tz)) {
+    return false;
+  }
+  rule->has_dst = true;
+  rule->dst_offset_sec = rule->std_offset_sec + DEFAULT_DST_SHIFT_SEC;
+  if (!posix_tz.empty() && posix_tz.front() != ',') {
+    if (!ParseTime(&posix_tz, &offset_sec)) {
+      return false;
+    }
+    rule->dst_offset_sec = -offset_sec;
+  }
+
+  if (posix_tz.empty()) {
+    rule->dst_start = DEFAULT_DST_START;
+    rule->dst_end = DEFAULT_DST_END;
+    return true;
+  }
+  if (posix_tz.front() != ',') {
+    return false;
+  }
+  posix_tz.remove_prefix(1);
+  if (!ParseRule(&posix_tz, &rule->dst_start) || posix_tz.empty() ||
+      posix_tz.front() != ',') {
+    return false;
+  }
+  posix_tz.remove_prefix(1);
+  return ParseRule(&posix_tz, &rule->dst_end) && posix_tz.empty();
+}
+
+Period CalcPeriod(const TimeZoneRule &rule, const int64_t epoch_sec) {
+  if (!rule.has_dst) {
+    return {std::numeric_limits<int64_t>::min(),
+            std::numeric_limits<int64_t>::max(), rule.std_offset_sec, false};
+  }
+
+  int32_t year = 0;
+  int32_t month = 0;
+  int32_t day = 0;
+  CivilFromDays(FloorDiv(epoch_sec + rule.std_offset_sec, SECONDS_PER_DAY),
+                &year, &month, &day);
+
+  const auto start_of = [&rule](const int32_t y) {
+    return TransitionSeconds(rule.dst_start, y, rule.std_offset_sec);
+  };
+  const auto end_of = [&rule](const int32_t y) {
+    return TransitionSeconds(rule.dst_end, y, rule.dst_offset_sec);
+  };
+  const Period std_period = {0, 0, rule.std_offset_sec, false};
+  const Period dst_period = {0, 0, rule.dst_offset_sec, true};
+
+  const int64_t start_sec = start_of(year);
+  const int64_t end_sec = end_of(year);
+  Period period = {};
+  if (start_sec < end_sec) {
+    // 北半球 (年内に夏時間)
+    if (epoch_sec < start_sec) {
+      period = std_period;
+      period.begin_sec = end_of(year - 1);
+      period.end_sec = start_sec;
+    } else if (epoch_sec < end_sec) {
+      period = dst_period;
+      period.begin_sec = start_sec;
+      period.end_sec = end_sec;
+    } else {
+      period = std_period;
+      period.begin_sec = end_sec;
+      period.end_sec = start_of(year + 1);
+    }
+  } else {
+    // 南半球 (年をまたいで夏時間)
+    if (epoch_sec < end_sec) {
+      period = dst_period;
+      period.begin_sec = start_of(year - 1);
+      period.end_sec = end_sec;
+    } else if (epoch_sec < start_sec) {
+      period = std_period;
+      period.begin_sec = end_sec;
+      period.end_sec = start_sec;
+    } else {
+      period = dst_period;
+      period.begin_sec = start_sec;
+      period.end_sec = end_of(year + 1);
+    }
+  }
+  return period;
+}
+
+bool Initialize(std::string_view posix_tz) {
+  TimeZoneRule rule = {};
+  const bool is_parsed = ParseTimeZone(posix_tz, &rule);
+  if (!is_parsed) {
+    rule = {};
+  }
+
+  portENTER_CRITICAL(&mux);
+  time_zone = rule;
+  cached_period = {};
+  portEXIT_CRITICAL(&mux);
+  return is_parsed;
+}
+
+std::tm ToLocalTime(const std::time_t epoch) {
+  const Period period = GetPeriod(epoch);
+  const int64_t local_sec = static_cast<int64_t>(epoch) + period.offset_sec;
+  const int64_t days = FloorDiv(local_sec, SECONDS_PER_DAY);
+  const int32_t second_of_day =
+      static_cast<int32_t>(local_sec - days * SECONDS_PER_DAY);
+
+  int32_t year = 0;
+  int32_t month = 0;
+  int32_t day = 0;
+  CivilFromDays(days, &year, &month, &day);
+
+  std::tm time_info = {};
+  time_info.tm_year = year - 1900;
+  time_info.tm_mon = month - 1;
+  time_info.tm_mday = day;
+  time_info.tm_hour = second_of_day / 3600;
+  time_info.tm_min = second_of_day / 60 % 60;
+  time_info.tm_sec = second_of_day % 60;
+  time_info.tm_wday = Weekday(days);
+  time_info.tm_yday = static_cast<int32_t>(days - DaysFromCivil(year, 1, 1));
+  time_info.tm_isdst = period.is_dst ? 1 : 0;
+  return time_info;
+}
+
+int32_t GetUtcOffsetSeconds(const std::time_t epoch) {
+  return GetPeriod(epoch).offset_sec;
+}
+
+int64_t MicrosecondsUntilNextMinute(const int64_t epoch_us) {
+  return MicrosecondsUntilNext(epoch_us, MICROSECONDS_PER_MINUTE);
+}
+
+int64_t MicrosecondsUntilNextHour(const int64_t epoch_us) {
+  return MicrosecondsUntilNext(epoch_us, MICROSECONDS_PER_HOUR);
+}
+
+}  // namespace HareTortoiseClockSystem::LocalTime
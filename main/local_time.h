@@ -0,0 +1,70 @@
+#ifndef LOCAL_TIME_H_
+#define LOCAL_TIME_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include <cstdint>
+#include <ctime>
+#include <string_view>
+
+namespace HareTortoiseClockSystem::LocalTime {
+
+/// 夏時間の切替日時 (POSIX TZ の Jn / n / Mm.w.d)
+struct TransitionRule {
+  enum Type : uint8_t {
+    JULIAN_NO_LEAP,  // Jn (1-365 2/29を数えない)
+    ZERO_BASED,      // n (0-365)
+    MONTH_WEEK_DAY,  // Mm.w.d (m月 第w週(5:最終) d曜日)
+  };
+  Type type;
+  int16_t day;
+  int8_t month;
+  int8_t week;
+  int8_t weekday;
+  /// 切替時刻 (その時点の地方時 秒)
+  int32_t time_sec;
+};
+
+/// 解析済みのタイムゾーン (オフセットは 地方時 - UTC)
+struct TimeZoneRule {
+  int32_t std_offset_sec;
+  int32_t dst_offset_sec;
+  bool has_dst;
+  TransitionRule dst_start;
+  TransitionRule dst_end;
+};
+
+/// 同じオフセットが続く期間 [begin_sec, end_sec) (Unix時間)
+struct Period {
+  int64_t begin_sec;
+  int64_t end_sec;
+  int32_t offset_sec;
+  bool is_dst;
+};
+
+/// POSIX TZ文字列の解析 (例: "JST-9", "CET-1CEST,M3.5.0,M10.5.0/3")
+bool ParseTimeZone(std::string_view posix_tz, TimeZoneRule *const rule);
+
+/// 指定時刻を含む期間の計算
+Period CalcPeriod(const TimeZoneRule &rule, const int64_t epoch_sec);
+
+/// 年月日から1970/1/1からの日数
+int64_t DaysFromCivil(int32_t year, const int32_t month, const int32_t day);
+
+/// タイムゾーンの初期化 (解析に失敗した場合はUTC)
+bool Initialize(std::string_view posix_tz);
+
+/// Unix時間から地方時 (スレッドセーフ・ヒープ確保なし)
+std::tm ToLocalTime(const std::time_t epoch);
+
+/// UTCからのオフセット(秒)
+int32_t GetUtcOffsetSeconds(const std::time_t epoch);
+
+/// 次の分・時の切替までの時間(us) 夏時間の切替も境界とする
+int64_t MicrosecondsUntilNextMinute(const int64_t epoch_us);
+int64_t MicrosecondsUntilNextHour(const int64_t epoch_us);
+
+}  // namespace HareTortoiseClockSystem::LocalTime
+
+#endif  // LOCAL_TIME_H_
@@ -0,0 +1,132 @@
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include "power_fail_monitor.h"
+
+#include <esp_attr.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+
+#include "gpio_control.h"
+#include "logger.h"
+#include "util.h"
+
+namespace HareTortoiseClockSystem {
+
+#ifdef CONFIG_POWER_FAIL_DETECT
+/// NVS書き込み待機時間(ms)
+constexpr int32_t TRIGGER_RECEIVE_LIMIT_MS = 1000;
+#endif
+
+PowerFailMonitor::PowerFailMonitor()
+    : mux_(portMUX_INITIALIZER_UNLOCKED),
+      checkpoint_(nullptr),
+      hour_motor_(nullptr),
+      minute_motor_(nullptr),
+      epoch_offset_us_(0),
+      last_sync_us_(0),
+      last_precise_sync_us_(0),
+      is_time_set_(false),
+      is_triggered_(false) {}
+
+PowerFailMonitor::~PowerFailMonitor() {
+#ifdef CONFIG_POWER_FAIL_DETECT
+  if (checkpoint_) {
+    GPIO::RemoveIsrHandler(
+        static_cast<gpio_num_t>(CONFIG_POWER_FAIL_INPUT_GPIO_NO));
+  }
+#endif
+}
+
+void PowerFailMonitor::Start(ClockCheckpoint *const checkpoint,
+                             StepperMotorControllerBase *const hour_motor,
+                             StepperMotorControllerBase *const minute_motor) {
+#ifdef CONFIG_POWER_FAIL_DETECT
+  checkpoint_ = checkpoint;
+  hour_motor_ = hour_motor;
+  minute_motor_ = minute_motor;
+
+  if (!trigger_queue_.Create()) {
+    ESP_LOGE(TAG, "Creating queue failed");
+    return;
+  }
+  flush_task_.Start();
+
+  // 電源監視ICの出力 (LOWで電源断)
+  const gpio_num_t gpio_number =
+      static_cast<gpio_num_t>(CONFIG_POWER_FAIL_INPUT_GPIO_NO);
+  GPIO::InitInput(gpio_number, GPIO::INPUT_EDGE_FALLING);
+  GPIO::AddIsrHandler(gpio_number, &PowerFailMonitor::GpioCallback, this);
+
+  ESP_LOGI(TAG, "Start Power Fail Monitor > gpio:%d", gpio_number);
+#endif
+}
+
+void PowerFailMonitor::UpdateClockState(const int64_t last_sync_us,
+                                        const int64_t last_precise_sync_us,
+                                        const bool is_time_set) {
+  // ISRでは時刻取得(gettimeofday)を使えないため、モノトニック時刻との差を保持
+  const int64_t epoch_offset_us =
+      Util::GetEpochMicroseconds() - esp_timer_get_time();
+
+  portENTER_CRITICAL(&mux_);
+  epoch_offset_us_ = epoch_offset_us;
+  last_sync_us_ = last_sync_us;
+  last_precise_sync_us_ = last_precise_sync_us;
+  is_time_set_ = is_time_set;
+  portEXIT_CRITICAL(&mux_);
+}
+
+#ifdef CONFIG_POWER_FAIL_DETECT
+void IRAM_ATTR PowerFailMonitor::GpioCallback(void *monitor) {
+  PowerFailMonitor *const self = static_cast<PowerFailMonitor *>(monitor);
+  if (self->is_triggered_) {
+    return;
+  }
+  self->is_triggered_ = true;
+
+  // 最優先でステップ出力を止める (以降の位置は変化しない)
+  self->hour_motor_->StopFromISR();
+  self->minute_motor_->StopFromISR();
+
+  ClockCheckpoint::Data data = {};
+  data.hour_pos = self->hour_motor_->GetPosition().Count();
+  data.minute_pos = self->minute_motor_->GetPosition().Count();
+  data.is_moving = 0;
+
+  portENTER_CRITICAL_ISR(&self->mux_);
+  data.saved_us = esp_timer_get_time() + self->epoch_offset_us_;
+  data.last_sync_us = self->last_sync_us_;
+  data.last_precise_sync_us = self->last_precise_sync_us_;
+  data.is_time_set = self->is_time_set_ ? 1 : 0;
+  portEXIT_CRITICAL_ISR(&self->mux_);
+
+  ClockCheckpoint::SaveFromISR(data);
+  self->trigger_queue_.SendFromISRAndYield(1);
+}
+
+PowerFailMonitor::FlushTask::FlushTask(PowerFailMonitor &monitor)
+    : Task(std::string(TASK_NAME).c_str(), PRIORITY, CORE_ID, STACK_DEPTH,
+           stack_buffer_),
+      stack_buffer_(),
+      monitor_(monitor) {}
+
+void PowerFailMonitor::FlushTask::Update() {
+  uint8_t trigger = 0;
+  if (!monitor_.trigger_queue_.ReceiveWait(&trigger,
+                                           TRIGGER_RECEIVE_LIMIT_MS)) {
+    return;
+  }
+
+  // 電源が完全に落ちるとRTCメモリも失われるため、保持時間内にNVSへ書き込む
+  monitor_.checkpoint_->FlushToNvs();
+  ESP_LOGW(TAG, "Power Fail > Saved Checkpoint");
+
+  // 電源が復帰した(瞬断)場合は記録から再開
+  Util::SleepMillisecond(100);
+  esp_restart();
+}
+#endif
+
+}  // namespace HareTortoiseClockSystem
@@ -0,0 +1,82 @@
+#ifndef POWER_FAIL_MONITOR_H_
+#define POWER_FAIL_MONITOR_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include <freertos/FreeRTOS.h>
+#include <sdkconfig.h>
+
+#include <cstdint>
+#include <string_view>
+
+#include "clock_checkpoint.h"
+#include "message_queue.h"
+#include "stepper_motor_controller.h"
+#include "task.h"
+
+namespace HareTortoiseClockSystem {
+
+/// 電源断検出入力(電源監視ICの出力)で動作を止め、針位置を記録する
+/// ESP32のブラウンアウト割込はIDFが占有しているため外部入力で検出する
+class PowerFailMonitor final {
+ public:
+  PowerFailMonitor();
+  ~PowerFailMonitor();
+
+  /// 監視開始 (CONFIG_POWER_FAIL_DETECT無効時は何もしない)
+  void Start(ClockCheckpoint *const checkpoint,
+             StepperMotorControllerBase *const hour_motor,
+             StepperMotorControllerBase *const minute_motor);
+
+  /// 記録する時刻・同期情報の更新 (毎秒)
+  void UpdateClockState(const int64_t last_sync_us,
+                        const int64_t last_precise_sync_us,
+                        const bool is_time_set);
+
+  /// 電源断を検出済みか
+  bool IsTriggered() const { return is_triggered_; }
+
+ private:
+#ifdef CONFIG_POWER_FAIL_DETECT
+  static void GpioCallback(void *monitor);
+
+  /// ISRの記録をNVSへ書き込み、電源が残っていれば再起動する
+  class FlushTask final : public Task {
+   public:
+    static constexpr std::string_view TASK_NAME = "PowerFailTask";
+    static constexpr int32_t PRIORITY = Task::PRIORITY_TOP;
+    static constexpr int32_t CORE_ID = PRO_CPU_NUM;
+    static constexpr uint32_t STACK_DEPTH = 3072;
+
+    explicit FlushTask(PowerFailMonitor &monitor);
+
+    void Update() override;
+
+   private:
+    StackType_t stack_buffer_[STACK_DEPTH];
+    PowerFailMonitor &monitor_;
+  };
+#endif
+
+ private:
+  mutable portMUX_TYPE mux_;
+  ClockCheckpoint *checkpoint_;
+  StepperMotorControllerBase *hour_motor_;
+  StepperMotorControllerBase *minute_motor_;
+  /// ISRで記録する時刻・同期情報
+  int64_t epoch_offset_us_;
+  int64_t last_sync_us_;
+  int64_t last_precise_sync_us_;
+  bool is_time_set_;
+  volatile bool is_triggered_;
+#ifdef CONFIG_POWER_FAIL_DETECT
+  /// 無効時はタスクとスタックを確保しない
+  StaticMessageQueue<uint8_t, 1> trigger_queue_;
+  FlushTask flush_task_{*this};
+#endif
+};
+
+}  // namespace HareTortoiseClockSystem
+
+#endif  // POWER_FAIL_MONITOR_H_
@@ -0,0 +1,94 @@
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include "power_management.h"
+
+#include <esp_pm.h>
+#include <sdkconfig.h>
+
+#include <cstdio>
+
+#include "logger.h"
+
+namespace HareTortoiseClockSystem::PowerManagement {
+
+#ifdef CONFIG_POWER_MANAGEMENT
+void Initialize() {
+  // 待機中はXTAL(40MHz)まで下げ、タスクが全て待機中であればlight sleep
+  // BLEは接続イベントの間modem sleep (低速クロックは32kHz XTAL)
+  const esp_pm_config_t pm_config = {
+      .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+      .min_freq_mhz = CONFIG_XTAL_FREQ,
+      .light_sleep_enable = true,
+  };
+  const esp_err_t ret = esp_pm_configure(&pm_config);
+  if (ret != ESP_OK) {
+    ESP_LOGE(TAG, "Power Management configure failed: %s",
+             esp_err_to_name(ret));
+    return;
+  }
+  ESP_LOGI(TAG, "Power Management > cpu:%d-%dMHz light sleep:on",
+           pm_config.min_freq_mhz, pm_config.max_freq_mhz);
+}
+
+void ReportStatistics() {
+#ifdef CONFIG_PM_PROFILING
+  // ロック毎の保持時間とモード毎(CPU_MAX/APB_MAX/APB_MIN/SLEEP)の滞在時間
+  esp_pm_dump_locks(stdout);
+#endif
+}
+
+MotionLock::MotionLock(const char* const name)
+    : cpu_freq_lock_(nullptr), no_light_sleep_lock_(nullptr) {
+  if (esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, name, &cpu_freq_lock_) !=
+          ESP_OK ||
+      esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, name,
+                         &no_light_sleep_lock_) != ESP_OK) {
+    ESP_LOGE(TAG, "Creating pm lock failed");
+  }
+}
+
+MotionLock::~MotionLock() {
+  if (cpu_freq_lock_) {
+    esp_pm_lock_delete(cpu_freq_lock_);
+  }
+  if (no_light_sleep_lock_) {
+    esp_pm_lock_delete(no_light_sleep_lock_);
+  }
+}
+
+void MotionLock::Acquire() {
+  // 取得した時点で最大周波数に切り替わる
+  if (cpu_freq_lock_) {
+    esp_pm_lock_acquire(cpu_freq_lock_);
+  }
+  if (no_light_sleep_lock_) {
+    esp_pm_lock_acquire(no_light_sleep_lock_);
+  }
+}
+
+void MotionLock::Release() {
+  if (no_light_sleep_lock_) {
+    esp_pm_lock_release(no_light_sleep_lock_);
+  }
+  if (cpu_freq_lock_) {
+    esp_pm_lock_release(cpu_freq_lock_);
+  }
+}
+#else
+void Initialize() {}
+
+void ReportStatistics() {}
+
+MotionLock::MotionLock(const char* const name)
+    : cpu_freq_lock_(nullptr), no_light_sleep_lock_(nullptr) {}
+
+MotionLock::~MotionLock() = default;
+
+void MotionLock::Acquire() {}
+
+void MotionLock::Release() {}
+#endif
+
+}  // namespace HareTortoiseClockSystem::PowerManagement
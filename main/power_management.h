@@ -0,0 +1,39 @@
+#ifndef POWER_MANAGEMENT_H_
+#define POWER_MANAGEMENT_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include <esp_pm.h>
+
+namespace HareTortoiseClockSystem::PowerManagement {
+
+/// 動的周波数制御と自動light sleepの設定
+/// 起動直後、各タスクの開始より前に呼び出す
+void Initialize();
+
+/// 省電力の状態の出力 (CONFIG_PM_PROFILING時はモード毎の滞在時間を含む)
+void ReportStatistics();
+
+/// 針の移動中に保持するロック (CPU最大周波数・light sleep禁止)
+/// ステップ周期が周波数切替・light sleepからの復帰で乱れないようにする
+class MotionLock {
+ public:
+  explicit MotionLock(const char* const name);
+  ~MotionLock();
+
+  /// コピー禁止
+  MotionLock(const MotionLock&) = delete;
+  MotionLock& operator=(const MotionLock&) = delete;
+
+  void Acquire();
+  void Release();
+
+ private:
+  esp_pm_lock_handle_t cpu_freq_lock_;
+  esp_pm_lock_handle_t no_light_sleep_lock_;
+};
+
+}  // namespace HareTortoiseClockSystem::PowerManagement
+
+#endif  // POWER_MANAGEMENT_H_
@@ -0,0 +1,203 @@
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include "sntp_sync_task.h"
+
+#include <esp_sntp.h>
+#include <esp_timer.h>
+#include <esp_wifi.h>
+
+#include <cinttypes>
+#include <cstring>
+
+#include "logger.h"
+#include "util.h"
+
+// Wi-Fi・SNTPの設定項目はSNTP_SYNCが有効な場合のみ定義される
+#ifdef CONFIG_SNTP_SYNC
+
+namespace HareTortoiseClockSystem {
+
+/// 起動後、最初の同期までの待機時間(us)
+constexpr int64_t FIRST_SYNC_DELAY_US = 10ll * 1000000;
+/// 同期失敗時の再試行間隔(us)
+constexpr int64_t RETRY_INTERVAL_US = 10ll * 60 * 1000000;
+/// 同期待ちの確認間隔(ms)
+constexpr int32_t SYNC_CHECK_INTERVAL_MS = 10000;
+/// Wi-Fi接続の待機上限(ms)
+constexpr int32_t WIFI_CONNECT_LIMIT_MS = 15000;
+/// SNTP応答の待機上限(ms)
+constexpr int32_t SNTP_RESPONSE_LIMIT_MS = 10000;
+
+/// Wi-Fiイベント
+constexpr EventBits_t WIFI_CONNECTED_BIT = BIT0;
+constexpr EventBits_t WIFI_FAILED_BIT = BIT1;
+
+SntpSyncTask* SntpSyncTask::instance_ = nullptr;
+
+SntpSyncTask::SntpSyncTask(
+    const HareTortoiseClockInterfaceWeakPtr hare_tortoise_clock_interface)
+    : Task(std::string(TASK_NAME).c_str(), PRIORITY, CORE_ID, STACK_DEPTH,
+           stack_buffer_),
+      stack_buffer_(),
+      hare_tortoise_clock_interface_(std::move(hare_tortoise_clock_interface)),
+      event_group_buffer_(),
+      event_group_(nullptr),
+      offset_queue_(),
+      netif_(nullptr),
+      next_sync_us_(0) {}
+
+SntpSyncTask::~SntpSyncTask() {
+  if (instance_ == this) {
+    instance_ = nullptr;
+  }
+}
+
+void SntpSyncTask::Initialize() {
+  ESP_LOGI(TAG, "Start SNTP Sync Task > server:%s interval:%dh",
+           CONFIG_SNTP_SERVER, CONFIG_SNTP_SYNC_INTERVAL_HOURS);
+
+  event_group_ = xEventGroupCreateStatic(&event_group_buffer_);
+  if (!offset_queue_.Create()) {
+    ESP_LOGE(TAG, "Creating queue failed");
+  }
+
+  // ネットワークスタックは常駐 (Wi-Fiドライバのみ同期毎に起動・解放)
+  esp_netif_init();
+  esp_event_loop_create_default();
+  netif_ = esp_netif_create_default_wifi_sta();
+  esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID,
+                             &SntpSyncTask::WifiEventHandler, this);
+  esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP,
+                             &SntpSyncTask::WifiEventHandler, this);
+
+  // 受信時刻はsntp_sync_timeで受け取り、システム時刻は直接変更しない
+  esp_sntp_setoperatingmode(ESP_SNTP_OPMODE_POLL);
+  esp_sntp_setservername(0, CONFIG_SNTP_SERVER);
+
+  instance_ = this;
+  next_sync_us_ = esp_timer_get_time() + FIRST_SYNC_DELAY_US;
+}
+
+void SntpSyncTask::Update() {
+  const int64_t now_us = esp_timer_get_time();
+  if (now_us < next_sync_us_) {
+    const int64_t wait_ms = (next_sync_us_ - now_us) / 1000;
+    Util::SleepMillisecond(wait_ms < SYNC_CHECK_INTERVAL_MS
+                               ? static_cast<uint32_t>(wait_ms)
+                               : SYNC_CHECK_INTERVAL_MS);
+    return;
+  }
+
+  const bool is_synced = Burst();
+  next_sync_us_ = esp_timer_get_time() +
+                  (is_synced ? CONFIG_SNTP_SYNC_INTERVAL_HOURS * 3600ll * 1000000
+                             : RETRY_INTERVAL_US);
+}
+
+bool SntpSyncTask::Burst() {
+  const int64_t begin_us = esp_timer_get_time();
+
+  int64_t offset_us = 0;
+  bool is_synced = false;
+  if (StartWifi()) {
+    const int64_t connected_us = esp_timer_get_time();
+    // 前回の残りを破棄してから要求
+    offset_queue_.ReceiveNonBlock(&offset_us);
+    esp_sntp_init();
+    is_synced = offset_queue_.ReceiveWait(&offset_us, SNTP_RESPONSE_LIMIT_MS);
+    esp_sntp_stop();
+    ESP_LOGI(TAG, "SNTP Burst > connect:%" PRId64 "ms sntp:%" PRId64 "ms",
+             (connected_us - begin_us) / 1000,
+             (esp_timer_get_time() - connected_us) / 1000);
+  }
+  StopWifi();
+
+  if (!is_synced) {
+    ESP_LOGW(TAG, "SNTP Sync Failed (radio on:%" PRId64 "ms)",
+             (esp_timer_get_time() - begin_us) / 1000);
+    return false;
+  }
+
+  ESP_LOGI(TAG, "SNTP Sync > offset:%" PRId64 "us (radio on:%" PRId64 "ms)",
+           offset_us, (esp_timer_get_time() - begin_us) / 1000);
+  HareTortoiseClockInterfaceSharedPtr hare_tortoise_clock =
+      hare_tortoise_clock_interface_.lock();
+  if (hare_tortoise_clock) {
+    hare_tortoise_clock->AdjustTime(offset_us);
+  }
+  return true;
+}
+
+bool SntpSyncTask::StartWifi() {
+  wifi_init_config_t init_config = WIFI_INIT_CONFIG_DEFAULT();
+  if (esp_wifi_init(&init_config) != ESP_OK) {
+    ESP_LOGE(TAG, "Failed Wi-Fi init");
+    return false;
+  }
+  esp_wifi_set_storage(WIFI_STORAGE_RAM);
+
+  wifi_config_t wifi_config = {};
+  std::strncpy(reinterpret_cast<char*>(wifi_config.sta.ssid),
+               CONFIG_SNTP_WIFI_SSID, sizeof(wifi_config.sta.ssid));
+  std::strncpy(reinterpret_cast<char*>(wifi_config.sta.password),
+               CONFIG_SNTP_WIFI_PASSWORD, sizeof(wifi_config.sta.password));
+  esp_wifi_set_mode(WIFI_MODE_STA);
+  esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+
+  xEventGroupClearBits(event_group_, WIFI_CONNECTED_BIT | WIFI_FAILED_BIT);
+  if (esp_wifi_start() != ESP_OK) {
+    ESP_LOGE(TAG, "Failed Wi-Fi start");
+    return false;
+  }
+
+  const EventBits_t bits = xEventGroupWaitBits(
+      event_group_, WIFI_CONNECTED_BIT | WIFI_FAILED_BIT, pdTRUE, pdFALSE,
+      pdMS_TO_TICKS(WIFI_CONNECT_LIMIT_MS));
+  if ((bits & WIFI_CONNECTED_BIT) == 0) {
+    ESP_LOGW(TAG, "Failed Wi-Fi connect > %s", CONFIG_SNTP_WIFI_SSID);
+    return false;
+  }
+  return true;
+}
+
+void SntpSyncTask::StopWifi() {
+  // 無線を完全に停止し、ドライバのメモリも解放する
+  esp_wifi_disconnect();
+  esp_wifi_stop();
+  esp_wifi_deinit();
+}
+
+void SntpSyncTask::OnTimeReceived(const int64_t server_epoch_us) {
+  // 受信直後のローカル時刻との差を求める (tcpipスレッド)
+  const int64_t offset_us = server_epoch_us - Util::GetEpochMicroseconds();
+  SntpSyncTask* const self = instance_;
+  if (self) {
+    self->offset_queue_.Send(offset_us);
+  }
+}
+
+void SntpSyncTask::WifiEventHandler(void* arg, esp_event_base_t event_base,
+                                    int32_t event_id, void* event_data) {
+  SntpSyncTask* const self = static_cast<SntpSyncTask*>(arg);
+  if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
+    esp_wifi_connect();
+  } else if (event_base == WIFI_EVENT &&
+             event_id == WIFI_EVENT_STA_DISCONNECTED) {
+    xEventGroupSetBits(self->event_group_, WIFI_FAILED_BIT);
+  } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
+    xEventGroupSetBits(self->event_group_, WIFI_CONNECTED_BIT);
+  }
+}
+
+}  // namespace HareTortoiseClockSystem
+
+/// lwIPのSNTP受信時の処理を置き換え (weak関数)
+/// システム時刻の変更はHareTortoiseClock::AdjustTimeで行う
+extern "C" void sntp_sync_time(struct timeval* tv) {
+  HareTortoiseClockSystem::SntpSyncTask::OnTimeReceived(
+      static_cast<int64_t>(tv->tv_sec) * 1000000 + tv->tv_usec);
+  sntp_set_sync_status(SNTP_SYNC_STATUS_COMPLETED);
+}
+#endif  // CONFIG_SNTP_SYNC
@@ -0,0 +1,67 @@
+#ifndef SNTP_SYNC_TASK_H_
+#define SNTP_SYNC_TASK_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include <esp_event.h>
+#include <esp_netif.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+#include "hare_tortoise_clock_interface.h"
+#include "message_queue.h"
+#include "task.h"
+
+namespace HareTortoiseClockSystem {
+
+/// 一定間隔でWi-Fiを短時間だけ起動してSNTPで時刻同期する
+/// 同期以外の時間は無線を停止する
+class SntpSyncTask final : public Task {
+ public:
+  static constexpr std::string_view TASK_NAME = "SntpSyncTask";
+  static constexpr int32_t PRIORITY = Task::PRIORITY_LOW;
+  static constexpr int32_t CORE_ID = PRO_CPU_NUM;
+  static constexpr uint32_t STACK_DEPTH = 4096;
+
+ public:
+  explicit SntpSyncTask(
+      const HareTortoiseClockInterfaceWeakPtr hare_tortoise_clock_interface);
+  ~SntpSyncTask();
+
+  void Initialize() override;
+  void Update() override;
+
+  /// SNTP受信時刻の通知 (lwIPのsntp_sync_timeから呼び出し)
+  static void OnTimeReceived(const int64_t server_epoch_us);
+
+ private:
+  bool Burst();
+  bool StartWifi();
+  void StopWifi();
+
+  static void WifiEventHandler(void* arg, esp_event_base_t event_base,
+                               int32_t event_id, void* event_data);
+
+ private:
+  static SntpSyncTask* instance_;
+
+  StackType_t stack_buffer_[STACK_DEPTH];
+  const HareTortoiseClockInterfaceWeakPtr hare_tortoise_clock_interface_;
+  StaticEventGroup_t event_group_buffer_;
+  EventGroupHandle_t event_group_;
+  StaticMessageQueue<int64_t, 1> offset_queue_;
+  esp_netif_t* netif_;
+  /// 次回同期のモノトニック時刻(us)
+  int64_t next_sync_us_;
+};
+
+using SntpSyncTaskSharedPtr = std::shared_ptr<SntpSyncTask>;
+
+}  // namespace HareTortoiseClockSystem
+
+#endif  // SNTP_SYNC_TASK_H_
@@ -0,0 +1,74 @@
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include "status_beacon.h"
+
+namespace HareTortoiseClockSystem::StatusBeacon {
+
+/// 1分(us)
+constexpr int64_t MINUTE_US = 60LL * 1000 * 1000;
+
+size_t Encode(const Status &status, uint8_t *const data, const size_t size) {
+  if (size < MANUFACTURER_DATA_LENGTH) {
+    return 0;
+  }
+  int32_t drift = status.drift_ppb / DRIFT_UNIT_PPB;
+  if (drift < INT8_MIN) {
+    drift = INT8_MIN;
+  } else if (INT8_MAX < drift) {
+    drift = INT8_MAX;
+  }
+
+  // リトルエンディアン (BLEの慣例に合わせる)
+  data[0] = COMPANY_ID & 0xFF;
+  data[1] = COMPANY_ID >> 8;
+  data[2] = BEACON_ID;
+  data[3] = static_cast<uint8_t>((status.sync_hops & 0x0F) << 4 |
+                                 (status.clock_status & 0x0F));
+  data[4] = static_cast<uint8_t>((status.minute_move_result & 0x0F) << 4 |
+                                 (status.hour_move_result & 0x0F));
+  data[5] = status.sync_age_min & 0xFF;
+  data[6] = status.sync_age_min >> 8;
+  data[7] = static_cast<uint8_t>(static_cast<int8_t>(drift));
+  data[8] = status.version_hash & 0xFF;
+  data[9] = status.version_hash >> 8;
+  return MANUFACTURER_DATA_LENGTH;
+}
+
+bool Decode(const uint8_t *const data, const size_t length,
+            Status *const status) {
+  if (length < MANUFACTURER_DATA_LENGTH ||
+      (data[0] | (data[1] << 8)) != COMPANY_ID || data[2] != BEACON_ID) {
+    return false;
+  }
+  status->clock_status = data[3] & 0x0F;
+  status->sync_hops = data[3] >> 4;
+  status->hour_move_result = data[4] & 0x0F;
+  status->minute_move_result = data[4] >> 4;
+  status->sync_age_min = static_cast<uint16_t>(data[5] | (data[6] << 8));
+  status->drift_ppb = static_cast<int8_t>(data[7]) * DRIFT_UNIT_PPB;
+  status->version_hash = static_cast<uint16_t>(data[8] | (data[9] << 8));
+  return true;
+}
+
+uint16_t CalcSyncAgeMinutes(const bool is_synced, const int64_t sync_age_us) {
+  if (!is_synced || sync_age_us < 0) {
+    return SYNC_AGE_UNKNOWN;
+  }
+  const int64_t age_min = sync_age_us / MINUTE_US;
+  return (age_min < SYNC_AGE_UNKNOWN) ? static_cast<uint16_t>(age_min)
+                                      : SYNC_AGE_UNKNOWN;
+}
+
+uint16_t CalcVersionHash(std::string_view version) {
+  uint32_t hash = 2166136261u;
+  for (const char c : version) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 16777619u;
+  }
+  // 上位と下位を畳み込む
+  return static_cast<uint16_t>((hash >> 16) ^ (hash & 0xFFFF));
+}
+
+}  // namespace HareTortoiseClockSystem::StatusBeacon
@@ -0,0 +1,61 @@
+#ifndef STATUS_BEACON_H_
+#define STATUS_BEACON_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/// 接続不要の状態監視ブロック (スキャンレスポンスのManufacturer Specific Data)
+/// 送信はBleStatusAdvertiserが行う Decodeはスキャンする側の形式の定義を兼ねる
+namespace HareTortoiseClockSystem::StatusBeacon {
+
+/// Company ID (時刻ビーコンと同じ 0xFFFF:試験・社内用)
+constexpr uint16_t COMPANY_ID = 0xFFFF;
+/// ブロック識別子
+constexpr uint8_t BEACON_ID = 0x53;
+/// Manufacturer Specific Data長 (デバイス名と合わせてスキャンレスポンスに収まる長さ)
+/// CompanyID 2 + ID 1 + 状態 1 + 移動結果 1 + 同期経過 2 + ずれ 1 + 版 2
+constexpr size_t MANUFACTURER_DATA_LENGTH = 10;
+/// 同期段数の未同期値
+constexpr uint8_t HOPS_UNSYNCED = 0x0F;
+/// 同期経過時間(分)の未同期・上限値
+constexpr uint16_t SYNC_AGE_UNKNOWN = 0xFFFF;
+/// ずれの単位(ppb)
+constexpr int32_t DRIFT_UNIT_PPB = 500;
+
+struct Status {
+  /// 時計の状態 (ClockStatus 0-15)
+  uint8_t clock_status;
+  /// 同期元からの段数 (未同期はHOPS_UNSYNCED)
+  uint8_t sync_hops;
+  /// 直近の移動結果 (MoveResult 0-15)
+  uint8_t hour_move_result;
+  uint8_t minute_move_result;
+  /// 最後の同期からの経過時間(分) (未同期はSYNC_AGE_UNKNOWN)
+  uint16_t sync_age_min;
+  /// 推定した水晶のずれ(ppb)
+  int32_t drift_ppb;
+  /// ファームウェアの版 (CalcVersionHash)
+  uint16_t version_hash;
+};
+
+/// Manufacturer Specific Dataへ変換 (書き込んだ長さ 不足時0)
+/// ずれはDRIFT_UNIT_PPB単位に切り捨て、int8_tの範囲で飽和させる
+size_t Encode(const Status &status, uint8_t *const data, const size_t size);
+
+/// Manufacturer Specific Dataから変換
+bool Decode(const uint8_t *const data, const size_t length,
+            Status *const status);
+
+/// 経過時間(us)から同期経過時間(分) (未同期・上限はSYNC_AGE_UNKNOWN)
+uint16_t CalcSyncAgeMinutes(const bool is_synced, const int64_t sync_age_us);
+
+/// 版文字列(git describe)の16bitハッシュ (FNV-1a)
+uint16_t CalcVersionHash(std::string_view version);
+
+}  // namespace HareTortoiseClockSystem::StatusBeacon
+
+#endif  // STATUS_BEACON_H_
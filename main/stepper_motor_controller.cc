@@ -4,13 +4,12 @@
 // Include ----------------------
 #include "stepper_motor_controller.h"
 
-#include <driver/gpio.h>
-#include <driver/gptimer.h>
-#include <esp_pthread.h>
+#include <esp_rom_sys.h>
 
-#include <future>
+#include <cinttypes>
 
 #include "gpio_control.h"
+#include "heap_audit.h"
 #include "logger.h"
 #include "message_queue.h"
 #include "util.h"
@@ -20,99 +19,78 @@ namespace HareTortoiseClockSystem {
 /// モータードライバーをON/OFFするインターバル時間(ms)
 /// ステッピングモータードライバによって調整
 constexpr int32_t ENABLE_INTERVAL = 20;
-/// イベントキューサイズ
-constexpr int32_t MOTOR_CONTROL_QUEUE_SIZE = 10;
-/// イベントキュー最大待機tick
-constexpr int32_t MOTOR_CONTROL_QUEUE_RECEIVE_LIMIT = 1000 / portTICK_PERIOD_MS;
-/// 非同期実行時のスレッド名
-constexpr std::string_view TASK_NAME = "StepperMotorTask";
-/// 非同期実行時のスレッド利用CPUコア
-constexpr int32_t CORE_ID = APP_CPU_NUM;
-
-StepperMotorController::StepperMotorController(
-    const uint32_t gptimer_resolution, const gpio_num_t gpio_enable,
-    const gpio_num_t gpio_step, const gpio_num_t gpio_dir,
-    const gpio_num_t gpio_right_limit, const gpio_num_t gpio_left_limit,
-    const bool is_rotate_right_is_dir_up)
+/// イベントキュー待機時間の余裕(ms) 残りステップの所要時間に加算
+constexpr int32_t MOTOR_CONTROL_QUEUE_RECEIVE_MARGIN_MS = 1000;
+/// 非同期実行リクエストの待機時間(ms)
+constexpr int32_t MOVE_REQUEST_RECEIVE_LIMIT_MS = 1000;
+
+StepperMotorControllerBase::StepperMotorControllerBase(
+    const uint32_t gptimer_resolution, const bool is_rotate_right_is_dir_up)
     : gptimer_resolution_(gptimer_resolution),
-      gpio_enable_(gpio_enable),
-      gpio_step_(gpio_step),
-      gpio_dir_(gpio_dir),
-      gpio_right_limit_(gpio_right_limit),
-      gpio_left_limit_(gpio_left_limit),
       is_rotate_right_is_dir_up_(is_rotate_right_is_dir_up),
       motor_control_queue_(),
-      gptimer_() {
-  ESP_LOGI(TAG,
-           "Initialize Stepper Motor ports > en:%d step:%d dir:%d "
-           "right_limit:%d left_limit:%d",
-           gpio_enable_, gpio_step_, gpio_dir_,
-           gpio_right_limit_, gpio_left_limit_);
-
-  // Init Gpio
-  GPIO::InitOutput(gpio_enable_, 1);  // HIGHで無効 LOWで有効
-  GPIO::InitOutput(gpio_step_, 0);
-  GPIO::InitOutput(gpio_dir_, 0);  // HIGHで時計回り
-  GPIO::InitInput(gpio_right_limit_);
-  GPIO::InitInput(gpio_left_limit_);
-
+      gptimer_(),
+      remaining_edges_(0),
+      position_(0),
+      step_delta_(0),
+      is_edge_recorded_(false),
+      last_edge_cycles_(0),
+      edge_cycles_min_(0),
+      edge_cycles_max_(0),
+      motion_lock_("stepper_motor"),
+      move_request_queue_(),
+      move_result_queue_(),
+      move_worker_(*this) {
   // Create MessageQueue
-  if (!motor_control_queue_.Create(MOTOR_CONTROL_QUEUE_SIZE)) {
+  if (!motor_control_queue_.Create() || !move_request_queue_.Create() ||
+      !move_result_queue_.Create()) {
     ESP_LOGE(TAG, "Creating queue failed");
   }
 
-  // Set Gpio Input Callback
-  gpio_isr_handler_add(gpio_right_limit_,
-                       &StepperMotorController::GpioRightLimitCallback,
-                       &motor_control_queue_);
-  gpio_isr_handler_add(gpio_left_limit_,
-                       &StepperMotorController::GpioLeftLimitCallback,
-                       &motor_control_queue_);
-
-  // Create Timer
-  gptimer_.Create(gptimer_resolution_, &StepperMotorController::TimerCallback,
-                  &motor_control_queue_);
+  move_worker_.Start();
 }
 
-StepperMotorController::~StepperMotorController() {
+StepperMotorControllerBase::~StepperMotorControllerBase() {
   gptimer_.Destroy();
 
   motor_control_queue_.Destroy();
-
-  gpio_isr_handler_remove(gpio_right_limit_);
-  gpio_isr_handler_remove(gpio_left_limit_);
-
-  GPIO::Reset(gpio_enable_);
-  GPIO::Reset(gpio_step_);
-  GPIO::Reset(gpio_dir_);
-  GPIO::Reset(gpio_right_limit_);
-  GPIO::Reset(gpio_left_limit_);
 }
 
-void StepperMotorController::EmergencyStop() {
+void StepperMotorControllerBase::StopMoveWorker() { move_worker_.Stop(); }
+
+void StepperMotorControllerBase::EmergencyStop() {
   ESP_LOGI(TAG, "Stepper Motor. Add Queue EmergencyStop");
   motor_control_queue_.Send(EventType::EMERGENCY_STOP);
 }
 
-MoveResultFuture StepperMotorController::ExecMoveAsync(
+MoveResultFuture StepperMotorControllerBase::ExecMoveAsync(
     const StepperMotorExecInfo &exec_info) {
-  // 新規スレッドを作る際の設定(コアを指定)
-  esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
-  cfg.thread_name = std::string(TASK_NAME).c_str();
-  cfg.pin_to_core = CORE_ID;
-  esp_pthread_set_cfg(&cfg);
-
-  return std::async(std::launch::async,
-                    [this, exec_info] { return ExecMove(exec_info); });
+  // 待機上限を超えた前回動作の結果が残っていれば読み捨てる
+  MoveResult stale_result = RESULT_NONE;
+  if (move_result_queue_.ReceiveNonBlock(&stale_result)) {
+    ESP_LOGW(TAG, "Discard stale move result:%d", stale_result);
+  }
+  if (!move_request_queue_.Send(exec_info)) {
+    ESP_LOGE(TAG, "Stepper Motor is busy");
+    return MoveResultFuture();
+  }
+  // 全エッジの所要時間 + ドライバON/OFF + 余裕 を待機上限とする
+  const uint64_t total_ticks =
+      static_cast<uint64_t>(exec_info.step_num_.Count()) * 2 *
+      exec_info.timer_tick_count_.Count();
+  const int32_t wait_limit_ms =
+      total_ticks * 1000u / gptimer_resolution_ + ENABLE_INTERVAL * 2 +
+      MOTOR_CONTROL_QUEUE_RECEIVE_MARGIN_MS;
+  return MoveResultFuture(&move_result_queue_, wait_limit_ms);
 }
 
-MoveResult StepperMotorController::ExecMove(
+MoveResult StepperMotorControllerBase::ExecMove(
     const StepperMotorExecInfo &exec_info) {
   ESP_LOGI(TAG, "Start Exec Motor. dir:%d step:%d", exec_info.dir_,
-           exec_info.step_num_);
+           exec_info.step_num_.Count());
   // リミット事前チェック
-  bool is_right_on = GPIO::GetLevel(gpio_right_limit_);
-  bool is_left_on = GPIO::GetLevel(gpio_left_limit_);
+  bool is_right_on = IsRightLimitOn();
+  bool is_left_on = IsLeftLimitOn();
   if (is_right_on && exec_info.dir_ == ROTATE_RIGHT) {
     ESP_LOGI(TAG, "Motor Limit Left");
     return RESULT_RIGHT_LIMIT;
@@ -122,35 +100,54 @@ MoveResult StepperMotorController::ExecMove(
   }
 
   // モーター動作
-  int32_t record =
-      exec_info.step_num_ *
-      2;  // LOW/HIGHで1周期にするためループ回数を2倍にする(2回で1周期)
+  // LOW/HIGHで1周期にするためエッジ数はステップ数の2倍(2回で1周期)
+  // STEP信号の出力はタイマーISRで行い、タスク側は終了・リミットのみ待つ
+  step_delta_ = (exec_info.dir_ == ROTATE_RIGHT) ? 1 : -1;
+  remaining_edges_ = exec_info.step_num_.Count() * 2;
   EventType event_type = EventType::NONE;
   MoveResult result = RESULT_STEP_FINISH;
-
-  GPIO::SetLevel(gpio_enable_, false);  // LOWで有効
-  GPIO::SetLevel(gpio_step_, false);
-  GPIO::SetLevel(gpio_dir_,  // HIGHで時計回り
-                 !(is_rotate_right_is_dir_up_ ^ exec_info.dir_));
+  is_edge_recorded_ = false;
+  edge_cycles_min_ = UINT32_MAX;
+  edge_cycles_max_ = 0;
+
+  // 移動中のみCPU最大周波数・light sleep禁止 (ステップ周期を一定に保つ)
+  motion_lock_.Acquire();
+  gptimer_.Enable();
+  SetDriverEnable(true);
+  ClearStep();
+  SetDirLevel(!(is_rotate_right_is_dir_up_ ^ exec_info.dir_));  // HIGHで時計回り
   Util::SleepMillisecond(ENABLE_INTERVAL);
 
-  gptimer_.Start(exec_info.timer_tick_count_);
+  if (0 < remaining_edges_) {
+    gptimer_.Start(exec_info.timer_tick_count_.Count());
+
+    while (true) {
+      // 残りエッジの所要時間 + 余裕 を待機上限とする
+      const uint64_t remaining_ticks = static_cast<uint64_t>(remaining_edges_) *
+                                       exec_info.timer_tick_count_.Count();
+      const int32_t receive_limit_ms =
+          remaining_ticks * 1000u / gptimer_resolution_ +
+          MOTOR_CONTROL_QUEUE_RECEIVE_MARGIN_MS;
+      if (!motor_control_queue_.ReceiveWait(&event_type, receive_limit_ms)) {
+        ESP_LOGE(TAG, "Missed step finish event");
+        result = RESULT_ERROR;
+        break;
+      }
 
-  while (record) {
-    if (motor_control_queue_.ReceiveWait(&event_type,
-                                         MOTOR_CONTROL_QUEUE_RECEIVE_LIMIT)) {
-      if (event_type == EventType::TIMER) {
-        record--;
-        GPIO::SetLevel(gpio_step_, record % 2);
+      if (event_type == EventType::STEP_FINISH) {
+        // 前回動作を中断した際の終了通知は読み捨てる
+        if (remaining_edges_ == 0) {
+          break;
+        }
       } else if (event_type == EventType::INPUT_RIGHT_LIMIT) {
-        is_right_on = GPIO::GetLevel(gpio_right_limit_);
+        is_right_on = IsRightLimitOn();
         ESP_LOGD(TAG, "Right %s", is_right_on ? "ON" : "OFF");
         if (is_right_on && exec_info.dir_ == ROTATE_RIGHT) {
           result = RESULT_RIGHT_LIMIT;
           break;
         }
       } else if (event_type == EventType::INPUT_LEFT_LIMIT) {
-        is_left_on = GPIO::GetLevel(gpio_left_limit_);
+        is_left_on = IsLeftLimitOn();
         ESP_LOGD(TAG, "Left %s", is_left_on ? "ON" : "OFF");
         if (is_left_on && exec_info.dir_ == ROTATE_LEFT) {
           result = RESULT_LEFT_LIMIT;
@@ -160,43 +157,85 @@ MoveResult StepperMotorController::ExecMove(
         result = RESULT_ERROR;
         break;
       }
-    } else {
-      ESP_LOGE(TAG, "Missed one count event");
-      result = RESULT_ERROR;
-      break;
     }
   }
 
   gptimer_.Stop();
+  remaining_edges_ = 0;
+  gptimer_.Disable();
 
   Util::SleepMillisecond(ENABLE_INTERVAL);
-  GPIO::SetLevel(gpio_step_, false);
-  GPIO::SetLevel(gpio_enable_, true);
-
-  ESP_LOGI(TAG, "Finish Exec Motor");
+  ClearStep();
+  SetDriverEnable(false);
+  // サイクル数の換算はロックの解放(周波数の低下)より前
+  LogStepTiming(exec_info);
+  motion_lock_.Release();
+
+  ESP_LOGI(TAG, "Finish Exec Motor. stack free:%u",
+           Task::GetCurrentStackHighWaterMark());
   return result;
 }
 
-bool IRAM_ATTR StepperMotorController::TimerCallback(
-    gptimer_handle_t timer, const gptimer_alarm_event_data_t *event_data,
-    void *message_queue) {
-  MessageQueue<EventType> *const queue =
-      static_cast<MessageQueue<EventType> *>(message_queue);
-  return queue->SendFromISR(EventType::TIMER);
+void StepperMotorControllerBase::LogStepTiming(
+    const StepperMotorExecInfo &exec_info) const {
+  if (edge_cycles_max_ == 0) {
+    return;
+  }
+  const uint32_t cycles_per_us = esp_rom_get_cpu_ticks_per_us();
+  const uint64_t edge_ns = static_cast<uint64_t>(
+                               exec_info.timer_tick_count_.Count()) *
+                           1000000000ull / gptimer_resolution_;
+  const uint32_t min_ns = edge_cycles_min_ * 1000ull / cycles_per_us;
+  const uint32_t max_ns = edge_cycles_max_ * 1000ull / cycles_per_us;
+  ESP_LOGI(TAG,
+           "Step timing > edge:%" PRIu64 "ns min:%" PRIu32 "ns max:%" PRIu32
+           "ns jitter:%" PRIu32 "ns cpu:%" PRIu32 "MHz",
+           edge_ns, min_ns, max_ns, max_ns - min_ns, cycles_per_us);
+}
+
+void StepperMotorControllerBase::SetPosition(const Steps position) {
+  position_ = position.Count();
+}
+
+void IRAM_ATTR StepperMotorControllerBase::StopFromISR() {
+  // gptimer_stopはCONFIG_GPTIMER_CTRL_FUNC_IN_IRAMでISRから利用可
+  gptimer_.Stop();
+}
+
+StepperMotorControllerBase::MoveWorkerTask::MoveWorkerTask(
+    StepperMotorControllerBase &controller)
+    : Task(std::string(TASK_NAME).c_str(), PRIORITY, CORE_ID, STACK_DEPTH,
+           stack_buffer_),
+      stack_buffer_(),
+      controller_(controller) {}
+
+void StepperMotorControllerBase::MoveWorkerTask::Initialize() {
+  HeapAudit::WatchCurrentTask();
+}
+
+void StepperMotorControllerBase::MoveWorkerTask::Update() {
+  StepperMotorExecInfo exec_info;
+  if (controller_.move_request_queue_.ReceiveWait(
+          &exec_info, MOVE_REQUEST_RECEIVE_LIMIT_MS)) {
+    const MoveResult result = controller_.ExecMove(exec_info);
+    if (!controller_.move_result_queue_.Send(result)) {
+      ESP_LOGE(TAG, "Move result dropped:%d", result);
+    }
+  }
 }
 
 void IRAM_ATTR
-StepperMotorController::GpioLeftLimitCallback(void *message_queue) {
+StepperMotorControllerBase::GpioLeftLimitCallback(void *message_queue) {
   MessageQueue<EventType> *const queue =
       static_cast<MessageQueue<EventType> *>(message_queue);
-  queue->SendFromISR(EventType::INPUT_LEFT_LIMIT);
+  queue->SendFromISRAndYield(EventType::INPUT_LEFT_LIMIT);
 }
 
 void IRAM_ATTR
-StepperMotorController::GpioRightLimitCallback(void *message_queue) {
+StepperMotorControllerBase::GpioRightLimitCallback(void *message_queue) {
   MessageQueue<EventType> *const queue =
       static_cast<MessageQueue<EventType> *>(message_queue);
-  queue->SendFromISR(EventType::INPUT_RIGHT_LIMIT);
+  queue->SendFromISRAndYield(EventType::INPUT_RIGHT_LIMIT);
 }
 
 }  // namespace HareTortoiseClockSystem
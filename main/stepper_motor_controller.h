@@ -4,17 +4,20 @@
 // (C)2024 bekki.jp
 
 // Include ----------------------
-#include <driver/gpio.h>
-#include <driver/gptimer.h>
-#include <soc/soc.h>
+#include <esp_attr.h>
+#include <esp_cpu.h>
 
 #include <chrono>
-#include <future>
 #include <memory>
 #include <string_view>
 
+#include "gpio_control.h"
 #include "gptimer.h"
+#include "logger.h"
 #include "message_queue.h"
+#include "power_management.h"
+#include "task.h"
+#include "units.h"
 
 namespace HareTortoiseClockSystem {
 
@@ -31,76 +34,267 @@ enum MoveResult {
   RESULT_ERROR = 4,
 };
 
-using MoveResultPromise = std::promise<MoveResult>;
-using MoveResultFuture = std::future<MoveResult>;
+/// モーター動作結果 (非同期実行の完了待ち)
+class MoveResultFuture {
+ public:
+  MoveResultFuture() : result_queue_(nullptr), wait_limit_ms_(0) {}
+  MoveResultFuture(MessageQueue<MoveResult>* const result_queue,
+                   const int32_t wait_limit_ms)
+      : result_queue_(result_queue), wait_limit_ms_(wait_limit_ms) {}
+
+  /// 動作完了まで待機し結果を取得 (待機上限を超えた場合はRESULT_ERROR)
+  MoveResult get() const {
+    MoveResult result = RESULT_ERROR;
+    if (!result_queue_ ||
+        !result_queue_->ReceiveWait(&result, wait_limit_ms_)) {
+      return RESULT_ERROR;
+    }
+    return result;
+  }
+
+ private:
+  MessageQueue<MoveResult>* result_queue_;
+  /// 動作の所要時間 + 余裕(ms)
+  int32_t wait_limit_ms_;
+};
 
 /// ステッピングモーター実行情報
 class StepperMotorExecInfo {
  public:
   StepperMotorExecInfo()
-      : dir_(ROTATE_RIGHT), timer_tick_count_(0), step_num_(0) {}
-  StepperMotorExecInfo(const RotateDir dir, const uint64_t timer_tick_count,
-                       const int32_t step_num)
+      : dir_(ROTATE_RIGHT), timer_tick_count_(), step_num_() {}
+  StepperMotorExecInfo(const RotateDir dir, const Ticks timer_tick_count,
+                       const Steps step_num)
       : dir_(dir), timer_tick_count_(timer_tick_count), step_num_(step_num) {}
 
-  const RotateDir dir_;
-  const uint64_t timer_tick_count_;
-  const int32_t step_num_;
+  RotateDir dir_;
+  Ticks timer_tick_count_;
+  Steps step_num_;
 };
 
-/// ステッピングモーターコントロールクラス
-class StepperMotorController {
+/// ステッピングモーター ピン定義 (Kconfigの定数から生成)
+template <int ENABLE, int STEP, int DIR, int RIGHT_LIMIT, int LEFT_LIMIT>
+struct StepperMotorPins {
+  static constexpr gpio_num_t GPIO_ENABLE = static_cast<gpio_num_t>(ENABLE);
+  static constexpr gpio_num_t GPIO_STEP = static_cast<gpio_num_t>(STEP);
+  static constexpr gpio_num_t GPIO_DIR = static_cast<gpio_num_t>(DIR);
+  static constexpr gpio_num_t GPIO_RIGHT_LIMIT =
+      static_cast<gpio_num_t>(RIGHT_LIMIT);
+  static constexpr gpio_num_t GPIO_LEFT_LIMIT =
+      static_cast<gpio_num_t>(LEFT_LIMIT);
+
+  static constexpr uint64_t ENABLE_MASK = GPIO::PinMask(GPIO_ENABLE);
+  static constexpr uint64_t STEP_MASK = GPIO::PinMask(GPIO_STEP);
+  static constexpr uint64_t DIR_MASK = GPIO::PinMask(GPIO_DIR);
+  static constexpr uint64_t RIGHT_LIMIT_MASK = GPIO::PinMask(GPIO_RIGHT_LIMIT);
+  static constexpr uint64_t LEFT_LIMIT_MASK = GPIO::PinMask(GPIO_LEFT_LIMIT);
+};
+
+/// ステッピングモーターコントロールクラス (ピン非依存部分)
+class StepperMotorControllerBase {
  public:
   enum EventType {
     NONE = 0,
-    TIMER = 1,
+    STEP_FINISH = 1,
     INPUT_LEFT_LIMIT = 2,
     INPUT_RIGHT_LIMIT = 3,
     EMERGENCY_STOP = 4,
   };
 
  public:
-  StepperMotorController(const uint32_t gptimer_resolution,
-                         const gpio_num_t gpio_enable,
-                         const gpio_num_t gpio_step, const gpio_num_t gpio_dir,
-                         const gpio_num_t gpio_right_limit,
-                         const gpio_num_t gpio_left_limit,
-                         const bool is_rotate_right_is_dir_up);
-  ~StepperMotorController();
+  StepperMotorControllerBase(const uint32_t gptimer_resolution,
+                             const bool is_rotate_right_is_dir_up);
+  virtual ~StepperMotorControllerBase();
 
   /// コピー禁止
-  StepperMotorController(const StepperMotorController&) = delete;
-  StepperMotorController& operator=(const StepperMotorController&) = delete;
+  StepperMotorControllerBase(const StepperMotorControllerBase&) = delete;
+  StepperMotorControllerBase& operator=(const StepperMotorControllerBase&) =
+      delete;
 
   /// 緊急停止
   void EmergencyStop();
 
   /// モーター動作
   MoveResult ExecMove(const StepperMotorExecInfo& exec_info);
-  /// モーター動作(非同期版)
+  /// モーター動作(非同期版 常駐タスクで実行)
   MoveResultFuture ExecMoveAsync(const StepperMotorExecInfo& exec_info);
 
+  /// 現在位置(step)の設定 (原点復帰・記録の復元時)
+  void SetPosition(const Steps position);
+  /// 現在位置(step) ステップ毎にISRで更新 (ISRからも参照可)
+  Steps GetPosition() const { return Steps(position_); }
+  /// 電源断検出時の即時停止 (ISRから呼び出し)
+  void StopFromISR();
+
  public:
-  static bool TimerCallback(gptimer_handle_t timer,
-                            const gptimer_alarm_event_data_t* event_data,
-                            void* message_queue);
   static void GpioLeftLimitCallback(void* message_queue);
   static void GpioRightLimitCallback(void* message_queue);
 
  private:
+  /// 非同期実行用の常駐タスク (動作毎のスレッド生成を行わない)
+  class MoveWorkerTask final : public Task {
+   public:
+    static constexpr std::string_view TASK_NAME = "StepperMotorTask";
+    static constexpr int32_t PRIORITY = Task::PRIORITY_NORMAL;
+    static constexpr int32_t CORE_ID = APP_CPU_NUM;
+    static constexpr uint32_t STACK_DEPTH = 3072;
+
+    explicit MoveWorkerTask(StepperMotorControllerBase& controller);
+    ~MoveWorkerTask() override { Stop(); }
+
+    void Initialize() override;
+    void Update() override;
+
+   private:
+    StackType_t stack_buffer_[STACK_DEPTH];
+    StepperMotorControllerBase& controller_;
+  };
+
+ protected:
+  /// イベントキューサイズ
+  static constexpr int32_t MOTOR_CONTROL_QUEUE_SIZE = 10;
+
+  /// ピン操作 (ピン固定の派生クラスで実装)
+  virtual void SetDriverEnable(const bool is_enable) = 0;
+  virtual void SetDirLevel(const bool level) = 0;
+  virtual void ClearStep() = 0;
+  virtual bool IsRightLimitOn() const = 0;
+  virtual bool IsLeftLimitOn() const = 0;
+
+  /// 常駐タスクの終了 (派生クラスの破棄の最初に呼び出し、破棄後のピン操作を防ぐ)
+  void StopMoveWorker();
+
+ private:
+  /// エッジ間隔の最小・最大の出力 (ステップ周期の揺らぎ)
+  void LogStepTiming(const StepperMotorExecInfo& exec_info) const;
+
+ protected:
   const uint32_t gptimer_resolution_;
-  const gpio_num_t gpio_enable_;
-  const gpio_num_t gpio_step_;
-  const gpio_num_t gpio_dir_;
-  const gpio_num_t gpio_right_limit_;
-  const gpio_num_t gpio_left_limit_;
   const bool is_rotate_right_is_dir_up_;
-  MessageQueue<EventType> motor_control_queue_;
+  StaticMessageQueue<EventType, MOTOR_CONTROL_QUEUE_SIZE>
+      motor_control_queue_;
   GPTimer gptimer_;
+  /// 残りエッジ数 (LOW/HIGHの切替回数, ISRで減算)
+  volatile int32_t remaining_edges_;
+  /// 現在位置(step) と 1ステップ毎の増減
+  volatile int32_t position_;
+  volatile int32_t step_delta_;
+  /// 前回エッジのCPUサイクル数 と エッジ間隔(サイクル)の最小・最大
+  /// 移動中はCPU最大周波数に固定されるためサイクル数で比較できる
+  volatile bool is_edge_recorded_;
+  volatile uint32_t last_edge_cycles_;
+  volatile uint32_t edge_cycles_min_;
+  volatile uint32_t edge_cycles_max_;
+
+ private:
+  PowerManagement::MotionLock motion_lock_;
+  StaticMessageQueue<StepperMotorExecInfo, 1> move_request_queue_;
+  StaticMessageQueue<MoveResult, 1> move_result_queue_;
+  MoveWorkerTask move_worker_;
+};
+
+/// ステッピングモーターコントロールクラス (ピン固定)
+/// STEP信号はタイマーISR内でw1ts/w1tcレジスタへ直接書き込む
+template <typename PINS>
+class StepperMotorController final : public StepperMotorControllerBase {
+ public:
+  StepperMotorController(const uint32_t gptimer_resolution,
+                         const bool is_rotate_right_is_dir_up)
+      : StepperMotorControllerBase(gptimer_resolution,
+                                   is_rotate_right_is_dir_up) {
+    ESP_LOGI(TAG,
+             "Initialize Stepper Motor ports > en:%d step:%d dir:%d "
+             "right_limit:%d left_limit:%d",
+             PINS::GPIO_ENABLE, PINS::GPIO_STEP, PINS::GPIO_DIR,
+             PINS::GPIO_RIGHT_LIMIT, PINS::GPIO_LEFT_LIMIT);
+
+    // Init Gpio
+    GPIO::InitOutput(PINS::GPIO_ENABLE, 1);  // HIGHで無効 LOWで有効
+    GPIO::InitOutput(PINS::GPIO_STEP, 0);
+    GPIO::InitOutput(PINS::GPIO_DIR, 0);  // HIGHで時計回り
+    GPIO::InitInput(PINS::GPIO_RIGHT_LIMIT);
+    GPIO::InitInput(PINS::GPIO_LEFT_LIMIT);
+
+    // Set Gpio Input Callback
+    MessageQueue<EventType>* const queue = &motor_control_queue_;
+    GPIO::AddIsrHandler(PINS::GPIO_RIGHT_LIMIT,
+                        &StepperMotorControllerBase::GpioRightLimitCallback,
+                        queue);
+    GPIO::AddIsrHandler(PINS::GPIO_LEFT_LIMIT,
+                        &StepperMotorControllerBase::GpioLeftLimitCallback,
+                        queue);
+
+    // Create Timer
+    gptimer_.Create(gptimer_resolution_, &StepperMotorController::TimerCallback,
+                    this);
+  }
+
+  ~StepperMotorController() override {
+    StopMoveWorker();
+    gptimer_.Destroy();
+
+    GPIO::RemoveIsrHandler(PINS::GPIO_RIGHT_LIMIT);
+    GPIO::RemoveIsrHandler(PINS::GPIO_LEFT_LIMIT);
+
+    GPIO::Reset(PINS::GPIO_ENABLE);
+    GPIO::Reset(PINS::GPIO_STEP);
+    GPIO::Reset(PINS::GPIO_DIR);
+    GPIO::Reset(PINS::GPIO_RIGHT_LIMIT);
+    GPIO::Reset(PINS::GPIO_LEFT_LIMIT);
+  }
+
+  static bool IRAM_ATTR TimerCallback(
+      gptimer_handle_t timer, const gptimer_alarm_event_data_t* event_data,
+      void* controller) {
+    StepperMotorController* const self =
+        static_cast<StepperMotorController*>(controller);
+    const int32_t remaining_edges = self->remaining_edges_ - 1;
+    if (remaining_edges < 0) {
+      return false;
+    }
+    self->remaining_edges_ = remaining_edges;
+    // LOW/HIGHで1周期 (奇数:HIGH 偶数:LOW) 立ち上がりで1ステップ進む
+    GPIO::WriteBits<PINS::STEP_MASK>(remaining_edges & 1);
+    const uint32_t cycles = esp_cpu_get_cycle_count();
+    if (self->is_edge_recorded_) {
+      const uint32_t interval = cycles - self->last_edge_cycles_;
+      if (interval < self->edge_cycles_min_) {
+        self->edge_cycles_min_ = interval;
+      }
+      if (self->edge_cycles_max_ < interval) {
+        self->edge_cycles_max_ = interval;
+      }
+    }
+    self->last_edge_cycles_ = cycles;
+    self->is_edge_recorded_ = true;
+    if (remaining_edges & 1) {
+      self->position_ = self->position_ + self->step_delta_;
+    }
+    if (remaining_edges == 0) {
+      return self->motor_control_queue_.SendFromISR(EventType::STEP_FINISH);
+    }
+    return false;
+  }
+
+ protected:
+  void SetDriverEnable(const bool is_enable) override {
+    GPIO::WriteBits<PINS::ENABLE_MASK>(!is_enable);  // LOWで有効
+  }
+  void SetDirLevel(const bool level) override {
+    GPIO::WriteBits<PINS::DIR_MASK>(level);
+  }
+  void ClearStep() override { GPIO::ClearBits<PINS::STEP_MASK>(); }
+  bool IsRightLimitOn() const override {
+    return GPIO::TestBit<PINS::RIGHT_LIMIT_MASK>();
+  }
+  bool IsLeftLimitOn() const override {
+    return GPIO::TestBit<PINS::LEFT_LIMIT_MASK>();
+  }
 };
 
-using StepperMotorControllerSharedPtr = std::shared_ptr<StepperMotorController>;
-using StepperMotorControllerWeakPtr = std::weak_ptr<StepperMotorController>;
+using StepperMotorControllerSharedPtr =
+    std::shared_ptr<StepperMotorControllerBase>;
+using StepperMotorControllerWeakPtr = std::weak_ptr<StepperMotorControllerBase>;
 
 }  // namespace HareTortoiseClockSystem
 
@@ -8,26 +8,51 @@
 
 #include <cstdint>
 
+#include "units.h"
+
 /// 1MHz, 1 tick=1us
 constexpr uint32_t STEPPER_MOTOR_RESOLUTION = 1000000u;
 /// 1回転のステップ数
 constexpr uint32_t STEPPER_MOTOR_REVOLUTION_STEP = 200;
 /// 1回転の動作量(mm)
-constexpr float STEPPER_MOTOR_REVOLUTION_MOVE_MM = 40.0f;
+constexpr uint32_t STEPPER_MOTOR_REVOLUTION_MOVE_MM = 40;
 
 namespace HareTortoiseClockSystem::StepperMotorUtil {
 
-/// Frequency(Hz) to Tick
-constexpr uint32_t FrequencyToTick(const uint32_t hz) {
-  return STEPPER_MOTOR_RESOLUTION / hz / 2;
+/// 1回転のステップ数 (マイクロステップ込み)
+constexpr int64_t REVOLUTION_STEPS =
+    static_cast<int64_t>(STEPPER_MOTOR_REVOLUTION_STEP) *
+    CONFIG_STEPPER_MOTOR_STEP_DIVIDE;
+/// 1回転の動作量(μm)
+constexpr int64_t REVOLUTION_MOVE_UM =
+    static_cast<int64_t>(STEPPER_MOTOR_REVOLUTION_MOVE_MM) * 1000;
+
+/// Frequency(Hz) to Tick (半周期)
+constexpr Ticks FrequencyToTick(const uint32_t hz) {
+  return Ticks(STEPPER_MOTOR_RESOLUTION / hz / 2);
+}
+
+/// Micrometres to Steps (最近接丸め)
+constexpr Steps ToSteps(const Micrometres length) {
+  const int64_t scaled = length.Count() * REVOLUTION_STEPS;
+  const int64_t half = REVOLUTION_MOVE_UM / 2;
+  return Steps(static_cast<int32_t>(
+      (0 <= scaled ? scaled + half : scaled - half) / REVOLUTION_MOVE_UM));
 }
 
-/// mm to Step
-constexpr int32_t MMtoStep(const uint32_t mm) {
-  return static_cast<float>(mm / STEPPER_MOTOR_REVOLUTION_MOVE_MM) *
-         STEPPER_MOTOR_REVOLUTION_STEP * CONFIG_STEPPER_MOTOR_STEP_DIVIDE;
+/// Steps to Micrometres (最近接丸め)
+constexpr Micrometres ToMicrometres(const Steps steps) {
+  const int64_t scaled = steps.Count() * REVOLUTION_MOVE_UM;
+  const int64_t half = REVOLUTION_STEPS / 2;
+  return Micrometres(static_cast<int32_t>(
+      (0 <= scaled ? scaled + half : scaled - half) / REVOLUTION_STEPS));
 }
 
+static_assert(ToSteps(Millimetres(STEPPER_MOTOR_REVOLUTION_MOVE_MM)) ==
+                  Steps(STEPPER_MOTOR_REVOLUTION_STEP *
+                        CONFIG_STEPPER_MOTOR_STEP_DIVIDE),
+              "one revolution must convert to one revolution of steps");
+
 }  // namespace HareTortoiseClockSystem::StepperMotorUtil
 
 #endif  // STEPPER_MOTOR_UTIL_H_
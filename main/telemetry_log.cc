@@ -0,0 +1,154 @@
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include "telemetry_log.h"
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+
+#include "logger.h"
+
+#ifdef CONFIG_BLE_TELEMETRY
+
+namespace HareTortoiseClockSystem::TelemetryLog {
+
+/// リングバッファ容量 (2のべき乗)
+constexpr uint32_t BUFFER_SIZE = CONFIG_BLE_TELEMETRY_BUFFER_SIZE;
+static_assert((BUFFER_SIZE & (BUFFER_SIZE - 1)) == 0,
+              "BLE_TELEMETRY_BUFFER_SIZE must be a power of two");
+
+/// 書式化バッファの待機上限(ms) (超えた場合は記録せず破棄数に含める)
+constexpr int32_t FORMAT_WAIT_LIMIT_MS = 10;
+
+namespace {
+
+uint8_t ring_buffer[BUFFER_SIZE];
+/// 書き込み・読み出し位置 (累積バイト数)
+uint32_t head = 0;
+uint32_t tail = 0;
+uint32_t dropped_count = 0;
+portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+vprintf_like_t previous_vprintf = nullptr;
+/// 書式化バッファ (ログを出力する各タスクのスタックを消費しないよう共有する)
+char format_buffer[MAX_TEXT_LENGTH + 1];
+StaticSemaphore_t format_mutex_buffer;
+SemaphoreHandle_t format_mutex = nullptr;
+
+uint8_t At(const uint32_t position) {
+  return ring_buffer[position & (BUFFER_SIZE - 1)];
+}
+
+void Put(const uint32_t position, const uint8_t value) {
+  ring_buffer[position & (BUFFER_SIZE - 1)] = value;
+}
+
+size_t RecordLength(const uint32_t position) {
+  return RECORD_HEADER_LENGTH +
+         ((static_cast<size_t>(At(position)) << 8) | At(position + 1));
+}
+
+int LogVprintf(const char* format, va_list args) {
+  // 出力先を差し替えても元の出力は維持する
+  if (xSemaphoreTake(format_mutex, pdMS_TO_TICKS(FORMAT_WAIT_LIMIT_MS)) ==
+      pdTRUE) {
+    va_list copied_args;
+    va_copy(copied_args, args);
+    const int formatted = std::vsnprintf(
+        format_buffer, sizeof(format_buffer), format, copied_args);
+    va_end(copied_args);
+    if (0 < formatted) {
+      size_t length = std::min<size_t>(formatted, MAX_TEXT_LENGTH);
+      // 行末の改行は記録しない
+      while (0 < length && (format_buffer[length - 1] == '\n' ||
+                            format_buffer[length - 1] == '\r')) {
+        --length;
+      }
+      Append(esp_log_timestamp(), format_buffer, length);
+    }
+    xSemaphoreGive(format_mutex);
+  } else {
+    portENTER_CRITICAL(&mux);
+    ++dropped_count;
+    portEXIT_CRITICAL(&mux);
+  }
+  return previous_vprintf ? previous_vprintf(format, args)
+                          : std::vprintf(format, args);
+}
+
+}  // namespace
+
+void Initialize() {
+  if (previous_vprintf == nullptr) {
+    format_mutex = xSemaphoreCreateMutexStatic(&format_mutex_buffer);
+    previous_vprintf = esp_log_set_vprintf(&LogVprintf);
+  }
+}
+
+void Append(const uint32_t timestamp_ms, const char* const text,
+            const size_t length) {
+  const size_t text_length = std::min(length, MAX_TEXT_LENGTH);
+  const uint32_t record_length = RECORD_HEADER_LENGTH + text_length;
+
+  portENTER_CRITICAL_SAFE(&mux);
+  // 空きが足りない場合は古い記録を破棄
+  while (BUFFER_SIZE < head - tail + record_length) {
+    tail += RecordLength(tail);
+    ++dropped_count;
+  }
+  uint32_t position = head;
+  Put(position++, static_cast<uint8_t>(text_length >> 8));
+  Put(position++, static_cast<uint8_t>(text_length));
+  for (int32_t shift = 24; 0 <= shift; shift -= 8) {
+    Put(position++, static_cast<uint8_t>(timestamp_ms >> shift));
+  }
+  for (size_t i = 0; i < text_length; ++i) {
+    Put(position++, static_cast<uint8_t>(text[i]));
+  }
+  head = position;
+  portEXIT_CRITICAL_SAFE(&mux);
+}
+
+size_t Snapshot(uint8_t* const buffer, const size_t size) {
+  // 割り込み禁止の時間を短くするため、1記録ずつ複写する
+  size_t copied = 0;
+  portENTER_CRITICAL(&mux);
+  uint32_t position = tail;
+  const uint32_t end = head;
+  portEXIT_CRITICAL(&mux);
+  while (true) {
+    portENTER_CRITICAL(&mux);
+    if (static_cast<int32_t>(position - tail) < 0) {
+      // 複写中に上書きされた記録は読み飛ばす
+      position = tail;
+    }
+    const bool is_remaining = static_cast<int32_t>(end - position) > 0;
+    const size_t record_length = is_remaining ? RecordLength(position) : 0;
+    const bool is_fit = is_remaining && copied + record_length <= size;
+    if (is_fit) {
+      for (size_t i = 0; i < record_length; ++i) {
+        buffer[copied++] = At(position++);
+      }
+    }
+    portEXIT_CRITICAL(&mux);
+    if (!is_fit) {
+      break;
+    }
+  }
+  return copied;
+}
+
+uint32_t GetDroppedCount() {
+  portENTER_CRITICAL(&mux);
+  const uint32_t count = dropped_count;
+  portEXIT_CRITICAL(&mux);
+  return count;
+}
+
+}  // namespace HareTortoiseClockSystem::TelemetryLog
+
+#endif  // CONFIG_BLE_TELEMETRY
@@ -0,0 +1,36 @@
+#ifndef TELEMETRY_LOG_H_
+#define TELEMETRY_LOG_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include <cstddef>
+#include <cstdint>
+
+/// ログをRAMのリングバッファに記録し、BLEで取り出すためのテレメトリ
+/// 記録形式: [長さ(uint16_t)][時刻ms(uint32_t)][本文] ビッグエンディアン
+/// 容量を超えた場合は古い記録から破棄する
+namespace HareTortoiseClockSystem::TelemetryLog {
+
+/// 1記録の本文の最大長
+constexpr size_t MAX_TEXT_LENGTH = 160;
+/// 記録のヘッダ長
+constexpr size_t RECORD_HEADER_LENGTH = 6;
+
+/// ESP_LOGの出力を記録に追加する (元の出力先へも出力する)
+void Initialize();
+
+/// 記録の追加
+void Append(const uint32_t timestamp_ms, const char* const text,
+            const size_t length);
+
+/// 現在の記録を古い順に複写 (記録単位で収まる分のみ)
+/// @return 複写した長さ
+size_t Snapshot(uint8_t* const buffer, const size_t size);
+
+/// 破棄した記録数 (容量超過・書式化バッファの待機上限超過)
+uint32_t GetDroppedCount();
+
+}  // namespace HareTortoiseClockSystem::TelemetryLog
+
+#endif  // TELEMETRY_LOG_H_
@@ -0,0 +1,130 @@
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include "time_beacon.h"
+
+namespace HareTortoiseClockSystem::TimeBeacon {
+
+/// AD Type (Manufacturer Specific Data)
+constexpr uint8_t AD_TYPE_MANUFACTURER_SPECIFIC = 0xFF;
+/// 時刻フィールドのバイト数 (48bit ms 約8900年)
+constexpr size_t EPOCH_BYTES = 6;
+/// 直接同期時の誤差(ms) (BLE往復・SNTPの誤差)
+constexpr int64_t DIRECT_SYNC_UNCERTAINTY_MS = 20;
+/// 1段あたりの誤差(ms) (更新間隔の半分 + 受信遅延)
+constexpr int64_t HOP_UNCERTAINTY_MS = UPDATE_INTERVAL_US / 2000 + 10;
+/// 同期後の誤差の増加 (水晶のずれ 20ppm = 20us/s)
+constexpr int64_t DRIFT_UNCERTAINTY_PPM = 20;
+constexpr uint16_t MAX_UNCERTAINTY_MS = 0xFFFF;
+
+namespace {
+
+uint16_t ClampUncertaintyMs(const int64_t uncertainty_ms) {
+  return (uncertainty_ms < MAX_UNCERTAINTY_MS)
+             ? static_cast<uint16_t>(uncertainty_ms)
+             : MAX_UNCERTAINTY_MS;
+}
+
+}  // namespace
+
+size_t Encode(const Beacon &beacon, uint8_t *const data, const size_t size) {
+  if (size < MANUFACTURER_DATA_LENGTH) {
+    return 0;
+  }
+  // リトルエンディアン (BLEの慣例に合わせる)
+  data[0] = COMPANY_ID & 0xFF;
+  data[1] = COMPANY_ID >> 8;
+  data[2] = BEACON_ID;
+  for (size_t i = 0; i < EPOCH_BYTES; ++i) {
+    data[3 + i] = static_cast<uint8_t>(beacon.epoch_ms >> (8 * i));
+  }
+  data[9] = beacon.hops;
+  data[10] = beacon.uncertainty_ms & 0xFF;
+  data[11] = beacon.uncertainty_ms >> 8;
+  return MANUFACTURER_DATA_LENGTH;
+}
+
+bool Decode(const uint8_t *const data, const size_t length,
+            Beacon *const beacon) {
+  if (length < MANUFACTURER_DATA_LENGTH ||
+      (data[0] | (data[1] << 8)) != COMPANY_ID || data[2] != BEACON_ID) {
+    return false;
+  }
+  int64_t epoch_ms = 0;
+  for (size_t i = 0; i < EPOCH_BYTES; ++i) {
+    epoch_ms |= static_cast<int64_t>(data[3 + i]) << (8 * i);
+  }
+  beacon->epoch_ms = epoch_ms;
+  beacon->hops = data[9];
+  beacon->uncertainty_ms = static_cast<uint16_t>(data[10] | (data[11] << 8));
+  return true;
+}
+
+const uint8_t *FindManufacturerData(const uint8_t *const adv_data,
+                                    const size_t length,
+                                    size_t *const data_length) {
+  // AD構造: [長さ][Type][データ(長さ-1)]
+  size_t pos = 0;
+  while (pos < length) {
+    const size_t field_length = adv_data[pos];
+    if (field_length == 0 || length < pos + 1 + field_length) {
+      break;
+    }
+    if (adv_data[pos + 1] == AD_TYPE_MANUFACTURER_SPECIFIC) {
+      *data_length = field_length - 1;
+      return &adv_data[pos + 2];
+    }
+    pos += 1 + field_length;
+  }
+  return nullptr;
+}
+
+uint16_t CalcBaseUncertaintyMs(const uint8_t hops) {
+  return ClampUncertaintyMs(DIRECT_SYNC_UNCERTAINTY_MS +
+                            hops * HOP_UNCERTAINTY_MS);
+}
+
+uint16_t CalcAdoptedUncertaintyMs(const Beacon &beacon) {
+  return ClampUncertaintyMs(beacon.uncertainty_ms + HOP_UNCERTAINTY_MS);
+}
+
+uint16_t EstimateUncertaintyMs(const uint16_t base_uncertainty_ms,
+                               const int64_t sync_age_us) {
+  const int64_t drift_ms =
+      (0 < sync_age_us) ? sync_age_us * DRIFT_UNCERTAINTY_PPM / 1000000000 : 0;
+  return ClampUncertaintyMs(base_uncertainty_ms + drift_ms);
+}
+
+int64_t CalcOffsetUs(const Beacon &beacon, const int64_t receive_local_us) {
+  // 送信側は更新間隔毎に時刻を書き換えるため、平均として半分進める
+  return beacon.epoch_ms * 1000 + UPDATE_INTERVAL_US / 2 - receive_local_us;
+}
+
+Selector::Selector() : has_best_(false), best_(), best_offset_us_(0) {}
+
+void Selector::Reset() { has_best_ = false; }
+
+bool Selector::Offer(const Beacon &beacon, const int64_t receive_local_us) {
+  if (MAX_HOPS <= beacon.hops) {
+    return false;
+  }
+  if (has_best_ && best_.uncertainty_ms <= beacon.uncertainty_ms) {
+    return false;
+  }
+  has_best_ = true;
+  best_ = beacon;
+  best_offset_us_ = CalcOffsetUs(beacon, receive_local_us);
+  return true;
+}
+
+bool Selector::GetBest(int64_t *const offset_us, Beacon *const beacon) const {
+  if (!has_best_) {
+    return false;
+  }
+  *offset_us = best_offset_us_;
+  *beacon = best_;
+  return true;
+}
+
+}  // namespace HareTortoiseClockSystem::TimeBeacon
@@ -0,0 +1,80 @@
+#ifndef TIME_BEACON_H_
+#define TIME_BEACON_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include <cstddef>
+#include <cstdint>
+
+/// 時計間の時刻伝搬ビーコン (アドバタイズのManufacturer Specific Data)
+/// 符号化と受信したビーコンの選択のみを行い、送受信はBleTimeBeaconが行う
+namespace HareTortoiseClockSystem::TimeBeacon {
+
+/// Company ID (0xFFFF:試験・社内用)
+constexpr uint16_t COMPANY_ID = 0xFFFF;
+/// ビーコン識別子
+constexpr uint8_t BEACON_ID = 0x54;
+/// Manufacturer Specific Data長 (CompanyID 2 + ID 1 + 時刻 6 + 段数 1 + 誤差 2)
+constexpr size_t MANUFACTURER_DATA_LENGTH = 12;
+/// 送信側の時刻更新間隔(us) 受信側は平均として半分を加える
+constexpr int64_t UPDATE_INTERVAL_US = 250000;
+/// 採用する最大の段数 (直接同期した時計を0とする)
+constexpr uint8_t MAX_HOPS = 8;
+
+struct Beacon {
+  /// 送信側の時刻 (Unix時間 ms)
+  int64_t epoch_ms;
+  /// 直接同期した時計からの段数
+  uint8_t hops;
+  /// 送信側の推定誤差(ms)
+  uint16_t uncertainty_ms;
+};
+
+/// Manufacturer Specific Dataへ変換 (書き込んだ長さ 不足時0)
+size_t Encode(const Beacon &beacon, uint8_t *const data, const size_t size);
+
+/// Manufacturer Specific Dataから変換
+bool Decode(const uint8_t *const data, const size_t length,
+            Beacon *const beacon);
+
+/// アドバタイズデータ(AD構造の列)からManufacturer Specific Dataを検索
+/// 見つからない場合nullptr
+const uint8_t *FindManufacturerData(const uint8_t *const adv_data,
+                                    const size_t length,
+                                    size_t *const data_length);
+
+/// 同期時点の誤差(ms) 段数のみ分かる場合の見積り (直接同期は0段)
+uint16_t CalcBaseUncertaintyMs(const uint8_t hops);
+
+/// ビーコンを採用した時点の誤差(ms) (送信側の誤差に1段分を加える)
+uint16_t CalcAdoptedUncertaintyMs(const Beacon &beacon);
+
+/// 現在の推定誤差(ms) 同期時点の誤差に経過時間分のずれを加える
+/// 子孫の誤差は常に祖先より大きくなるため、同期の循環は起きない
+uint16_t EstimateUncertaintyMs(const uint16_t base_uncertainty_ms,
+                               const int64_t sync_age_us);
+
+/// 受信時刻(ローカル Unix時間 us)から時刻差(us)を求める
+int64_t CalcOffsetUs(const Beacon &beacon, const int64_t receive_local_us);
+
+/// 受信したビーコンから最良のものを選択
+class Selector final {
+ public:
+  Selector();
+
+  void Reset();
+  /// 受信 (採用できない場合false)
+  bool Offer(const Beacon &beacon, const int64_t receive_local_us);
+  /// 最良のビーコンによる時刻差
+  bool GetBest(int64_t *const offset_us, Beacon *const beacon) const;
+
+ private:
+  bool has_best_;
+  Beacon best_;
+  int64_t best_offset_us_;
+};
+
+}  // namespace HareTortoiseClockSystem::TimeBeacon
+
+#endif  // TIME_BEACON_H_
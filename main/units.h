@@ -0,0 +1,90 @@
+#ifndef UNITS_H_
+#define UNITS_H_
+// ESP32 Hare Tortoise Clock
+// (C)2024 bekki.jp
+
+// Include ----------------------
+#include <cstdint>
+
+namespace HareTortoiseClockSystem {
+
+/// 単位付き整数値 (異なる単位同士の演算・代入はコンパイルエラー)
+template <typename TAG, typename REP>
+class Quantity {
+ public:
+  using Rep = REP;
+
+  constexpr Quantity() : value_(0) {}
+  constexpr explicit Quantity(const REP value) : value_(value) {}
+
+  constexpr REP Count() const { return value_; }
+
+  constexpr Quantity operator+(const Quantity rhs) const {
+    return Quantity(value_ + rhs.value_);
+  }
+  constexpr Quantity operator-(const Quantity rhs) const {
+    return Quantity(value_ - rhs.value_);
+  }
+  constexpr Quantity operator-() const { return Quantity(-value_); }
+  constexpr Quantity operator*(const REP rhs) const {
+    return Quantity(value_ * rhs);
+  }
+  constexpr Quantity operator/(const REP rhs) const {
+    return Quantity(value_ / rhs);
+  }
+  Quantity& operator+=(const Quantity rhs) {
+    value_ += rhs.value_;
+    return *this;
+  }
+  Quantity& operator-=(const Quantity rhs) {
+    value_ -= rhs.value_;
+    return *this;
+  }
+
+  constexpr bool operator==(const Quantity rhs) const {
+    return value_ == rhs.value_;
+  }
+  constexpr bool operator!=(const Quantity rhs) const {
+    return value_ != rhs.value_;
+  }
+  constexpr bool operator<(const Quantity rhs) const {
+    return value_ < rhs.value_;
+  }
+  constexpr bool operator<=(const Quantity rhs) const {
+    return value_ <= rhs.value_;
+  }
+  constexpr bool operator>(const Quantity rhs) const {
+    return value_ > rhs.value_;
+  }
+  constexpr bool operator>=(const Quantity rhs) const {
+    return value_ >= rhs.value_;
+  }
+
+  /// 絶対値
+  constexpr Quantity Abs() const {
+    return Quantity(value_ < 0 ? -value_ : value_);
+  }
+
+ private:
+  REP value_;
+};
+
+struct StepsTag {};
+struct MicrometresTag {};
+struct TicksTag {};
+
+/// モーターのステップ数 (マイクロステップ単位)
+using Steps = Quantity<StepsTag, int32_t>;
+/// 直線移動量 (μm)
+using Micrometres = Quantity<MicrometresTag, int32_t>;
+/// タイマーのカウント数
+using Ticks = Quantity<TicksTag, uint64_t>;
+
+/// mm から Micrometres を生成
+constexpr Micrometres Millimetres(const int32_t mm) {
+  return Micrometres(mm * 1000);
+}
+
+}  // namespace HareTortoiseClockSystem
+
+#endif  // UNITS_H_
@@ -4,44 +4,23 @@
 // Include ----------------------
 #include "util.h"
 
-#include <esp_sntp.h>
-#include <freertos/FreeRTOS.h>
-#include <freertos/task.h>
-#include <lwip/err.h>
-#include <lwip/sys.h>
+#include <sdkconfig.h>
 
-#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
 #include <iomanip>
 #include <sstream>
 
-#include "gpio_control.h"
+#include "local_time.h"
 #include "logger.h"
 
 namespace HareTortoiseClockSystem {
 namespace Util {
 
-/// Sleep
-void SleepMillisecond(const uint32_t sleep_milliseconds) {
-  TickType_t lastWakeTime = xTaskGetTickCount();
-  vTaskDelayUntil(&lastWakeTime, sleep_milliseconds / portTICK_PERIOD_MS);
-}
-
-std::time_t GetEpoch() {
-  std::chrono::system_clock::time_point now_time_point =
-      std::chrono::system_clock::now();
-  return std::chrono::system_clock::to_time_t(now_time_point);
-}
-
-/// SetTime
-void SetSystemTime(const std::time_t set_epoch_time) {
-  timeval set_time;
-  set_time.tv_sec = set_epoch_time;
-  set_time.tv_usec = 0;
-  settimeofday(&set_time, nullptr);
-}
-
 std::tm EpochToLocalTime(const std::time_t epoch) {
-  return *std::localtime(&epoch);
+  // localtimeは非リエントラントかつ毎回TZを解析するため使わない
+  return LocalTime::ToLocalTime(epoch);
 }
 
 std::tm GetLocalTime() { return EpochToLocalTime(GetEpoch()); }
@@ -58,9 +37,22 @@ std::string TimeToStr(const std::tm& time_info) {
 
 std::string GetNowTimeStr() { return TimeToStr(GetLocalTime()); }
 
+TimeStrBuffer TimeToStrBuffer(const std::tm& time_info) {
+  TimeStrBuffer buffer = {};
+  std::snprintf(buffer.data(), buffer.size(), "%04d/%02d/%02d %02d:%02d:%02d",
+                time_info.tm_year + 1900, time_info.tm_mon + 1,
+                time_info.tm_mday, time_info.tm_hour, time_info.tm_min,
+                time_info.tm_sec);
+  return buffer;
+}
+
 void InitTimeZone() {
   setenv("TZ", CONFIG_LOCAL_TIME_ZONE, 1);
   tzset();
+
+  if (!LocalTime::Initialize(CONFIG_LOCAL_TIME_ZONE)) {
+    ESP_LOGE(TAG, "Invalid Time Zone > %s (Use UTC)", CONFIG_LOCAL_TIME_ZONE);
+  }
 }
 
 /// Get ChronoMinutes from hours and minutes.
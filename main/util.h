@@ -4,12 +4,15 @@
 // (C)2024 bekki.jp
 
 // Include ----------------------
+#include <array>
 #include <chrono>
 #include <string>
 #include <vector>
 
 namespace HareTortoiseClockSystem::Util {
 
+// 待機・時刻の取得と設定はHALの各実装 (hal/*/system_clock.cc)
+
 /// Sleep
 void SleepMillisecond(const uint32_t sleep_milliseconds);
 
@@ -19,6 +22,17 @@ std::time_t GetEpoch();
 /// SetSystemTime
 void SetSystemTime(const std::time_t set_epoch_time);
 
+/// GetEpoch (Microseconds)
+int64_t GetEpochMicroseconds();
+
+/// Step System Time (Microseconds)
+/// 現在時刻の読み出しと設定は不可分ではないため、時計管理タスクのみから呼び出す
+void StepSystemTime(const int64_t offset_microseconds);
+
+/// Slew System Time (adjtime / Microseconds, added to the outstanding slew)
+/// 残量の読み出しと設定は不可分ではないため、時計管理タスクのみから呼び出す
+void SlewSystemTime(const int64_t offset_microseconds);
+
 /// Epoch To Local Time
 std::tm EpochToLocalTime(std::time_t epoch);
 
@@ -31,6 +45,13 @@ std::string TimeToStr(const std::tm& time_info);
 /// Get Now Date String (yyyy/dd/mm hh:mm:ss)
 std::string GetNowTimeStr();
 
+/// Fixed Size Time String (yyyy/dd/mm hh:mm:ss + NUL)
+/// 範囲外の値でも切り詰めないよう、6項目ともintの最大桁数(符号込み11文字)で確保
+using TimeStrBuffer = std::array<char, 6 * 11 + 5 + 1>;
+
+/// Get Time To String without heap allocation (yyyy/dd/mm hh:mm:ss)
+TimeStrBuffer TimeToStrBuffer(const std::tm& time_info);
+
 /// Get Time To String (yyyy/dd/mm hh:mm:ss)
 std::string TimeToStr(const std::tm& time_info);
 
@@ -0,0 +1,16 @@
+# Hare Tortoise Clock System sdkconfig for power management
+# idf.py -D SDKCONFIG_DEFAULTS="sdkconfig.defaults;sdkconfig.pm" build
+
+# Dynamic frequency scaling and automatic light sleep
+# (upper limit is the CPU frequency in sdkconfig.defaults)
+CONFIG_POWER_MANAGEMENT=y
+
+# BLE modem sleep between connection events, clocked by the 32kHz XTAL so the
+# chip can enter light sleep while advertising or connected
+# (requires a 32kHz crystal on XTAL_32K_P/N)
+CONFIG_BTDM_CTRL_MODEM_SLEEP=y
+CONFIG_BTDM_CTRL_MODEM_SLEEP_MODE_ORIG=y
+CONFIG_BTDM_CTRL_LPCLK_SEL_EXT_32K_XTAL=y
+# Place the light sleep entry/exit code in IRAM to shorten the wake up
+CONFIG_PM_SLP_IRAM_OPT=y
+CONFIG_PM_RTOS_IDLE_OPT=y
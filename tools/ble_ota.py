@@ -0,0 +1,181 @@
+#!/usr/bin/env python3
+# ESP32 Hare Tortoise Clock
+# (C)2024 bekki.jp
+"""BLEによるファームウェア更新 (OTA Characteristicのクライアント)
+
+イメージ長とSHA-256で開始し、データをWrite Without Responseで
+ウィンドウ数まで応答を待たずに送信する。再送要求・応答の途絶・切断時は
+開始を再送して時計が返す位置から続きを送る。完了後に再起動を指示する。
+OTA CharacteristicはMITM保護付きの暗号化が必要なため、事前にOSで
+時計とペアリングしておく (パスキーはmenuconfigの BLE_OTA_PASSKEY)。
+
+    pip install bleak
+    python3 tools/ble_ota.py build/hare_tortoise_clock.bin
+"""
+
+import argparse
+import asyncio
+import hashlib
+import struct
+import time
+
+from bleak import BleakClient, BleakScanner
+from bleak.exc import BleakError
+
+DEVICE_NAME = "HareTortoiseClock"
+OTA_CHARACTERISTIC_UUID = "6b1e9d47-3c25-4a8f-9e60-c4d2b7a1f853"
+
+OPERATION_BEGIN = 0x01
+OPERATION_DATA = 0x02
+OPERATION_END = 0x03
+OPERATION_APPLY = 0x05
+
+REPLY_READY = 0x81
+REPLY_ACK = 0x82
+REPLY_NACK = 0x83
+REPLY_DONE = 0x84
+
+RESULTS = ["OK", "NO_SPACE", "INVALID_STATE", "HASH_MISMATCH",
+           "INVALID_IMAGE", "FLASH_ERROR"]
+
+# 応答が途絶えたとみなす時間(sec)
+REPLY_TIMEOUT_SEC = 3.0
+# 接続・再開を試みる回数
+MAX_ATTEMPTS = 5
+
+
+class OtaSession:
+    def __init__(self, image):
+        self.image = image
+        self.digest = hashlib.sha256(image).digest()
+        self.acked = 0
+        self.window = 1
+        self.max_data = 20
+        self.resend_from = None
+        self.ready = asyncio.Event()
+        self.ack = asyncio.Event()
+        self.done = asyncio.Event()
+        self.result = None
+        self.bytes_per_sec = 0
+        self.elapsed_ms = 0
+
+    def on_notify(self, _sender, data):
+        reply = data[0]
+        if reply == REPLY_READY:
+            self.result, self.acked, self.window, self.max_data = \
+                struct.unpack(">BIHH", data[1:10])
+            self.ready.set()
+        elif reply == REPLY_ACK:
+            (self.acked,) = struct.unpack(">I", data[1:5])
+            self.ack.set()
+        elif reply == REPLY_NACK:
+            (self.resend_from,) = struct.unpack(">I", data[1:5])
+            self.ack.set()
+        elif reply == REPLY_DONE:
+            self.result, self.bytes_per_sec, self.elapsed_ms = \
+                struct.unpack(">BII", data[1:10])
+            self.done.set()
+
+    async def begin(self, client):
+        self.ready.clear()
+        await client.write_gatt_char(
+            OTA_CHARACTERISTIC_UUID,
+            struct.pack(">BI", OPERATION_BEGIN, len(self.image)) + self.digest,
+            response=True)
+        await asyncio.wait_for(self.ready.wait(), REPLY_TIMEOUT_SEC)
+        if self.result != 0:
+            raise RuntimeError(f"begin failed: {RESULTS[self.result]}")
+        # MTUに収まる長さに合わせる ([操作][位置]の5byteとATTヘッダ3byte)
+        self.max_data = min(self.max_data, client.mtu_size - 3 - 5)
+        print(f"begin offset:{self.acked} window:{self.window}"
+              f" chunk:{self.max_data}")
+
+    async def stream(self, client):
+        offset = self.acked
+        while self.acked < len(self.image):
+            # ウィンドウ内は応答を待たずに送る
+            while (offset < len(self.image) and
+                   offset < self.acked + self.window * self.max_data):
+                chunk = self.image[offset:offset + self.max_data]
+                await client.write_gatt_char(
+                    OTA_CHARACTERISTIC_UUID,
+                    struct.pack(">BI", OPERATION_DATA, offset) + chunk,
+                    response=False)
+                offset += len(chunk)
+            self.ack.clear()
+            try:
+                await asyncio.wait_for(self.ack.wait(), REPLY_TIMEOUT_SEC)
+            except asyncio.TimeoutError:
+                # 応答が途絶えた場合は開始を再送して位置を得る
+                await self.begin(client)
+                offset = self.acked
+                continue
+            if self.resend_from is not None:
+                offset = self.resend_from
+                self.resend_from = None
+            print(f"\r{self.acked}/{len(self.image)} byte", end="", flush=True)
+        print()
+
+    async def finish(self, client):
+        self.done.clear()
+        await client.write_gatt_char(OTA_CHARACTERISTIC_UUID,
+                                     bytes([OPERATION_END]), response=True)
+        # ハッシュ・イメージの検証を待つ
+        await asyncio.wait_for(self.done.wait(), REPLY_TIMEOUT_SEC * 10)
+        if self.result != 0:
+            raise RuntimeError(f"end failed: {RESULTS[self.result]}")
+        print(f"complete {len(self.image)} byte {self.elapsed_ms}ms"
+              f" {self.bytes_per_sec / 1000:.1f}kB/s")
+
+
+async def find_address(name):
+    device = await BleakScanner.find_device_by_name(name)
+    if device is None:
+        raise RuntimeError(f"{name} not found")
+    return device.address
+
+
+async def run(args):
+    with open(args.image, "rb") as f:
+        session = OtaSession(f.read())
+    address = args.address or await find_address(args.name)
+    print(f"{address} {len(session.image)} byte"
+          f" sha256:{session.digest.hex()}")
+
+    begin_time = time.monotonic()
+    for attempt in range(1, MAX_ATTEMPTS + 1):
+        try:
+            async with BleakClient(address) as client:
+                await client.start_notify(OTA_CHARACTERISTIC_UUID,
+                                          session.on_notify)
+                await session.begin(client)
+                await session.stream(client)
+                await session.finish(client)
+                if not args.no_apply:
+                    await client.write_gatt_char(OTA_CHARACTERISTIC_UUID,
+                                                 bytes([OPERATION_APPLY]),
+                                                 response=True)
+                    print("restart")
+                break
+        except (asyncio.TimeoutError, BleakError, OSError) as error:
+            # 切断時は再接続して続きから
+            print(f"\nretry {attempt}/{MAX_ATTEMPTS}: {error!r}")
+    else:
+        raise RuntimeError("update failed")
+    elapsed = time.monotonic() - begin_time
+    print(f"total {elapsed:.1f}s {len(session.image) / elapsed / 1000:.1f}kB/s")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("image", help="ファームウェアのイメージ (.bin)")
+    parser.add_argument("--name", default=DEVICE_NAME)
+    parser.add_argument("--address", help="指定時はスキャンしない")
+    parser.add_argument("--no-apply", action="store_true",
+                        help="完了後に再起動しない")
+    args = parser.parse_args()
+    asyncio.run(run(args))
+
+
+if __name__ == "__main__":
+    main()
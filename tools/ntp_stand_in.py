@@ -0,0 +1,60 @@
+#!/usr/bin/env python3
+# ESP32 Hare Tortoise Clock
+# (C)2024 bekki.jp
+"""ローカル検証用のNTPサーバー (SNTP同期の確認用)
+
+PCの時刻に任意のオフセットを加えて応答する。
+CONFIG_SNTP_SERVER にPCのIPアドレスを設定し、時計のログに出る
+"SNTP Sync > offset" が指定したオフセットと一致することを確認する。
+
+    sudo python3 tools/ntp_stand_in.py --offset-ms 250
+"""
+
+import argparse
+import socket
+import struct
+import time
+
+# 1900/1/1 から 1970/1/1 までの秒数
+NTP_EPOCH_OFFSET = 2208988800
+
+
+def to_ntp_timestamp(unix_time):
+    seconds = int(unix_time)
+    fraction = int((unix_time - seconds) * (1 << 32)) & 0xFFFFFFFF
+    return (seconds + NTP_EPOCH_OFFSET) & 0xFFFFFFFF, fraction
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--port", type=int, default=123)
+    parser.add_argument("--offset-ms", type=float, default=0.0,
+                        help="応答する時刻に加えるオフセット(ms)")
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(("0.0.0.0", args.port))
+    print(f"NTP stand-in on udp/{args.port} offset:{args.offset_ms}ms")
+
+    while True:
+        request, address = sock.recvfrom(512)
+        receive_time = time.time() + args.offset_ms / 1000.0
+        if len(request) < 48:
+            continue
+        # クライアントの送信時刻をOriginateとして返す
+        originate = request[40:48]
+        version = (request[0] >> 3) & 0x7
+        transmit_time = time.time() + args.offset_ms / 1000.0
+        response = struct.pack(
+            "!BBbbII4s", (0 << 6) | (version << 3) | 4, 1, 6, -20, 0, 0,
+            b"LOCL")
+        response += struct.pack("!II", *to_ntp_timestamp(receive_time))
+        response += originate
+        response += struct.pack("!II", *to_ntp_timestamp(receive_time))
+        response += struct.pack("!II", *to_ntp_timestamp(transmit_time))
+        sock.sendto(response, address)
+        print(f"{address[0]} served")
+
+
+if __name__ == "__main__":
+    main()